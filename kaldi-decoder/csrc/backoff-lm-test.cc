@@ -0,0 +1,140 @@
+// kaldi-decoder/csrc/backoff-lm-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/backoff-lm.h"
+
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace kaldi_decoder {
+
+static const char *kArpa = R"(
+\data\
+ngram 1=6
+ngram 2=4
+ngram 3=2
+
+\1-grams:
+-1.0	</s>
+-99	<s>	-0.5
+-0.5	a	-0.3
+-0.7	b	-0.2
+-1.2	c
+-0.9	oov
+
+\2-grams:
+-0.2	<s> a	-0.1
+-0.4	a b	-0.25
+-0.3	b </s>
+-0.6	b c
+
+\3-grams:
+-0.1	<s> a b
+-0.05	a b c
+
+\end\
+)";
+
+static constexpr float kLn10 = 2.302585093f;
+
+TEST(ReadSymbolTable, Basic) {
+  std::istringstream is("<eps> 0\na 1\n\nb 2\n");
+  auto table = ReadSymbolTable(is);
+  ASSERT_EQ(table.size(), 3);
+  EXPECT_EQ(table["<eps>"], 0);
+  EXPECT_EQ(table["b"], 2);
+
+  std::istringstream bad("a\n");
+  EXPECT_THROW(ReadSymbolTable(bad), std::runtime_error);
+}
+
+TEST(ArpaBackoffLm, Costs) {
+  std::istringstream is(kArpa);
+  ArpaBackoffLm lm(is, {{"a", 1}, {"b", 2}, {"c", 3}});
+  EXPECT_EQ(lm.Order(), 3);
+
+  int32_t s = lm.Start(), next;
+  float cost;
+
+  // <s> a
+  ASSERT_TRUE(lm.GetArc(s, 1, &next, &cost));
+  EXPECT_NEAR(cost, 0.2 * kLn10, 1e-4);
+  int32_t s_a = next;
+
+  // <s> a b
+  ASSERT_TRUE(lm.GetArc(s_a, 2, &next, &cost));
+  EXPECT_NEAR(cost, 0.1 * kLn10, 1e-4);
+  int32_t a_b = next;
+
+  // a b c, whose next state is the history "b c"
+  ASSERT_TRUE(lm.GetArc(a_b, 3, &next, &cost));
+  EXPECT_NEAR(cost, 0.05 * kLn10, 1e-4);
+
+  // b c a: backs off to the unigram of a; "b c" and "c" have no back-off
+  // weights
+  ASSERT_TRUE(lm.GetArc(next, 1, &next, &cost));
+  EXPECT_NEAR(cost, 0.5 * kLn10, 1e-4);
+
+  // <s> a c: backs off twice
+  ASSERT_TRUE(lm.GetArc(s_a, 3, &next, &cost));
+  EXPECT_NEAR(cost, (0.1 + 0.3 + 1.2) * kLn10, 1e-4);
+
+  // a b </s>: backs off to "b </s>"
+  EXPECT_NEAR(lm.Final(a_b), (0.25 + 0.3) * kLn10, 1e-4);
+
+  // Words not in the symbol table, like "oov", are not accepted
+  EXPECT_FALSE(lm.GetArc(s, 4, &next, &cost));
+}
+
+TEST(ArpaBackoffLm, Errors) {
+  std::string arpa = kArpa;
+  std::istringstream truncated(arpa.substr(0, arpa.find("\\end\\")));
+  EXPECT_THROW(ArpaBackoffLm(truncated, {{"a", 1}}), std::runtime_error);
+
+  std::istringstream empty("");
+  EXPECT_THROW(ArpaBackoffLm(empty, {{"a", 1}}), std::runtime_error);
+}
+
+TEST(FstBackoffLm, Costs) {
+  // A bigram LM: state 0 has the unigrams, state 1 is after <s> and state 2
+  // is after "a"
+  fst::StdVectorFst g;
+  for (int32_t i = 0; i != 3; ++i) {
+    g.AddState();
+  }
+  g.SetStart(1);
+  g.AddArc(0, fst::StdArc(1, 1, 0.5, 2));
+  g.AddArc(0, fst::StdArc(2, 2, 0.7, 0));
+  g.SetFinal(0, 1.0);
+  g.AddArc(1, fst::StdArc(1, 1, 0.2, 2));
+  g.AddArc(1, fst::StdArc(0, 0, 0.5, 0));
+  g.AddArc(2, fst::StdArc(2, 2, 0.4, 0));
+  g.AddArc(2, fst::StdArc(0, 0, 0.3, 0));
+
+  FstBackoffLm lm(g);
+  EXPECT_EQ(lm.Start(), 1);
+
+  int32_t next;
+  float cost;
+  ASSERT_TRUE(lm.GetArc(1, 1, &next, &cost));
+  EXPECT_EQ(next, 2);
+  EXPECT_NEAR(cost, 0.2, 1e-6);
+
+  ASSERT_TRUE(lm.GetArc(1, 2, &next, &cost));
+  EXPECT_EQ(next, 0);
+  EXPECT_NEAR(cost, 0.5 + 0.7, 1e-6);
+
+  ASSERT_TRUE(lm.GetArc(2, 2, &next, &cost));
+  EXPECT_NEAR(cost, 0.4, 1e-6);
+
+  EXPECT_NEAR(lm.Final(2), 0.3 + 1.0, 1e-6);
+  EXPECT_EQ(lm.Final(0), 1.0);
+
+  EXPECT_FALSE(lm.GetArc(2, 3, &next, &cost));
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,310 @@
+// kaldi-decoder/csrc/backoff-lm.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/backoff-lm.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <utility>
+
+#include "kaldi-decoder/csrc/log.h"
+
+namespace kaldi_decoder {
+
+// IDs of <s> and </s> in ArpaBackoffLm; the IDs of a symbol table are
+// non-negative.
+static constexpr int32_t kBosId = -1;
+static constexpr int32_t kEosId = -2;
+
+// ARPA files use log10 probabilities
+static constexpr float kLn10 = 2.302585093f;
+
+std::unordered_map<std::string, int32_t> ReadSymbolTable(std::istream &is) {
+  std::unordered_map<std::string, int32_t> ans;
+  std::string line;
+  int32_t line_number = 0;
+  while (std::getline(is, line)) {
+    ++line_number;
+    std::istringstream iss(line);
+    std::string symbol;
+    int32_t id;
+    if (!(iss >> symbol)) {
+      continue;  // empty line
+    }
+    if (!(iss >> id)) {
+      KALDI_DECODER_ERR << "Bad line " << line_number
+                        << " in symbol table: " << line;
+    }
+    ans[symbol] = id;
+  }
+  return ans;
+}
+
+ArpaBackoffLm::ArpaBackoffLm(
+    std::istream &is,
+    const std::unordered_map<std::string, int32_t> &symbol_table) {
+  struct Entry {
+    std::vector<int32_t> words;
+    float cost;
+    float backoff_cost;
+  };
+  std::vector<Entry> entries;
+
+  std::string line;
+  int32_t cur_order = 0;
+  int32_t num_skipped = 0;
+  bool seen_end = false;
+  while (std::getline(is, line)) {
+    std::istringstream iss(line);
+    std::string first;
+    if (!(iss >> first)) {
+      continue;  // empty line
+    }
+
+    if (first == "\\data\\") {
+      continue;
+    }
+
+    if (first == "\\end\\") {
+      seen_end = true;
+      break;
+    }
+
+    if (first == "ngram") {
+      // e.g., ngram 3=12345
+      std::string count;
+      iss >> count;
+      order_ = std::max(order_, std::atoi(count.c_str()));
+      continue;
+    }
+
+    if (first[0] == '\\') {
+      // e.g., \3-grams:
+      cur_order = std::atoi(first.c_str() + 1);
+      if (cur_order <= 0 || cur_order > order_) {
+        KALDI_DECODER_ERR << "Bad section in ARPA file: " << line;
+      }
+      continue;
+    }
+
+    if (cur_order == 0) {
+      KALDI_DECODER_ERR << "Unexpected line in ARPA file: " << line;
+    }
+
+    Entry entry;
+    entry.cost = -std::atof(first.c_str()) * kLn10;
+    bool known = true;
+    for (int32_t i = 0; i != cur_order; ++i) {
+      std::string word;
+      if (!(iss >> word)) {
+        KALDI_DECODER_ERR << "Bad " << cur_order
+                          << "-gram in ARPA file: " << line;
+      }
+
+      if (word == "<s>") {
+        entry.words.push_back(kBosId);
+      } else if (word == "</s>") {
+        entry.words.push_back(kEosId);
+      } else {
+        auto iter = symbol_table.find(word);
+        if (iter == symbol_table.end()) {
+          known = false;
+        } else {
+          entry.words.push_back(iter->second);
+        }
+      }
+    }
+
+    float backoff = 0;
+    iss >> backoff;
+    entry.backoff_cost = -backoff * kLn10;
+
+    if (known) {
+      entries.push_back(std::move(entry));
+    } else {
+      ++num_skipped;
+    }
+  }
+
+  if (!seen_end || order_ == 0) {
+    KALDI_DECODER_ERR << "The ARPA file is truncated or empty";
+  }
+
+  if (num_skipped != 0) {
+    KALDI_DECODER_WARN << "Skipped " << num_skipped
+                       << " n-grams with words not in the symbol table";
+  }
+
+  // States are the histories of fewer than order_ words. The n-grams of
+  // lower orders come first in the file, so a history is always created
+  // before it is needed as the next state of an n-gram.
+  HistoryMap histories;
+  histories[{}] = 0;
+  states_.push_back({-1, 0});
+  for (const auto &e : entries) {
+    if (static_cast<int32_t>(e.words.size()) < order_) {
+      int32_t s = FindOrAddState(e.words, &histories);
+      states_[s].backoff_cost = e.backoff_cost;
+    }
+  }
+
+  ngrams_.reserve(entries.size());
+  for (const auto &e : entries) {
+    std::vector<int32_t> history(e.words.begin(), e.words.end() - 1);
+    int32_t state = FindOrAddState(history, &histories);
+
+    // The next state is the longest suffix of the n-gram that is a history
+    std::vector<int32_t> next = e.words;
+    if (static_cast<int32_t>(next.size()) >= order_) {
+      next.erase(next.begin());
+    }
+    auto iter = histories.find(next);
+    while (iter == histories.end()) {
+      next.erase(next.begin());
+      iter = histories.find(next);
+    }
+
+    ngrams_[Key(state, e.words.back())] = {iter->second, e.cost};
+  }
+
+  auto iter = histories.find({kBosId});
+  start_ = (iter != histories.end()) ? iter->second : 0;
+}
+
+int32_t ArpaBackoffLm::FindOrAddState(const std::vector<int32_t> &history,
+                                      HistoryMap *histories) {
+  auto iter = histories->find(history);
+  if (iter != histories->end()) {
+    return iter->second;
+  }
+
+  std::vector<int32_t> suffix(history.begin() + 1, history.end());
+  int32_t backoff_state = FindOrAddState(suffix, histories);
+
+  int32_t state = static_cast<int32_t>(states_.size());
+  states_.push_back({backoff_state, 0});
+  (*histories)[history] = state;
+  return state;
+}
+
+bool ArpaBackoffLm::GetArc(int32_t state, int32_t word, int32_t *next_state,
+                           float *cost) const {
+  KALDI_DECODER_ASSERT(state >= 0 && state < NumStates());
+
+  float backoff_cost = 0;
+  while (true) {
+    auto iter = ngrams_.find(Key(state, word));
+    if (iter != ngrams_.end()) {
+      *next_state = iter->second.next_state;
+      *cost = backoff_cost + iter->second.cost;
+      return true;
+    }
+
+    const State &s = states_[state];
+    if (s.backoff_state < 0) {
+      return false;
+    }
+    backoff_cost += s.backoff_cost;
+    state = s.backoff_state;
+  }
+}
+
+float ArpaBackoffLm::Final(int32_t state) const {
+  int32_t next_state;
+  float cost;
+  if (GetArc(state, kEosId, &next_state, &cost)) {
+    return cost;
+  }
+  return std::numeric_limits<float>::infinity();
+}
+
+FstBackoffLm::FstBackoffLm(const fst::Fst<fst::StdArc> &fst) {
+  using StateId = fst::StdArc::StateId;
+
+  float infinity = std::numeric_limits<float>::infinity();
+
+  StateId num_states = 0;
+  for (fst::StateIterator<fst::Fst<fst::StdArc>> siter(fst); !siter.Done();
+       siter.Next()) {
+    num_states = std::max(num_states, siter.Value() + 1);
+  }
+  if (fst.Start() == fst::kNoStateId) {
+    KALDI_DECODER_ERR << "FstBackoffLm: the FST is empty";
+  }
+  start_ = fst.Start();
+
+  states_.resize(num_states, {0, 0, -1, 0, infinity});
+  for (StateId s = 0; s != num_states; ++s) {
+    State &state = states_[s];
+    state.arc_begin = static_cast<int32_t>(arcs_.size());
+    state.final_cost = fst.Final(s).Value();
+
+    for (fst::ArcIterator<fst::Fst<fst::StdArc>> aiter(fst, s); !aiter.Done();
+         aiter.Next()) {
+      const auto &arc = aiter.Value();
+      if (arc.ilabel == 0) {
+        if (state.backoff_state != -1) {
+          KALDI_DECODER_ERR << "FstBackoffLm: state " << s
+                            << " has more than one back-off arc";
+        }
+        state.backoff_state = arc.nextstate;
+        state.backoff_cost = arc.weight.Value();
+      } else {
+        arcs_.push_back({arc.ilabel, arc.nextstate, arc.weight.Value()});
+      }
+    }
+
+    state.arc_end = static_cast<int32_t>(arcs_.size());
+    std::sort(arcs_.begin() + state.arc_begin, arcs_.end());
+  }
+}
+
+bool FstBackoffLm::GetArc(int32_t state, int32_t word, int32_t *next_state,
+                          float *cost) const {
+  KALDI_DECODER_ASSERT(state >= 0 &&
+                       state < static_cast<int32_t>(states_.size()));
+  KALDI_DECODER_ASSERT(word != 0);
+
+  float backoff_cost = 0;
+  while (true) {
+    const State &s = states_[state];
+    auto begin = arcs_.begin() + s.arc_begin;
+    auto end = arcs_.begin() + s.arc_end;
+    auto iter = std::lower_bound(begin, end, Arc{word, 0, 0});
+    if (iter != end && iter->word == word) {
+      *next_state = iter->next_state;
+      *cost = backoff_cost + iter->cost;
+      return true;
+    }
+
+    if (s.backoff_state < 0) {
+      return false;
+    }
+    backoff_cost += s.backoff_cost;
+    state = s.backoff_state;
+  }
+}
+
+float FstBackoffLm::Final(int32_t state) const {
+  KALDI_DECODER_ASSERT(state >= 0 &&
+                       state < static_cast<int32_t>(states_.size()));
+
+  float backoff_cost = 0;
+  while (true) {
+    const State &s = states_[state];
+    if (s.final_cost != std::numeric_limits<float>::infinity()) {
+      return backoff_cost + s.final_cost;
+    }
+
+    if (s.backoff_state < 0) {
+      return s.final_cost;
+    }
+    backoff_cost += s.backoff_cost;
+    state = s.backoff_state;
+  }
+}
+
+}  // namespace kaldi_decoder
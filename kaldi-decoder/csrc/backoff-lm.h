@@ -0,0 +1,130 @@
+// kaldi-decoder/csrc/backoff-lm.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_BACKOFF_LM_H_
+#define KALDI_DECODER_CSRC_BACKOFF_LM_H_
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "fst/fst.h"
+#include "kaldi-decoder/csrc/deterministic-lm.h"
+
+namespace kaldi_decoder {
+
+/// Reads a symbol table in the text format of OpenFst, e.g., words.txt,
+/// where each line has a symbol and its integer ID.
+std::unordered_map<std::string, int32_t> ReadSymbolTable(std::istream &is);
+
+/** A back-off n-gram LM read from a file in the ARPA format.
+
+    Words are mapped to IDs with a symbol table, which must be the one of
+    the output labels of the decoding graph. N-grams with words that are
+    not in the table are skipped. <s> and </s> need not be in the table;
+    they are handled by Start() and Final().
+ */
+class ArpaBackoffLm : public DeterministicLm {
+ public:
+  ArpaBackoffLm(std::istream &is,
+                const std::unordered_map<std::string, int32_t> &symbol_table);
+
+  int32_t Start() const override { return start_; }
+
+  float Final(int32_t state) const override;
+
+  bool GetArc(int32_t state, int32_t word, int32_t *next_state,
+              float *cost) const override;
+
+  /// The largest n of the n-grams
+  int32_t Order() const { return order_; }
+
+  int32_t NumStates() const { return static_cast<int32_t>(states_.size()); }
+
+ private:
+  struct State {
+    int32_t backoff_state;  // -1 for the empty history
+    float backoff_cost;
+  };
+
+  struct NGram {
+    int32_t next_state;
+    float cost;
+  };
+
+  struct VectorHasher {
+    size_t operator()(const std::vector<int32_t> &v) const {
+      size_t ans = v.size();
+      for (int32_t i : v) {
+        ans = ans * 7853 + static_cast<size_t>(i);
+      }
+      return ans;
+    }
+  };
+
+  using HistoryMap =
+      std::unordered_map<std::vector<int32_t>, int32_t, VectorHasher>;
+
+  static uint64_t Key(int32_t state, int32_t word) {
+    return (static_cast<uint64_t>(state) << 32) | static_cast<uint32_t>(word);
+  }
+
+  // Returns the state of the history, which is added if needed, together
+  // with the states of its suffixes.
+  int32_t FindOrAddState(const std::vector<int32_t> &history,
+                         HistoryMap *histories);
+
+  int32_t order_ = 0;
+  int32_t start_ = 0;
+  std::vector<State> states_;
+  std::unordered_map<uint64_t, NGram> ngrams_;
+};
+
+/** A back-off LM given as an FST, e.g., the G.fst that Kaldi's arpa2fst
+    creates: the back-off arcs have epsilon input labels, and the
+    disambiguation symbol on them, if any, must have been replaced by
+    epsilon. Like Kaldi's BackoffDeterministicOnDemandFst, it follows the
+    back-off arcs for the words that a state has no arc for.
+
+    The arcs are indexed on construction, so that lookups are fast and
+    thread-safe; the FST is not used afterwards.
+ */
+class FstBackoffLm : public DeterministicLm {
+ public:
+  explicit FstBackoffLm(const fst::Fst<fst::StdArc> &fst);
+
+  int32_t Start() const override { return start_; }
+
+  float Final(int32_t state) const override;
+
+  bool GetArc(int32_t state, int32_t word, int32_t *next_state,
+              float *cost) const override;
+
+ private:
+  struct Arc {
+    int32_t word;
+    int32_t next_state;
+    float cost;
+
+    bool operator<(const Arc &other) const { return word < other.word; }
+  };
+
+  struct State {
+    int32_t arc_begin;      // index into arcs_; the arcs are sorted by word
+    int32_t arc_end;
+    int32_t backoff_state;  // -1 if there is no back-off arc
+    float backoff_cost;
+    float final_cost;
+  };
+
+  int32_t start_ = 0;
+  std::vector<State> states_;
+  std::vector<Arc> arcs_;
+};
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_BACKOFF_LM_H_
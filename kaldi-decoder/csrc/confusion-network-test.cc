@@ -0,0 +1,62 @@
+// kaldi-decoder/csrc/confusion-network-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/confusion-network.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace kaldi_decoder {
+
+static void ExpectBin(const ConfusionBin &bin,
+                      const std::vector<WordPosterior> &expected) {
+  ASSERT_EQ(bin.words.size(), expected.size());
+  for (size_t i = 0; i != expected.size(); ++i) {
+    EXPECT_EQ(bin.words[i].word, expected[i].word);
+    EXPECT_EQ(bin.words[i].frame, expected[i].frame);
+    EXPECT_NEAR(bin.words[i].posterior, expected[i].posterior, 1e-5);
+  }
+}
+
+TEST(ConfusionNetwork, Build) {
+  std::vector<WordPosterior> best_path = {{5, 10, 0.7}, {6, 30, 0.9}};
+  std::vector<WordPosterior> posteriors = {
+      {5, 10, 0.7},  {7, 12, 0.2},  {6, 30, 0.9},
+      {6, 31, 0.05}, {8, 50, 0.3},  {4, 10, 0.0005},
+      {9, 52, 0.1},  {3, 70, 0.25},
+  };
+
+  ConfusionNetworkOptions opts(1.0, 5, 1e-3);
+  std::vector<ConfusionBin> bins =
+      BuildConfusionNetwork(posteriors, best_path, opts);
+  ASSERT_EQ(bins.size(), 4);
+
+  ExpectBin(bins[0], {{5, 10, 0.7}, {7, 12, 0.2}, {0, 10, 0.1}});
+  ExpectBin(bins[1], {{6, 30, 0.95}, {0, 30, 0.05}});
+
+  // Words far from the best path are clustered into other bins
+  ExpectBin(bins[2], {{0, 50, 0.6}, {8, 50, 0.3}, {9, 52, 0.1}});
+  ExpectBin(bins[3], {{0, 70, 0.75}, {3, 70, 0.25}});
+
+  std::vector<WordPosterior> words = MbrDecode(bins);
+  ASSERT_EQ(words.size(), 2);
+  EXPECT_EQ(words[0].word, 5);
+  EXPECT_NEAR(words[0].posterior, 0.7, 1e-5);
+  EXPECT_EQ(words[1].word, 6);
+  EXPECT_NEAR(words[1].posterior, 0.95, 1e-5);
+
+  // Occurrences on the same path can sum to more than 1
+  posteriors = {{5, 10, 0.7}, {5, 14, 0.6}, {6, 30, 0.9}};
+  bins = BuildConfusionNetwork(posteriors, best_path, opts);
+  ASSERT_EQ(bins.size(), 2);
+  ExpectBin(bins[0], {{5, 10, 1.0}});
+
+  // No best path: all the words go to clustered bins
+  bins = BuildConfusionNetwork(posteriors, {}, opts);
+  ASSERT_EQ(bins.size(), 2);
+  EXPECT_TRUE(MbrDecode({}).empty());
+}
+
+}  // namespace kaldi_decoder
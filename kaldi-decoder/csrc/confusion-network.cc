@@ -0,0 +1,168 @@
+// kaldi-decoder/csrc/confusion-network.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/confusion-network.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+
+namespace kaldi_decoder {
+
+namespace {
+
+// Accumulates the words of a bin
+class BinBuilder {
+ public:
+  void Add(const WordPosterior &w) {
+    Entry &e = entries_[w.word];
+    e.sum += w.posterior;
+    if (w.posterior > e.best) {
+      e.best = w.posterior;
+      e.frame = w.frame;
+    }
+  }
+
+  bool Empty() const { return entries_.empty(); }
+
+  // Returns the bin; "frame" is the frame of the deletion entry.
+  ConfusionBin Finish(int32_t frame) const {
+    ConfusionBin bin;
+    float total = 0;
+    for (const auto &p : entries_) {
+      total += p.second.sum;
+    }
+
+    // Several occurrences of a word on the same path can fall into the
+    // same bin, so the sum can exceed 1.
+    float scale = total > 1 ? 1 / total : 1;
+    for (const auto &p : entries_) {
+      bin.words.push_back({p.first, p.second.frame, p.second.sum * scale});
+    }
+    if (total < 1) {
+      bin.words.push_back({0, frame, 1 - total});
+    }
+
+    std::stable_sort(bin.words.begin(), bin.words.end(),
+                     [](const WordPosterior &a, const WordPosterior &b) {
+                       return a.posterior > b.posterior;
+                     });
+    return bin;
+  }
+
+ private:
+  struct Entry {
+    float sum = 0;
+    float best = -1;
+    int32_t frame = 0;
+  };
+
+  std::map<int32_t, Entry> entries_;  // ordered, for a deterministic output
+};
+
+}  // namespace
+
+std::vector<ConfusionBin> BuildConfusionNetwork(
+    const std::vector<WordPosterior> &posteriors,
+    const std::vector<WordPosterior> &best_path,
+    const ConfusionNetworkOptions &opts) {
+  opts.Check();
+
+  int32_t num_pivots = static_cast<int32_t>(best_path.size());
+  std::vector<int32_t> pivot_frames(num_pivots);
+  for (int32_t i = 0; i != num_pivots; ++i) {
+    pivot_frames[i] = best_path[i].frame;
+    if (i > 0) {
+      KALDI_DECODER_ASSERT(pivot_frames[i] >= pivot_frames[i - 1]);
+    }
+  }
+
+  std::vector<BinBuilder> pivot_bins(num_pivots);
+
+  // gaps[k] has the words before the k-th word of the best path that are
+  // not close to any of its words
+  std::vector<std::vector<WordPosterior>> gaps(num_pivots + 1);
+
+  for (const auto &w : posteriors) {
+    if (w.word == 0 || w.posterior < opts.min_posterior) {
+      continue;
+    }
+
+    int32_t k = std::lower_bound(pivot_frames.begin(), pivot_frames.end(),
+                                 w.frame) -
+                pivot_frames.begin();
+
+    // The nearest frame of the best path is the one of pivot k - 1 or k
+    int32_t nearest = -1;
+    if (k > 0) {
+      nearest = k - 1;
+    }
+    if (k < num_pivots &&
+        (nearest == -1 || pivot_frames[k] - w.frame <
+                              w.frame - pivot_frames[nearest])) {
+      nearest = k;
+    }
+
+    if (nearest == -1 ||
+        std::abs(pivot_frames[nearest] - w.frame) > opts.max_shift) {
+      gaps[k].push_back(w);
+      continue;
+    }
+
+    // Among the words of the best path on that frame, prefer the same word
+    int32_t frame = pivot_frames[nearest];
+    int32_t begin = std::lower_bound(pivot_frames.begin(), pivot_frames.end(),
+                                     frame) -
+                    pivot_frames.begin();
+    int32_t end = std::upper_bound(pivot_frames.begin(), pivot_frames.end(),
+                                   frame) -
+                  pivot_frames.begin();
+    int32_t pivot = begin;
+    for (int32_t i = begin; i != end; ++i) {
+      if (best_path[i].word == w.word) {
+        pivot = i;
+        break;
+      }
+    }
+    pivot_bins[pivot].Add(w);
+  }
+
+  std::vector<ConfusionBin> ans;
+  for (int32_t k = 0; k <= num_pivots; ++k) {
+    std::vector<WordPosterior> &gap = gaps[k];
+    std::stable_sort(gap.begin(), gap.end(),
+                     [](const WordPosterior &a, const WordPosterior &b) {
+                       return a.frame < b.frame;
+                     });
+
+    // Words of a gap are clustered by frame
+    for (size_t i = 0; i != gap.size();) {
+      BinBuilder builder;
+      int32_t first_frame = gap[i].frame;
+      for (; i != gap.size() && gap[i].frame - first_frame <= opts.max_shift;
+           ++i) {
+        builder.Add(gap[i]);
+      }
+      ans.push_back(builder.Finish(first_frame));
+    }
+
+    if (k < num_pivots) {
+      ans.push_back(pivot_bins[k].Finish(pivot_frames[k]));
+    }
+  }
+
+  return ans;
+}
+
+std::vector<WordPosterior> MbrDecode(const std::vector<ConfusionBin> &bins) {
+  std::vector<WordPosterior> ans;
+  for (const auto &bin : bins) {
+    if (!bin.words.empty() && bin.words[0].word != 0) {
+      ans.push_back(bin.words[0]);
+    }
+  }
+  return ans;
+}
+
+}  // namespace kaldi_decoder
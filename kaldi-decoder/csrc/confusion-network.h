@@ -0,0 +1,99 @@
+// kaldi-decoder/csrc/confusion-network.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_CONFUSION_NETWORK_H_
+#define KALDI_DECODER_CSRC_CONFUSION_NETWORK_H_
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "kaldi-decoder/csrc/log.h"
+
+namespace kaldi_decoder {
+
+/// A word starting at a frame, with its posterior probability, i.e., the
+/// total probability of the lattice paths that have it, divided by the
+/// total probability of all the paths.
+struct WordPosterior {
+  int32_t word;
+  int32_t frame;
+  float posterior;
+};
+
+struct ConfusionNetworkOptions {
+  // Scale of the acoustic costs when computing posteriors. The graph costs
+  // are not scaled.
+  float acoustic_scale;
+
+  // A word that starts at most this many frames away from a word of the
+  // best path competes with it, i.e., is put into its bin. Other words are
+  // put into bins between those of the best path.
+  int32_t max_shift;
+
+  // Words with a smaller posterior are not put into any bin
+  float min_posterior;
+
+  ConfusionNetworkOptions(float acoustic_scale = 1.0, int32_t max_shift = 10,
+                          float min_posterior = 1e-3)
+      : acoustic_scale(acoustic_scale),
+        max_shift(max_shift),
+        min_posterior(min_posterior) {}
+
+  void Check() const {
+    KALDI_DECODER_ASSERT(acoustic_scale > 0 && max_shift >= 0 &&
+                         min_posterior >= 0 && min_posterior < 1);
+  }
+
+  std::string ToString() const {
+    std::ostringstream os;
+
+    os << "ConfusionNetworkOptions(";
+    os << "acoustic_scale=" << acoustic_scale << ", ";
+    os << "max_shift=" << max_shift << ", ";
+    os << "min_posterior=" << min_posterior << ")";
+
+    return os.str();
+  }
+};
+
+/// A bin of a confusion network (a "sausage"): the words competing for the
+/// same position of the word sequence.
+struct ConfusionBin {
+  // Sorted by decreasing posterior. Word 0 stands for no word, i.e., the
+  // deletion of the position. The posteriors sum to 1. The frame of a word
+  // is the one of its most likely occurrence in the bin.
+  std::vector<WordPosterior> words;
+};
+
+/** Builds a confusion network from the word posteriors of a lattice, e.g.,
+    from LatticeSimpleDecoder::GetWordPosteriors(). It uses pivot alignment:
+    the words of the best path define the bins, and each other word goes to
+    the bin of the nearest word of the best path, if it starts at most
+    opts.max_shift frames away from it. Words farther from the best path go
+    to bins in between, clustered by the same distance.
+
+    This is much cheaper than the clustering of Kaldi's MinimumBayesRisk,
+    which needs a determinized lattice, and gives similar results when the
+    word boundaries are well defined, which is the case with CTC models.
+
+    @param posteriors The posteriors of the words of the lattice.
+    @param best_path  The words of the best path, in order.
+    @param opts       The options; acoustic_scale is not used here.
+    @return The bins, in the order of their frames.
+ */
+std::vector<ConfusionBin> BuildConfusionNetwork(
+    const std::vector<WordPosterior> &posteriors,
+    const std::vector<WordPosterior> &best_path,
+    const ConfusionNetworkOptions &opts);
+
+/// Returns the minimum Bayes risk word sequence of a confusion network:
+/// the most likely entry of each bin, unless it is no word. The posterior
+/// of each returned word is its confidence.
+std::vector<WordPosterior> MbrDecode(const std::vector<ConfusionBin> &bins);
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_CONFUSION_NETWORK_H_
@@ -0,0 +1,191 @@
+// kaldi-decoder/csrc/context-graph-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/context-graph.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/faster-decoder.h"
+#include "kaldi-decoder/csrc/lattice-simple-decoder.h"
+
+namespace kaldi_decoder {
+
+// Returns the total cost of passing the labels through the graph, including
+// the cost from Finalize()
+static float ComputeCost(const ContextGraph &graph,
+                         const std::vector<int32_t> &labels) {
+  int32_t state = graph.Root();
+  float cost = 0;
+  for (auto label : labels) {
+    cost += graph.ForwardOneStep(state, label, &state);
+  }
+  return cost + graph.Finalize(state);
+}
+
+// Returns the words, i.e., the non-epsilon output labels, of a linear lattice
+static std::vector<int32_t> GetWords(const fst::Lattice &best_path) {
+  std::vector<int32_t> ans;
+  int32_t s = best_path.Start();
+  for (;;) {
+    fst::ArcIterator<fst::Lattice> aiter(best_path, s);
+    if (aiter.Done()) {
+      break;
+    }
+    const auto &arc = aiter.Value();
+    if (arc.olabel != 0) {
+      ans.push_back(arc.olabel);
+    }
+    s = arc.nextstate;
+  }
+  return ans;
+}
+
+// Two word sequences, "103 101 103" and "103 102 103", where word w is made
+// of token w - 100. Word 102 costs 1 more than word 101. The paths do not
+// merge, so that the decoders compare the complete biasing costs of both;
+// in a word loop, tokens in the same state of the graph are recombined
+// whatever their state in the context graph.
+static fst::StdVectorFst BuildTwoPaths() {
+  fst::StdVectorFst g;
+  int32_t start = g.AddState();
+  int32_t first = g.AddState();
+  g.SetStart(start);
+  g.AddArc(start, fst::StdArc(3, 103, 3, first));
+  g.AddArc(first, fst::StdArc(3, 0, 0, first));
+
+  for (int32_t i : {1, 2}) {
+    int32_t second = g.AddState();
+    int32_t third = g.AddState();
+    g.AddArc(first, fst::StdArc(i, 100 + i, i == 1 ? 3 : 4, second));
+    g.AddArc(second, fst::StdArc(i, 0, 0, second));
+    g.AddArc(second, fst::StdArc(3, 103, 3, third));
+    g.AddArc(third, fst::StdArc(3, 0, 0, third));
+    g.SetFinal(third, 0);
+  }
+  return g;
+}
+
+// Returns the words that FasterDecoder and LatticeSimpleDecoder find with
+// the given context graph, which must be the same
+static std::vector<int32_t> Decode(const fst::StdVectorFst &g,
+                                   DecodableInterface *decodable,
+                                   const ContextGraph *context_graph) {
+  FasterDecoder decoder(g, FasterDecoderOptions(16.0));
+  decoder.SetContextGraph(context_graph);
+  decoder.Decode(decodable);
+  fst::Lattice best_path;
+  EXPECT_TRUE(decoder.GetBestPath(&best_path));
+  std::vector<int32_t> words = GetWords(best_path);
+
+  LatticeSimpleDecoder lattice_decoder(g, LatticeSimpleDecoderConfig(16.0));
+  lattice_decoder.SetContextGraph(context_graph);
+  lattice_decoder.Decode(decodable);
+  EXPECT_TRUE(lattice_decoder.GetBestPath(&best_path));
+  EXPECT_EQ(GetWords(best_path), words);
+
+  return words;
+}
+
+TEST(ContextGraph, FullMatch) {
+  ContextGraph graph({{1, 2, 3}, {2, 4}}, 1.0);
+
+  EXPECT_FLOAT_EQ(ComputeCost(graph, {1, 2, 3}), -3);
+  EXPECT_FLOAT_EQ(ComputeCost(graph, {2, 4}), -2);
+  EXPECT_FLOAT_EQ(ComputeCost(graph, {5, 1, 2, 3, 5}), -3);
+  EXPECT_FLOAT_EQ(ComputeCost(graph, {1, 2, 3, 2, 4}), -5);
+}
+
+TEST(ContextGraph, PartialMatchIsRolledBack) {
+  ContextGraph graph({{1, 2, 3}, {2, 4}}, 1.0);
+
+  EXPECT_FLOAT_EQ(ComputeCost(graph, {1, 2}), 0);
+  EXPECT_FLOAT_EQ(ComputeCost(graph, {1, 5}), 0);
+  EXPECT_FLOAT_EQ(ComputeCost(graph, {1, 2, 5, 6}), 0);
+
+  // After "1 2", label 4 is matched via the failure link to "2"
+  EXPECT_FLOAT_EQ(ComputeCost(graph, {1, 2, 4}), -2);
+
+  int32_t state = graph.Root();
+  EXPECT_FLOAT_EQ(graph.ForwardOneStep(state, 1, &state), -1);
+  EXPECT_FLOAT_EQ(graph.ForwardOneStep(state, 2, &state), -1);
+  EXPECT_FLOAT_EQ(graph.Finalize(state), 2);
+  EXPECT_FLOAT_EQ(graph.ForwardOneStep(state, 7, &state), 2);
+  EXPECT_EQ(state, graph.Root());
+}
+
+TEST(ContextGraph, PerPhraseBonus) {
+  ContextGraph graph({{1, 2}, {3}}, 1.0, {0.5, 2.0});
+
+  EXPECT_FLOAT_EQ(ComputeCost(graph, {1, 2}), -1);
+  EXPECT_FLOAT_EQ(ComputeCost(graph, {3}), -2);
+  EXPECT_FLOAT_EQ(ComputeCost(graph, {1, 3}), -2);
+}
+
+TEST(ContextGraph, SharedPrefix) {
+  ContextGraph graph({{1, 2}, {1, 2, 3}}, 1.0);
+
+  // "1 2" is a complete phrase, so its bonus is kept even if "3" does not
+  // follow
+  EXPECT_FLOAT_EQ(ComputeCost(graph, {1, 2}), -2);
+  EXPECT_FLOAT_EQ(ComputeCost(graph, {1, 2, 3}), -3);
+  EXPECT_FLOAT_EQ(ComputeCost(graph, {1, 2, 5}), -2);
+}
+
+TEST(ContextGraph, SuffixPhrase) {
+  ContextGraph graph({{1, 2, 3}, {2}}, 1.0);
+
+  // "2" is a phrase of its own, even if the match of "1 2 3" breaks off
+  EXPECT_FLOAT_EQ(ComputeCost(graph, {1, 2, 5}), -1);
+  EXPECT_FLOAT_EQ(ComputeCost(graph, {1, 2}), -1);
+  EXPECT_FLOAT_EQ(ComputeCost(graph, {1, 2, 3}), -4);
+  EXPECT_FLOAT_EQ(ComputeCost(graph, {1, 2, 2}), -2);
+
+  // Phrases ending at the same place are all credited
+  ContextGraph nested({{1, 2, 3, 4}, {2, 3}, {3}}, 1.0);
+  EXPECT_FLOAT_EQ(ComputeCost(nested, {1, 2, 3, 5}), -3);
+
+  int32_t state = nested.Root();
+  EXPECT_FLOAT_EQ(nested.ForwardOneStep(state, 1, &state), -1);
+  EXPECT_FLOAT_EQ(nested.ForwardOneStep(state, 2, &state), -1);
+  EXPECT_FLOAT_EQ(nested.ForwardOneStep(state, 3, &state), -4);
+  EXPECT_FLOAT_EQ(nested.Finalize(state), 3);
+}
+
+TEST(ContextGraph, Decoders) {
+  fst::StdVectorFst g = BuildTwoPaths();
+
+  // Token 3, then tokens 1 and 2 with the same probability, then token 3
+  FloatMatrix log_probs(9, 3);
+  log_probs.setConstant(-10);
+  for (int32_t t = 0; t != 3; ++t) {
+    log_probs(t, 2) = 0;
+    log_probs(t + 3, 0) = -0.7;
+    log_probs(t + 3, 1) = -0.7;
+    log_probs(t + 6, 2) = 0;
+  }
+  DecodableCtc decodable(log_probs);
+
+  std::vector<int32_t> without = {103, 101, 103};
+  std::vector<int32_t> with = {103, 102, 103};
+
+  // Without biasing, the graph prefers word 101
+  EXPECT_EQ(Decode(g, &decodable, nullptr), without);
+
+  ContextGraph hotword({{102}}, 2.0);
+  EXPECT_EQ(Decode(g, &decodable, &hotword), with);
+
+  // "103 102" is a partial match of the first phrase, whose bonus is taken
+  // back when "103" follows; the second phrase, which ends inside it, keeps
+  // its bonus.
+  ContextGraph suffix({{103, 102, 104}, {102}}, 2.0);
+  EXPECT_EQ(Decode(g, &decodable, &suffix), with);
+
+  // Without the second phrase, nothing is left of the bonus
+  ContextGraph partial({{103, 102, 104}}, 2.0);
+  EXPECT_EQ(Decode(g, &decodable, &partial), without);
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,162 @@
+// kaldi-decoder/csrc/context-graph.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/context-graph.h"
+
+#include <algorithm>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "kaldi-decoder/csrc/log.h"
+
+namespace kaldi_decoder {
+
+ContextGraph::ContextGraph(const std::vector<std::vector<int32_t>> &phrases,
+                           float bonus,
+                           const std::vector<float> &bonuses /*= {}*/) {
+  KALDI_DECODER_ASSERT(bonuses.empty() || bonuses.size() == phrases.size());
+
+  // children[i] contains (label, node) pairs of the children of node i
+  std::vector<std::vector<std::pair<int32_t, int32_t>>> children(1);
+  nodes_.emplace_back();  // the root
+
+  for (size_t i = 0; i != phrases.size(); ++i) {
+    const auto &phrase = phrases[i];
+    float this_bonus = bonuses.empty() ? bonus : bonuses[i];
+
+    if (phrase.empty()) {
+      KALDI_DECODER_ERR << "Empty phrase at index " << i;
+    }
+
+    int32_t cur = 0;
+    for (size_t j = 0; j != phrase.size(); ++j) {
+      int32_t label = phrase[j];
+      if (label == 0) {
+        KALDI_DECODER_ERR << "Epsilon is not allowed in phrases. Phrase index: "
+                          << i;
+      }
+
+      auto &c = children[cur];
+      auto iter = std::find_if(
+          c.begin(), c.end(),
+          [label](const std::pair<int32_t, int32_t> &p) {
+            return p.first == label;
+          });
+
+      int32_t next;
+      if (iter == c.end()) {
+        next = static_cast<int32_t>(nodes_.size());
+        nodes_.emplace_back();
+        nodes_.back().bonus = this_bonus;
+        children.emplace_back();
+        // Note: c may be invalidated by the emplace_back() above
+        children[cur].emplace_back(label, next);
+      } else {
+        // A prefix shared by several phrases keeps the largest bonus
+        next = iter->second;
+        nodes_[next].bonus = std::max(nodes_[next].bonus, this_bonus);
+      }
+
+      if (j + 1 == phrase.size()) {
+        nodes_[next].is_end = true;
+      }
+      cur = next;
+    }
+  }
+
+  Finish(&children);
+}
+
+void ContextGraph::Finish(
+    std::vector<std::vector<std::pair<int32_t, int32_t>>> *children) {
+  for (size_t i = 0; i != nodes_.size(); ++i) {
+    auto &c = (*children)[i];
+    std::sort(c.begin(), c.end());
+    nodes_[i].arcs_begin = static_cast<int32_t>(arcs_.size());
+    arcs_.insert(arcs_.end(), c.begin(), c.end());
+    nodes_[i].arcs_end = static_cast<int32_t>(arcs_.size());
+  }
+
+  // Breadth-first traversal, so that the failure link of a node is always
+  // available before we visit its children.
+  std::queue<int32_t> q;
+  q.push(0);
+  while (!q.empty()) {
+    int32_t node = q.front();
+    q.pop();
+
+    const Node &n = nodes_[node];
+    float base = (node == 0 || n.is_end) ? 0 : n.partial;
+
+    for (int32_t a = n.arcs_begin; a != n.arcs_end; ++a) {
+      int32_t label = arcs_[a].first;
+      Node &child = nodes_[arcs_[a].second];
+
+      child.partial = base + child.bonus;
+      child.unbanked = child.is_end ? 0 : child.partial;
+      child.total = n.total + child.bonus;
+
+      if (node == 0) {
+        child.fail = 0;
+      } else {
+        int32_t f = n.fail;
+        int32_t target = FindChild(f, label);
+        while (target == -1 && f != 0) {
+          f = nodes_[f].fail;
+          target = FindChild(f, label);
+        }
+        child.fail = (target == -1) ? 0 : target;
+      }
+
+      // The failure link is shallower than the child, so its output is
+      // already known
+      const Node &f = nodes_[child.fail];
+      child.output = (f.is_end ? f.total : 0) + f.output;
+
+      q.push(arcs_[a].second);
+    }
+  }
+}
+
+int32_t ContextGraph::FindChild(int32_t node, int32_t label) const {
+  auto begin = arcs_.begin() + nodes_[node].arcs_begin;
+  auto end = arcs_.begin() + nodes_[node].arcs_end;
+  auto iter = std::lower_bound(begin, end, std::make_pair(label, -1));
+  if (iter != end && iter->first == label) {
+    return iter->second;
+  }
+
+  return -1;
+}
+
+float ContextGraph::ForwardOneStep(int32_t state, int32_t label,
+                                   int32_t *next_state) const {
+  int32_t next = FindChild(state, label);
+  if (next != -1) {
+    // The match continues
+    *next_state = next;
+    return -nodes_[next].bonus - nodes_[next].output;
+  }
+
+  // The match breaks off. Follow the failure links to find the longest
+  // suffix that can be continued with this label.
+  int32_t node = state;
+  while (next == -1 && node != 0) {
+    node = nodes_[node].fail;
+    next = FindChild(node, label);
+  }
+
+  if (next == -1) {
+    next = 0;
+  }
+
+  *next_state = next;
+
+  // Take back the pending bonus of "state" and give the bonus of the
+  // partial match ending at "next" and of the phrases ending inside it
+  return nodes_[state].unbanked - nodes_[next].partial - nodes_[next].output;
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,111 @@
+// kaldi-decoder/csrc/context-graph.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_CONTEXT_GRAPH_H_
+#define KALDI_DECODER_CSRC_CONTEXT_GRAPH_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace kaldi_decoder {
+
+/** ContextGraph is a small prefix trie (with Aho-Corasick failure links) over
+    the output labels (usually word IDs) of the decoding graph. It is used for
+    contextual biasing, e.g., boosting per-request hotwords such as contact
+    names, without recompiling the decoding graph.
+
+    During decoding, each token carries a state of the ContextGraph. Whenever
+    a token crosses an arc with a non-epsilon output label, the decoder calls
+    ForwardOneStep() and adds the returned cost to the graph cost of the arc.
+    Matching a prefix of a phrase gives a bonus (a negative cost) for every
+    label matched; once the whole phrase is matched, the bonus is kept. If the
+    match breaks off in the middle of a phrase, the bonus collected so far is
+    taken back. Finalize() takes back the bonus of a partial match that is
+    still pending at the end of the utterance.
+
+    As in Aho-Corasick, a phrase that ends inside a longer match, e.g., "b"
+    in the partial match "a b" of "a b c", is credited with its whole bonus
+    when its last label is matched, whatever happens to the longer match.
+
+    The graph is immutable after construction, so one ContextGraph can be
+    shared by any number of decoders, even across threads.
+ */
+class ContextGraph {
+ public:
+  /// @param phrases  Each phrase is a sequence of output labels; 0 (epsilon)
+  ///                 is not allowed.
+  /// @param bonus    Bonus (>0 for boosting, <0 for penalizing) added to the
+  ///                 score for each matched label.
+  /// @param bonuses  If not empty, it has the same size as phrases and
+  ///                 overrides "bonus" per phrase.
+  ContextGraph(const std::vector<std::vector<int32_t>> &phrases, float bonus,
+               const std::vector<float> &bonuses = {});
+
+  /// The state every token starts from.
+  int32_t Root() const { return 0; }
+
+  int32_t NumStates() const { return static_cast<int32_t>(nodes_.size()); }
+
+  /// Advances "state" by the output label "label".
+  ///
+  /// @param state       The current state of the hypothesis.
+  /// @param label       A non-epsilon output label.
+  /// @param next_state  On return, it contains the new state.
+  /// @return Return the cost (negative for a bonus) to add to the hypothesis.
+  float ForwardOneStep(int32_t state, int32_t label, int32_t *next_state) const;
+
+  /// Returns the cost (>= 0 for boosting phrases) that takes back the bonus of
+  /// a phrase that has only been partially matched in "state".
+  float Finalize(int32_t state) const { return nodes_[state].unbanked; }
+
+ private:
+  struct Node {
+    // Bonus for the label on the arc entering this node.
+    float bonus = 0;
+
+    // Sum of the bonuses along the path from the root to this node since
+    // the last node that completed a phrase.
+    float partial = 0;
+
+    // The part of the bonus that is taken back if the match stops at this
+    // node. It is 0 for a node completing a phrase and "partial" otherwise.
+    float unbanked = 0;
+
+    bool is_end = false;
+
+    // Sum of the bonuses along the path from the root to this node
+    float total = 0;
+
+    // Sum of the bonuses of the phrases ending at proper suffixes of the path
+    // to this node, i.e., the nodes completing a phrase on the chain of
+    // failure links (the output links of Aho-Corasick). They are credited
+    // whenever this node is entered.
+    float output = 0;
+
+    // Failure link, i.e., the node for the longest proper suffix of the path
+    // to this node that is also a path from the root.
+    int32_t fail = 0;
+
+    // Children of this node, as a range in arcs_ sorted by label.
+    int32_t arcs_begin = 0;
+    int32_t arcs_end = 0;
+  };
+
+  // Returns the child of "node" with the given label, or -1 if none.
+  int32_t FindChild(int32_t node, int32_t label) const;
+
+  // Converts the temporary per-node child lists into the sorted arcs_ array
+  // and computes the failure links.
+  void Finish(std::vector<std::vector<std::pair<int32_t, int32_t>>> *children);
+
+  std::vector<Node> nodes_;
+
+  // (label, node) pairs; the children of a node are stored contiguously.
+  std::vector<std::pair<int32_t, int32_t>> arcs_;
+};
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_CONTEXT_GRAPH_H_
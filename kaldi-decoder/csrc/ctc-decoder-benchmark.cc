@@ -0,0 +1,190 @@
+// kaldi-decoder/csrc/ctc-decoder-benchmark.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+// Compares CtcDecoder on a lexicon graph (LG) with FasterDecoder on its
+// composition with the CTC topology (HLG). The log-probs are random, with
+// peaks along the tokens of a random word sequence.
+//
+// Usage:
+//   ./bin/ctc-decoder-benchmark [num_frames] [num_words] [num_tokens]
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "kaldi-decoder/csrc/ctc-decoder.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/faster-decoder.h"
+#include "kaldi-decoder/csrc/test-utils.h"
+
+namespace kaldi_decoder {
+
+// A lexicon loop with a unigram cost. Word i is 1 to 4 random tokens.
+static fst::StdVectorFst BuildLexicon(
+    int32_t num_words, int32_t num_tokens,
+    std::vector<std::vector<int32_t>> *words) {
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int32_t> length(1, 4);
+  std::uniform_int_distribution<int32_t> token(1, num_tokens - 1);
+
+  fst::StdVectorFst g;
+  g.AddState();
+  g.SetStart(0);
+  g.SetFinal(0, 0);
+  words->resize(num_words);
+  for (int32_t w = 0; w != num_words; ++w) {
+    int32_t n = length(gen);
+    int32_t prev = 0;
+    for (int32_t i = 0; i != n; ++i) {
+      (*words)[w].push_back(token(gen));
+      int32_t s = g.AddState();
+      g.AddArc(prev, fst::StdArc((*words)[w][i], i == 0 ? w + 1 : 0,
+                                 i == 0 ? 5 : 0, s));
+      prev = s;
+    }
+    g.AddArc(prev, fst::StdArc(0, 0, 0, 0));
+  }
+  return g;
+}
+
+// The same as CtcDecoder does implicitly: the states are pairs of (state of
+// the graph, label of the last token), with 0 after a blank.
+static fst::StdVectorFst ComposeCtcTopo(const fst::StdVectorFst &g) {
+  fst::StdVectorFst ans;
+  std::map<std::pair<int32_t, int32_t>, int32_t> ids;
+  std::vector<std::pair<int32_t, int32_t>> queue;
+
+  auto get_id = [&](int32_t s, int32_t label) {
+    auto it = ids.find({s, label});
+    if (it != ids.end()) {
+      return it->second;
+    }
+    int32_t id = ans.AddState();
+    ans.SetFinal(id, g.Final(s));
+    ids[{s, label}] = id;
+    queue.emplace_back(s, label);
+    return id;
+  };
+
+  ans.SetStart(get_id(g.Start(), 0));
+  while (!queue.empty()) {
+    auto [s, last] = queue.back();
+    queue.pop_back();
+    int32_t id = ids[{s, last}];
+
+    ans.AddArc(id, fst::StdArc(1, 0, 0, get_id(s, 0)));
+    if (last != 0) {
+      ans.AddArc(id, fst::StdArc(last, 0, 0, id));
+    }
+
+    for (fst::ArcIterator<fst::StdVectorFst> aiter(g, s); !aiter.Done();
+         aiter.Next()) {
+      const auto &arc = aiter.Value();
+      if (arc.ilabel == 0) {
+        ans.AddArc(id, fst::StdArc(0, arc.olabel, arc.weight,
+                                   get_id(arc.nextstate, last)));
+      } else if (arc.ilabel + 1 != last) {
+        ans.AddArc(id,
+                   fst::StdArc(arc.ilabel + 1, arc.olabel, arc.weight,
+                               get_id(arc.nextstate, arc.ilabel + 1)));
+      }
+    }
+  }
+  return ans;
+}
+
+// Each token of a random word sequence takes 2 frames, followed by 2 frames
+// of blank
+static std::vector<int32_t> FrameTokens(
+    const std::vector<std::vector<int32_t>> &words, int32_t num_frames) {
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<int32_t> word(0, words.size() - 1);
+
+  std::vector<int32_t> ans;
+  ans.reserve(num_frames + 4);
+  while (static_cast<int32_t>(ans.size()) < num_frames) {
+    for (int32_t token : words[word(gen)]) {
+      ans.insert(ans.end(), {token, token, 0, 0});
+    }
+  }
+  ans.resize(num_frames);
+  return ans;
+}
+
+static std::vector<int32_t> GetWords(const fst::Lattice &lat) {
+  std::vector<int32_t> ans;
+  for (int32_t s = lat.Start(); s != fst::kNoStateId;) {
+    fst::ArcIterator<fst::Lattice> aiter(lat, s);
+    if (aiter.Done()) {
+      break;
+    }
+    if (aiter.Value().olabel != 0) {
+      ans.push_back(aiter.Value().olabel);
+    }
+    s = aiter.Value().nextstate;
+  }
+  return ans;
+}
+
+static void Run(int32_t num_frames, int32_t num_words, int32_t num_tokens) {
+  std::vector<std::vector<int32_t>> words;
+  fst::StdVectorFst lg = BuildLexicon(num_words, num_tokens, &words);
+  fst::StdVectorFst hlg = ComposeCtcTopo(lg);
+
+  FloatMatrix log_probs = PeakyLogProbs(FrameTokens(words, num_frames),
+                                        num_tokens, 4, 1, /*seed=*/0);
+  DecodableCtc decodable(log_probs);
+
+  FasterDecoderOptions opts(12.0, 2000);
+
+  fprintf(stderr, "num_frames: %d, num_words: %d, num_tokens: %d\n",
+          num_frames, num_words, num_tokens);
+  fprintf(stderr, "LG: %d states, HLG: %d states\n", lg.NumStates(),
+          hlg.NumStates());
+
+  const int32_t num_runs = 3;
+  double faster_ms = 0;
+  double ctc_ms = 0;
+  fst::Lattice faster_path;
+  fst::Lattice ctc_path;
+  for (int32_t i = 0; i != num_runs; ++i) {
+    FasterDecoder faster_decoder(hlg, opts);
+    auto start = std::chrono::steady_clock::now();
+    faster_decoder.Decode(&decodable);
+    faster_decoder.GetBestPath(&faster_path);
+    double ms = ElapsedMs(start);
+    faster_ms = i == 0 ? ms : std::min(faster_ms, ms);
+
+    CtcDecoder ctc_decoder(lg, opts);
+    start = std::chrono::steady_clock::now();
+    ctc_decoder.Decode(&decodable);
+    ctc_decoder.GetBestPath(&ctc_path);
+    ms = ElapsedMs(start);
+    ctc_ms = i == 0 ? ms : std::min(ctc_ms, ms);
+  }
+
+  fprintf(stderr, "FasterDecoder with HLG: %.1f ms (best of %d)\n", faster_ms,
+          num_runs);
+  fprintf(stderr, "CtcDecoder with LG: %.1f ms (best of %d)\n", ctc_ms,
+          num_runs);
+  fprintf(stderr, "Speedup: %.2f\n", faster_ms / ctc_ms);
+  fprintf(stderr, "Same words: %s\n",
+          GetWords(faster_path) == GetWords(ctc_path) ? "yes" : "no");
+}
+
+}  // namespace kaldi_decoder
+
+int main(int argc, char *argv[]) {
+  int32_t num_frames = argc > 1 ? atoi(argv[1]) : 1000;
+  int32_t num_words = argc > 2 ? atoi(argv[2]) : 2000;
+  int32_t num_tokens = argc > 3 ? atoi(argv[3]) : 500;
+  kaldi_decoder::Run(num_frames, num_words, num_tokens);
+  return 0;
+}
@@ -0,0 +1,240 @@
+// kaldi-decoder/csrc/ctc-decoder-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/ctc-decoder.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/faster-decoder.h"
+
+namespace kaldi_decoder {
+
+// A lexicon loop: word w is 100 + w. The word of the tokens "3 3" needs a
+// blank in between.
+static fst::StdVectorFst BuildLexicon() {
+  std::vector<std::vector<int32_t>> words = {
+      {1}, {2, 3}, {3, 3}, {1, 2, 4}, {4}, {2, 1}};
+
+  fst::StdVectorFst g;
+  g.AddState();
+  g.SetStart(0);
+  g.SetFinal(0, 0);
+  for (size_t w = 0; w != words.size(); ++w) {
+    int32_t prev = 0;
+    for (size_t i = 0; i != words[w].size(); ++i) {
+      int32_t s = g.AddState();
+      int32_t olabel = i == 0 ? 101 + w : 0;
+      float cost = i == 0 ? 1 + 0.3 * w : 0;
+      g.AddArc(prev, fst::StdArc(words[w][i], olabel, cost, s));
+      prev = s;
+    }
+    // Back to the start with an epsilon arc
+    g.AddArc(prev, fst::StdArc(0, 0, 0.1, 0));
+  }
+  return g;
+}
+
+// The composition of the CTC topology and the graph, i.e., HLG for LG: its
+// states are pairs of (state of the graph, label of the last token), where
+// the label is 0 after a blank.
+static fst::StdVectorFst ComposeCtcTopo(const fst::StdVectorFst &g) {
+  fst::StdVectorFst ans;
+  std::map<std::pair<int32_t, int32_t>, int32_t> ids;
+  std::vector<std::pair<int32_t, int32_t>> queue;
+
+  auto get_id = [&](int32_t s, int32_t label) {
+    auto it = ids.find({s, label});
+    if (it != ids.end()) {
+      return it->second;
+    }
+    int32_t id = ans.AddState();
+    ans.SetFinal(id, g.Final(s));
+    ids[{s, label}] = id;
+    queue.emplace_back(s, label);
+    return id;
+  };
+
+  ans.SetStart(get_id(g.Start(), 0));
+  while (!queue.empty()) {
+    auto [s, last] = queue.back();
+    queue.pop_back();
+    int32_t id = ids[{s, last}];
+
+    ans.AddArc(id, fst::StdArc(1, 0, 0, get_id(s, 0)));
+    if (last != 0) {
+      ans.AddArc(id, fst::StdArc(last, 0, 0, id));
+    }
+
+    for (fst::ArcIterator<fst::StdVectorFst> aiter(g, s); !aiter.Done();
+         aiter.Next()) {
+      const auto &arc = aiter.Value();
+      if (arc.ilabel == 0) {
+        ans.AddArc(id, fst::StdArc(0, arc.olabel, arc.weight,
+                                   get_id(arc.nextstate, last)));
+      } else if (arc.ilabel + 1 != last) {
+        ans.AddArc(id,
+                   fst::StdArc(arc.ilabel + 1, arc.olabel, arc.weight,
+                               get_id(arc.nextstate, arc.ilabel + 1)));
+      }
+    }
+  }
+  return ans;
+}
+
+struct PathInfo {
+  std::vector<int32_t> ilabels;
+  std::vector<int32_t> olabels;
+  float graph_cost = 0;
+  float ac_cost = 0;
+};
+
+static PathInfo GetPathInfo(const fst::Lattice &lat) {
+  PathInfo ans;
+  for (int32_t s = lat.Start(); s != fst::kNoStateId;) {
+    fst::ArcIterator<fst::Lattice> aiter(lat, s);
+    if (aiter.Done()) {
+      ans.graph_cost += lat.Final(s).Value1();
+      break;
+    }
+    const auto &arc = aiter.Value();
+    if (arc.ilabel != 0) ans.ilabels.push_back(arc.ilabel);
+    if (arc.olabel != 0) ans.olabels.push_back(arc.olabel);
+    ans.graph_cost += arc.weight.Value1();
+    ans.ac_cost += arc.weight.Value2();
+    s = arc.nextstate;
+  }
+  return ans;
+}
+
+static void ExpectSamePath(const fst::Lattice &a, const fst::Lattice &b) {
+  PathInfo pa = GetPathInfo(a);
+  PathInfo pb = GetPathInfo(b);
+  EXPECT_EQ(pa.ilabels, pb.ilabels);
+  EXPECT_EQ(pa.olabels, pb.olabels);
+  EXPECT_NEAR(pa.graph_cost, pb.graph_cost, 1e-3);
+  EXPECT_NEAR(pa.ac_cost, pb.ac_cost, 1e-3);
+}
+
+TEST(CtcDecoder, SameAsFasterDecoder) {
+  fst::StdVectorFst lg = BuildLexicon();
+  fst::StdVectorFst hlg = ComposeCtcTopo(lg);
+
+  // A large beam, so that both do exact Viterbi
+  FasterDecoderOptions opts(1000.0);
+  opts.min_active = 0;
+
+  for (int32_t i = 0; i != 10; ++i) {
+    FloatMatrix log_probs = RandnMatrix(40, 5, 0, 3);
+    DecodableCtc decodable(log_probs);
+
+    FasterDecoder faster_decoder(hlg, opts);
+    faster_decoder.Decode(&decodable);
+    fst::Lattice expected;
+    ASSERT_TRUE(faster_decoder.GetBestPath(&expected));
+
+    CtcDecoder decoder(lg, opts);
+    decoder.Decode(&decodable);
+    EXPECT_EQ(decoder.NumFramesDecoded(), 40);
+    EXPECT_EQ(decoder.ReachedFinal(), faster_decoder.ReachedFinal());
+    fst::Lattice best_path;
+    ASSERT_TRUE(decoder.GetBestPath(&best_path));
+
+    ExpectSamePath(best_path, expected);
+    EXPECT_EQ(GetPathInfo(best_path).ilabels.size(), 40);
+  }
+}
+
+TEST(CtcDecoder, Repeats) {
+  fst::StdVectorFst lg = BuildLexicon();
+
+  // "3 3" is word 103. Token 3 on 2 frames is a single occurrence, so it
+  // needs a blank in between.
+  FloatMatrix log_probs(5, 5);
+  log_probs.setConstant(-10);
+  log_probs(0, 3) = 0;
+  log_probs(1, 3) = 0;
+  log_probs(2, 0) = 0;
+  log_probs(3, 3) = 0;
+  log_probs(4, 0) = 0;
+  DecodableCtc decodable(log_probs);
+
+  CtcDecoder decoder(lg, FasterDecoderOptions(16.0));
+  decoder.Decode(&decodable);
+  ASSERT_TRUE(decoder.ReachedFinal());
+
+  fst::Lattice best_path;
+  ASSERT_TRUE(decoder.GetBestPath(&best_path));
+  PathInfo info = GetPathInfo(best_path);
+  EXPECT_EQ(info.olabels, std::vector<int32_t>({103}));
+  EXPECT_EQ(info.ilabels, std::vector<int32_t>({4, 4, 1, 4, 1}));
+  EXPECT_NEAR(info.ac_cost, 0, 1e-5);
+}
+
+TEST(CtcDecoder, AdvanceDecoding) {
+  fst::StdVectorFst lg = BuildLexicon();
+  FloatMatrix log_probs = RandnMatrix(50, 5, 0, 3);
+  DecodableCtc decodable(log_probs);
+  FasterDecoderOptions opts(10.0);
+
+  CtcDecoder expected_decoder(lg, opts);
+  expected_decoder.Decode(&decodable);
+  fst::Lattice expected;
+  expected_decoder.GetBestPath(&expected);
+
+  CtcDecoder decoder(lg, opts);
+  decoder.InitDecoding();
+  while (decoder.NumFramesDecoded() < 50) {
+    decoder.AdvanceDecoding(&decodable, 7);
+  }
+  fst::Lattice best_path;
+  decoder.GetBestPath(&best_path);
+  ExpectSamePath(best_path, expected);
+
+  EXPECT_GT(decoder.GetMemoryStats().peak_bytes, 0);
+}
+
+TEST(CtcDecoder, Prefetch) {
+  fst::StdVectorFst lg = BuildLexicon();
+  fst::StdVectorFst hlg = ComposeCtcTopo(lg);
+  FloatMatrix log_probs = RandnMatrix(50, 5, 0, 3);
+  DecodableCtc decodable(log_probs);
+
+  // A small max_active, so that pruning happens while prefetching
+  FasterDecoderOptions opts(10.0, 4);
+  opts.min_active = 0;
+
+  FasterDecoder expected_faster(hlg, opts);
+  expected_faster.Decode(&decodable);
+  fst::Lattice expected_faster_path;
+  ASSERT_TRUE(expected_faster.GetBestPath(&expected_faster_path));
+
+  CtcDecoder expected_ctc(lg, opts);
+  expected_ctc.Decode(&decodable);
+  fst::Lattice expected_ctc_path;
+  ASSERT_TRUE(expected_ctc.GetBestPath(&expected_ctc_path));
+
+  // Prefetching must not change the results, whatever the distance
+  for (int32_t distance : {1, 3, 100}) {
+    opts.prefetch_distance = distance;
+
+    FasterDecoder faster_decoder(hlg, opts);
+    faster_decoder.Decode(&decodable);
+    fst::Lattice faster_path;
+    ASSERT_TRUE(faster_decoder.GetBestPath(&faster_path));
+    ExpectSamePath(faster_path, expected_faster_path);
+
+    CtcDecoder decoder(lg, opts);
+    decoder.Decode(&decodable);
+    fst::Lattice best_path;
+    ASSERT_TRUE(decoder.GetBestPath(&best_path));
+    ExpectSamePath(best_path, expected_ctc_path);
+  }
+}
+
+}  // namespace kaldi_decoder
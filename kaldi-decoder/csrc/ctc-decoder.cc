@@ -0,0 +1,455 @@
+// kaldi-decoder/csrc/ctc-decoder.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/ctc-decoder.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "kaldi-decoder/csrc/log.h"
+#include "kaldifst/csrc/remove-eps-local.h"
+
+namespace kaldi_decoder {
+
+// The index of the blank in the decodable object, i.e., token 0 plus 1
+static constexpr int32_t kBlankLabel = 1;
+
+CtcDecoder::CtcDecoder(const fst::Fst<fst::StdArc> &fst,
+                       const FasterDecoderOptions &opts)
+    : fst_(fst),
+      fst_is_expanded_(fst.Properties(fst::kExpanded, false) != 0),
+      config_(opts),
+      num_frames_decoded_(-1) {
+  KALDI_DECODER_ASSERT(config_.hash_ratio >= 1.0);
+  KALDI_DECODER_ASSERT(config_.max_active > 1);
+  KALDI_DECODER_ASSERT(config_.min_active >= 0 &&
+                       config_.min_active < config_.max_active);
+
+  toks_.SetSize(1000);
+}
+
+void CtcDecoder::ClearToks(Elem *list) {
+  for (Elem *e = list, *e_tail; e != nullptr; e = e_tail) {
+    Token::TokenDelete(e->val, &token_pool_);
+    e_tail = e->tail;
+    toks_.Delete(e);
+  }
+}
+
+void CtcDecoder::Reset() {
+  ClearToks(toks_.Clear());
+  if (endpoint_tok_ != nullptr) {
+    Token::TokenDelete(endpoint_tok_, &token_pool_);
+    endpoint_tok_ = nullptr;
+  }
+  endpoint_silence_frames_ = 0;
+  endpoint_detected_ = false;
+  num_frames_decoded_ = -1;
+  cost_offsets_.clear();
+  peak_bytes_ = 0;
+  beam_scale_ = 1;
+  num_tightened_frames_ = 0;
+}
+
+DecoderMemoryStats CtcDecoder::GetMemoryStats() const {
+  DecoderMemoryStats stats;
+  stats.token_bytes = token_pool_.NumInUse() * token_pool_.ElemSize();
+  stats.hash_bytes = toks_.AllocatedBytes();
+  stats.free_bytes = (token_pool_.NumAllocated() - token_pool_.NumInUse()) *
+                     token_pool_.ElemSize();
+  stats.peak_bytes = std::max(peak_bytes_, stats.LiveBytes());
+  stats.num_tightened_frames = num_tightened_frames_;
+  return stats;
+}
+
+void CtcDecoder::UpdateMemoryUsage() {
+  int64_t live_bytes = GetMemoryStats().LiveBytes();
+  peak_bytes_ = std::max(peak_bytes_, live_bytes);
+
+  float prev_beam_scale = beam_scale_;
+  beam_scale_ = UpdateBeamScale(beam_scale_, live_bytes, config_.max_mem_bytes);
+  if (beam_scale_ < prev_beam_scale) {
+    KALDI_DECODER_WARN << "Memory use " << live_bytes << " exceeds "
+                       << config_.max_mem_bytes << " bytes at frame "
+                       << num_frames_decoded_ << ". Tightening the beam to "
+                       << config_.beam * beam_scale_;
+  }
+}
+
+void CtcDecoder::InitDecoding() {
+  Reset();
+  StateId start_state = fst_.Start();
+
+  KALDI_DECODER_ASSERT(start_state != fst::kNoStateId);
+
+  toks_.Insert(MakeKey(start_state, 0), token_pool_.New(start_state));
+
+  ProcessNonemitting(std::numeric_limits<float>::max());
+
+  num_frames_decoded_ = 0;
+}
+
+void CtcDecoder::Decode(DecodableInterface *decodable) {
+  InitDecoding();
+  AdvanceDecoding(decodable);
+}
+
+bool CtcDecoder::AdvanceDecoding(DecodableInterface *decodable,
+                                 int32_t max_num_frames /*=-1*/) {
+  KALDI_DECODER_ASSERT(num_frames_decoded_ >= 0 &&
+                       "You must call InitDecoding() before AdvanceDecoding()");
+
+  int32_t num_frames_ready = decodable->NumFramesReady();
+  KALDI_DECODER_ASSERT(num_frames_ready >= num_frames_decoded_);
+
+  int32_t target_frames_decoded = num_frames_ready;
+  if (max_num_frames >= 0) {
+    target_frames_decoded =
+        std::min(target_frames_decoded, num_frames_decoded_ + max_num_frames);
+  }
+
+  while (num_frames_decoded_ < target_frames_decoded) {
+    if (beam_scale_ < 1) {
+      ++num_tightened_frames_;
+    }
+
+    // note: ProcessEmitting() increments num_frames_decoded_
+    float weight_cutoff = ProcessEmitting(decodable);
+
+    Token *best_tok = ProcessNonemitting(weight_cutoff);
+
+    UpdateMemoryUsage();
+
+    if (endpoint_.Enabled() && best_tok != nullptr) {
+      UpdateEndpoint(best_tok);
+      if (endpoint_detected_) {
+        break;
+      }
+    }
+  }
+
+  return endpoint_detected_;
+}
+
+void CtcDecoder::UpdateEndpoint(Token *best_tok) {
+  int32_t silence_frames = endpoint_.TrailingSilenceFrames(
+      best_tok, endpoint_tok_, endpoint_silence_frames_,
+      [](const Token *tok) -> int32_t { return tok->ilabel_; });
+
+  ++best_tok->ref_count_;
+  if (endpoint_tok_ != nullptr) {
+    Token::TokenDelete(endpoint_tok_, &token_pool_);
+  }
+  endpoint_tok_ = best_tok;
+  endpoint_silence_frames_ = silence_frames;
+
+  endpoint_detected_ =
+      endpoint_.Detect(num_frames_decoded_, silence_frames,
+                       [this]() { return FinalRelativeCost(); });
+}
+
+CtcDecoder::Elem *CtcDecoder::InsertToken(Key key, Token *new_tok) {
+  Elem *e_found = toks_.Insert(key, new_tok);
+  if (e_found->val == new_tok) {
+    return e_found;
+  }
+
+  if (*(e_found->val) < *new_tok) {
+    // e_found has a higher cost
+    Token::TokenDelete(e_found->val, &token_pool_);
+    e_found->val = new_tok;
+    return e_found;
+  }
+
+  Token::TokenDelete(new_tok, &token_pool_);
+  return nullptr;
+}
+
+CtcDecoder::Token *CtcDecoder::ProcessNonemitting(float cutoff) {
+  KALDI_DECODER_ASSERT(queue_.empty());
+
+  // A token is only deleted when it is replaced by a better one, so the
+  // best token can be tracked while the tokens are inserted
+  Token *best_tok = nullptr;
+  for (const Elem *e = toks_.GetList(); e != nullptr; e = e->tail) {
+    queue_.push_back(e);
+    if (best_tok == nullptr || *best_tok < *e->val) {
+      best_tok = e->val;
+    }
+  }
+
+  while (!queue_.empty()) {
+    const Elem *e = queue_.back();
+    queue_.pop_back();
+
+    Token *tok = e->val;
+    if (tok->cost_ > cutoff) {
+      continue;
+    }
+
+    StateId state = KeyState(e->key);
+    Label last_label = KeyLabel(e->key);
+
+    for (fst::ArcIterator<fst::Fst<Arc>> aiter(fst_, state); !aiter.Done();
+         aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      if (arc.ilabel != 0) {
+        continue;
+      }
+
+      // An epsilon arc of the graph keeps the last token, so that it can
+      // still be repeated after it
+      Token *new_tok = token_pool_.New(arc.nextstate, 0, aiter.Position(),
+                                       arc.weight.Value(), tok);
+      if (new_tok->cost_ > cutoff) {
+        Token::TokenDelete(new_tok, &token_pool_);
+        continue;
+      }
+
+      // Compared before the insertion, which may delete best_tok
+      bool is_best = *best_tok < *new_tok;
+      Elem *e_kept = InsertToken(MakeKey(arc.nextstate, last_label), new_tok);
+      if (e_kept) {
+        queue_.push_back(e_kept);
+        if (is_best) {
+          best_tok = new_tok;
+        }
+      }
+    }
+  }
+
+  return best_tok;
+}
+
+float CtcDecoder::ProcessEmitting(DecodableInterface *decodable) {
+  int32_t frame = num_frames_decoded_;
+  Elem *last_toks = toks_.Clear();
+  size_t tok_cnt;
+  float adaptive_beam;
+  Elem *best_elem = nullptr;
+  float weight_cutoff =
+      GetBeamCutoff(config_, config_.beam * beam_scale_, last_toks,
+                    &tmp_array_, &tok_cnt, &adaptive_beam, &best_elem);
+
+  // See FasterDecoder::ProcessEmitting()
+  float cost_offset = best_elem ? -best_elem->val->cost_ : 0;
+  cost_offsets_.push_back(cost_offset);
+
+  // A token can go to its own state twice: with a blank and with a repeat
+  PossiblyResizeHash(config_, 2 * tok_cnt, &toks_);
+
+  float next_weight_cutoff = std::numeric_limits<float>::infinity();
+
+  float blank_cost =
+      cost_offset - decodable->LogLikelihood(frame, kBlankLabel);
+
+  // First process the best token to get a hopefully reasonably tight bound
+  // on the next cutoff. Staying on a blank is usually the best.
+  if (best_elem) {
+    Token *tok = best_elem->val;
+    next_weight_cutoff = tok->cost_ + blank_cost + adaptive_beam;
+
+    for (fst::ArcIterator<fst::Fst<Arc>> aiter(fst_, KeyState(best_elem->key));
+         !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      if (arc.ilabel != 0) {
+        float ac_cost =
+            cost_offset - decodable->LogLikelihood(frame, arc.ilabel + 1);
+        float new_weight = arc.weight.Value() + tok->cost_ + ac_cost;
+        next_weight_cutoff =
+            std::min(next_weight_cutoff, new_weight + adaptive_beam);
+      }
+    }
+  }
+
+  // See FasterDecoderOptions::prefetch_distance
+  const int32_t prefetch_distance = config_.prefetch_distance;
+  Elem *ahead = last_toks;
+  for (int32_t i = 0; i < prefetch_distance && ahead != nullptr; ++i) {
+    PrefetchToken(ahead);
+    ahead = ahead->tail;
+  }
+
+  for (Elem *e = last_toks, *e_tail; e != nullptr; e = e_tail) {
+    if (ahead != nullptr) {
+      PrefetchToken(ahead);
+      ahead = ahead->tail;
+    }
+
+    Token *tok = e->val;
+    if (tok->cost_ < weight_cutoff) {
+      StateId state = KeyState(e->key);
+      Label last_label = KeyLabel(e->key);
+
+      if (prefetch_distance > 0) {
+        for (fst::ArcIterator<fst::Fst<Arc>> aiter(fst_, state);
+             !aiter.Done(); aiter.Next()) {
+          const Arc &arc = aiter.Value();
+          if (arc.ilabel != 0) {
+            toks_.Prefetch(MakeKey(arc.nextstate, arc.ilabel + 1));
+          }
+        }
+      }
+
+      // The blank
+      float new_weight = tok->cost_ + blank_cost;
+      if (new_weight < next_weight_cutoff) {
+        next_weight_cutoff =
+            std::min(next_weight_cutoff, new_weight + adaptive_beam);
+        InsertToken(MakeKey(state, 0),
+                    token_pool_.New(state, kBlankLabel, -1, blank_cost, tok));
+      }
+
+      // The repeat of the last token
+      if (last_label != 0) {
+        float ac_cost =
+            cost_offset - decodable->LogLikelihood(frame, last_label);
+        new_weight = tok->cost_ + ac_cost;
+        if (new_weight < next_weight_cutoff) {
+          next_weight_cutoff =
+              std::min(next_weight_cutoff, new_weight + adaptive_beam);
+          InsertToken(e->key,
+                      token_pool_.New(state, last_label, -1, ac_cost, tok));
+        }
+      }
+
+      // A new token, i.e., an arc of the graph. Without a blank in between,
+      // the last token is a repeat, not a new occurrence.
+      for (fst::ArcIterator<fst::Fst<Arc>> aiter(fst_, state); !aiter.Done();
+           aiter.Next()) {
+        const Arc &arc = aiter.Value();
+        Label label = arc.ilabel + 1;
+        if (arc.ilabel == 0 || label == last_label) {
+          continue;
+        }
+
+        float ac_cost = cost_offset - decodable->LogLikelihood(frame, label);
+        new_weight = arc.weight.Value() + tok->cost_ + ac_cost;
+        if (new_weight < next_weight_cutoff) {
+          next_weight_cutoff =
+              std::min(next_weight_cutoff, new_weight + adaptive_beam);
+          InsertToken(MakeKey(arc.nextstate, label),
+                      token_pool_.New(arc.nextstate, label, aiter.Position(),
+                                      arc.weight.Value() + ac_cost, tok));
+        }
+      }
+    }
+
+    e_tail = e->tail;
+    Token::TokenDelete(e->val, &token_pool_);
+    toks_.Delete(e);
+  }
+
+  num_frames_decoded_++;
+  return next_weight_cutoff;
+}
+
+bool CtcDecoder::ReachedFinal() const {
+  for (const Elem *e = toks_.GetList(); e != nullptr; e = e->tail) {
+    if (e->val->cost_ != std::numeric_limits<float>::infinity() &&
+        fst_.Final(KeyState(e->key)) != Weight::Zero()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+float CtcDecoder::FinalRelativeCost() const {
+  float infinity = std::numeric_limits<float>::infinity();
+  float best_cost = infinity;
+  float best_cost_with_final = infinity;
+  for (const Elem *e = toks_.GetList(); e != nullptr; e = e->tail) {
+    best_cost = std::min(best_cost, e->val->cost_);
+    best_cost_with_final =
+        std::min(best_cost_with_final,
+                 e->val->cost_ + fst_.Final(KeyState(e->key)).Value());
+  }
+
+  float extra_cost = best_cost_with_final - best_cost;
+  if (extra_cost != extra_cost) {  // NaN
+    KALDI_DECODER_WARN << "Found NaN (likely search failure in decoding)";
+    return infinity;
+  }
+  return extra_cost;
+}
+
+bool CtcDecoder::GetBestPath(fst::MutableFst<fst::LatticeArc> *fst_out,
+                             bool use_final_probs /*= true*/) {
+  fst_out->DeleteStates();
+  Token *best_tok = nullptr;
+  bool is_final = ReachedFinal();
+
+  if (!is_final) {
+    for (const Elem *e = toks_.GetList(); e != nullptr; e = e->tail) {
+      if (best_tok == nullptr || *best_tok < *(e->val)) {
+        best_tok = e->val;
+      }
+    }
+  } else {
+    double infinity = std::numeric_limits<double>::infinity();
+    double best_cost = infinity;
+
+    for (const Elem *e = toks_.GetList(); e != nullptr; e = e->tail) {
+      double this_cost = e->val->cost_ + fst_.Final(KeyState(e->key)).Value();
+      if (this_cost < best_cost && this_cost != infinity) {
+        best_cost = this_cost;
+        best_tok = e->val;
+      }
+    }
+  }
+
+  if (best_tok == nullptr) {
+    return false;
+  }
+
+  std::vector<fst::LatticeArc> arcs_reverse;  // arcs in reverse order.
+  // See FasterDecoder::GetBestPath()
+  int32_t frame = num_frames_decoded_;
+  const Token *tok = best_tok;
+  for (; tok->prev_ != nullptr; tok = tok->prev_) {
+    // A blank or a repeat has no arc of the graph
+    Label olabel = 0;
+    float graph_cost = 0;
+    if (tok->arc_index_ >= 0) {
+      fst::ArcIterator<fst::Fst<Arc>> aiter(fst_, tok->prev_->state_);
+      aiter.Seek(tok->arc_index_);
+      olabel = aiter.Value().olabel;
+      graph_cost = aiter.Value().weight.Value();
+    }
+
+    float ac_cost = tok->cost_ - tok->prev_->cost_ - graph_cost;
+    if (tok->ilabel_ != 0) {
+      ac_cost -= cost_offsets_[--frame];
+    }
+
+    arcs_reverse.emplace_back(tok->ilabel_, olabel,
+                              fst::LatticeWeight(graph_cost, ac_cost),
+                              tok->state_);
+  }
+
+  // The start token has no arc
+  KALDI_DECODER_ASSERT(tok->state_ == fst_.Start() && frame == 0);
+
+  StateId cur_state = fst_out->AddState();
+  fst_out->SetStart(cur_state);
+  for (ssize_t i = static_cast<ssize_t>(arcs_reverse.size()) - 1; i >= 0; --i) {
+    fst::LatticeArc arc = arcs_reverse[i];
+    arc.nextstate = fst_out->AddState();
+    fst_out->AddArc(cur_state, arc);
+    cur_state = arc.nextstate;
+  }
+
+  if (is_final && use_final_probs) {
+    Weight final_weight = fst_.Final(best_tok->state_);
+    fst_out->SetFinal(cur_state,
+                      fst::LatticeWeight(final_weight.Value(), 0.0));
+  } else {
+    fst_out->SetFinal(cur_state, fst::LatticeWeight::One());
+  }
+  fst::RemoveEpsLocal(fst_out);
+  return true;
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,220 @@
+// kaldi-decoder/csrc/ctc-decoder.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_CTC_DECODER_H_
+#define KALDI_DECODER_CSRC_CTC_DECODER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "fst/fst.h"
+#include "kaldi-decoder/csrc/decodable-itf.h"
+#include "kaldi-decoder/csrc/decoder-memory-stats.h"
+#include "kaldi-decoder/csrc/endpoint.h"
+#include "kaldi-decoder/csrc/faster-decoder.h"
+#include "kaldi-decoder/csrc/hash-list.h"
+#include "kaldi-decoder/csrc/memory-pool.h"
+#include "kaldi-decoder/csrc/prefetch.h"
+#include "kaldifst/csrc/lattice-weight.h"
+
+namespace kaldi_decoder {
+
+/** A FasterDecoder for CTC models that takes the graph without the CTC
+    topology, e.g., LG instead of HLG.
+
+    The input labels of the graph are token IDs, i.e., the columns of the
+    CTC output, and 0 is epsilon, so the blank must be token 0 and it does
+    not appear in the graph. The blank and the repeats of a token do not
+    change the state of the graph, so instead of following self-loops of
+    H, the decoder keeps the last token of each hypothesis next to its
+    graph state: a token is a repeat if it follows itself, and a new
+    occurrence, i.e., an arc of the graph, if a blank is in between.
+
+    It gives the same result as FasterDecoder with the composition of the
+    CTC topology and the graph, including the best path: its input labels
+    are the indexes of DecodableCtc, i.e., token IDs plus 1, with one arc
+    per frame, and its epsilon arcs are those of the graph.
+ */
+class CtcDecoder {
+ public:
+  typedef fst::StdArc Arc;
+  typedef Arc::Label Label;
+  typedef Arc::StateId StateId;
+  typedef Arc::Weight Weight;
+
+  CtcDecoder(const fst::Fst<fst::StdArc> &fst,
+             const FasterDecoderOptions &config);
+
+  CtcDecoder(const CtcDecoder &) = delete;
+  CtcDecoder &operator=(const CtcDecoder &) = delete;
+
+  ~CtcDecoder() { Reset(); }
+
+  void SetOptions(const FasterDecoderOptions &config) { config_ = config; }
+
+  /// See FasterDecoder::SetEndpointConfig(). The silence labels are indexes
+  /// of the decodable object, e.g., {1} for the blank.
+  void SetEndpointConfig(const EndpointConfig &config) {
+    endpoint_ = EndpointDetector(config);
+  }
+
+  void Decode(DecodableInterface *decodable);
+
+  /// Returns true if a final state was active on the last frame.
+  bool ReachedFinal() const;
+
+  /// See FasterDecoder::GetBestPath()
+  bool GetBestPath(fst::MutableFst<fst::LatticeArc> *fst_out,
+                   bool use_final_probs = true);
+
+  void InitDecoding();
+
+  /// Releases the state of the current utterance; see FasterDecoder::Reset()
+  void Reset();
+
+  /// See FasterDecoder::AdvanceDecoding()
+  bool AdvanceDecoding(DecodableInterface *decodable,
+                       int32_t max_num_frames = -1);
+
+  bool EndpointDetected() const { return endpoint_detected_; }
+
+  /// See FasterDecoder::FinalRelativeCost()
+  float FinalRelativeCost() const;
+
+  /// Returns the number of frames already decoded.
+  int32_t NumFramesDecoded() const { return num_frames_decoded_; }
+
+  DecoderMemoryStats GetMemoryStats() const;
+
+ protected:
+  // A token takes 32 bytes. As in FasterDecoder, it does not store a copy
+  // of its arc but the index of the arc among the arcs leaving the state of
+  // prev_, and its cost is a float, relative to the cost offsets of the
+  // frames (see cost_offsets_ below).
+  class Token {
+   public:
+    Token *prev_;
+    // The total cost up to this point, minus the sum of cost_offsets_ of
+    // the frames decoded so far
+    float cost_;
+    int32_t ref_count_;
+    // The state of the graph
+    StateId state_;
+    // The index passed to the decodable object, i.e., the token ID plus 1,
+    // or 0 for an epsilon arc of the graph
+    Label ilabel_;
+    // Index of the arc of the graph in the arcs leaving prev_->state_, or -1
+    // if the token does not follow an arc: the start token, a blank and a
+    // repeat
+    int32_t arc_index_;
+
+    // The start token
+    inline explicit Token(StateId state)
+        : prev_(nullptr),
+          cost_(0),
+          ref_count_(1),
+          state_(state),
+          ilabel_(0),
+          arc_index_(-1) {}
+
+    // "cost" is the graph cost plus the acoustic cost of the token.
+    inline Token(StateId state, Label ilabel, int32_t arc_index, float cost,
+                 Token *prev)
+        : prev_(prev),
+          cost_(prev->cost_ + cost),
+          ref_count_(1),
+          state_(state),
+          ilabel_(ilabel),
+          arc_index_(arc_index) {
+      prev->ref_count_++;
+    }
+
+    inline bool operator<(const Token &other) const {
+      return cost_ > other.cost_;
+    }
+
+    inline static void TokenDelete(Token *tok, MemoryPool<Token> *pool) {
+      while (--tok->ref_count_ == 0) {
+        Token *prev = tok->prev_;
+        pool->Delete(tok);
+        if (prev == nullptr) {
+          return;
+        } else {
+          tok = prev;
+        }
+      }
+    }
+  };
+
+  // A hypothesis is identified by its graph state and by the label of the
+  // token it has just emitted, or 0 after a blank or at the start.
+  using Key = uint64_t;
+
+  static Key MakeKey(StateId state, Label last_label) {
+    return (static_cast<Key>(state) << 32) | static_cast<uint32_t>(last_label);
+  }
+
+  static StateId KeyState(Key key) { return static_cast<StateId>(key >> 32); }
+
+  static Label KeyLabel(Key key) {
+    return static_cast<Label>(key & 0xffffffff);
+  }
+
+  using Elem = HashList<Key, Token *>::Elem;
+
+  void UpdateMemoryUsage();
+
+  // Keeps the token with the lower cost at "key". It takes the ownership of
+  // new_tok. Returns the element if new_tok was kept, nullptr otherwise.
+  inline Elem *InsertToken(Key key, Token *new_tok);
+
+  float ProcessEmitting(DecodableInterface *decodable);
+
+  // Returns the best token of the frame
+  Token *ProcessNonemitting(float cutoff);
+
+  void UpdateEndpoint(Token *best_tok);
+
+  // See FasterDecoder::PrefetchToken()
+  inline void PrefetchToken(const Elem *e) const {
+    Prefetch(e->val);
+    if (fst_is_expanded_) {
+      PrefetchArcs(fst_, KeyState(e->key));
+    }
+  }
+
+  MemoryPool<Token> token_pool_;
+
+  HashList<Key, Token *> toks_;
+
+  const fst::Fst<fst::StdArc> &fst_;
+  bool fst_is_expanded_;
+
+  FasterDecoderOptions config_;
+
+  std::vector<const Elem *> queue_;
+
+  std::vector<float> tmp_array_;  // used in GetBeamCutoff().
+
+  int32_t num_frames_decoded_;
+
+  // See FasterDecoder
+  std::vector<float> cost_offsets_;
+
+  int64_t peak_bytes_ = 0;
+  float beam_scale_ = 1;
+  int32_t num_tightened_frames_ = 0;
+
+  // See FasterDecoder
+  EndpointDetector endpoint_;
+  Token *endpoint_tok_ = nullptr;
+  int32_t endpoint_silence_frames_ = 0;
+  bool endpoint_detected_ = false;
+
+  void ClearToks(Elem *list);
+};
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_CTC_DECODER_H_
@@ -0,0 +1,131 @@
+// kaldi-decoder/csrc/decodable-chunked-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/decodable-chunked.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/faster-decoder.h"
+
+namespace kaldi_decoder {
+
+// Provides the rows of a matrix chunk_size frames at a time
+class MatrixChunks : public DecodableChunked {
+ public:
+  MatrixChunks(const FloatMatrix &m, int32_t chunk_size)
+      : m_(m), chunk_size_(chunk_size) {}
+
+  FloatMatrix GetChunk(int32_t frame) override {
+    requested_frames.push_back(frame);
+    int32_t n = std::min<int32_t>(chunk_size_, m_.rows() - frame);
+    return m_.middleRows(frame, n);
+  }
+
+  int32_t NumFramesReady() const override { return m_.rows(); }
+
+  int32_t NumIndices() const override { return m_.cols(); }
+
+  bool IsLastFrame(int32_t frame) const override {
+    return frame == m_.rows() - 1;
+  }
+
+  std::vector<int32_t> requested_frames;
+
+ private:
+  FloatMatrix m_;
+  int32_t chunk_size_;
+};
+
+TEST(DecodableChunked, LogLikelihood) {
+  FloatMatrix m = RandnMatrix(10, 4, 0, 1, /*seed=*/1);
+  MatrixChunks decodable(m, 3);
+
+  for (int32_t t = 0; t != 10; ++t) {
+    for (int32_t i = 1; i <= 4; ++i) {
+      EXPECT_EQ(decodable.LogLikelihood(t, i), m(t, i - 1));
+    }
+  }
+  EXPECT_EQ(decodable.requested_frames, (std::vector<int32_t>{0, 3, 6, 9}));
+
+  // Going back loads the chunk that starts at the requested frame
+  EXPECT_EQ(decodable.LogLikelihood(4, 2), m(4, 1));
+  EXPECT_EQ(decodable.LogLikelihood(6, 2), m(6, 1));
+  EXPECT_EQ(decodable.requested_frames.size(), 5);
+  EXPECT_EQ(decodable.requested_frames.back(), 4);
+
+  decodable.ClearCache();
+  decodable.LogLikelihood(5, 1);
+  EXPECT_EQ(decodable.requested_frames.size(), 6);
+}
+
+static std::vector<int32_t> GetOutputLabels(const fst::Lattice &best_path) {
+  std::vector<int32_t> ans;
+  for (int32_t s = best_path.Start(); s != fst::kNoStateId;) {
+    fst::ArcIterator<fst::Lattice> aiter(best_path, s);
+    if (aiter.Done()) {
+      break;
+    }
+    ans.push_back(aiter.Value().olabel);
+    s = aiter.Value().nextstate;
+  }
+  return ans;
+}
+
+TEST(DecodableChunked, Decode) {
+  fst::StdVectorFst g;
+  g.AddState();
+  g.SetStart(0);
+  g.SetFinal(0, 0);
+  for (int32_t label = 1; label <= 5; ++label) {
+    g.AddArc(0, fst::StdArc(label, label, 0, 0));
+  }
+
+  FloatMatrix m = RandnMatrix(50, 5, 0, 1, /*seed=*/2);
+  DecodableCtc expected_decodable(m);
+  FasterDecoder expected_decoder(g, FasterDecoderOptions(8.0));
+  expected_decoder.Decode(&expected_decodable);
+  fst::Lattice expected;
+  expected_decoder.GetBestPath(&expected);
+  ASSERT_EQ(GetOutputLabels(expected).size(), 50);
+
+  // One call per chunk, although every arc of every frame is scored
+  for (int32_t chunk_size : {1, 7, 64}) {
+    MatrixChunks decodable(m, chunk_size);
+    FasterDecoder decoder(g, FasterDecoderOptions(8.0));
+    decoder.Decode(&decodable);
+    EXPECT_EQ(decodable.requested_frames.size(),
+              (50 + chunk_size - 1) / chunk_size);
+
+    fst::Lattice best_path;
+    decoder.GetBestPath(&best_path);
+    EXPECT_EQ(GetOutputLabels(best_path), GetOutputLabels(expected));
+  }
+}
+
+TEST(DecodableChunked, WrongChunk) {
+  class Empty : public MatrixChunks {
+   public:
+    using MatrixChunks::MatrixChunks;
+    FloatMatrix GetChunk(int32_t /*frame*/) override { return FloatMatrix(); }
+  };
+
+  FloatMatrix m = RandnMatrix(3, 2);
+  Empty empty(m, 1);
+  EXPECT_THROW(empty.LogLikelihood(0, 1), std::runtime_error);
+
+  class WrongSize : public MatrixChunks {
+   public:
+    using MatrixChunks::MatrixChunks;
+    FloatMatrix GetChunk(int32_t /*frame*/) override {
+      return FloatMatrix(1, 5);
+    }
+  };
+  WrongSize wrong_size(m, 1);
+  EXPECT_THROW(wrong_size.LogLikelihood(0, 1), std::runtime_error);
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,34 @@
+// kaldi-decoder/csrc/decodable-chunked.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/decodable-chunked.h"
+
+#include <utility>
+
+namespace kaldi_decoder {
+
+void DecodableChunked::ClearCache() {
+  chunk_.resize(0, 0);
+  chunk_begin_ = 0;
+  chunk_end_ = 0;
+}
+
+void DecodableChunked::LoadChunk(int32_t frame) {
+  FloatMatrix chunk = GetChunk(frame);
+  if (chunk.rows() == 0) {
+    KALDI_DECODER_ERR << "GetChunk(" << frame << ") returned no frames";
+  }
+
+  if (chunk.cols() != NumIndices()) {
+    KALDI_DECODER_ERR << "GetChunk(" << frame << ") returned "
+                      << chunk.cols() << " columns. Expected: "
+                      << NumIndices();
+  }
+
+  chunk_ = std::move(chunk);
+  chunk_begin_ = frame;
+  chunk_end_ = frame + static_cast<int32_t>(chunk_.rows());
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,50 @@
+// kaldi-decoder/csrc/decodable-chunked.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_DECODABLE_CHUNKED_H_
+#define KALDI_DECODER_CSRC_DECODABLE_CHUNKED_H_
+
+#include "kaldi-decoder/csrc/decodable-itf.h"
+#include "kaldi-decoder/csrc/eigen.h"
+
+namespace kaldi_decoder {
+
+/** A decodable object whose log-likelihoods are provided a chunk of frames
+    at a time by GetChunk(), e.g., by a subclass in Python, which would
+    otherwise be called for every arc of every frame by LogLikelihood().
+
+    The current chunk is cached, so GetChunk() is called once per chunk as
+    long as the frames are read in increasing order, which is what the
+    decoders do.
+ */
+class DecodableChunked : public DecodableInterface {
+ public:
+  /// Returns the log-likelihoods of the frames starting at "frame", one row
+  /// per frame, with NumIndices() columns. Column i is index i + 1, as for
+  /// DecodableCtc. It has at least one row, e.g., exactly one to provide a
+  /// frame at a time, and at most NumFramesReady() - frame rows.
+  virtual FloatMatrix GetChunk(int32_t frame) = 0;
+
+  float LogLikelihood(int32_t frame, int32_t index) override {
+    if (frame < chunk_begin_ || frame >= chunk_end_) {
+      LoadChunk(frame);
+    }
+    return chunk_(frame - chunk_begin_, index - 1);
+  }
+
+  /// Forgets the cached chunk, e.g., if the log-likelihoods of its frames
+  /// were changed.
+  void ClearCache();
+
+ private:
+  void LoadChunk(int32_t frame);
+
+  FloatMatrix chunk_;
+  int32_t chunk_begin_ = 0;
+  int32_t chunk_end_ = 0;  // one past the last frame of chunk_
+};
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_DECODABLE_CHUNKED_H_
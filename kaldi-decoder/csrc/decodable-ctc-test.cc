@@ -0,0 +1,44 @@
+// kaldi-decoder/csrc/decodable-ctc-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/eigen.h"
+
+namespace kaldi_decoder {
+
+TEST(DecodableCtc, Move) {
+  FloatMatrix log_probs = RandnMatrix(4, 3);
+  FloatMatrix expected = log_probs;
+
+  // The memory is taken over, not copied
+  DecodableCtc decodable(std::move(log_probs), 10);
+  EXPECT_EQ(log_probs.size(), 0);
+
+  EXPECT_EQ(decodable.NumFramesReady(), 14);
+  EXPECT_EQ(decodable.NumIndices(), 3);
+  for (int32_t t = 0; t != 4; ++t) {
+    for (int32_t i = 0; i != 3; ++i) {
+      EXPECT_EQ(decodable.LogLikelihood(10 + t, i + 1), expected(t, i));
+    }
+  }
+}
+
+TEST(DecodableCtc, ApplyLogSoftmax) {
+  FloatMatrix logits = RandnMatrix(5, 7, 0, 3);
+  FloatMatrix expected = logits;
+  LogSoftmaxRows(&expected);
+
+  DecodableCtc decodable(std::move(logits), 0, true);
+  for (int32_t t = 0; t != 5; ++t) {
+    for (int32_t i = 0; i != 7; ++i) {
+      EXPECT_NEAR(decodable.LogLikelihood(t, i + 1), expected(t, i), 1e-5);
+    }
+  }
+}
+
+}  // namespace kaldi_decoder
@@ -6,6 +6,8 @@
 
 #include <assert.h>
 
+#include <utility>
+
 namespace kaldi_decoder {
 
 DecodableCtc::DecodableCtc(const FloatMatrix &log_probs, int32_t offset /*= 0*/)
@@ -15,6 +17,18 @@ DecodableCtc::DecodableCtc(const FloatMatrix &log_probs, int32_t offset /*= 0*/)
   num_cols_ = log_probs_.cols();
 }
 
+DecodableCtc::DecodableCtc(FloatMatrix &&log_probs, int32_t offset /*= 0*/,
+                           bool apply_log_softmax /*= false*/)
+    : log_probs_(std::move(log_probs)), offset_(offset) {
+  if (apply_log_softmax) {
+    LogSoftmaxRows(&log_probs_, /*approximate=*/true);
+  }
+
+  p_ = log_probs_.data();
+  num_rows_ = log_probs_.rows();
+  num_cols_ = log_probs_.cols();
+}
+
 DecodableCtc::DecodableCtc(const float *p, int32_t num_rows, int32_t num_cols,
                            int32_t offset /*= 0*/)
     : p_(p), num_rows_(num_rows), num_cols_(num_cols), offset_(offset) {}
@@ -15,6 +15,15 @@ class DecodableCtc : public DecodableInterface {
   // It copies the input log_probs
   explicit DecodableCtc(const FloatMatrix &log_probs, int32_t offset = 0);
 
+  // It takes the input without copying it.
+  //
+  // @param apply_log_softmax If true, the input is the unnormalized output
+  //                          of the model, e.g., logits, and it is replaced
+  //                          with its log-softmax in place, using the
+  //                          approximate mode of LogSoftmaxRows().
+  explicit DecodableCtc(FloatMatrix &&log_probs, int32_t offset = 0,
+                        bool apply_log_softmax = false);
+
   // It shares the memory with the input array.
   //
   // @param p Pointer to a 2-d array of shape (num_rows, num_cols).
@@ -0,0 +1,168 @@
+// kaldi-decoder/csrc/decoder-memory-stats-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/decoder-memory-stats.h"
+
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/faster-decoder.h"
+#include "kaldi-decoder/csrc/lattice-simple-decoder.h"
+#include "kaldi-decoder/csrc/simple-decoder.h"
+#include "kaldi-decoder/csrc/test-utils.h"
+
+namespace kaldi_decoder {
+
+// Returns the input and output labels of a linear lattice, and its costs
+static void WalkBestPath(const fst::Lattice &best_path,
+                         std::vector<int32_t> *labels, double *graph_cost,
+                         double *acoustic_cost) {
+  *graph_cost = 0;
+  *acoustic_cost = 0;
+  int32_t s = best_path.Start();
+  for (;;) {
+    fst::ArcIterator<fst::Lattice> aiter(best_path, s);
+    if (aiter.Done()) {
+      break;
+    }
+    const auto &arc = aiter.Value();
+    labels->push_back(arc.ilabel);
+    labels->push_back(arc.olabel);
+    *graph_cost += arc.weight.Value1();
+    *acoustic_cost += arc.weight.Value2();
+    s = arc.nextstate;
+  }
+  *graph_cost += best_path.Final(s).Value1();
+  *acoustic_cost += best_path.Final(s).Value2();
+}
+
+TEST(DecoderMemoryStats, UpdateBeamScale) {
+  EXPECT_EQ(UpdateBeamScale(0.5, 100, 0), 1);
+  EXPECT_EQ(UpdateBeamScale(1, 100, 50), 0.5);
+  EXPECT_EQ(UpdateBeamScale(kMinBeamScale, 100, 50), kMinBeamScale);
+  EXPECT_EQ(UpdateBeamScale(0.5, 45, 50), 0.5);
+  EXPECT_EQ(UpdateBeamScale(0.5, 10, 50), 0.625);
+  EXPECT_EQ(UpdateBeamScale(0.9, 10, 50), 1);
+}
+
+TEST(DecoderMemoryStats, FasterDecoder) {
+  int32_t num_labels = 20;
+  fst::StdVectorFst g = BuildLoopGraph(num_labels);
+  FloatMatrix log_probs = RandnMatrix(50, num_labels);
+  DecodableCtc decodable(log_probs);
+
+  FasterDecoder decoder(g, FasterDecoderOptions(16.0));
+  decoder.Decode(&decodable);
+
+  DecoderMemoryStats stats = decoder.GetMemoryStats();
+  EXPECT_GT(stats.token_bytes, 0);
+  EXPECT_GT(stats.hash_bytes, 0);
+  EXPECT_EQ(stats.link_bytes, 0);
+  EXPECT_GE(stats.peak_bytes, stats.LiveBytes());
+  EXPECT_EQ(stats.num_tightened_frames, 0);
+
+  decoder.Reset();
+  DecoderMemoryStats reset_stats = decoder.GetMemoryStats();
+  EXPECT_EQ(reset_stats.token_bytes, 0);
+  EXPECT_EQ(reset_stats.free_bytes, stats.token_bytes + stats.free_bytes);
+
+  // Any cap below the memory of the first frame tightens the beam on every
+  // later frame
+  FasterDecoder capped(g, FasterDecoderOptions(16.0, 1000000, 1, 0.5, 2.0, 1));
+  capped.Decode(&decodable);
+  DecoderMemoryStats capped_stats = capped.GetMemoryStats();
+  EXPECT_EQ(capped_stats.num_tightened_frames, decodable.NumFramesReady() - 1);
+  EXPECT_LE(capped_stats.token_bytes, stats.token_bytes);
+
+  fst::Lattice best_path;
+  EXPECT_TRUE(capped.GetBestPath(&best_path));
+}
+
+// The tokens of FasterDecoder store float costs relative to the best cost
+// of the previous frame; on a long utterance, the best path must still
+// match the one of SimpleDecoder, whose costs are doubles.
+TEST(DecoderMemoryStats, FasterDecoderLongUtterance) {
+  int32_t num_labels = 20;
+  fst::StdVectorFst g = BuildLoopGraph(num_labels);
+  FloatMatrix log_probs = RandnMatrix(20000, num_labels);
+  DecodableCtc decodable(log_probs);
+
+  FasterDecoder decoder(g, FasterDecoderOptions(16.0));
+  decoder.Decode(&decodable);
+  fst::Lattice best_path;
+  ASSERT_TRUE(decoder.GetBestPath(&best_path));
+
+  SimpleDecoder simple_decoder(g, 16.0);
+  simple_decoder.Decode(&decodable);
+  fst::Lattice expected;
+  ASSERT_TRUE(simple_decoder.GetBestPath(&expected));
+
+  std::vector<int32_t> labels, expected_labels;
+  double graph_cost, acoustic_cost, expected_graph_cost, expected_acoustic_cost;
+  WalkBestPath(best_path, &labels, &graph_cost, &acoustic_cost);
+  WalkBestPath(expected, &expected_labels, &expected_graph_cost,
+               &expected_acoustic_cost);
+
+  EXPECT_EQ(labels, expected_labels);
+  EXPECT_NEAR(graph_cost, expected_graph_cost, 1e-2);
+  EXPECT_NEAR(acoustic_cost, expected_acoustic_cost,
+              1e-5 * std::abs(expected_acoustic_cost));
+}
+
+TEST(DecoderMemoryStats, LatticeSimpleDecoder) {
+  int32_t num_labels = 20;
+  fst::StdVectorFst g = BuildLoopGraph(num_labels);
+  FloatMatrix log_probs = RandnMatrix(50, num_labels);
+  DecodableCtc decodable(log_probs);
+
+  LatticeSimpleDecoder decoder(g, LatticeSimpleDecoderConfig(16.0, 10.0));
+  decoder.Decode(&decodable);
+
+  DecoderMemoryStats stats = decoder.GetMemoryStats();
+  EXPECT_GT(stats.token_bytes, 0);
+  EXPECT_GT(stats.link_bytes, 0);
+  EXPECT_GT(stats.hash_bytes, 0);
+  EXPECT_GT(stats.frame_list_bytes, 0);
+  EXPECT_GE(stats.peak_bytes, stats.LiveBytes());
+
+  LatticeSimpleDecoderConfig config(16.0, 10.0);
+  config.max_mem_bytes = stats.peak_bytes / 4;
+  LatticeSimpleDecoder capped(g, config);
+  capped.Decode(&decodable);
+
+  DecoderMemoryStats capped_stats = capped.GetMemoryStats();
+  EXPECT_GT(capped_stats.num_tightened_frames, 0);
+  EXPECT_LT(capped_stats.peak_bytes, stats.peak_bytes);
+  EXPECT_LT(capped_stats.token_bytes + capped_stats.link_bytes,
+            stats.token_bytes + stats.link_bytes);
+
+  fst::Lattice lat;
+  EXPECT_TRUE(capped.GetRawLattice(&lat));
+}
+
+TEST(DecoderMemoryStats, SimpleDecoder) {
+  int32_t num_labels = 20;
+  fst::StdVectorFst g = BuildLoopGraph(num_labels);
+  FloatMatrix log_probs = RandnMatrix(50, num_labels);
+  DecodableCtc decodable(log_probs);
+
+  SimpleDecoder decoder(g, 16.0);
+  decoder.Decode(&decodable);
+
+  DecoderMemoryStats stats = decoder.GetMemoryStats();
+  EXPECT_GT(stats.token_bytes, 0);
+  EXPECT_GT(stats.hash_bytes, 0);
+  EXPECT_GE(stats.peak_bytes, stats.LiveBytes());
+
+  // The tokens of the previous utterance are recycled
+  decoder.Decode(&decodable);
+  EXPECT_EQ(decoder.GetMemoryStats().token_bytes +
+                decoder.GetMemoryStats().free_bytes,
+            stats.token_bytes + stats.free_bytes);
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,94 @@
+// kaldi-decoder/csrc/decoder-memory-stats.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_DECODER_MEMORY_STATS_H_
+#define KALDI_DECODER_CSRC_DECODER_MEMORY_STATS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+namespace kaldi_decoder {
+
+/// Memory held by a decoder, as returned by GetMemoryStats() of each decoder.
+/// All sizes are in bytes. Fields that do not apply to a decoder are 0,
+/// e.g., link_bytes for decoders that do not generate lattices.
+struct DecoderMemoryStats {
+  // Tokens that are alive, including the ones kept for tracebacks
+  int64_t token_bytes = 0;
+
+  // Forward links that are alive
+  int64_t link_bytes = 0;
+
+  // Hash tables indexing the active tokens, i.e., buckets and elements
+  int64_t hash_bytes = 0;
+
+  // Per-frame token lists
+  int64_t frame_list_bytes = 0;
+
+  // Memory that has been obtained from the system and is kept in free lists
+  // for reuse, but is not in use at the moment
+  int64_t free_bytes = 0;
+
+  // The maximum of LiveBytes() since InitDecoding(), sampled once per frame
+  int64_t peak_bytes = 0;
+
+  // Number of frames decoded with tightened beams because LiveBytes()
+  // exceeded the max_mem_bytes option of the decoder
+  int32_t num_tightened_frames = 0;
+
+  int64_t LiveBytes() const {
+    return token_bytes + link_bytes + hash_bytes + frame_list_bytes;
+  }
+
+  std::string ToString() const {
+    std::ostringstream os;
+
+    os << "DecoderMemoryStats(";
+    os << "token_bytes=" << token_bytes << ", ";
+    os << "link_bytes=" << link_bytes << ", ";
+    os << "hash_bytes=" << hash_bytes << ", ";
+    os << "frame_list_bytes=" << frame_list_bytes << ", ";
+    os << "free_bytes=" << free_bytes << ", ";
+    os << "peak_bytes=" << peak_bytes << ", ";
+    os << "num_tightened_frames=" << num_tightened_frames << ")";
+
+    return os.str();
+  }
+};
+
+/// Decoders multiply their beams by a scale in [kMinBeamScale, 1], which is
+/// 1 unless a memory cap is set and exceeded.
+constexpr float kMinBeamScale = 1.0f / 16;
+
+/// Returns the beam scale for the next frame given the one of the current
+/// frame. If live_bytes exceeds max_mem_bytes (> 0), the beams are halved,
+/// down to kMinBeamScale; once the memory use drops well below the cap they
+/// are relaxed again slowly, so that a single burst does not make the
+/// decoder oscillate.
+///
+/// Note that the cap is enforced by pruning harder, not by failing, so the
+/// memory use can still exceed it, e.g., if even the tightest beam keeps too
+/// many tokens alive.
+inline float UpdateBeamScale(float scale, int64_t live_bytes,
+                             int64_t max_mem_bytes) {
+  if (max_mem_bytes <= 0) {
+    return 1;
+  }
+
+  if (live_bytes > max_mem_bytes) {
+    return std::max(scale * 0.5f, kMinBeamScale);
+  }
+
+  if (live_bytes < max_mem_bytes * 3 / 4) {
+    return std::min(scale * 1.25f, 1.0f);
+  }
+
+  return scale;
+}
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_DECODER_MEMORY_STATS_H_
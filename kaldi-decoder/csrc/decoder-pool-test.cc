@@ -0,0 +1,124 @@
+// kaldi-decoder/csrc/decoder-pool-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/decoder-pool.h"
+
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/faster-decoder.h"
+#include "kaldi-decoder/csrc/lattice-simple-decoder.h"
+#include "kaldi-decoder/csrc/test-utils.h"
+
+namespace kaldi_decoder {
+
+static std::vector<int32_t> GetOlabels(const fst::Lattice &best_path) {
+  std::vector<int32_t> ans;
+  for (fst::StateIterator<fst::Lattice> siter(best_path); !siter.Done();
+       siter.Next()) {
+    for (fst::ArcIterator<fst::Lattice> aiter(best_path, siter.Value());
+         !aiter.Done(); aiter.Next()) {
+      if (aiter.Value().olabel != 0) {
+        ans.push_back(aiter.Value().olabel);
+      }
+    }
+  }
+  return ans;
+}
+
+TEST(DecoderPool, ReuseDecoders) {
+  fst::StdVectorFst g = BuildLoopGraph(5);
+  DecoderPool<FasterDecoder> pool(
+      [&g]() {
+        return std::make_unique<FasterDecoder>(g, FasterDecoderOptions());
+      },
+      2);
+
+  FloatMatrix log_probs = RandnMatrix(50, 5);
+  DecodableCtc decodable(log_probs);
+
+  std::vector<int32_t> expected;
+  FasterDecoder *first = nullptr;
+  {
+    auto decoder = pool.Acquire();
+    first = decoder.get();
+    decoder->Decode(&decodable);
+    fst::Lattice best_path;
+    decoder->GetBestPath(&best_path);
+    expected = GetOlabels(best_path);
+  }
+  EXPECT_EQ(pool.NumIdle(), 1);
+
+  for (int32_t i = 0; i != 3; ++i) {
+    auto decoder = pool.Acquire();
+    EXPECT_EQ(decoder.get(), first);
+    EXPECT_EQ(decoder->NumFramesDecoded(), -1);  // it has been reset
+
+    decoder->Decode(&decodable);
+    fst::Lattice best_path;
+    decoder->GetBestPath(&best_path);
+    EXPECT_EQ(GetOlabels(best_path), expected);
+  }
+
+  {
+    // At most 2 idle decoders are kept
+    auto d1 = pool.Acquire();
+    auto d2 = pool.Acquire();
+    auto d3 = pool.Acquire();
+  }
+  EXPECT_EQ(pool.NumIdle(), 2);
+}
+
+TEST(DecoderPool, MultipleThreads) {
+  fst::StdVectorFst g = BuildLoopGraph(5);
+  DecoderPool<LatticeSimpleDecoder> pool([&g]() {
+    return std::make_unique<LatticeSimpleDecoder>(g,
+                                                  LatticeSimpleDecoderConfig());
+  });
+  pool.Reserve(2);
+  EXPECT_EQ(pool.NumIdle(), 2);
+
+  FloatMatrix log_probs = RandnMatrix(20, 5);
+
+  std::vector<int32_t> expected;
+  {
+    auto decoder = pool.Acquire();
+    DecodableCtc decodable(log_probs);
+    decoder->Decode(&decodable);
+    fst::Lattice best_path;
+    decoder->GetBestPath(&best_path);
+    expected = GetOlabels(best_path);
+  }
+
+  int32_t num_threads = 4;
+  std::vector<std::vector<int32_t>> results(num_threads * 10);
+  std::vector<std::thread> threads;
+  for (int32_t t = 0; t != num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int32_t i = 0; i != 10; ++i) {
+        auto decoder = pool.Acquire();
+        DecodableCtc decodable(log_probs);
+        decoder->Decode(&decodable);
+        fst::Lattice best_path;
+        decoder->GetBestPath(&best_path);
+        results[t * 10 + i] = GetOlabels(best_path);
+      }
+    });
+  }
+
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  for (const auto &r : results) {
+    EXPECT_EQ(r, expected);
+  }
+  EXPECT_LE(pool.NumIdle(), num_threads);
+}
+
+}  // namespace kaldi_decoder
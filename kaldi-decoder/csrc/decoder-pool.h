@@ -0,0 +1,130 @@
+// kaldi-decoder/csrc/decoder-pool.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_DECODER_POOL_H_
+#define KALDI_DECODER_CSRC_DECODER_POOL_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "kaldi-decoder/csrc/log.h"
+
+namespace kaldi_decoder {
+
+/** DecoderPool keeps idle decoder objects for a server, so that a request
+    reuses a decoder, together with the memory it has already grown in its
+    internal free lists (see Reset()), instead of constructing a new one.
+
+    Decoder can be any decoder class with a Reset() method, e.g.,
+    FasterDecoder or LatticeSimpleDecoder.
+
+    \code{.cc}
+      DecoderPool<FasterDecoder> pool([&]() {
+        return std::make_unique<FasterDecoder>(graph, opts);
+      });
+
+      // In a request handler, possibly in several threads
+      auto decoder = pool.Acquire();
+      decoder->InitDecoding();
+      decoder->AdvanceDecoding(&decodable);
+      // The decoder goes back to the pool when "decoder" goes out of scope
+    \endcode
+
+    Acquire() and the release of a decoder are thread-safe. A decoder itself
+    must only be used by one thread at a time. The pool must outlive all the
+    decoders acquired from it.
+ */
+template <class Decoder>
+class DecoderPool {
+ public:
+  using Factory = std::function<std::unique_ptr<Decoder>()>;
+
+  // Returns a decoder to its pool instead of deleting it.
+  class Releaser {
+   public:
+    Releaser() = default;
+    explicit Releaser(DecoderPool *pool) : pool_(pool) {}
+
+    void operator()(Decoder *decoder) const { pool_->Release(decoder); }
+
+   private:
+    DecoderPool *pool_ = nullptr;
+  };
+
+  using Ptr = std::unique_ptr<Decoder, Releaser>;
+
+  /// @param factory  Creates a new decoder when the pool is empty.
+  /// @param max_idle Maximum number of idle decoders kept in the pool;
+  ///                 decoders released when the pool is full are deleted.
+  ///                 It bounds the memory held by idle decoders after a
+  ///                 burst of requests.
+  explicit DecoderPool(Factory factory, int32_t max_idle = 64)
+      : factory_(std::move(factory)), max_idle_(max_idle) {
+    KALDI_DECODER_ASSERT(factory_ != nullptr);
+    KALDI_DECODER_ASSERT(max_idle_ >= 0);
+  }
+
+  DecoderPool(const DecoderPool &) = delete;
+  DecoderPool &operator=(const DecoderPool &) = delete;
+
+  /// Returns an idle decoder if there is one, or a new decoder from the
+  /// factory otherwise.
+  Ptr Acquire() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!idle_.empty()) {
+        Decoder *decoder = idle_.back().release();
+        idle_.pop_back();
+        return Ptr(decoder, Releaser(this));
+      }
+    }
+
+    // Construct it outside of the lock; it can take a while.
+    std::unique_ptr<Decoder> decoder = factory_();
+    KALDI_DECODER_ASSERT(decoder != nullptr);
+    return Ptr(decoder.release(), Releaser(this));
+  }
+
+  /// Creates decoders up to "n" idle decoders, e.g., at server start-up.
+  void Reserve(int32_t n) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (static_cast<int32_t>(idle_.size()) < n &&
+           static_cast<int32_t>(idle_.size()) < max_idle_) {
+      idle_.push_back(factory_());
+    }
+  }
+
+  /// Number of idle decoders in the pool
+  int32_t NumIdle() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<int32_t>(idle_.size());
+  }
+
+ private:
+  void Release(Decoder *decoder) {
+    std::unique_ptr<Decoder> d(decoder);
+
+    // Free the state of the last utterance, but keep its memory
+    d->Reset();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (static_cast<int32_t>(idle_.size()) < max_idle_) {
+      idle_.push_back(std::move(d));
+    }
+  }
+
+  Factory factory_;
+  int32_t max_idle_;
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<Decoder>> idle_;
+};
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_DECODER_POOL_H_
@@ -0,0 +1,253 @@
+// kaldi-decoder/csrc/decoder-snapshot-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/faster-decoder.h"
+#include "kaldi-decoder/csrc/lattice-simple-decoder.h"
+#include "kaldi-decoder/csrc/test-utils.h"
+
+namespace kaldi_decoder {
+
+using ArcInfo = std::tuple<int32_t, int32_t, int32_t, int32_t, float, float>;
+
+static std::vector<ArcInfo> ToArcs(const fst::Lattice &lat) {
+  std::vector<ArcInfo> ans;
+  for (fst::StateIterator<fst::Lattice> siter(lat); !siter.Done();
+       siter.Next()) {
+    int32_t s = siter.Value();
+    for (fst::ArcIterator<fst::Lattice> aiter(lat, s); !aiter.Done();
+         aiter.Next()) {
+      const auto &arc = aiter.Value();
+      ans.emplace_back(s, arc.ilabel, arc.olabel, arc.nextstate,
+                       arc.weight.Value1(), arc.weight.Value2());
+    }
+  }
+  return ans;
+}
+
+TEST(DecoderSnapshot, FasterDecoder) {
+  int32_t num_labels = 4;
+  fst::StdVectorFst g = BuildLoopGraph(num_labels);
+  FloatMatrix log_probs = RandnMatrix(30, num_labels);
+
+  FasterDecoderOptions opts(8.0);
+  DecodableCtc decodable(log_probs);
+
+  FasterDecoder expected_decoder(g, opts);
+  expected_decoder.Decode(&decodable);
+  fst::Lattice expected;
+  expected_decoder.GetBestPath(&expected);
+
+  for (int32_t n : {0, 1, 13, 30}) {
+    FasterDecoder decoder(g, opts);
+    decoder.InitDecoding();
+    decoder.AdvanceDecoding(&decodable, n);
+
+    std::ostringstream os;
+    decoder.Snapshot(os);
+
+    FasterDecoder restored(g, opts);
+    std::istringstream is(os.str());
+    restored.Restore(is);
+    EXPECT_EQ(restored.NumFramesDecoded(), n);
+
+    restored.AdvanceDecoding(&decodable);
+    fst::Lattice best_path;
+    restored.GetBestPath(&best_path);
+    EXPECT_EQ(ToArcs(best_path), ToArcs(expected)) << "n: " << n;
+  }
+}
+
+TEST(DecoderSnapshot, FasterDecoderEndpoint) {
+  int32_t num_labels = 3;
+  fst::StdVectorFst g = BuildLoopGraph(num_labels);
+
+  // Label 2 on 10 frames, then silence, i.e., label 1
+  std::vector<int32_t> frame_tokens(40, 0);
+  std::fill(frame_tokens.begin(), frame_tokens.begin() + 10, 1);
+  FloatMatrix log_probs = PeakyLogProbs(frame_tokens, num_labels, 6, 1,
+                                        /*seed=*/0);
+  DecodableCtc decodable(log_probs);
+
+  // An endpoint after 1 second, i.e., 10 frames, of silence
+  EndpointConfig endpoint_config;
+  endpoint_config.silence_labels = {1};
+  endpoint_config.frame_shift_in_seconds = 0.1;
+  endpoint_config.rule1 = endpoint_config.rule2 = endpoint_config.rule3 =
+      endpoint_config.rule4 = EndpointRule(true, 1.0);
+
+  FasterDecoderOptions opts(8.0);
+  FasterDecoder decoder(g, opts);
+  decoder.SetEndpointConfig(endpoint_config);
+  decoder.InitDecoding();
+  ASSERT_TRUE(decoder.AdvanceDecoding(&decodable));
+  EXPECT_EQ(decoder.NumFramesDecoded(), 20);
+
+  std::ostringstream os;
+  decoder.Snapshot(os);
+
+  FasterDecoder restored(g, opts);
+  restored.SetEndpointConfig(endpoint_config);
+  std::istringstream is(os.str());
+  restored.Restore(is);
+  EXPECT_TRUE(restored.EndpointDetected());
+
+  // The endpoint state is the same as the one of the original decoder
+  for (int32_t i = 0; i != 5; ++i) {
+    decoder.AdvanceDecoding(&decodable, 1);
+    restored.AdvanceDecoding(&decodable, 1);
+
+    std::ostringstream expected, actual;
+    decoder.Snapshot(expected);
+    restored.Snapshot(actual);
+    EXPECT_EQ(actual.str(), expected.str()) << "i: " << i;
+  }
+}
+
+TEST(DecoderSnapshot, LatticeSimpleDecoder) {
+  int32_t num_labels = 4;
+  fst::StdVectorFst g = BuildLoopGraph(num_labels);
+  FloatMatrix log_probs = RandnMatrix(30, num_labels);
+
+  LatticeSimpleDecoderConfig config(8.0, 4.0, 10);
+  DecodableCtc decodable(log_probs);
+
+  LatticeSimpleDecoder decoder(g, config);
+  decoder.Decode(&decodable);
+
+  std::ostringstream os;
+  decoder.Snapshot(os);
+
+  LatticeSimpleDecoder restored(g, config);
+  std::istringstream is(os.str());
+  restored.Restore(is);
+  EXPECT_EQ(restored.NumFramesDecoded(), decoder.NumFramesDecoded());
+  EXPECT_EQ(restored.FinalRelativeCost(), decoder.FinalRelativeCost());
+
+  fst::Lattice expected, lat;
+  decoder.GetRawLattice(&expected);
+  restored.GetRawLattice(&lat);
+  EXPECT_EQ(ToArcs(lat), ToArcs(expected));
+}
+
+TEST(DecoderSnapshot, LatticeSimpleDecoderPartial) {
+  int32_t num_labels = 4;
+  fst::StdVectorFst g = BuildLoopGraph(num_labels);
+  FloatMatrix log_probs = RandnMatrix(30, num_labels, 0, 1, /*seed=*/0);
+  DecodableCtc decodable(log_probs);
+
+  // Pruned every 10 frames
+  LatticeSimpleDecoderConfig config(8.0, 4.0, 10);
+
+  LatticeSimpleDecoder decoder(g, config);
+  decoder.InitDecoding();
+  decoder.AdvanceDecoding(&decodable, 25);
+
+  std::ostringstream os;
+  decoder.Snapshot(os);
+
+  LatticeSimpleDecoder restored(g, config);
+  std::istringstream is(os.str());
+  restored.Restore(is);
+
+  // The frames pruned before the snapshot can be exported right away
+  fst::Lattice expected, lat;
+  int32_t num_exported = decoder.ExtendRawLattice(&expected);
+  EXPECT_EQ(num_exported, 20);
+  EXPECT_EQ(restored.ExtendRawLattice(&lat), num_exported);
+  EXPECT_EQ(ToArcs(lat), ToArcs(expected));
+
+  decoder.AdvanceDecoding(&decodable);
+  restored.AdvanceDecoding(&decodable);
+  decoder.GetRawLattice(&expected);
+  restored.GetRawLattice(&lat);
+  EXPECT_EQ(ToArcs(lat), ToArcs(expected));
+}
+
+TEST(DecoderSnapshot, LatticeSimpleDecoderMemoryCap) {
+  int32_t num_labels = 4;
+  fst::StdVectorFst g = BuildLoopGraph(num_labels);
+  FloatMatrix log_probs = RandnMatrix(30, num_labels, 0, 1, /*seed=*/0);
+  DecodableCtc decodable(log_probs);
+
+  // Any cap below the memory of the first frame tightens the beams
+  LatticeSimpleDecoderConfig config(8.0, 4.0, 10);
+  config.max_mem_bytes = 1;
+
+  LatticeSimpleDecoder decoder(g, config);
+  decoder.InitDecoding();
+  decoder.AdvanceDecoding(&decodable, 25);
+  EXPECT_EQ(decoder.GetMemoryStats().num_tightened_frames, 24);
+
+  std::ostringstream os;
+  decoder.Snapshot(os);
+
+  // The restored decoder keeps the tightened beams
+  LatticeSimpleDecoder restored(g, config);
+  std::istringstream is(os.str());
+  restored.Restore(is);
+  EXPECT_EQ(restored.GetMemoryStats().num_tightened_frames, 24);
+
+  restored.AdvanceDecoding(&decodable);
+  EXPECT_EQ(restored.GetMemoryStats().num_tightened_frames, 29);
+}
+
+TEST(DecoderSnapshot, LatticeSimpleDecoderOtherGraph) {
+  fst::StdVectorFst g = BuildLoopGraph(4);
+  FloatMatrix log_probs = PeakyLogProbs({0, 1, 1, 2, 3, 3, 3}, 4, 6, 1,
+                                        /*seed=*/0);
+  DecodableCtc decodable(log_probs);
+
+  LatticeSimpleDecoder decoder(g, LatticeSimpleDecoderConfig());
+  decoder.InitDecoding();
+  decoder.AdvanceDecoding(&decodable);
+
+  std::ostringstream os;
+  decoder.Snapshot(os);
+
+  // State 4 of g, where the last frames are, does not exist in small_g
+  fst::StdVectorFst small_g = BuildLoopGraph(2);
+  LatticeSimpleDecoder restored(small_g, LatticeSimpleDecoderConfig());
+  std::istringstream is(os.str());
+  EXPECT_THROW(restored.Restore(is), std::runtime_error);
+}
+
+TEST(DecoderSnapshot, TruncatedInput) {
+  fst::StdVectorFst g = BuildLoopGraph(3);
+  FloatMatrix log_probs = RandnMatrix(10, 3);
+  DecodableCtc decodable(log_probs);
+
+  FasterDecoder decoder(g, FasterDecoderOptions());
+  decoder.InitDecoding();
+  decoder.AdvanceDecoding(&decodable, 5);
+
+  std::ostringstream os;
+  decoder.Snapshot(os);
+  std::string s = os.str();
+
+  FasterDecoder restored(g, FasterDecoderOptions());
+  restored.InitDecoding();
+  restored.AdvanceDecoding(&decodable, 2);
+
+  std::istringstream is(s.substr(0, s.size() - 1));
+  EXPECT_THROW(restored.Restore(is), std::runtime_error);
+
+  // It is unchanged on errors
+  EXPECT_EQ(restored.NumFramesDecoded(), 2);
+
+  // A snapshot of one decoder cannot be restored by the other
+  LatticeSimpleDecoder lattice_decoder(g, LatticeSimpleDecoderConfig());
+  std::istringstream is2(s);
+  EXPECT_THROW(lattice_decoder.Restore(is2), std::runtime_error);
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,40 @@
+// kaldi-decoder/csrc/deterministic-lm.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_DETERMINISTIC_LM_H_
+#define KALDI_DECODER_CSRC_DETERMINISTIC_LM_H_
+
+#include <cstdint>
+
+namespace kaldi_decoder {
+
+/** A language model seen as a deterministic FST whose arcs are computed on
+    demand, like Kaldi's DeterministicOnDemandFst: a state is an LM history,
+    and each word leads from a state to at most one next state. It is the
+    interface used by lattice rescoring (see lattice-rescore.h); implement
+    it to rescore with any LM, e.g., a neural one.
+
+    All the methods are const and must be thread-safe, so that one LM can
+    be shared by the threads of a LatticeRescorer.
+ */
+class DeterministicLm {
+ public:
+  virtual ~DeterministicLm() = default;
+
+  /// Returns the state of the empty history, i.e., after <s>.
+  virtual int32_t Start() const = 0;
+
+  /// Returns the cost (negated natural log-probability) of ending the
+  /// sentence in "state", i.e., of </s>; infinity if it is not allowed.
+  virtual float Final(int32_t state) const = 0;
+
+  /// Outputs the state after "word" and its cost in "state". Returns false
+  /// if the LM does not accept the word, e.g., if it is out of vocabulary.
+  virtual bool GetArc(int32_t state, int32_t word, int32_t *next_state,
+                      float *cost) const = 0;
+};
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_DETERMINISTIC_LM_H_
@@ -5,9 +5,12 @@
 #include "kaldi-decoder/csrc/eigen.h"
 
 #include <cmath>
+#include <limits>
 #include <type_traits>
+#include <vector>
 
 #include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/test-utils.h"
 
 // See
 //
@@ -653,6 +656,78 @@ TEST(Eigen, TestSoftmax) {
   }
 }
 
+TEST(Eigen, LogSoftmaxRows) {
+  FloatMatrix m = RandnMatrix(50, 37, 0, 5);
+  m(3, 4) = -std::numeric_limits<float>::infinity();
+  m(7, 0) = -200;
+
+  FloatMatrix expected = m;
+  for (int32_t r = 0; r != m.rows(); ++r) {
+    expected.row(r).array() -= LogSumExp(m.row(r).transpose());
+  }
+
+  for (bool approximate : {false, true}) {
+    for (int32_t num_threads : {1, 3, 100}) {
+      FloatMatrix a = m;
+      LogSoftmaxRows(&a, approximate, num_threads);
+      EXPECT_EQ(a(3, 4), -std::numeric_limits<float>::infinity());
+      a(3, 4) = expected(3, 4) = 0;
+      // Relative to the magnitude, for the rounding of large outputs
+      FloatMatrix error = (a - expected).cwiseAbs().array() /
+                          (1 + expected.cwiseAbs().array());
+      EXPECT_LT(error.maxCoeff(), 1e-5) << approximate << " " << num_threads;
+    }
+  }
+
+  FloatMatrix empty;
+  LogSoftmaxRows(&empty);
+  EXPECT_EQ(empty.size(), 0);
+}
+
+TEST(Eigen, Randn) {
+  // Reproducible, and independent of the number of threads
+  FloatMatrix a = RandnMatrix(301, 77, 1, 2, /*seed=*/42);
+  for (int32_t num_threads : {1, 2, 7}) {
+    FloatMatrix b = RandnMatrix(301, 77, 1, 2, 42, num_threads);
+    EXPECT_EQ(a, b) << num_threads;
+  }
+  EXPECT_NE(a, RandnMatrix(301, 77, 1, 2, 43));
+  EXPECT_NE(RandnMatrix(3, 4), RandnMatrix(3, 4));
+
+  // The first samples do not depend on n
+  FloatVector v = RandnVector(1001, 1, 2, 42);
+  EXPECT_EQ(v.head(999), RandnVector(999, 1, 2, 42));
+  EXPECT_TRUE(std::isfinite(v[1000]));
+
+  FloatVector x = RandnVector(200000, 3, 0.5, 7, 4);
+  float mean = x.mean();
+  float stddev = std::sqrt((x.array() - mean).square().mean());
+  EXPECT_NEAR(mean, 3, 0.01);
+  EXPECT_NEAR(stddev, 0.5, 0.01);
+
+  // About 68.3% of the samples are within one stddev of the mean
+  float inside = ((x.array() - 3).abs() < 0.5).cast<float>().mean();
+  EXPECT_NEAR(inside, 0.683, 0.01);
+
+  EXPECT_NE(Randn(), Randn());
+}
+
+TEST(Eigen, PeakyLogProbs) {
+  std::vector<int32_t> frame_tokens = {0, 3, 3, 0, 1, 2, 0};
+  FloatMatrix m = PeakyLogProbs(frame_tokens, 5, 8, 0.5, /*seed=*/1);
+  ASSERT_EQ(m.rows(), 7);
+  ASSERT_EQ(m.cols(), 5);
+  for (int32_t t = 0; t != 7; ++t) {
+    Eigen::Index best;
+    m.row(t).maxCoeff(&best);
+    EXPECT_EQ(best, frame_tokens[t]);
+    EXPECT_NEAR(m.row(t).array().exp().sum(), 1, 1e-5);
+  }
+  EXPECT_EQ(m, PeakyLogProbs(frame_tokens, 5, 8, 0.5, 1, 3));
+
+  EXPECT_THROW(PeakyLogProbs({5}, 5), std::runtime_error);
+}
+
 TEST(Eigen, Op1) {
   Eigen::VectorXf a(2);
   Eigen::VectorXf b(3);
@@ -4,8 +4,15 @@
 
 #include "kaldi-decoder/csrc/eigen.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <random>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "kaldi-decoder/csrc/log.h"
 
 namespace kaldi_decoder {
 
@@ -31,41 +38,196 @@ FloatVector Softmax(const FloatVector &v, float *log_sum_exp /*= nullptr*/) {
   return ans / ans_sum;
 }
 
-FloatVector RandnVector(int32_t n, float mean /*= 0*/, float stddev /*= 1*/) {
-  std::random_device rd{};
-  std::mt19937 gen{rd()};
-  std::normal_distribution<float> d{mean, stddev};
+// Returns exp(x) for x in [-87, 0], with a relative error below 3e-6. It is
+// exp(x) = 2^i * 2^f, where i is an integer and f is in [0, 1), with 2^f
+// from a minimax polynomial and 2^i from the bits of a float. It has no
+// branches, so that loops calling it are vectorized.
+static inline float ExpApprox(float x) {
+  constexpr float kLog2e = 1.44269504f;
+
+  // In (1, 127], so that the truncation is the floor and 2^(i - 127) is a
+  // normal float
+  float t = x * kLog2e + 127.0f;
+  int32_t i = static_cast<int32_t>(t);
+  float f = t - static_cast<float>(i);
+
+  float p = 1.00000259f +
+            f * (0.693003834f +
+                 f * (0.241442757f + f * (0.0520114606f + f * 0.0135341679f)));
+
+  int32_t bits = i << 23;
+  float scale;
+  std::memcpy(&scale, &bits, sizeof(scale));
+  return scale * p;
+}
 
-  FloatVector ans(n);
+// "buf" has room for n floats
+static void LogSoftmaxRow(float *p, int32_t n, bool approximate, float *buf) {
+  Eigen::Map<FloatRowVector> row(p, n);
+  float max_v = row.maxCoeff();
+
+  float sum;
+  if (approximate) {
+    // The clamping is done by Eigen, since a comparison in the loop below
+    // would prevent its vectorization. exp(-87) is negligible in a sum with
+    // exp(0) = 1. The float sum is not vectorized by the compiler without
+    // -ffast-math, so it is done by Eigen as well.
+    Eigen::Map<FloatRowVector> tmp(buf, n);
+    tmp = (row.array() - max_v).max(-87.0f);
+    for (int32_t i = 0; i != n; ++i) {
+      buf[i] = ExpApprox(buf[i]);
+    }
+    sum = tmp.sum();
+  } else {
+    // A lazy expression; it does not allocate
+    sum = (row.array() - max_v).exp().sum();
+  }
 
-  for (int32_t i = 0; i != n; ++i) {
-    ans[i] = d(gen);
+  row.array() -= max_v + std::log(sum);
+}
+
+// Calls f(begin, end) on contiguous blocks of [0, n), one per thread, the
+// calling thread being one of them, as in LatticeRescorer::RescoreBatch().
+template <class F>
+static void ParallelFor(int64_t n, int32_t num_threads, F f) {
+  KALDI_DECODER_ASSERT(num_threads > 0);
+  if (n <= 0) {
+    return;
   }
 
-  return ans;
+  num_threads = static_cast<int32_t>(std::min<int64_t>(num_threads, n));
+  int64_t block = (n + num_threads - 1) / num_threads;
+
+  auto worker = [&](int64_t begin) { f(begin, std::min(begin + block, n)); };
+
+  std::vector<std::thread> threads;
+  for (int64_t begin = block; begin < n; begin += block) {
+    threads.emplace_back(worker, begin);
+  }
+  worker(0);  // the calling thread is one of the workers
+  for (auto &t : threads) {
+    t.join();
+  }
 }
 
-FloatMatrix RandnMatrix(int32_t rows, int32_t cols, float mean /*= 0*/,
-                        float stddev /*= 1*/) {
-  std::random_device rd{};
-  std::mt19937 gen{rd()};
-  std::normal_distribution<float> d{mean, stddev};
+void LogSoftmaxRows(FloatMatrix *m, bool approximate /*= false*/,
+                    int32_t num_threads /*= 1*/) {
+  int32_t num_cols = m->cols();
+  if (num_cols == 0) {
+    return;
+  }
 
-  FloatMatrix ans(rows, cols);
+  ParallelFor(m->rows(), num_threads, [&](int64_t begin, int64_t end) {
+    std::vector<float> buf(approximate ? num_cols : 0);
+    for (int64_t r = begin; r < end; ++r) {
+      LogSoftmaxRow(m->row(r).data(), num_cols, approximate, buf.data());
+    }
+  });
+}
+
+// The finalizer of SplitMix64. It is a bijection of the 64-bit integers
+// whose outputs for consecutive inputs pass the usual statistical tests.
+static inline uint64_t Mix64(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
 
-  for (int32_t i = 0; i != ans.size(); ++i) {
-    ans(i) = d(gen);
+static uint64_t RandomSeed() {
+  std::random_device rd;
+  return (static_cast<uint64_t>(rd()) << 32) | rd();
+}
+
+// Number of samples generated together by RandnBlock()
+static constexpr int32_t kRandnBlock = 512;
+
+// Writes block b of the normal samples of a key to out, i.e., the samples
+// [b * kRandnBlock, (b + 1) * kRandnBlock). The generator is counter-based:
+// a block only depends on the key and b, so the blocks can be generated in
+// any order, by any thread.
+//
+// Each pair of samples comes from 64 random bits: two uniforms of 24 bits
+// turned into normal samples by the Box-Muller transform. The logarithms
+// and the trigonometric functions are computed by Eigen, which vectorizes
+// them. A whole block is always computed, so that each sample comes from
+// the same lane whatever the caller; Eigen's vectorized and scalar
+// functions may differ in the last bit.
+static void RandnBlock(uint64_t key, int64_t b, float mean, float stddev,
+                       float *out) {
+  constexpr int32_t kNumPairs = kRandnBlock / 2;
+  constexpr float kTwoPi = 6.28318531f;
+  constexpr float kScale = 1.0f / (1 << 24);
+
+  using Array = Eigen::Array<float, kNumPairs, 1>;
+  Array r;
+  Array theta;
+  uint64_t first = static_cast<uint64_t>(b) * kNumPairs;
+  for (int32_t i = 0; i != kNumPairs; ++i) {
+    uint64_t bits = Mix64(key + (first + i) * 0x9e3779b97f4a7c15ULL);
+    // In (0, 1], so that the log is finite
+    r[i] = static_cast<float>((bits >> 40) + 1) * kScale;
+    // In [0, 1)
+    theta[i] = static_cast<float>((bits >> 8) & 0xffffff) * kScale;
+  }
+
+  r = ((-2 * stddev * stddev) * r.log()).sqrt();
+  theta *= kTwoPi;
+  Array c = r * theta.cos() + mean;
+  Array s = r * theta.sin() + mean;
+
+  for (int32_t i = 0; i != kNumPairs; ++i) {
+    out[2 * i] = c[i];
+    out[2 * i + 1] = s[i];
   }
+}
+
+void RandnFill(float *p, int64_t n, float mean /*= 0*/, float stddev /*= 1*/,
+               int64_t seed /*= -1*/, int32_t num_threads /*= 1*/) {
+  uint64_t key = Mix64(seed < 0 ? RandomSeed() : static_cast<uint64_t>(seed));
+
+  int64_t num_blocks = (n + kRandnBlock - 1) / kRandnBlock;
+  ParallelFor(num_blocks, num_threads, [&](int64_t begin, int64_t end) {
+    for (int64_t b = begin; b < end; ++b) {
+      int64_t offset = b * kRandnBlock;
+      if (offset + kRandnBlock <= n) {
+        RandnBlock(key, b, mean, stddev, p + offset);
+      } else {
+        float buf[kRandnBlock];
+        RandnBlock(key, b, mean, stddev, buf);
+        std::copy(buf, buf + (n - offset), p + offset);
+      }
+    }
+  });
+}
 
+FloatVector RandnVector(int32_t n, float mean /*= 0*/, float stddev /*= 1*/,
+                        int64_t seed /*= -1*/, int32_t num_threads /*= 1*/) {
+  FloatVector ans(n);
+  RandnFill(ans.data(), ans.size(), mean, stddev, seed, num_threads);
   return ans;
 }
 
-float Randn(float mean /*= 0*/, float stddev /*= 1*/) {
-  std::random_device rd{};
-  std::mt19937 gen{rd()};
-  std::normal_distribution<float> d{mean, stddev};
+FloatMatrix RandnMatrix(int32_t rows, int32_t cols, float mean /*= 0*/,
+                        float stddev /*= 1*/, int64_t seed /*= -1*/,
+                        int32_t num_threads /*= 1*/) {
+  FloatMatrix ans(rows, cols);
+  RandnFill(ans.data(), ans.size(), mean, stddev, seed, num_threads);
+  return ans;
+}
 
-  return d(gen);
+float Randn(float mean /*= 0*/, float stddev /*= 1*/) {
+  // One stream of standard normal samples per thread, seeded on its first
+  // call and generated a block at a time
+  thread_local uint64_t key = Mix64(RandomSeed());
+  thread_local int64_t next_block = 0;
+  thread_local float buf[kRandnBlock];
+  thread_local int32_t num_used = kRandnBlock;
+
+  if (num_used == kRandnBlock) {
+    RandnBlock(key, next_block++, 0, 1, buf);
+    num_used = 0;
+  }
+  return mean + stddev * buf[num_used++];
 }
 
 }  // namespace kaldi_decoder
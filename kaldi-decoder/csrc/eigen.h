@@ -4,6 +4,8 @@
 #ifndef KALDI_DECODER_CSRC_EIGEN_H_
 #define KALDI_DECODER_CSRC_EIGEN_H_
 
+#include <cstdint>
+
 #include "Eigen/Dense"
 
 namespace kaldi_decoder {
@@ -26,12 +28,37 @@ float LogSumExp(const FloatVector &v);
 
 FloatVector Softmax(const FloatVector &v, float *log_sum_exp = nullptr);
 
-// A vector of normal distribution
-FloatVector RandnVector(int32_t n, float mean = 0, float stddev = 1);
+// Replaces each row of m with its log-softmax, in place, e.g., to normalize
+// the output of a CTC model before decoding.
+//
+// If approximate is true, exp() is computed with a polynomial that the
+// compiler can vectorize, instead of with Eigen's exp(). Its relative error
+// is below 3e-6, so the log of the sum of each row, which is subtracted from
+// it, has an absolute error below 1e-5.
+//
+// The rows are split among num_threads threads, the calling thread being
+// one of them.
+void LogSoftmaxRows(FloatMatrix *m, bool approximate = false,
+                    int32_t num_threads = 1);
+
+// Fills p[0..n) with samples of a normal distribution.
+//
+// The generator is counter-based: the samples only depend on the seed and on
+// their indexes, so the same seed gives the same samples whatever
+// num_threads. A negative seed is replaced with a random one.
+void RandnFill(float *p, int64_t n, float mean = 0, float stddev = 1,
+               int64_t seed = -1, int32_t num_threads = 1);
+
+// A vector of normal distribution. See RandnFill() for seed and num_threads.
+FloatVector RandnVector(int32_t n, float mean = 0, float stddev = 1,
+                        int64_t seed = -1, int32_t num_threads = 1);
 
 FloatMatrix RandnMatrix(int32_t rows, int32_t cols, float mean = 0,
-                        float stddev = 1);
+                        float stddev = 1, int64_t seed = -1,
+                        int32_t num_threads = 1);
 
+// A sample of normal distribution, from a generator of the calling thread
+// that is seeded randomly on its first use
 float Randn(float mean = 0, float stddev = 1);
 
 }  // namespace kaldi_decoder
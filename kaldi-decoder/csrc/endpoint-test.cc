@@ -0,0 +1,251 @@
+// kaldi-decoder/csrc/endpoint-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/endpoint.h"
+
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/ctc-decoder.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/faster-decoder.h"
+#include "kaldi-decoder/csrc/simple-decoder.h"
+
+namespace kaldi_decoder {
+
+// Label 1 is silence; 2 and 3 are words. The words end in state 0, which is
+// final with the given cost.
+static fst::StdVectorFst BuildGraph(float final_cost) {
+  fst::StdVectorFst g;
+  g.AddState();
+  g.SetStart(0);
+  g.SetFinal(0, final_cost);
+  g.AddArc(0, fst::StdArc(1, 0, 0, 0));
+  g.AddArc(0, fst::StdArc(2, 102, 0.5, 0));
+  g.AddArc(0, fst::StdArc(3, 103, 0.5, 0));
+  return g;
+}
+
+// The most likely label of each frame is 2, i.e., column 1, on the first
+// num_speech_frames frames, and 1, i.e., silence, on the others
+static FloatMatrix SpeechThenSilence(int32_t num_speech_frames,
+                                     int32_t num_frames) {
+  FloatMatrix m(num_frames, 3);
+  m.setConstant(-8);
+  for (int32_t t = 0; t != num_frames; ++t) {
+    m(t, t < num_speech_frames ? 1 : 0) = -0.01;
+  }
+  return m;
+}
+
+static EndpointConfig MakeConfig() {
+  EndpointConfig config;
+  config.silence_labels = {1};
+  config.frame_shift_in_seconds = 0.05;
+  return config;
+}
+
+TEST(Endpoint, Rules) {
+  EndpointDetector detector(MakeConfig());
+  EXPECT_TRUE(detector.Enabled());
+  EXPECT_TRUE(detector.IsSilence(1));
+  EXPECT_FALSE(detector.IsSilence(0));
+  EXPECT_FALSE(detector.IsSilence(2));
+
+  float relative_cost = 0;
+  int32_t num_calls = 0;
+  auto final_relative_cost = [&]() {
+    ++num_calls;
+    return relative_cost;
+  };
+
+  // Not enough silence for any rule; the relative cost is not needed
+  EXPECT_FALSE(detector.Detect(50, 5, final_relative_cost));
+  EXPECT_EQ(num_calls, 0);
+
+  // rule2: 0.5 seconds of silence after a likely sentence
+  EXPECT_TRUE(detector.Detect(50, 11, final_relative_cost));
+  EXPECT_EQ(num_calls, 1);
+
+  // rule3 needs 1 second of silence if the sentence is less likely
+  relative_cost = 5;
+  EXPECT_FALSE(detector.Detect(50, 11, final_relative_cost));
+  EXPECT_TRUE(detector.Detect(50, 21, final_relative_cost));
+
+  // rule4: 2 seconds of silence, whatever the relative cost
+  relative_cost = std::numeric_limits<float>::infinity();
+  EXPECT_FALSE(detector.Detect(50, 21, final_relative_cost));
+  EXPECT_TRUE(detector.Detect(50, 41, final_relative_cost));
+
+  // rule1: 5 seconds of silence only
+  EXPECT_FALSE(detector.Detect(41, 41, final_relative_cost));
+  EXPECT_TRUE(detector.Detect(101, 101, final_relative_cost));
+
+  // rule5: 20 seconds
+  EXPECT_FALSE(detector.Detect(399, 0, final_relative_cost));
+  EXPECT_TRUE(detector.Detect(401, 0, final_relative_cost));
+
+  EXPECT_FALSE(EndpointDetector().Enabled());
+
+  EndpointConfig config = MakeConfig();
+  config.silence_labels = {0};
+  EXPECT_THROW(EndpointDetector{config}, std::runtime_error);
+}
+
+template <class Decoder>
+static void TestDecoder(Decoder *decoder) {
+  // 20 frames of speech. The end is likely, so rule2 is activated after 0.5
+  // seconds of silence, i.e., 10 frames.
+  FloatMatrix log_probs = SpeechThenSilence(20, 200);
+  DecodableCtc decodable(log_probs);
+
+  decoder->InitDecoding();
+  EXPECT_FALSE(decoder->AdvanceDecoding(&decodable, 25));
+  EXPECT_EQ(decoder->NumFramesDecoded(), 25);
+  EXPECT_FALSE(decoder->EndpointDetected());
+
+  EXPECT_TRUE(decoder->AdvanceDecoding(&decodable));
+  EXPECT_EQ(decoder->NumFramesDecoded(), 30);
+  EXPECT_TRUE(decoder->EndpointDetected());
+
+  // Decoding can continue after the endpoint
+  EXPECT_TRUE(decoder->AdvanceDecoding(&decodable, 5));
+  EXPECT_EQ(decoder->NumFramesDecoded(), 31);
+
+  decoder->InitDecoding();
+  EXPECT_FALSE(decoder->EndpointDetected());
+  decoder->AdvanceDecoding(&decodable);
+  EXPECT_EQ(decoder->NumFramesDecoded(), 30);
+}
+
+TEST(Endpoint, SimpleDecoder) {
+  fst::StdVectorFst g = BuildGraph(0);
+  SimpleDecoder decoder(g, 16.0);
+
+  // Disabled by default
+  FloatMatrix log_probs = SpeechThenSilence(20, 200);
+  DecodableCtc decodable(log_probs);
+  decoder.InitDecoding();
+  EXPECT_FALSE(decoder.AdvanceDecoding(&decodable));
+  EXPECT_EQ(decoder.NumFramesDecoded(), 200);
+
+  decoder.SetEndpointConfig(MakeConfig());
+  TestDecoder(&decoder);
+}
+
+TEST(Endpoint, FasterDecoder) {
+  fst::StdVectorFst g = BuildGraph(0);
+  FasterDecoder decoder(g, FasterDecoderOptions(16.0));
+  decoder.SetEndpointConfig(MakeConfig());
+  TestDecoder(&decoder);
+
+  // The end is not likely, so rule4 is activated after 2 seconds of silence
+  fst::StdVectorFst g2 = BuildGraph(std::numeric_limits<float>::infinity());
+  FasterDecoder decoder2(g2, FasterDecoderOptions(16.0));
+  decoder2.SetEndpointConfig(MakeConfig());
+
+  FloatMatrix log_probs = SpeechThenSilence(20, 200);
+  DecodableCtc decodable(log_probs);
+  decoder2.InitDecoding();
+  EXPECT_TRUE(decoder2.AdvanceDecoding(&decodable));
+  EXPECT_EQ(decoder2.NumFramesDecoded(), 60);
+}
+
+TEST(Endpoint, CtcDecoder) {
+  // The graph of CtcDecoder has token IDs, i.e., the labels minus 1, and
+  // no blank; the blank, label 1, is the silence
+  fst::StdVectorFst g;
+  g.AddState();
+  g.SetStart(0);
+  g.SetFinal(0, 0);
+  g.AddArc(0, fst::StdArc(1, 102, 0.5, 0));
+  g.AddArc(0, fst::StdArc(2, 103, 0.5, 0));
+
+  CtcDecoder decoder(g, FasterDecoderOptions(16.0));
+  decoder.SetEndpointConfig(MakeConfig());
+  TestDecoder(&decoder);
+}
+
+// Counts the trailing silence frames of the best path from scratch
+static int32_t TrailingSilenceFrames(const fst::Lattice &best_path) {
+  std::vector<int32_t> ilabels;
+  for (int32_t s = best_path.Start(); s != fst::kNoStateId;) {
+    fst::ArcIterator<fst::Lattice> aiter(best_path, s);
+    if (aiter.Done()) {
+      break;
+    }
+    if (aiter.Value().ilabel != 0) {
+      ilabels.push_back(aiter.Value().ilabel);
+    }
+    s = aiter.Value().nextstate;
+  }
+
+  int32_t n = 0;
+  while (n < static_cast<int32_t>(ilabels.size()) &&
+         ilabels[ilabels.size() - 1 - n] == 1) {
+    ++n;
+  }
+  return n;
+}
+
+// The incremental count of trailing silence frames must follow the best
+// path, even when it changes
+template <class Decoder>
+static void TestTrailingSilence(const fst::StdVectorFst &g) {
+  FloatMatrix log_probs = RandnMatrix(300, 4, 0, 2);
+  for (int32_t t = 0; t != 300; ++t) {
+    if ((t / 15) % 2 == 1) {
+      log_probs(t, 0) += 3;
+    }
+  }
+  DecodableCtc decodable(log_probs);
+
+  // Only rule1, with 6 frames of silence
+  EndpointConfig config = MakeConfig();
+  config.rule1 = {false, 0.3, std::numeric_limits<float>::infinity(), 0};
+  EndpointRule disabled = {false, 0, std::numeric_limits<float>::infinity(),
+                           1e9};
+  config.rule2 = config.rule3 = config.rule4 = config.rule5 = disabled;
+
+  Decoder decoder(g, FasterDecoderOptions(8.0));
+  decoder.SetEndpointConfig(config);
+  decoder.InitDecoding();
+
+  int32_t num_detected = 0;
+  while (decoder.NumFramesDecoded() < 300) {
+    decoder.AdvanceDecoding(&decodable, 1);
+
+    fst::Lattice best_path;
+    ASSERT_TRUE(decoder.GetBestPath(&best_path, false));
+    bool expected = TrailingSilenceFrames(best_path) >= 6;
+    EXPECT_EQ(decoder.EndpointDetected(), expected)
+        << "frame " << decoder.NumFramesDecoded();
+    num_detected += expected;
+  }
+  EXPECT_GT(num_detected, 0);
+}
+
+TEST(Endpoint, TrailingSilence) {
+  // No final state, so that GetBestPath() gives the best token; the arcs
+  // with the same labels lead to different states
+  fst::StdVectorFst g;
+  for (int32_t s = 0; s != 3; ++s) {
+    g.AddState();
+  }
+  g.SetStart(0);
+  for (int32_t s = 0; s != 3; ++s) {
+    for (int32_t label = 1; label <= 3; ++label) {
+      g.AddArc(s, fst::StdArc(label, 0, 0.3 * ((s + label) % 3),
+                              (s + label) % 3));
+    }
+    g.AddArc(s, fst::StdArc(0, 0, 0.7, (s + 1) % 3));
+  }
+
+  TestTrailingSilence<FasterDecoder>(g);
+  TestTrailingSilence<CtcDecoder>(g);
+}
+
+}  // namespace kaldi_decoder
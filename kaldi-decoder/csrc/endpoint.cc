@@ -0,0 +1,83 @@
+// kaldi-decoder/csrc/endpoint.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+// This file is modified from
+// kaldi/src/online2/online-endpoint.cc
+
+#include "kaldi-decoder/csrc/endpoint.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "kaldi-decoder/csrc/log.h"
+
+namespace kaldi_decoder {
+
+std::string EndpointRule::ToString() const {
+  std::ostringstream os;
+
+  os << "EndpointRule(";
+  os << "must_contain_nonsilence="
+     << (must_contain_nonsilence ? "True" : "False") << ", ";
+  os << "min_trailing_silence=" << min_trailing_silence << ", ";
+  os << "max_relative_cost=" << max_relative_cost << ", ";
+  os << "min_utterance_length=" << min_utterance_length << ")";
+
+  return os.str();
+}
+
+std::string EndpointConfig::ToString() const {
+  std::ostringstream os;
+
+  os << "EndpointConfig(";
+  os << "silence_labels=[";
+  for (size_t i = 0; i != silence_labels.size(); ++i) {
+    os << (i ? ", " : "") << silence_labels[i];
+  }
+  os << "], ";
+  os << "frame_shift_in_seconds=" << frame_shift_in_seconds << ", ";
+  os << "rule1=" << rule1.ToString() << ", ";
+  os << "rule2=" << rule2.ToString() << ", ";
+  os << "rule3=" << rule3.ToString() << ", ";
+  os << "rule4=" << rule4.ToString() << ", ";
+  os << "rule5=" << rule5.ToString() << ")";
+
+  return os.str();
+}
+
+EndpointDetector::EndpointDetector(const EndpointConfig &config)
+    : enabled_(true),
+      frame_shift_in_seconds_(config.frame_shift_in_seconds),
+      rules_({config.rule1, config.rule2, config.rule3, config.rule4,
+              config.rule5}) {
+  if (config.frame_shift_in_seconds <= 0) {
+    KALDI_DECODER_ERR << "frame_shift_in_seconds should be positive. Given: "
+                      << config.frame_shift_in_seconds;
+  }
+
+  for (int32_t label : config.silence_labels) {
+    if (label <= 0) {
+      KALDI_DECODER_ERR << "Invalid silence label " << label;
+    }
+
+    if (label >= static_cast<int32_t>(is_silence_.size())) {
+      is_silence_.resize(label + 1, false);
+    }
+    is_silence_[label] = true;
+  }
+}
+
+bool EndpointDetector::RuleActivated(const EndpointRule &rule,
+                                     int32_t num_frames,
+                                     int32_t trailing_silence_frames) const {
+  bool contains_nonsilence = num_frames > trailing_silence_frames;
+  float trailing_silence = trailing_silence_frames * frame_shift_in_seconds_;
+  float utterance_length = num_frames * frame_shift_in_seconds_;
+
+  return (contains_nonsilence || !rule.must_contain_nonsilence) &&
+         trailing_silence >= rule.min_trailing_silence &&
+         utterance_length >= rule.min_utterance_length;
+}
+
+}  // namespace kaldi_decoder
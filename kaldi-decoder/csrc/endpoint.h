@@ -0,0 +1,189 @@
+// kaldi-decoder/csrc/endpoint.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+// This file is modified from
+// kaldi/src/online2/online-endpoint.h
+
+#ifndef KALDI_DECODER_CSRC_ENDPOINT_H_
+#define KALDI_DECODER_CSRC_ENDPOINT_H_
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace kaldi_decoder {
+
+/// An endpoint rule is activated when all of its conditions hold. The
+/// lengths are in seconds.
+struct EndpointRule {
+  // If true, the best path must contain a non-silence label
+  bool must_contain_nonsilence;
+
+  // The best path must end with at least this much silence
+  float min_trailing_silence;
+
+  // FinalRelativeCost() of the decoder must be at most this value, i.e.,
+  // the end of the utterance must be likely in the graph. Infinity disables
+  // this condition.
+  float max_relative_cost;
+
+  // At least this much audio must have been decoded
+  float min_utterance_length;
+
+  /*implicit*/ EndpointRule(
+      bool must_contain_nonsilence = true, float min_trailing_silence = 1.0,
+      float max_relative_cost = std::numeric_limits<float>::infinity(),
+      float min_utterance_length = 0.0)
+      : must_contain_nonsilence(must_contain_nonsilence),
+        min_trailing_silence(min_trailing_silence),
+        max_relative_cost(max_relative_cost),
+        min_utterance_length(min_utterance_length) {}
+
+  std::string ToString() const;
+};
+
+/// The default rules are those of Kaldi. An endpoint is detected if any of
+/// them is activated:
+///   rule1: 5 seconds of silence, even if nothing has been decoded
+///   rule2: 0.5 seconds of silence after the end of a likely sentence
+///   rule3: 1 second of silence after the end of a less likely sentence
+///   rule4: 2 seconds of silence after something has been decoded
+///   rule5: the utterance is 20 seconds long
+struct EndpointConfig {
+  // Input labels of the graph that are silence, e.g., {1} for the blank of
+  // CTC models (whose labels are the token IDs plus 1). The epsilon label 0
+  // is ignored.
+  std::vector<int32_t> silence_labels;
+
+  // Duration of a frame of the decodable object, e.g., 0.04 for CTC models
+  // with a subsampling factor of 4
+  float frame_shift_in_seconds = 0.01;
+
+  EndpointRule rule1 = {false, 5.0, std::numeric_limits<float>::infinity(),
+                        0.0};
+  EndpointRule rule2 = {true, 0.5, 2.0, 0.0};
+  EndpointRule rule3 = {true, 1.0, 8.0, 0.0};
+  EndpointRule rule4 = {true, 2.0, std::numeric_limits<float>::infinity(),
+                        0.0};
+  EndpointRule rule5 = {false, 0.0, std::numeric_limits<float>::infinity(),
+                        20.0};
+
+  std::string ToString() const;
+};
+
+/** Evaluates the rules of an EndpointConfig for the decoders, after each
+    frame. It is built into SimpleDecoder, FasterDecoder and CtcDecoder; see
+    their SetEndpointConfig().
+
+    Instead of tracing back the whole best path of every frame, as Kaldi
+    does, the decoders keep the best token of the previous frame together
+    with its number of trailing silence frames, and TrailingSilenceFrames()
+    only walks back until it reaches that token. It is one step per frame
+    while the best path does not change. FinalRelativeCost(), which visits
+    all the active tokens, is only computed when a rule that uses it would
+    otherwise be activated.
+ */
+class EndpointDetector {
+ public:
+  /// Endpoint detection is disabled
+  EndpointDetector() = default;
+
+  explicit EndpointDetector(const EndpointConfig &config);
+
+  bool Enabled() const { return enabled_; }
+
+  bool IsSilence(int32_t label) const {
+    return label >= 0 && label < static_cast<int32_t>(is_silence_.size()) &&
+           is_silence_[label];
+  }
+
+  /// Returns the number of frames at the end of the traceback of "tok" whose
+  /// input labels are silence. If the traceback goes through "anchor", the
+  /// walk stops there and "anchor_silence_frames" is taken as the number of
+  /// trailing silence frames of "anchor".
+  ///
+  /// Token is the token type of a decoder, with the members arc_.ilabel and
+  /// prev_.
+  template <class Token>
+  int32_t TrailingSilenceFrames(const Token *tok, const Token *anchor,
+                                int32_t anchor_silence_frames) const {
+    return TrailingSilenceFrames(
+        tok, anchor, anchor_silence_frames,
+        [](const Token *t) -> int32_t { return t->arc_.ilabel; });
+  }
+
+  /// The same for a token type that does not store its arc; ilabel(tok)
+  /// returns the input label of the arc of tok.
+  template <class Token, class F>
+  int32_t TrailingSilenceFrames(const Token *tok, const Token *anchor,
+                                int32_t anchor_silence_frames,
+                                F ilabel) const {
+    int32_t n = 0;
+    for (; tok != nullptr; tok = tok->prev_) {
+      if (tok == anchor) {
+        return n + anchor_silence_frames;
+      }
+
+      int32_t label = ilabel(tok);
+      if (label == 0) {
+        continue;
+      }
+
+      if (!IsSilence(label)) {
+        break;
+      }
+      ++n;
+    }
+    return n;
+  }
+
+  /// Returns true if any rule is activated after num_frames frames whose
+  /// best path ends with trailing_silence_frames silence frames.
+  /// final_relative_cost is a callable returning the FinalRelativeCost() of
+  /// the decoder; it is called at most once.
+  template <class F>
+  bool Detect(int32_t num_frames, int32_t trailing_silence_frames,
+              F final_relative_cost) const {
+    bool has_relative_cost = false;
+    float relative_cost = 0;
+    for (const EndpointRule &rule : rules_) {
+      if (!RuleActivated(rule, num_frames, trailing_silence_frames)) {
+        continue;
+      }
+
+      if (rule.max_relative_cost == std::numeric_limits<float>::infinity()) {
+        return true;
+      }
+
+      if (!has_relative_cost) {
+        relative_cost = final_relative_cost();
+        has_relative_cost = true;
+      }
+
+      if (relative_cost <= rule.max_relative_cost) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  // Checks all the conditions of the rule except max_relative_cost
+  bool RuleActivated(const EndpointRule &rule, int32_t num_frames,
+                     int32_t trailing_silence_frames) const;
+
+  bool enabled_ = false;
+  float frame_shift_in_seconds_ = 0;
+
+  // Indexed by input label
+  std::vector<bool> is_silence_;
+
+  // rule1 to rule5 of the config
+  std::vector<EndpointRule> rules_;
+};
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_ENDPOINT_H_
@@ -11,16 +11,26 @@
 
 #include <algorithm>
 #include <limits>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
+#include "kaldi-decoder/csrc/io-funcs.h"
 #include "kaldi-decoder/csrc/log.h"
 #include "kaldifst/csrc/remove-eps-local.h"
 
 namespace kaldi_decoder {
 
+// Increase it whenever the format written by FasterDecoder::Snapshot()
+// changes.
+static constexpr int32_t kFasterDecoderSnapshotVersion = 3;
+
 FasterDecoder::FasterDecoder(const fst::Fst<fst::StdArc> &fst,
                              const FasterDecoderOptions &opts)
-    : fst_(fst), config_(opts), num_frames_decoded_(-1) {
+    : fst_(fst),
+      fst_is_expanded_(fst.Properties(fst::kExpanded, false) != 0),
+      config_(opts),
+      num_frames_decoded_(-1) {
   KALDI_DECODER_ASSERT(config_.hash_ratio >=
                        1.0);  // less doesn't make much sense.
   KALDI_DECODER_ASSERT(config_.max_active > 1);
@@ -33,22 +43,61 @@ FasterDecoder::FasterDecoder(const fst::Fst<fst::StdArc> &fst,
 
 void FasterDecoder::ClearToks(Elem *list) {
   for (Elem *e = list, *e_tail; e != nullptr; e = e_tail) {
-    Token::TokenDelete(e->val);
+    Token::TokenDelete(e->val, &token_pool_);
     e_tail = e->tail;
     toks_.Delete(e);
   }
 }
 
+void FasterDecoder::Reset() {
+  ClearToks(toks_.Clear());
+  if (endpoint_tok_ != nullptr) {
+    Token::TokenDelete(endpoint_tok_, &token_pool_);
+    endpoint_tok_ = nullptr;
+  }
+  endpoint_silence_frames_ = 0;
+  endpoint_detected_ = false;
+  num_frames_decoded_ = -1;
+  cost_offsets_.clear();
+  peak_bytes_ = 0;
+  beam_scale_ = 1;
+  num_tightened_frames_ = 0;
+}
+
+DecoderMemoryStats FasterDecoder::GetMemoryStats() const {
+  DecoderMemoryStats stats;
+  stats.token_bytes = token_pool_.NumInUse() * token_pool_.ElemSize();
+  stats.hash_bytes = toks_.AllocatedBytes();
+  stats.free_bytes = (token_pool_.NumAllocated() - token_pool_.NumInUse()) *
+                     token_pool_.ElemSize();
+  stats.peak_bytes = std::max(peak_bytes_, stats.LiveBytes());
+  stats.num_tightened_frames = num_tightened_frames_;
+  return stats;
+}
+
+void FasterDecoder::UpdateMemoryUsage() {
+  int64_t live_bytes = GetMemoryStats().LiveBytes();
+  peak_bytes_ = std::max(peak_bytes_, live_bytes);
+
+  float prev_beam_scale = beam_scale_;
+  beam_scale_ = UpdateBeamScale(beam_scale_, live_bytes, config_.max_mem_bytes);
+  if (beam_scale_ < prev_beam_scale) {
+    KALDI_DECODER_WARN << "Memory use " << live_bytes << " exceeds "
+                       << config_.max_mem_bytes << " bytes at frame "
+                       << num_frames_decoded_ << ". Tightening the beam to "
+                       << config_.beam * beam_scale_;
+  }
+}
+
 void FasterDecoder::InitDecoding() {
   // clean up from last time:
-  ClearToks(toks_.Clear());
+  Reset();
   StateId start_state = fst_.Start();
 
   KALDI_DECODER_ASSERT(start_state != fst::kNoStateId);
 
-  Arc dummy_arc(0, 0, Weight::One(), start_state);
-
-  toks_.Insert(start_state, new Token(dummy_arc, nullptr));
+  int32_t context_state = context_graph_ ? context_graph_->Root() : 0;
+  toks_.Insert(start_state, token_pool_.New(start_state, context_state));
 
   ProcessNonemitting(std::numeric_limits<float>::max());
 
@@ -56,12 +105,18 @@ void FasterDecoder::InitDecoding() {
 }
 
 // TODO(dan): first time we go through this, could avoid using the queue.
-void FasterDecoder::ProcessNonemitting(double cutoff) {
+FasterDecoder::Token *FasterDecoder::ProcessNonemitting(float cutoff) {
   // Processes nonemitting arcs for one frame.
   KALDI_DECODER_ASSERT(queue_.empty());
 
+  // A token is only deleted when it is replaced by a better one, so the
+  // best token can be tracked while the tokens are inserted.
+  Token *best_tok = nullptr;
   for (const Elem *e = toks_.GetList(); e != nullptr; e = e->tail) {
     queue_.push_back(e);
+    if (best_tok == nullptr || *best_tok < *e->val) {
+      best_tok = e->val;
+    }
   }
 
   while (!queue_.empty()) {
@@ -75,7 +130,7 @@ void FasterDecoder::ProcessNonemitting(double cutoff) {
       continue;
     }
 
-    KALDI_DECODER_ASSERT(tok != nullptr && state == tok->arc_.nextstate);
+    KALDI_DECODER_ASSERT(tok != nullptr && state == tok->state_);
 
     for (fst::ArcIterator<fst::Fst<Arc>> aiter(fst_, state); !aiter.Done();
          aiter.Next()) {
@@ -87,10 +142,13 @@ void FasterDecoder::ProcessNonemitting(double cutoff) {
 
       // propagate nonemitting only...
 
-      Token *new_tok = new Token(arc, tok);
+      int32_t context_state;
+      float graph_cost = GraphCost(arc, tok, &context_state);
+      Token *new_tok = token_pool_.New(arc, aiter.Position(), graph_cost, 0,
+                                       tok, context_state);
 
       if (new_tok->cost_ > cutoff) {  // prune
-        Token::TokenDelete(new_tok);
+        Token::TokenDelete(new_tok, &token_pool_);
         continue;
       }
 
@@ -98,6 +156,9 @@ void FasterDecoder::ProcessNonemitting(double cutoff) {
       if (e_found->val == new_tok) {
         // if inserted successfully
         queue_.push_back(e_found);
+        if (*best_tok < *new_tok) {
+          best_tok = new_tok;
+        }
         continue;
       }
 
@@ -107,15 +168,21 @@ void FasterDecoder::ProcessNonemitting(double cutoff) {
       if (*(e_found->val) < *new_tok) {
         // i.e., if the cost of e_found is larger than new_tok
         // we keep the token with a lower cost
-        Token::TokenDelete(e_found->val);
+        // best_tok may be the token that is replaced
+        if (*best_tok < *new_tok) {
+          best_tok = new_tok;
+        }
+        Token::TokenDelete(e_found->val, &token_pool_);
         e_found->val = new_tok;
         queue_.push_back(e_found);
       } else {
         // the new token has a higher cost, remove it
-        Token::TokenDelete(new_tok);
+        Token::TokenDelete(new_tok, &token_pool_);
       }
     }
   }
+
+  return best_tok;
 }
 
 void FasterDecoder::Decode(DecodableInterface *decodable) {
@@ -123,7 +190,7 @@ void FasterDecoder::Decode(DecodableInterface *decodable) {
   AdvanceDecoding(decodable);
 }
 
-void FasterDecoder::AdvanceDecoding(DecodableInterface *decodable,
+bool FasterDecoder::AdvanceDecoding(DecodableInterface *decodable,
                                     int32_t max_num_frames /*=-1*/) {
   KALDI_DECODER_ASSERT(num_frames_decoded_ >= 0 &&
                        "You must call InitDecoding() before AdvanceDecoding()");
@@ -144,32 +211,74 @@ void FasterDecoder::AdvanceDecoding(DecodableInterface *decodable,
   }
 
   while (num_frames_decoded_ < target_frames_decoded) {
+    if (beam_scale_ < 1) {
+      ++num_tightened_frames_;
+    }
+
     // note: ProcessEmitting() increments num_frames_decoded_
-    double weight_cutoff = ProcessEmitting(decodable);
+    float weight_cutoff = ProcessEmitting(decodable);
+
+    Token *best_tok = ProcessNonemitting(weight_cutoff);
+
+    UpdateMemoryUsage();
 
-    ProcessNonemitting(weight_cutoff);
+    if (endpoint_.Enabled() && best_tok != nullptr) {
+      UpdateEndpoint(best_tok);
+      if (endpoint_detected_) {
+        break;
+      }
+    }
+  }
+
+  return endpoint_detected_;
+}
+
+void FasterDecoder::UpdateEndpoint(Token *best_tok) {
+  int32_t silence_frames = endpoint_.TrailingSilenceFrames(
+      best_tok, endpoint_tok_, endpoint_silence_frames_,
+      [](const Token *tok) -> int32_t { return tok->ilabel_; });
+
+  // Take the new reference first, as the old token may be kept alive only
+  // by the traceback of the new one
+  ++best_tok->ref_count_;
+  if (endpoint_tok_ != nullptr) {
+    Token::TokenDelete(endpoint_tok_, &token_pool_);
   }
+  endpoint_tok_ = best_tok;
+  endpoint_silence_frames_ = silence_frames;
+
+  endpoint_detected_ =
+      endpoint_.Detect(num_frames_decoded_, silence_frames,
+                       [this]() { return FinalRelativeCost(); });
 }
 
 // ProcessEmitting returns the likelihood cutoff used.
-double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
+float FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
   int32_t frame = num_frames_decoded_;
   Elem *last_toks = toks_.Clear();
   size_t tok_cnt;
   float adaptive_beam;
   Elem *best_elem = nullptr;
-  double weight_cutoff =
-      GetCutoff(last_toks, &tok_cnt, &adaptive_beam, &best_elem);
+  // The beam is tighter than config_.beam if max_mem_bytes has been
+  // exceeded
+  float weight_cutoff =
+      GetBeamCutoff(config_, config_.beam * beam_scale_, last_toks,
+                    &tmp_array_, &tok_cnt, &adaptive_beam, &best_elem);
+
+  // Added to the acoustic costs of this frame, so that the best token of
+  // the previous frame is at cost 0; see cost_offsets_.
+  float cost_offset = best_elem ? -best_elem->val->cost_ : 0;
+  cost_offsets_.push_back(cost_offset);
 
   // KALDI_DECODER_LOG << tok_cnt << " tokens active.";
 
   // This makes sure the hash is always big enough.
-  PossiblyResizeHash(tok_cnt);
+  PossiblyResizeHash(config_, tok_cnt, &toks_);
 
   // This is the cutoff we use after adding in the log-likes (i.e.
   // for the next frame).  This is a bound on the cutoff we will use
   // on the next frame.
-  double next_weight_cutoff = std::numeric_limits<double>::infinity();
+  float next_weight_cutoff = std::numeric_limits<float>::infinity();
 
   // First process the best token to get a hopefully
   // reasonably tight bound on the next cutoff.
@@ -180,8 +289,9 @@ double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
          aiter.Next()) {
       const Arc &arc = aiter.Value();
       if (arc.ilabel != 0) {  // we'd propagate..
-        float ac_cost = -1 * decodable->LogLikelihood(frame, arc.ilabel);
-        double new_weight = arc.weight.Value() + tok->cost_ + ac_cost;
+        float ac_cost =
+            cost_offset - decodable->LogLikelihood(frame, arc.ilabel);
+        float new_weight = arc.weight.Value() + tok->cost_ + ac_cost;
         if (new_weight + adaptive_beam < next_weight_cutoff)
           next_weight_cutoff = new_weight + adaptive_beam;
       }
@@ -190,6 +300,15 @@ double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
 
   // int32_t n = 0, np = 0;
 
+  // See FasterDecoderOptions::prefetch_distance. "ahead" is the element
+  // whose token and arcs are prefetched.
+  const int32_t prefetch_distance = config_.prefetch_distance;
+  Elem *ahead = last_toks;
+  for (int32_t i = 0; i < prefetch_distance && ahead != nullptr; ++i) {
+    PrefetchToken(ahead);
+    ahead = ahead->tail;
+  }
+
   // the tokens are now owned here, in last_toks, and the hash is empty.
   // 'owned' is a complex thing here; the point is we need to call TokenDelete
   // on each elem 'e' to let toks_ know we're done with them.
@@ -197,19 +316,39 @@ double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
        e = e_tail) {  // loop this way
     // n++;
     // because we delete "e" as we go.
+    if (ahead != nullptr) {
+      PrefetchToken(ahead);
+      ahead = ahead->tail;
+    }
+
     StateId state = e->key;
     Token *tok = e->val;
     if (tok->cost_ < weight_cutoff) {  // not pruned.
       // np++;
-      KALDI_DECODER_ASSERT(state == tok->arc_.nextstate);
+      KALDI_DECODER_ASSERT(state == tok->state_);
+      if (prefetch_distance > 0) {
+        // The arcs are in the caches by now; the buckets of their
+        // destinations are loaded while the first arcs are processed.
+        for (fst::ArcIterator<fst::Fst<Arc>> aiter(fst_, state);
+             !aiter.Done(); aiter.Next()) {
+          if (aiter.Value().ilabel != 0) {
+            toks_.Prefetch(aiter.Value().nextstate);
+          }
+        }
+      }
+
       for (fst::ArcIterator<fst::Fst<Arc>> aiter(fst_, state); !aiter.Done();
            aiter.Next()) {
         const Arc &arc = aiter.Value();
         if (arc.ilabel != 0) {  // propagate..
-          float ac_cost = -1 * decodable->LogLikelihood(frame, arc.ilabel);
-          double new_weight = arc.weight.Value() + tok->cost_ + ac_cost;
+          float ac_cost =
+              cost_offset - decodable->LogLikelihood(frame, arc.ilabel);
+          int32_t context_state;
+          float graph_cost = GraphCost(arc, tok, &context_state);
+          float new_weight = graph_cost + tok->cost_ + ac_cost;
           if (new_weight < next_weight_cutoff) {  // not pruned..
-            Token *new_tok = new Token(arc, ac_cost, tok);
+            Token *new_tok = token_pool_.New(arc, aiter.Position(), graph_cost,
+                                             ac_cost, tok, context_state);
             Elem *e_found = toks_.Insert(arc.nextstate, new_tok);
 
             if (new_weight + adaptive_beam < next_weight_cutoff) {
@@ -219,11 +358,11 @@ double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
             if (e_found->val != new_tok) {
               if (*(e_found->val) < *new_tok) {
                 // e_found has a higher cost
-                Token::TokenDelete(e_found->val);
+                Token::TokenDelete(e_found->val, &token_pool_);
                 e_found->val = new_tok;
               } else {
                 // new_tok has a higher cost
-                Token::TokenDelete(new_tok);
+                Token::TokenDelete(new_tok, &token_pool_);
               }
             }
           }
@@ -232,7 +371,7 @@ double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
     }
 
     e_tail = e->tail;
-    Token::TokenDelete(e->val);
+    Token::TokenDelete(e->val, &token_pool_);
     toks_.Delete(e);
   }
 
@@ -240,119 +379,34 @@ double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
   return next_weight_cutoff;
 }
 
-// Gets the weight cutoff.  Also counts the active tokens.
-double FasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
-                                float *adaptive_beam, Elem **best_elem) {
-  double best_cost = std::numeric_limits<double>::infinity();
-
-  size_t count = 0;
-  if (config_.max_active == std::numeric_limits<int32_t>::max() &&
-      config_.min_active == 0) {
-    // no constraints
-    for (Elem *e = list_head; e != nullptr; e = e->tail, ++count) {
-      double w = e->val->cost_;
-      if (w < best_cost) {
-        best_cost = w;
-
-        if (best_elem) {
-          *best_elem = e;
-        }
-      }
-    }
-
-    if (tok_count != nullptr) {
-      *tok_count = count;
-    }
-
-    if (adaptive_beam != nullptr) {
-      *adaptive_beam = config_.beam;
-    }
-
-    return best_cost + config_.beam;
-  }
-
-  tmp_array_.clear();
-
-  for (Elem *e = list_head; e != nullptr; e = e->tail, ++count) {
-    double w = e->val->cost_;
-    tmp_array_.push_back(w);
-
-    if (w < best_cost) {
-      best_cost = w;
-
-      if (best_elem) {
-        *best_elem = e;
-      }
-    }
-  }
-
-  if (tok_count != nullptr) {
-    *tok_count = count;
-  }
-
-  double beam_cutoff = best_cost + config_.beam;
-  double min_active_cutoff = std::numeric_limits<double>::infinity();
-  double max_active_cutoff = std::numeric_limits<double>::infinity();
-
-  if (tmp_array_.size() > static_cast<size_t>(config_.max_active)) {
-    std::nth_element(tmp_array_.begin(),
-                     tmp_array_.begin() + config_.max_active, tmp_array_.end());
-    max_active_cutoff = tmp_array_[config_.max_active];
-  }
-
-  if (max_active_cutoff < beam_cutoff) {  // max_active is tighter than beam.
-    if (adaptive_beam) {
-      *adaptive_beam = max_active_cutoff - best_cost + config_.beam_delta;
-    }
-
-    return max_active_cutoff;
-  }
-
-  if (tmp_array_.size() > static_cast<size_t>(config_.min_active)) {
-    if (config_.min_active == 0) {
-      min_active_cutoff = best_cost;
-    } else {
-      std::nth_element(
-          tmp_array_.begin(), tmp_array_.begin() + config_.min_active,
-          tmp_array_.size() > static_cast<size_t>(config_.max_active)
-              ? tmp_array_.begin() + config_.max_active
-              : tmp_array_.end());
-
-      min_active_cutoff = tmp_array_[config_.min_active];
-    }
-  }
-
-  if (min_active_cutoff > beam_cutoff) {  // min_active is looser than beam.
-    if (adaptive_beam) {
-      *adaptive_beam = min_active_cutoff - best_cost + config_.beam_delta;
-    }
-
-    return min_active_cutoff;
-  } else {
-    *adaptive_beam = config_.beam;
-
-    return beam_cutoff;
-  }
-}
-
-void FasterDecoder::PossiblyResizeHash(size_t num_toks) {
-  auto new_sz =
-      static_cast<size_t>(static_cast<float>(num_toks) * config_.hash_ratio);
-
-  if (new_sz > toks_.Size()) {
-    toks_.SetSize(new_sz);
-  }
-}
-
 bool FasterDecoder::ReachedFinal() const {
   for (const Elem *e = toks_.GetList(); e != nullptr; e = e->tail) {
-    if (e->val->cost_ != std::numeric_limits<double>::infinity() &&
+    if (e->val->cost_ != std::numeric_limits<float>::infinity() &&
         fst_.Final(e->key) != Weight::Zero())
       return true;
   }
   return false;
 }
 
+float FasterDecoder::FinalRelativeCost() const {
+  float infinity = std::numeric_limits<float>::infinity();
+  float best_cost = infinity;
+  float best_cost_with_final = infinity;
+  for (const Elem *e = toks_.GetList(); e != nullptr; e = e->tail) {
+    best_cost = std::min(best_cost, e->val->cost_);
+    best_cost_with_final = std::min(
+        best_cost_with_final, e->val->cost_ + fst_.Final(e->key).Value());
+  }
+
+  // It is infinity if there are no tokens or no final states
+  float extra_cost = best_cost_with_final - best_cost;
+  if (extra_cost != extra_cost) {  // NaN
+    KALDI_DECODER_WARN << "Found NaN (likely search failure in decoding)";
+    return infinity;
+  }
+  return extra_cost;
+}
+
 bool FasterDecoder::GetBestPath(fst::MutableFst<fst::LatticeArc> *fst_out,
                                 bool use_final_probs) {
   // GetBestPath gets the decoding output.  If "use_final_probs" is true
@@ -364,10 +418,27 @@ bool FasterDecoder::GetBestPath(fst::MutableFst<fst::LatticeArc> *fst_out,
   fst_out->DeleteStates();
   Token *best_tok = nullptr;
   bool is_final = ReachedFinal();
+
+  // If we are asked to use final-probs, the bonus of any partially matched
+  // context phrase is taken back.
+  bool use_context_final = (context_graph_ != nullptr && use_final_probs);
+
   if (!is_final) {
-    for (const Elem *e = toks_.GetList(); e != nullptr; e = e->tail) {
-      if (best_tok == nullptr || *best_tok < *(e->val)) {
-        best_tok = e->val;
+    if (!use_context_final) {
+      for (const Elem *e = toks_.GetList(); e != nullptr; e = e->tail) {
+        if (best_tok == nullptr || *best_tok < *(e->val)) {
+          best_tok = e->val;
+        }
+      }
+    } else {
+      double best_cost = std::numeric_limits<double>::infinity();
+      for (const Elem *e = toks_.GetList(); e != nullptr; e = e->tail) {
+        double this_cost =
+            e->val->cost_ + context_graph_->Finalize(e->val->context_state_);
+        if (best_tok == nullptr || this_cost < best_cost) {
+          best_cost = this_cost;
+          best_tok = e->val;
+        }
       }
     }
   } else {
@@ -376,6 +447,10 @@ bool FasterDecoder::GetBestPath(fst::MutableFst<fst::LatticeArc> *fst_out,
 
     for (const Elem *e = toks_.GetList(); e != nullptr; e = e->tail) {
       double this_cost = e->val->cost_ + fst_.Final(e->key).Value();
+      if (use_context_final) {
+        this_cost += context_graph_->Finalize(e->val->context_state_);
+      }
+
       if (this_cost < best_cost && this_cost != infinity) {
         best_cost = this_cost;
         best_tok = e->val;
@@ -390,20 +465,29 @@ bool FasterDecoder::GetBestPath(fst::MutableFst<fst::LatticeArc> *fst_out,
 
   std::vector<fst::LatticeArc> arcs_reverse;  // arcs in reverse order.
 
-  for (Token *tok = best_tok; tok != nullptr; tok = tok->prev_) {
-    float tot_cost = tok->cost_ - (tok->prev_ ? tok->prev_->cost_ : 0.0);
-    float graph_cost = tok->arc_.weight.Value();
-    float ac_cost = tot_cost - graph_cost;
+  // The frame of the tokens of the traceback, which tells which cost offset
+  // to take off the acoustic costs of the emitting arcs
+  int32_t frame = num_frames_decoded_;
+  const Token *tok = best_tok;
+  for (; tok->prev_ != nullptr; tok = tok->prev_) {
+    fst::ArcIterator<fst::Fst<Arc>> aiter(fst_, tok->prev_->state_);
+    aiter.Seek(tok->arc_index_);
+    const Arc &arc = aiter.Value();
+
+    int32_t context_state;
+    float graph_cost = GraphCost(arc, tok->prev_, &context_state);
+    float ac_cost = tok->cost_ - tok->prev_->cost_ - graph_cost;
+    if (arc.ilabel != 0) {
+      ac_cost -= cost_offsets_[--frame];
+    }
 
-    fst::LatticeArc l_arc(tok->arc_.ilabel, tok->arc_.olabel,
-                          fst::LatticeWeight(graph_cost, ac_cost),
-                          tok->arc_.nextstate);
-    arcs_reverse.push_back(l_arc);
+    arcs_reverse.emplace_back(arc.ilabel, arc.olabel,
+                              fst::LatticeWeight(graph_cost, ac_cost),
+                              arc.nextstate);
   }
 
-  KALDI_DECODER_ASSERT(arcs_reverse.back().nextstate == fst_.Start());
-
-  arcs_reverse.pop_back();  // that was a "fake" token... gives no info.
+  // The start token has no arc
+  KALDI_DECODER_ASSERT(tok->state_ == fst_.Start() && frame == 0);
 
   StateId cur_state = fst_out->AddState();
   fst_out->SetStart(cur_state);
@@ -413,14 +497,241 @@ bool FasterDecoder::GetBestPath(fst::MutableFst<fst::LatticeArc> *fst_out,
     fst_out->AddArc(cur_state, arc);
     cur_state = arc.nextstate;
   }
+  float context_cost = use_context_final
+                           ? context_graph_->Finalize(best_tok->context_state_)
+                           : 0;
   if (is_final && use_final_probs) {
-    Weight final_weight = fst_.Final(best_tok->arc_.nextstate);
-    fst_out->SetFinal(cur_state, fst::LatticeWeight(final_weight.Value(), 0.0));
+    Weight final_weight = fst_.Final(best_tok->state_);
+    fst_out->SetFinal(cur_state, fst::LatticeWeight(
+                                     final_weight.Value() + context_cost, 0.0));
   } else {
-    fst_out->SetFinal(cur_state, fst::LatticeWeight::One());
+    fst_out->SetFinal(cur_state, fst::LatticeWeight(context_cost, 0.0));
   }
   fst::RemoveEpsLocal(fst_out);
   return true;
 }
 
+void FasterDecoder::Snapshot(std::ostream &os) const {
+  KALDI_DECODER_ASSERT(num_frames_decoded_ >= 0 &&
+                       "You must call InitDecoding() before Snapshot()");
+
+  // Number the active tokens, the endpoint token and their tracebacks such
+  // that a token always comes after its predecessor. Tracebacks shared by
+  // several tokens are written only once.
+  std::unordered_map<const Token *, int32_t> tok_ids;
+  std::vector<const Token *> toks;
+  std::vector<const Token *> stack;
+  auto number = [&tok_ids, &toks, &stack](const Token *tok) {
+    for (; tok != nullptr; tok = tok->prev_) {
+      if (!tok_ids.emplace(tok, -1).second) {
+        break;  // the rest of the traceback has been visited
+      }
+      stack.push_back(tok);
+    }
+
+    while (!stack.empty()) {
+      tok_ids[stack.back()] = static_cast<int32_t>(toks.size());
+      toks.push_back(stack.back());
+      stack.pop_back();
+    }
+  };
+
+  int32_t num_active = 0;
+  for (const Elem *e = toks_.GetList(); e != nullptr; e = e->tail) {
+    ++num_active;
+    number(e->val);
+  }
+  number(endpoint_tok_);
+
+  WriteMarker(os, "<FasterDecoder>");
+  WriteBasicType(os, kFasterDecoderSnapshotVersion);
+  WriteBasicType(os, num_frames_decoded_);
+  for (float offset : cost_offsets_) {
+    WriteBasicType(os, offset);
+  }
+  WriteBasicType(os, context_graph_ != nullptr);
+
+  WriteBasicType(os, static_cast<int32_t>(toks.size()));
+  for (const Token *tok : toks) {
+    WriteBasicType(os, tok->prev_ ? tok_ids[tok->prev_] : -1);
+    WriteBasicType(os, tok->arc_index_);
+    WriteBasicType(os, tok->context_state_);
+    WriteBasicType(os, tok->cost_);
+  }
+
+  // The active tokens are written in the order of the list
+  WriteBasicType(os, num_active);
+  for (const Elem *e = toks_.GetList(); e != nullptr; e = e->tail) {
+    WriteBasicType(os, tok_ids[e->val]);
+  }
+
+  WriteBasicType(os, endpoint_tok_ ? tok_ids[endpoint_tok_] : -1);
+  WriteBasicType(os, endpoint_silence_frames_);
+  WriteBasicType(os, endpoint_detected_);
+
+  if (!os) {
+    KALDI_DECODER_ERR << "Failed to write the snapshot";
+  }
+}
+
+void FasterDecoder::Restore(std::istream &is) {
+  ExpectMarker(is, "<FasterDecoder>");
+
+  int32_t version;
+  ReadBasicType(is, &version);
+  if (version != kFasterDecoderSnapshotVersion) {
+    KALDI_DECODER_ERR << "Unsupported snapshot version " << version
+                      << ". Expected: " << kFasterDecoderSnapshotVersion;
+  }
+
+  int32_t num_frames_decoded;
+  ReadBasicType(is, &num_frames_decoded);
+  if (num_frames_decoded < 0) {
+    KALDI_DECODER_ERR << "Invalid number of frames: " << num_frames_decoded;
+  }
+
+  // Not resized in advance, so that a corrupted number of frames makes the
+  // reading fail instead of allocating a huge vector
+  std::vector<float> cost_offsets;
+  for (int32_t t = 0; t != num_frames_decoded; ++t) {
+    float offset;
+    ReadBasicType(is, &offset);
+    cost_offsets.push_back(offset);
+  }
+
+  bool has_context_graph;
+  ReadBasicType(is, &has_context_graph);
+  if (has_context_graph != (context_graph_ != nullptr)) {
+    KALDI_DECODER_ERR << "The snapshot was written by a decoder "
+                      << (has_context_graph ? "with" : "without")
+                      << " a context graph, but this decoder "
+                      << (context_graph_ ? "has" : "has no")
+                      << " context graph";
+  }
+
+  // Read everything before touching the current state, so that a malformed
+  // input leaves the decoder unchanged.
+  int32_t num_toks;
+  ReadBasicType(is, &num_toks);
+  if (num_toks <= 0) {
+    KALDI_DECODER_ERR << "Invalid number of tokens: " << num_toks;
+  }
+
+  std::vector<int32_t> prev(num_toks);
+  std::vector<int32_t> arc_indexes(num_toks);
+  std::vector<int32_t> context_states(num_toks);
+  std::vector<float> costs(num_toks);
+  // The arc and state of each token, looked up in the graph
+  std::vector<Arc> arcs(num_toks);
+  for (int32_t i = 0; i != num_toks; ++i) {
+    ReadBasicType(is, &prev[i]);
+    ReadBasicType(is, &arc_indexes[i]);
+    ReadBasicType(is, &context_states[i]);
+    ReadBasicType(is, &costs[i]);
+
+    if (prev[i] < -1 || prev[i] >= i) {
+      KALDI_DECODER_ERR << "Invalid predecessor " << prev[i] << " of token "
+                        << i;
+    }
+
+    if (prev[i] == -1) {
+      if (arc_indexes[i] != -1) {
+        KALDI_DECODER_ERR << "Invalid arc index " << arc_indexes[i]
+                          << " of start token " << i;
+      }
+      arcs[i].nextstate = fst_.Start();
+    } else {
+      StateId state = arcs[prev[i]].nextstate;
+      if (arc_indexes[i] < 0 ||
+          arc_indexes[i] >= static_cast<int64_t>(fst_.NumArcs(state))) {
+        KALDI_DECODER_ERR << "Invalid arc index " << arc_indexes[i]
+                          << " of token " << i << ". Is it the same graph?";
+      }
+      fst::ArcIterator<fst::Fst<Arc>> aiter(fst_, state);
+      aiter.Seek(arc_indexes[i]);
+      arcs[i] = aiter.Value();
+    }
+
+    if (context_states[i] < 0 ||
+        (context_graph_ ? context_states[i] >= context_graph_->NumStates()
+                        : context_states[i] != 0)) {
+      KALDI_DECODER_ERR << "Invalid context state " << context_states[i]
+                        << " of token " << i
+                        << ". Is it the same context graph?";
+    }
+  }
+
+  int32_t num_active;
+  ReadBasicType(is, &num_active);
+  if (num_active < 0 || num_active > num_toks) {
+    KALDI_DECODER_ERR << "Invalid number of active tokens: " << num_active;
+  }
+
+  std::vector<int32_t> active(num_active);
+  std::vector<bool> is_active(num_toks, false);
+  for (int32_t i = 0; i != num_active; ++i) {
+    ReadBasicType(is, &active[i]);
+    if (active[i] < 0 || active[i] >= num_toks || is_active[active[i]]) {
+      KALDI_DECODER_ERR << "Invalid active token " << active[i];
+    }
+    is_active[active[i]] = true;
+  }
+
+  int32_t endpoint_tok;
+  int32_t endpoint_silence_frames;
+  bool endpoint_detected;
+  ReadBasicType(is, &endpoint_tok);
+  ReadBasicType(is, &endpoint_silence_frames);
+  ReadBasicType(is, &endpoint_detected);
+  if (endpoint_tok < -1 || endpoint_tok >= num_toks) {
+    KALDI_DECODER_ERR << "Invalid endpoint token " << endpoint_tok;
+  }
+
+  if (endpoint_silence_frames < 0 ||
+      endpoint_silence_frames > num_frames_decoded) {
+    KALDI_DECODER_ERR << "Invalid number of trailing silence frames: "
+                      << endpoint_silence_frames;
+  }
+
+  // Now replace the current state. The hash is sized for the active tokens,
+  // as at the start of a decode, instead of taking a size from the input.
+  Reset();
+  toks_.SetSize(1000);
+  PossiblyResizeHash(config_, num_active, &toks_);
+
+  std::vector<Token *> toks(num_toks);
+  for (int32_t i = 0; i != num_toks; ++i) {
+    if (prev[i] == -1) {
+      toks[i] = token_pool_.New(arcs[i].nextstate, context_states[i]);
+    } else {
+      toks[i] = token_pool_.New(arcs[i], arc_indexes[i], 0, 0, toks[prev[i]],
+                                context_states[i]);
+    }
+    toks[i]->cost_ = costs[i];
+  }
+
+  // The reference created by New() is taken over by the hash for an active
+  // token; for the others, it is released so that they are only kept alive
+  // by their successors.
+  for (int32_t i : active) {
+    toks_.Insert(toks[i]->state_, toks[i]);
+  }
+
+  if (endpoint_tok != -1) {
+    endpoint_tok_ = toks[endpoint_tok];
+    ++endpoint_tok_->ref_count_;
+  }
+
+  for (int32_t i = 0; i != num_toks; ++i) {
+    if (!is_active[i]) {
+      Token::TokenDelete(toks[i], &token_pool_);
+    }
+  }
+
+  num_frames_decoded_ = num_frames_decoded;
+  cost_offsets_ = std::move(cost_offsets);
+  endpoint_silence_frames_ = endpoint_silence_frames;
+  endpoint_detected_ = endpoint_detected;
+}
+
 }  // namespace kaldi_decoder
@@ -9,14 +9,22 @@
 #ifndef KALDI_DECODER_CSRC_FASTER_DECODER_H_
 #define KALDI_DECODER_CSRC_FASTER_DECODER_H_
 
+#include <algorithm>
+#include <istream>
 #include <limits>
+#include <ostream>
 #include <string>
 #include <vector>
 
 #include "fst/fst.h"
 #include "fst/fstlib.h"
+#include "kaldi-decoder/csrc/context-graph.h"
 #include "kaldi-decoder/csrc/decodable-itf.h"
+#include "kaldi-decoder/csrc/decoder-memory-stats.h"
+#include "kaldi-decoder/csrc/endpoint.h"
 #include "kaldi-decoder/csrc/hash-list.h"
+#include "kaldi-decoder/csrc/memory-pool.h"
+#include "kaldi-decoder/csrc/prefetch.h"
 #include "kaldifst/csrc/lattice-weight.h"
 
 namespace kaldi_decoder {
@@ -37,16 +45,32 @@ struct FasterDecoderOptions {
   // Setting used in decoder to control hash behavior
   float hash_ratio;
 
+  // If positive, the beam is tightened while the memory used by the decoder,
+  // i.e., DecoderMemoryStats::LiveBytes(), exceeds this number of bytes.
+  // 0 means no limit.
+  int64_t max_mem_bytes;
+
+  // While a token is expanded, the arcs of the token this many places
+  // after it in the list of active tokens are prefetched, as well as the
+  // hash buckets of the destinations of its own arcs. It helps on graphs
+  // larger than the CPU caches, where each state is a cache miss. 0
+  // disables prefetching. The arcs are not prefetched for lazy FSTs, e.g.,
+  // the FST of a LazyComposeFst.
+  int32_t prefetch_distance;
+
   /*implicit*/ FasterDecoderOptions(
       float beam = 16.0,
       int32_t max_active = std::numeric_limits<int32_t>::max(),
-      int32_t min_active = 20, float beam_delta = 0.5, float hash_ratio = 2.0)
+      int32_t min_active = 20, float beam_delta = 0.5, float hash_ratio = 2.0,
+      int64_t max_mem_bytes = 0, int32_t prefetch_distance = 0)
       : beam(beam),
         max_active(max_active),
         min_active(min_active),  // This decoder mostly used for
                                  // alignment, use small default.
         beam_delta(beam_delta),
-        hash_ratio(hash_ratio) {}
+        hash_ratio(hash_ratio),
+        max_mem_bytes(max_mem_bytes),
+        prefetch_distance(prefetch_distance) {}
 
   std::string ToString() const {
     std::ostringstream os;
@@ -56,12 +80,121 @@ struct FasterDecoderOptions {
     os << "max_active=" << max_active << ", ";
     os << "min_active=" << min_active << ", ";
     os << "beam_delta=" << beam_delta << ", ";
-    os << "hash_ratio=" << hash_ratio << ")";
+    os << "hash_ratio=" << hash_ratio << ", ";
+    os << "max_mem_bytes=" << max_mem_bytes << ", ";
+    os << "prefetch_distance=" << prefetch_distance << ")";
 
     return os.str();
   }
 };
 
+/// Gets the weight cutoff of a frame, whose tokens are in the list of
+/// elements of a HashList that starts at list_head, with the beam, max_active
+/// and min_active of "config". The tokens must have a float cost_. "beam" is
+/// config.beam, possibly tightened because of max_mem_bytes. tmp_array is a
+/// buffer kept by the caller to avoid allocations. It also counts the active
+/// tokens and finds the best one. The outputs may be nullptr, except for
+/// adaptive_beam. Shared by FasterDecoder and CtcDecoder.
+template <class Elem>
+float GetBeamCutoff(const FasterDecoderOptions &config, float beam,
+                    Elem *list_head, std::vector<float> *tmp_array,
+                    size_t *tok_count, float *adaptive_beam,
+                    Elem **best_elem) {
+  float best_cost = std::numeric_limits<float>::infinity();
+
+  size_t count = 0;
+  if (config.max_active == std::numeric_limits<int32_t>::max() &&
+      config.min_active == 0) {
+    // no constraints
+    for (Elem *e = list_head; e != nullptr; e = e->tail, ++count) {
+      float w = e->val->cost_;
+      if (w < best_cost) {
+        best_cost = w;
+
+        if (best_elem) {
+          *best_elem = e;
+        }
+      }
+    }
+
+    if (tok_count != nullptr) {
+      *tok_count = count;
+    }
+
+    *adaptive_beam = beam;
+    return best_cost + beam;
+  }
+
+  tmp_array->clear();
+
+  for (Elem *e = list_head; e != nullptr; e = e->tail, ++count) {
+    float w = e->val->cost_;
+    tmp_array->push_back(w);
+
+    if (w < best_cost) {
+      best_cost = w;
+
+      if (best_elem) {
+        *best_elem = e;
+      }
+    }
+  }
+
+  if (tok_count != nullptr) {
+    *tok_count = count;
+  }
+
+  float beam_cutoff = best_cost + beam;
+  float min_active_cutoff = std::numeric_limits<float>::infinity();
+  float max_active_cutoff = std::numeric_limits<float>::infinity();
+
+  if (tmp_array->size() > static_cast<size_t>(config.max_active)) {
+    std::nth_element(tmp_array->begin(),
+                     tmp_array->begin() + config.max_active, tmp_array->end());
+    max_active_cutoff = (*tmp_array)[config.max_active];
+  }
+
+  if (max_active_cutoff < beam_cutoff) {  // max_active is tighter than beam.
+    *adaptive_beam = max_active_cutoff - best_cost + config.beam_delta;
+    return max_active_cutoff;
+  }
+
+  if (tmp_array->size() > static_cast<size_t>(config.min_active)) {
+    if (config.min_active == 0) {
+      min_active_cutoff = best_cost;
+    } else {
+      std::nth_element(
+          tmp_array->begin(), tmp_array->begin() + config.min_active,
+          tmp_array->size() > static_cast<size_t>(config.max_active)
+              ? tmp_array->begin() + config.max_active
+              : tmp_array->end());
+
+      min_active_cutoff = (*tmp_array)[config.min_active];
+    }
+  }
+
+  if (min_active_cutoff > beam_cutoff) {  // min_active is looser than beam.
+    *adaptive_beam = min_active_cutoff - best_cost + config.beam_delta;
+    return min_active_cutoff;
+  }
+
+  *adaptive_beam = beam;
+  return beam_cutoff;
+}
+
+/// Makes the hash of "toks" big enough for num_toks tokens, with
+/// config.hash_ratio buckets per token. It never shrinks.
+template <class Key, class T>
+void PossiblyResizeHash(const FasterDecoderOptions &config, size_t num_toks,
+                        HashList<Key, T> *toks) {
+  auto new_sz =
+      static_cast<size_t>(static_cast<float>(num_toks) * config.hash_ratio);
+
+  if (new_sz > toks->Size()) {
+    toks->SetSize(new_sz);
+  }
+}
+
 class FasterDecoder {
  public:
   typedef fst::StdArc Arc;
@@ -77,7 +210,22 @@ class FasterDecoder {
 
   void SetOptions(const FasterDecoderOptions &config) { config_ = config; }
 
-  ~FasterDecoder() { ClearToks(toks_.Clear()); }
+  /// Attaches a ContextGraph for contextual biasing (e.g., hotwords), or
+  /// detaches it if context_graph is nullptr. Call it before InitDecoding();
+  /// changing it in the middle of an utterance is not supported. The graph is
+  /// not owned by the decoder and must outlive it; it can be shared with
+  /// other decoders.
+  void SetContextGraph(const ContextGraph *context_graph) {
+    context_graph_ = context_graph;
+  }
+
+  /// Enables endpoint detection in AdvanceDecoding(). Call it before
+  /// InitDecoding().
+  void SetEndpointConfig(const EndpointConfig &config) {
+    endpoint_ = EndpointDetector(config);
+  }
+
+  ~FasterDecoder() { Reset(); }
 
   void Decode(DecodableInterface *decodable);
 
@@ -97,55 +245,116 @@ class FasterDecoder {
   /// and then (possibly multiple times) AdvanceDecoding().
   void InitDecoding();
 
+  /// Releases the state of the current utterance. The memory of the tokens
+  /// is kept in internal free lists, and the hash keeps its size, so that
+  /// later utterances reuse them instead of allocating. InitDecoding() calls
+  /// it; call it directly to release a decoder that stays idle, e.g., before
+  /// returning it to a DecoderPool.
+  void Reset();
+
   /// This will decode until there are no more frames ready in the decodable
   /// object, but if max_num_frames is >= 0 it will decode no more than
   /// that many frames.
-  void AdvanceDecoding(DecodableInterface *decodable,
+  ///
+  /// If endpoint detection is enabled (see SetEndpointConfig()), it also
+  /// stops after the frame where an endpoint is detected, so that the
+  /// utterance can be cut there. Returns EndpointDetected().
+  bool AdvanceDecoding(DecodableInterface *decodable,
                        int32_t max_num_frames = -1);
 
+  /// Returns true if an endpoint was detected on the last decoded frame. It
+  /// is always false if endpoint detection is disabled.
+  bool EndpointDetected() const { return endpoint_detected_; }
+
+  /// FinalRelativeCost() serves the same purpose as ReachedFinal(), but gives
+  /// more information. It returns the difference between the best (final-cost
+  /// plus cost) of any token on the final frame, and the best cost of any
+  /// token on the final frame. If it is infinity it means no final-states
+  /// were present on the final frame.
+  float FinalRelativeCost() const;
+
   /// Returns the number of frames already decoded.
   int32_t NumFramesDecoded() const { return num_frames_decoded_; }
 
+  /// Returns the memory held by the decoder. It is cheap enough to be called
+  /// after every frame. The peak is over the frames decoded since
+  /// InitDecoding().
+  DecoderMemoryStats GetMemoryStats() const;
+
+  /// Writes the decoding state, i.e., the active tokens together with their
+  /// tracebacks, the number of frames decoded and the endpointing state (see
+  /// SetEndpointConfig()), to "os" in a compact binary format. It is meant
+  /// to be called between two calls of AdvanceDecoding(), e.g., to move a
+  /// streaming session to another host or to checkpoint a long decode. See
+  /// also Restore().
+  void Snapshot(std::ostream &os) const;
+
+  /// Replaces the decoding state with the one written by Snapshot().
+  /// This decoder must use the same decoding graph and, if any, the same
+  /// ContextGraph as the one that wrote the snapshot; the options may
+  /// differ. Decoding is continued by AdvanceDecoding() with a decodable
+  /// object whose frame indexes start from the beginning of the utterance,
+  /// i.e., the next frame to decode is NumFramesDecoded().
+  ///
+  /// It throws if the input is malformed; the decoder is unchanged in that
+  /// case.
+  void Restore(std::istream &is);
+
  protected:
+  // A token takes 32 bytes. It does not store a copy of its arc but the
+  // index of the arc among the arcs leaving the state of prev_, and its cost
+  // is a float, relative to the cost offsets of the frames (see
+  // cost_offsets_ below).
   class Token {
    public:
-    Arc arc_;  // contains only the graph part of the cost;
-    // we can work out the acoustic part from difference between
-    // "cost_" and prev->cost_.
     Token *prev_;
+    // The total cost up to this point, minus the sum of cost_offsets_ of
+    // the frames decoded so far
+    float cost_;
     int32_t ref_count_;
-    // if you are looking for weight_ here, it was removed and now we just have
-    // cost_, which corresponds to ConvertToCost(weight_).
-    double cost_;
-    inline Token(const Arc &arc, float ac_cost, Token *prev)
-        : arc_(arc), prev_(prev), ref_count_(1) {
-      if (prev) {
-        prev->ref_count_++;
-        cost_ = prev->cost_ + arc.weight.Value() + ac_cost;
-      } else {
-        cost_ = arc.weight.Value() + ac_cost;
-      }
-    }
-
-    // for epsilon transitions, i.e., non-emitting arcs
-    inline Token(const Arc &arc, Token *prev)
-        : arc_(arc), prev_(prev), ref_count_(1) {
-      if (prev) {
-        prev->ref_count_++;
-        cost_ = prev->cost_ + arc.weight.Value();
-      } else {
-        cost_ = arc.weight.Value();
-      }
+    // The state of the graph, i.e., the nextstate of the arc
+    StateId state_;
+    // Index of the arc in the arcs leaving prev_->state_, or -1 for the
+    // start token
+    int32_t arc_index_;
+    // The ilabel of the arc, kept so that the traceback of the endpoint
+    // detector need not look up the arc in the graph
+    Label ilabel_;
+    // State in context_graph_; it is always 0 if there is no context graph.
+    int32_t context_state_;
+
+    // The start token
+    inline Token(StateId state, int32_t context_state)
+        : prev_(nullptr),
+          cost_(0),
+          ref_count_(1),
+          state_(state),
+          arc_index_(-1),
+          ilabel_(0),
+          context_state_(context_state) {}
+
+    // For the arc with index "arc_index" leaving the state of "prev". For a
+    // non-emitting arc, ac_cost is 0.
+    inline Token(const Arc &arc, int32_t arc_index, float graph_cost,
+                 float ac_cost, Token *prev, int32_t context_state)
+        : prev_(prev),
+          cost_(prev->cost_ + graph_cost + ac_cost),
+          ref_count_(1),
+          state_(arc.nextstate),
+          arc_index_(arc_index),
+          ilabel_(arc.ilabel),
+          context_state_(context_state) {
+      prev->ref_count_++;
     }
 
     inline bool operator<(const Token &other) const {
       return cost_ > other.cost_;
     }
 
-    inline static void TokenDelete(Token *tok) {
+    inline static void TokenDelete(Token *tok, MemoryPool<Token> *pool) {
       while (--tok->ref_count_ == 0) {
         Token *prev = tok->prev_;
-        delete tok;
+        pool->Delete(tok);
         if (prev == nullptr) {
           return;
         } else {
@@ -157,19 +366,49 @@ class FasterDecoder {
 
   using Elem = HashList<StateId, Token *>::Elem;
 
-  /// Gets the weight cutoff.  Also counts the active tokens.
-  double GetCutoff(Elem *list_head, size_t *tok_count, float *adaptive_beam,
-                   Elem **best_elem);
-
-  void PossiblyResizeHash(size_t num_toks);
+  // Called after each frame. It updates peak_bytes_ and, if
+  // config_.max_mem_bytes is set, beam_scale_.
+  void UpdateMemoryUsage();
 
   // ProcessEmitting returns the likelihood cutoff used.
   // It decodes the frame num_frames_decoded_ of the decodable object
   // and then increments num_frames_decoded_
-  double ProcessEmitting(DecodableInterface *decodable);
+  float ProcessEmitting(DecodableInterface *decodable);
 
   // TODO(dan): first time we go through this, could avoid using the queue.
-  void ProcessNonemitting(double cutoff);
+  // Returns the best token of the frame.
+  Token *ProcessNonemitting(float cutoff);
+
+  // Prefetches the token of "e" and, if the graph is expanded, the arcs
+  // leaving its state; see FasterDecoderOptions::prefetch_distance.
+  inline void PrefetchToken(const Elem *e) const {
+    Prefetch(e->val);
+    if (fst_is_expanded_) {
+      PrefetchArcs(fst_, e->key);
+    }
+  }
+
+  // Called after each frame with its best token if endpoint detection is
+  // enabled. It updates endpoint_detected_.
+  void UpdateEndpoint(Token *best_tok);
+
+  // Returns the graph cost of leaving "tok" via "arc", including the
+  // contextual-biasing cost, and sets "context_state" to the context state
+  // of the destination.
+  inline float GraphCost(const Arc &arc, const Token *tok,
+                         int32_t *context_state) const {
+    *context_state = tok->context_state_;
+    if (context_graph_ == nullptr || arc.olabel == 0) {
+      return arc.weight.Value();
+    }
+
+    return arc.weight.Value() + context_graph_->ForwardOneStep(
+                                    tok->context_state_, arc.olabel,
+                                    context_state);
+  }
+
+  // Tokens are allocated from it; it has to be declared before toks_.
+  MemoryPool<Token> token_pool_;
 
   // HashList defined in ../hash-list.h.  It actually allows us to maintain
   // more than one list (e.g. for current and previous frames), but only one of
@@ -178,17 +417,45 @@ class FasterDecoder {
 
   const fst::Fst<fst::StdArc> &fst_;
 
+  // True if the arcs of fst_ can be prefetched; see PrefetchArcs()
+  bool fst_is_expanded_;
+
   FasterDecoderOptions config_;
 
+  // Not owned; nullptr if contextual biasing is disabled.
+  const ContextGraph *context_graph_ = nullptr;
+
   // temp variable used in ProcessNonemitting,
   std::vector<const Elem *> queue_;
 
-  std::vector<float> tmp_array_;  // used in GetCutoff.
+  std::vector<float> tmp_array_;  // used in GetBeamCutoff().
   // make it class member to avoid internal new/delete.
 
   // Keep track of the number of frames decoded in the current file.
   int32_t num_frames_decoded_;
 
+  // cost_offsets_[t] is added to the costs of the tokens created by the
+  // emitting arcs of frame t. It is minus the best cost on the previous
+  // frame, so that the costs of the tokens stay close to 0 and fit in a
+  // float, however long the utterance is.
+  std::vector<float> cost_offsets_;
+
+  // See GetMemoryStats() and UpdateMemoryUsage(). The beam used for pruning
+  // is config_.beam * beam_scale_.
+  int64_t peak_bytes_ = 0;
+  float beam_scale_ = 1;
+  int32_t num_tightened_frames_ = 0;
+
+  // See SetEndpointConfig(). endpoint_tok_ is the best token of the last
+  // decoded frame, and endpoint_silence_frames_ the number of trailing
+  // silence frames of its traceback. The decoder holds a reference to it,
+  // so that it is not reused while it is compared with the tokens of the
+  // next frame.
+  EndpointDetector endpoint_;
+  Token *endpoint_tok_ = nullptr;
+  int32_t endpoint_silence_frames_ = 0;
+  bool endpoint_detected_ = false;
+
   // It might seem unclear why we call ClearToks(toks_.Clear()).
   // There are two separate cleanup tasks we need to do at when we start a new
   // file. one is to delete the Token objects in the list; the other is to
@@ -82,6 +82,11 @@ inline typename HashList<I, T>::Elem *HashList<I, T>::Find(I key) {
   }
 }
 
+template <class I, class T>
+inline void HashList<I, T>::Prefetch(I key) const {
+  kaldi_decoder::Prefetch(&buckets_[static_cast<size_t>(key) % hash_size_]);
+}
+
 template <class I, class T>
 inline typename HashList<I, T>::Elem *HashList<I, T>::New() {
   if (freed_head_) {
@@ -16,6 +16,7 @@
 #include <set>
 #include <vector>
 
+#include "kaldi-decoder/csrc/prefetch.h"
 #include "kaldi-decoder/csrc/stl-utils.h"
 
 /* This header provides utilities for a structure that's used in a decoder (but
@@ -73,6 +74,10 @@ class HashList {
   /// is free to modify the "val" element.
   inline Elem *Find(I key);
 
+  /// Prefetches the hash bucket of "key" into the CPU caches, so that a
+  /// later Find() or Insert() of it waits less for memory.
+  inline void Prefetch(I key) const;
+
   /// Insert inserts a new element into the hashtable/stored list.
   /// Because element keys in a hashtable are unique, this operation checks
   /// whether each inserted element has a key equivalent to the one of an
@@ -99,6 +104,13 @@ class HashList {
   /// Returns current number of hash buckets.
   inline size_t Size() const { return hash_size_; }
 
+  /// Returns the number of bytes held by the hash buckets and by the blocks
+  /// of Elems, including the Elems in the free list.
+  inline size_t AllocatedBytes() const {
+    return buckets_.capacity() * sizeof(HashBucket) +
+           allocated_.size() * allocate_block_size_ * sizeof(Elem);
+  }
+
   ~HashList();
 
  private:
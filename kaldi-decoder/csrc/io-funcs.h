@@ -0,0 +1,59 @@
+// kaldi-decoder/csrc/io-funcs.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_IO_FUNCS_H_
+#define KALDI_DECODER_CSRC_IO_FUNCS_H_
+
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+
+#include "kaldi-decoder/csrc/log.h"
+
+// Minimal helpers for the binary snapshots of decoders. Values are written in
+// the native byte order and layout, so a snapshot can only be restored on a
+// machine with the same architecture. This is fine for moving a session
+// between hosts of the same fleet, but snapshots are not meant to be kept as
+// a long-term storage format.
+
+namespace kaldi_decoder {
+
+template <typename T>
+inline void WriteBasicType(std::ostream &os, T t) {
+  static_assert(std::is_arithmetic<T>::value, "Only for arithmetic types");
+  os.write(reinterpret_cast<const char *>(&t), sizeof(t));
+}
+
+// It throws if the stream ends prematurely.
+template <typename T>
+inline void ReadBasicType(std::istream &is, T *t) {
+  static_assert(std::is_arithmetic<T>::value, "Only for arithmetic types");
+  is.read(reinterpret_cast<char *>(t), sizeof(*t));
+  if (!is) {
+    KALDI_DECODER_ERR << "Failed to read " << sizeof(*t)
+                      << " bytes. Truncated input?";
+  }
+}
+
+// Writes a fixed string, e.g., "<FasterDecoder>", to mark the beginning
+// of an object.
+inline void WriteMarker(std::ostream &os, const char *marker) {
+  os.write(marker, std::strlen(marker));
+}
+
+// Reads a marker written by WriteMarker() and throws if it is not
+// "marker".
+inline void ExpectMarker(std::istream &is, const char *marker) {
+  std::string s(std::strlen(marker), '\0');
+  is.read(&s[0], s.size());
+  if (!is || s != marker) {
+    KALDI_DECODER_ERR << "Expected " << marker << ". Given: " << s;
+  }
+}
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_IO_FUNCS_H_
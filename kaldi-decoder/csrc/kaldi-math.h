@@ -32,6 +32,28 @@
 
 namespace kaldi_decoder {
 
+// Differences of log-probabilities below this are negligible in LogAdd()
+static const double kMinLogDiffDouble = std::log(DBL_EPSILON);
+
+/// Returns log(exp(x) + exp(y)).
+static inline double LogAdd(double x, double y) {
+  double diff;
+
+  if (x < y) {
+    diff = x - y;
+    x = y;
+  } else {
+    diff = y - x;
+  }
+  // diff is negative.  x is now the larger one.
+
+  if (diff >= kMinLogDiffDouble) {
+    return x + std::log1p(std::exp(diff));
+  } else {
+    return x;  // return the larger one.
+  }
+}
+
 /// return abs(a - b) <= relative_tolerance * (abs(a)+abs(b)).
 static inline bool ApproxEqual(float a, float b,
                                float relative_tolerance = 0.001) {
@@ -0,0 +1,229 @@
+// kaldi-decoder/csrc/keyword-spotter-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/keyword-spotter.h"
+
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/test-utils.h"
+
+namespace kaldi_decoder {
+
+// Frame t has the probability p on frame_tokens[t] and the rest is shared
+// by the other tokens, without noise.
+static FloatMatrix ConstantLogProbs(const std::vector<int32_t> &frame_tokens,
+                                    int32_t num_tokens, float p) {
+  int32_t num_frames = static_cast<int32_t>(frame_tokens.size());
+  FloatMatrix ans(num_frames, num_tokens);
+  ans.setConstant(std::log((1 - p) / (num_tokens - 1)));
+  for (int32_t t = 0; t != num_frames; ++t) {
+    ans(t, frame_tokens[t]) = std::log(p);
+  }
+  return ans;
+}
+
+static std::vector<KeywordTrigger> Spot(
+    const KeywordGraph &graph, const FloatMatrix &log_probs,
+    const KeywordSpotterOptions &opts = KeywordSpotterOptions()) {
+  DecodableCtc decodable(log_probs);
+  KeywordSpotter spotter(graph, opts);
+  spotter.InitDecoding();
+  spotter.AdvanceDecoding(&decodable);
+  return spotter.PopTriggers();
+}
+
+TEST(KeywordSpotter, Graph) {
+  KeywordGraph graph({{1, 2}, {3, 3, 4}, {5}}, 0.5);
+  EXPECT_EQ(graph.NumKeywords(), 3);
+  EXPECT_EQ(graph.NumPositions(), 3 + 5 + 1);
+
+  using Keywords = std::vector<std::vector<int32_t>>;
+  EXPECT_THROW(KeywordGraph(Keywords{{1, 0}}), std::runtime_error);
+  EXPECT_THROW(KeywordGraph(Keywords{{1}, {}}), std::runtime_error);
+  EXPECT_THROW(KeywordGraph(Keywords{{1}}, 0.5, {0.5, 0.6}),
+               std::runtime_error);
+  EXPECT_THROW(KeywordGraph(Keywords{{1}}, 1.5), std::runtime_error);
+}
+
+TEST(KeywordSpotter, Trigger) {
+  KeywordGraph graph({{1, 2}, {3, 3, 4}, {5}}, 0.5);
+
+  // 0 is the blank. "3 3 4" is at frames 6 to 12, "1 2" at 15 to 18.
+  std::vector<int32_t> frame_tokens = {0, 0, 6, 6, 0, 0, 3, 3, 0, 3,
+                                       4, 4, 4, 0, 0, 1, 1, 0, 2, 2,
+                                       0, 0, 3, 3, 4, 4, 0, 0};
+  FloatMatrix log_probs = PeakyLogProbs(frame_tokens, 7, 6, 0.1, /*seed=*/0);
+  DecodableCtc decodable(log_probs);
+
+  KeywordSpotter spotter(graph);
+  spotter.InitDecoding();
+  spotter.AdvanceDecoding(&decodable);
+  EXPECT_EQ(spotter.NumFramesDecoded(), frame_tokens.size());
+
+  // "3 3 4" is not triggered at frame 24, since there is no blank between
+  // the 3s
+  std::vector<KeywordTrigger> triggers = spotter.PopTriggers();
+  ASSERT_EQ(triggers.size(), 2);
+
+  EXPECT_EQ(triggers[0].keyword, 1);
+  EXPECT_EQ(triggers[0].start_frame, 6);
+  EXPECT_EQ(triggers[0].end_frame, 10);
+  EXPECT_GT(triggers[0].score, 0.9);
+
+  EXPECT_EQ(triggers[1].keyword, 0);
+  EXPECT_EQ(triggers[1].start_frame, 15);
+  EXPECT_EQ(triggers[1].end_frame, 18);
+  EXPECT_GT(triggers[1].score, 0.9);
+
+  EXPECT_TRUE(spotter.PopTriggers().empty());
+}
+
+TEST(KeywordSpotter, RepeatedKeyword) {
+  KeywordGraph graph({{5}, {1, 2}}, 0.5);
+
+  // A keyword of a single token spanning several frames is triggered once
+  std::vector<int32_t> frame_tokens = {0, 5, 5, 5, 0, 5, 5, 0, 1, 2, 0, 1, 2};
+  FloatMatrix log_probs = PeakyLogProbs(frame_tokens, 7, 6, 0.1, /*seed=*/0);
+  DecodableCtc decodable(log_probs);
+
+  KeywordSpotter spotter(graph);
+  spotter.InitDecoding();
+  spotter.AdvanceDecoding(&decodable);
+
+  std::vector<KeywordTrigger> triggers = spotter.PopTriggers();
+  ASSERT_EQ(triggers.size(), 4);
+  EXPECT_EQ(triggers[0].keyword, 0);
+  EXPECT_EQ(triggers[0].end_frame, 1);
+  EXPECT_EQ(triggers[1].keyword, 0);
+  EXPECT_EQ(triggers[1].end_frame, 5);
+  EXPECT_EQ(triggers[2].keyword, 1);
+  EXPECT_EQ(triggers[2].start_frame, 8);
+  EXPECT_EQ(triggers[2].end_frame, 9);
+  EXPECT_EQ(triggers[3].keyword, 1);
+  EXPECT_EQ(triggers[3].start_frame, 11);
+  EXPECT_EQ(triggers[3].end_frame, 12);
+}
+
+TEST(KeywordSpotter, Threshold) {
+  std::vector<int32_t> frame_tokens = {0, 1, 1, 0, 2, 0};
+  FloatMatrix log_probs = PeakyLogProbs(frame_tokens, 4, 6, 0.1, /*seed=*/0);
+
+  // Token 3 instead of token 2 on frame 4: the keyword "1 3" has a low
+  // score
+  log_probs(4, 3) = log_probs(4, 2) - 2;
+  DecodableCtc decodable(log_probs);
+
+  KeywordGraph graph({{1, 3}, {1, 3}}, 0.5, {0.9, 0.2});
+  KeywordSpotter spotter(graph);
+  spotter.InitDecoding();
+  spotter.AdvanceDecoding(&decodable);
+
+  std::vector<KeywordTrigger> triggers = spotter.PopTriggers();
+  ASSERT_EQ(triggers.size(), 1);
+  EXPECT_EQ(triggers[0].keyword, 1);
+  EXPECT_LT(triggers[0].score, 0.9);
+  EXPECT_GE(triggers[0].score, 0.2);
+}
+
+TEST(KeywordSpotter, Streaming) {
+  KeywordGraph graph({{1, 2}, {3, 3, 4}, {5}}, 0.3);
+
+  std::vector<int32_t> frame_tokens;
+  for (int32_t i = 0; i != 300; ++i) {
+    frame_tokens.push_back(i % 3 == 0 ? 0 : (i / 3) % 7);
+  }
+  FloatMatrix log_probs = PeakyLogProbs(frame_tokens, 7, 6, 0.1, /*seed=*/0);
+  DecodableCtc decodable(log_probs);
+
+  KeywordSpotter expected_spotter(graph);
+  expected_spotter.InitDecoding();
+  expected_spotter.AdvanceDecoding(&decodable);
+  std::vector<KeywordTrigger> expected = expected_spotter.PopTriggers();
+  ASSERT_FALSE(expected.empty());
+
+  KeywordSpotter spotter(graph);
+  spotter.InitDecoding();
+  std::vector<KeywordTrigger> triggers;
+  while (spotter.NumFramesDecoded() < 300) {
+    spotter.AdvanceDecoding(&decodable, 7);
+    for (const auto &t : spotter.PopTriggers()) {
+      triggers.push_back(t);
+    }
+  }
+
+  ASSERT_EQ(triggers.size(), expected.size());
+  for (size_t i = 0; i != triggers.size(); ++i) {
+    EXPECT_EQ(triggers[i].keyword, expected[i].keyword);
+    EXPECT_EQ(triggers[i].start_frame, expected[i].start_frame);
+    EXPECT_EQ(triggers[i].end_frame, expected[i].end_frame);
+    EXPECT_FLOAT_EQ(triggers[i].score, expected[i].score);
+  }
+}
+
+TEST(KeywordSpotter, Silence) {
+  KeywordGraph graph({{1, 2}}, 0.5);
+
+  // Blanks, except for the two tokens of the keyword at the first and the
+  // last frame. Neither the blanks between them nor the other tokens, which
+  // are unlikely on every frame, can make up the keyword.
+  std::vector<int32_t> frame_tokens(1000, 0);
+  frame_tokens.front() = 1;
+  frame_tokens.back() = 2;
+  FloatMatrix log_probs = ConstantLogProbs(frame_tokens, 4, 0.97);
+  EXPECT_TRUE(Spot(graph, log_probs).empty());
+
+  // Not even without the limit on the gap between the tokens, since the
+  // keyword cannot span so many frames
+  KeywordSpotterOptions opts;
+  opts.max_blank_frames = 1000;
+  EXPECT_TRUE(Spot(graph, log_probs, opts).empty());
+
+  // The same with noise
+  log_probs = PeakyLogProbs(frame_tokens, 4, 4.5, 0.5, /*seed=*/0);
+  EXPECT_TRUE(Spot(graph, log_probs).empty());
+}
+
+TEST(KeywordSpotter, Gap) {
+  KeywordGraph graph({{1, 2}}, 0.5);
+
+  // A pause of 10 frames between the two tokens
+  std::vector<int32_t> frame_tokens(20, 0);
+  frame_tokens[3] = 1;
+  frame_tokens[14] = 2;
+  FloatMatrix log_probs = ConstantLogProbs(frame_tokens, 4, 0.97);
+
+  std::vector<KeywordTrigger> triggers = Spot(graph, log_probs);
+  ASSERT_EQ(triggers.size(), 1);
+  EXPECT_EQ(triggers[0].start_frame, 3);
+  EXPECT_EQ(triggers[0].end_frame, 14);
+  EXPECT_NEAR(triggers[0].score, 1, 1e-5);
+
+  KeywordSpotterOptions opts;
+  opts.max_blank_frames = 10;
+  EXPECT_EQ(Spot(graph, log_probs, opts).size(), 1);
+
+  opts.max_blank_frames = 9;
+  EXPECT_TRUE(Spot(graph, log_probs, opts).empty());
+
+  opts = KeywordSpotterOptions();
+  opts.max_keyword_frames = 12;
+  EXPECT_EQ(Spot(graph, log_probs, opts).size(), 1);
+
+  opts.max_keyword_frames = 11;
+  EXPECT_TRUE(Spot(graph, log_probs, opts).empty());
+
+  // Token 3 instead of blanks in the pause costs log(0.97 / 0.01) per
+  // frame, which is beyond the beam
+  for (int32_t t = 5; t != 13; ++t) {
+    frame_tokens[t] = 3;
+  }
+  log_probs = ConstantLogProbs(frame_tokens, 4, 0.97);
+  EXPECT_TRUE(Spot(graph, log_probs).empty());
+}
+
+}  // namespace kaldi_decoder
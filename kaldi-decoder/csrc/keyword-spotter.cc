@@ -0,0 +1,203 @@
+// kaldi-decoder/csrc/keyword-spotter.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/keyword-spotter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "kaldi-decoder/csrc/log.h"
+
+namespace kaldi_decoder {
+
+KeywordGraph::KeywordGraph(const std::vector<std::vector<int32_t>> &keywords,
+                           float threshold /*= 0.5*/,
+                           const std::vector<float> &thresholds /*= {}*/,
+                           int32_t blank_id /*= 0*/)
+    : blank_label_(blank_id + 1), max_label_(blank_id + 1) {
+  if (!thresholds.empty() && thresholds.size() != keywords.size()) {
+    KALDI_DECODER_ERR << "Number of keywords " << keywords.size()
+                      << " != number of thresholds " << thresholds.size();
+  }
+
+  begins_.push_back(0);
+  for (size_t k = 0; k != keywords.size(); ++k) {
+    const std::vector<int32_t> &tokens = keywords[k];
+    if (tokens.empty()) {
+      KALDI_DECODER_ERR << "Keyword " << k << " is empty";
+    }
+
+    for (size_t i = 0; i != tokens.size(); ++i) {
+      if (tokens[i] < 0 || tokens[i] == blank_id) {
+        KALDI_DECODER_ERR << "Keyword " << k << " has an invalid token "
+                          << tokens[i] << " (blank is " << blank_id << ")";
+      }
+
+      if (i > 0) {
+        // The blank between two tokens is skipped unless they are equal
+        labels_.push_back(blank_label_);
+        can_skip_.push_back(0);
+      }
+
+      labels_.push_back(tokens[i] + 1);
+      can_skip_.push_back(i > 0 && tokens[i] != tokens[i - 1]);
+      max_label_ = std::max(max_label_, tokens[i] + 1);
+    }
+
+    begins_.push_back(static_cast<int32_t>(labels_.size()));
+    thresholds_.push_back(thresholds.empty() ? threshold : thresholds[k]);
+  }
+
+  for (float t : thresholds_) {
+    if (t <= 0 || t > 1) {
+      KALDI_DECODER_ERR << "The thresholds should be in (0, 1]. Given: " << t;
+    }
+  }
+}
+
+KeywordSpotter::KeywordSpotter(const KeywordGraph &graph,
+                               const KeywordSpotterOptions &opts)
+    : graph_(graph), opts_(opts) {
+  opts_.Check();
+  costs_.resize(graph_.NumPositions());
+  start_frames_.resize(graph_.NumPositions());
+  num_token_frames_.resize(graph_.NumPositions());
+  last_token_frames_.resize(graph_.NumPositions());
+}
+
+void KeywordSpotter::InitDecoding() {
+  std::fill(costs_.begin(), costs_.end(),
+            std::numeric_limits<float>::infinity());
+  std::fill(start_frames_.begin(), start_frames_.end(), 0);
+  std::fill(num_token_frames_.begin(), num_token_frames_.end(), 0);
+  std::fill(last_token_frames_.begin(), last_token_frames_.end(), 0);
+  prev_best_label_ = 0;
+  triggers_.clear();
+  num_frames_decoded_ = 0;
+}
+
+void KeywordSpotter::AdvanceDecoding(DecodableInterface *decodable,
+                                     int32_t max_num_frames /*= -1*/) {
+  KALDI_DECODER_ASSERT(num_frames_decoded_ >= 0 &&
+                       "You must call InitDecoding() before AdvanceDecoding()");
+
+  if (graph_.max_label_ > decodable->NumIndices()) {
+    KALDI_DECODER_ERR << "The keywords use token " << graph_.max_label_ - 1
+                      << " but the model has only "
+                      << decodable->NumIndices() << " tokens";
+  }
+
+  int32_t num_frames_ready = decodable->NumFramesReady();
+  KALDI_DECODER_ASSERT(num_frames_ready >= num_frames_decoded_);
+
+  int32_t target_frames_decoded = num_frames_ready;
+  if (max_num_frames >= 0) {
+    target_frames_decoded =
+        std::min(target_frames_decoded, num_frames_decoded_ + max_num_frames);
+  }
+
+  while (num_frames_decoded_ < target_frames_decoded) {
+    ProcessFrame(decodable);
+    ++num_frames_decoded_;
+  }
+}
+
+void KeywordSpotter::ProcessFrame(DecodableInterface *decodable) {
+  constexpr float kInfinity = std::numeric_limits<float>::infinity();
+  int32_t frame = num_frames_decoded_;
+
+  // The filler, i.e., the best path, takes the most likely token
+  int32_t num_indices = decodable->NumIndices();
+  int32_t best_label = 1;
+  float best_log_prob = decodable->LogLikelihood(frame, 1);
+  for (int32_t i = 2; i <= num_indices; ++i) {
+    float log_prob = decodable->LogLikelihood(frame, i);
+    if (log_prob > best_log_prob) {
+      best_log_prob = log_prob;
+      best_label = i;
+    }
+  }
+
+  const std::vector<int32_t> &labels = graph_.labels_;
+  const std::vector<uint8_t> &can_skip = graph_.can_skip_;
+  int32_t blank_label = graph_.blank_label_;
+
+  for (int32_t k = 0; k != graph_.NumKeywords(); ++k) {
+    int32_t begin = graph_.begins_[k];
+    int32_t end = graph_.begins_[k + 1];
+
+    // Backwards, so that the costs of the previous frame can be updated in
+    // place
+    for (int32_t j = end - 1; j >= begin; --j) {
+      int32_t prev = j;
+      if (j > begin && costs_[j - 1] < costs_[prev]) {
+        prev = j - 1;
+      }
+
+      if (can_skip[j] && costs_[j - 2] < costs_[prev]) {
+        prev = j - 2;
+      }
+
+      float cost = costs_[prev];
+      int32_t start_frame = start_frames_[prev];
+      int32_t num_token_frames = num_token_frames_[prev];
+      int32_t last_token_frame = last_token_frames_[prev];
+
+      // A keyword starts after the filler, whose cost is 0 here since the
+      // costs are relative to it. On a tie, the earlier start is kept.
+      if (j == begin && labels[j] != prev_best_label_ && cost > 0) {
+        cost = 0;
+        start_frame = frame;
+        num_token_frames = 0;
+      }
+
+      if (cost != kInfinity) {
+        cost += best_log_prob - decodable->LogLikelihood(frame, labels[j]);
+
+        // The positions of the keyword are either tokens or the blanks
+        // between two of them; there is no blank before the first token.
+        if (labels[j] != blank_label) {
+          ++num_token_frames;
+          last_token_frame = frame;
+        }
+
+        if (cost > opts_.beam ||
+            frame - start_frame >= opts_.max_keyword_frames ||
+            frame - last_token_frame > opts_.max_blank_frames) {
+          cost = kInfinity;
+        }
+      }
+
+      costs_[j] = cost;
+      start_frames_[j] = start_frame;
+      num_token_frames_[j] = num_token_frames;
+      last_token_frames_[j] = last_token_frame;
+    }
+
+    float cost = costs_[end - 1];
+    if (cost == kInfinity) {
+      continue;
+    }
+
+    // The last position is a token, so num_token_frames is positive
+    int32_t start_frame = start_frames_[end - 1];
+    float score = std::exp(-cost / num_token_frames_[end - 1]);
+    if (score >= graph_.thresholds_[k]) {
+      triggers_.push_back({k, start_frame, frame, score});
+      std::fill(costs_.begin() + begin, costs_.begin() + end, kInfinity);
+    }
+  }
+
+  prev_best_label_ = best_label;
+}
+
+std::vector<KeywordTrigger> KeywordSpotter::PopTriggers() {
+  std::vector<KeywordTrigger> ans;
+  ans.swap(triggers_);
+  return ans;
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,193 @@
+// kaldi-decoder/csrc/keyword-spotter.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_KEYWORD_SPOTTER_H_
+#define KALDI_DECODER_CSRC_KEYWORD_SPOTTER_H_
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "kaldi-decoder/csrc/decodable-itf.h"
+#include "kaldi-decoder/csrc/log.h"
+
+namespace kaldi_decoder {
+
+/** KeywordGraph is the search graph of KeywordSpotter: a filler, which is
+    any token sequence, and one CTC path for each keyword, i.e., its tokens
+    separated by optional blanks, or by a required blank between two equal
+    tokens. A keyword can start on any frame after the filler.
+
+    The graph is immutable after construction, so one KeywordGraph can be
+    shared by any number of spotters, even across threads.
+ */
+class KeywordGraph {
+ public:
+  /// @param keywords    Each keyword is a sequence of token IDs, i.e., the
+  ///                    columns of the CTC output; the blank is not allowed.
+  /// @param threshold   A keyword is triggered when its score is at least
+  ///                    this value. See KeywordTrigger::score.
+  /// @param thresholds  If not empty, it has the same size as keywords and
+  ///                    overrides "threshold" per keyword.
+  /// @param blank_id    The ID of the blank.
+  KeywordGraph(const std::vector<std::vector<int32_t>> &keywords,
+               float threshold = 0.5,
+               const std::vector<float> &thresholds = {},
+               int32_t blank_id = 0);
+
+  int32_t NumKeywords() const {
+    return static_cast<int32_t>(thresholds_.size());
+  }
+
+  /// Returns the number of positions of all keywords. A keyword of n tokens
+  /// has 2 * n - 1 positions.
+  int32_t NumPositions() const { return static_cast<int32_t>(labels_.size()); }
+
+ private:
+  friend class KeywordSpotter;
+
+  // Keyword k has the positions [begins_[k], begins_[k + 1])
+  std::vector<int32_t> begins_;
+
+  // Index in the decodable object of each position, i.e., the token ID
+  // plus 1
+  std::vector<int32_t> labels_;
+
+  // Whether a position can be reached from the one before the previous
+  // position, i.e., if it skips a blank
+  std::vector<uint8_t> can_skip_;
+
+  std::vector<float> thresholds_;
+
+  int32_t blank_label_;
+  int32_t max_label_;
+};
+
+/// A keyword spotted by KeywordSpotter
+struct KeywordTrigger {
+  // Index of the keyword in the list given to KeywordGraph
+  int32_t keyword;
+
+  // The first and the last frame of the keyword. The last frame is the
+  // first one of its last token, i.e., the keyword is triggered as soon as
+  // it is complete.
+  int32_t start_frame;
+  int32_t end_frame;
+
+  // The geometric mean over the frames of the tokens of the keyword of the
+  // ratio between the probability of the keyword path and the one of the
+  // best path, i.e., of the most likely token of each frame. It is in (0, 1]
+  // and it is 1 if the keyword is the best path. The frames on the blanks
+  // between the tokens add their costs but are not counted, so that a pause
+  // cannot dilute the cost of the tokens.
+  float score;
+};
+
+struct KeywordSpotterOptions {
+  // A partial keyword path whose cost exceeds the one of the best path by
+  // more than this is dropped.
+  float beam;
+
+  // Maximum number of frames of a keyword, from its first frame to its last
+  // one. Longer paths are dropped.
+  int32_t max_keyword_frames;
+
+  // Maximum number of consecutive frames between two tokens of a keyword,
+  // e.g., the blanks of a pause between two words. Longer paths are
+  // dropped, so that tokens far apart are not taken as a keyword.
+  int32_t max_blank_frames;
+
+  KeywordSpotterOptions(float beam = 20, int32_t max_keyword_frames = 100,
+                        int32_t max_blank_frames = 25)
+      : beam(beam),
+        max_keyword_frames(max_keyword_frames),
+        max_blank_frames(max_blank_frames) {}
+
+  void Check() const {
+    KALDI_DECODER_ASSERT(beam > 0 && max_keyword_frames > 0 &&
+                         max_blank_frames >= 0);
+  }
+
+  std::string ToString() const {
+    std::ostringstream os;
+
+    os << "KeywordSpotterOptions(";
+    os << "beam=" << beam << ", ";
+    os << "max_keyword_frames=" << max_keyword_frames << ", ";
+    os << "max_blank_frames=" << max_blank_frames << ")";
+
+    return os.str();
+  }
+};
+
+/** A streaming keyword spotter for CTC models, e.g., for wake words or voice
+    commands, where a full decoder with a language model is not needed.
+
+    It runs Viterbi on a KeywordGraph with the scores of each keyword path
+    kept relative to those of the filler, i.e., of the best path. So the
+    costs stay bounded however long the stream, and the memory used is
+    fixed: 16 bytes per position of the graph. Nothing is allocated while
+    decoding, except for the triggers. Partial keyword paths are pruned by
+    beam, by length and by the gaps between their tokens (see
+    KeywordSpotterOptions), so that silence or noise does not keep them
+    alive until a token completes them.
+
+    After a keyword is triggered, its path is restarted, so that it is
+    triggered again only for a new occurrence. The paths of the other
+    keywords are kept, e.g., "hey you" can still be triggered after "hey".
+ */
+class KeywordSpotter {
+ public:
+  /// The graph is not owned and must outlive the spotter
+  explicit KeywordSpotter(
+      const KeywordGraph &graph,
+      const KeywordSpotterOptions &opts = KeywordSpotterOptions());
+
+  const KeywordSpotterOptions &GetOptions() const { return opts_; }
+
+  /// Starts a new stream
+  void InitDecoding();
+
+  /// Decodes the frames that are ready in the decodable object, or at most
+  /// max_num_frames of them if it is >= 0. The frame indexes start from 0
+  /// at InitDecoding(), as for the other decoders.
+  void AdvanceDecoding(DecodableInterface *decodable,
+                       int32_t max_num_frames = -1);
+
+  /// Returns the keywords triggered since the last call, in the order of
+  /// their end frames, and forgets them.
+  std::vector<KeywordTrigger> PopTriggers();
+
+  /// Returns the number of frames already decoded.
+  int32_t NumFramesDecoded() const { return num_frames_decoded_; }
+
+ private:
+  void ProcessFrame(DecodableInterface *decodable);
+
+  const KeywordGraph &graph_;
+  KeywordSpotterOptions opts_;
+
+  // For each position of the graph, the cost of the best path ending there,
+  // minus the one of the best path, its first frame, its number of frames
+  // on tokens, i.e., not on blanks, and the last of these frames. The cost
+  // is infinity if no path ends there.
+  std::vector<float> costs_;
+  std::vector<int32_t> start_frames_;
+  std::vector<int32_t> num_token_frames_;
+  std::vector<int32_t> last_token_frames_;
+
+  // The most likely token of the previous frame, as an index in the
+  // decodable object. A keyword cannot start with it, since that would be
+  // the repeat of a token, not a new one.
+  int32_t prev_best_label_ = 0;
+
+  std::vector<KeywordTrigger> triggers_;
+
+  int32_t num_frames_decoded_ = -1;
+};
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_KEYWORD_SPOTTER_H_
@@ -0,0 +1,158 @@
+// kaldi-decoder/csrc/lattice-determinize-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/lattice-determinize.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/lattice-simple-decoder.h"
+
+namespace kaldi_decoder {
+
+using Path = std::pair<double, std::vector<int32_t>>;  // (cost, ilabels)
+
+// Enumerates the successful paths of a small acyclic lattice. For each word
+// sequence, it returns the best path; "num_paths" is set to the number of
+// successful paths.
+static std::map<std::vector<int32_t>, Path> BestPaths(const fst::Lattice &lat,
+                                                     int32_t *num_paths) {
+  std::map<std::vector<int32_t>, Path> ans;
+  *num_paths = 0;
+
+  struct Item {
+    int32_t state;
+    double cost;
+    std::vector<int32_t> words;
+    std::vector<int32_t> ilabels;
+  };
+  std::vector<Item> stack = {{lat.Start(), 0, {}, {}}};
+  while (!stack.empty()) {
+    Item item = std::move(stack.back());
+    stack.pop_back();
+
+    fst::LatticeWeight w = lat.Final(item.state);
+    if (w != fst::LatticeWeight::Zero()) {
+      ++*num_paths;
+      double cost = item.cost + w.Value1() + w.Value2();
+      auto iter = ans.find(item.words);
+      if (iter == ans.end() || cost < iter->second.first) {
+        ans[item.words] = {cost, item.ilabels};
+      }
+    }
+
+    for (fst::ArcIterator<fst::Lattice> aiter(lat, item.state); !aiter.Done();
+         aiter.Next()) {
+      const auto &arc = aiter.Value();
+      Item next = item;
+      next.state = arc.nextstate;
+      next.cost += arc.weight.Value1() + arc.weight.Value2();
+      if (arc.olabel != 0) next.words.push_back(arc.olabel);
+      if (arc.ilabel != 0) next.ilabels.push_back(arc.ilabel);
+      stack.push_back(std::move(next));
+    }
+  }
+  return ans;
+}
+
+TEST(DeterminizeLattice, KeepsBestPathPerWordSequence) {
+  using Arc = fst::LatticeArc;
+  using Weight = fst::LatticeWeight;
+
+  // Two paths with the words "5 6" and one with "5"
+  fst::Lattice lat;
+  for (int32_t i = 0; i != 6; ++i) {
+    lat.AddState();
+  }
+  lat.SetStart(0);
+  lat.AddArc(0, Arc(1, 5, Weight(1, 1), 1));
+  lat.AddArc(0, Arc(2, 5, Weight(1, 0.5), 2));
+  lat.AddArc(1, Arc(3, 6, Weight(0, 1), 3));
+  lat.AddArc(2, Arc(4, 0, Weight(0, 1), 4));
+  lat.AddArc(4, Arc(3, 6, Weight(0, 1), 3));
+  lat.AddArc(2, Arc(3, 0, Weight(0, 0.25), 5));
+  lat.SetFinal(3, Weight(0.5, 0));
+  lat.SetFinal(5, Weight::One());
+
+  fst::Lattice det;
+  ASSERT_TRUE(DeterminizeLattice(lat, &det));
+
+  int32_t num_paths = 0;
+  auto paths = BestPaths(det, &num_paths);
+  EXPECT_EQ(num_paths, 2);
+  ASSERT_EQ(paths.size(), 2);
+
+  std::vector<int32_t> words = {5, 6};
+  EXPECT_NEAR(paths[words].first, 3.5, 1e-5);
+  EXPECT_EQ(paths[words].second, std::vector<int32_t>({1, 3}));
+
+  words = {5};
+  EXPECT_NEAR(paths[words].first, 1.75, 1e-5);
+  EXPECT_EQ(paths[words].second, std::vector<int32_t>({2, 3}));
+
+  // Paths more than beam = 1 above the best one are removed
+  ASSERT_TRUE(DeterminizeLattice(lat, &det, 1));
+  paths = BestPaths(det, &num_paths);
+  EXPECT_EQ(num_paths, 1);
+  EXPECT_EQ(paths.count({5}), 1);
+}
+
+TEST(DeterminizeLattice, DecoderLattice) {
+  fst::StdVectorFst g;
+  g.AddState();
+  g.SetStart(0);
+  g.SetFinal(0, 0);
+  for (int32_t i = 1; i <= 3; ++i) {
+    int32_t s = g.AddState();
+    g.AddArc(0, fst::StdArc(i, 100 + i, 0.1 * i, s));
+    g.AddArc(s, fst::StdArc(i, 0, 0.05, s));
+    g.AddArc(s, fst::StdArc(0, 0, 0.2, 0));
+  }
+
+  FloatMatrix log_probs = RandnMatrix(10, 3);
+  DecodableCtc decodable(log_probs);
+  LatticeSimpleDecoder decoder(g, LatticeSimpleDecoderConfig(6.0, 3.0));
+  decoder.Decode(&decodable);
+
+  fst::Lattice raw, det;
+  ASSERT_TRUE(decoder.GetRawLattice(&raw));
+  ASSERT_TRUE(DeterminizeLattice(raw, &det));
+
+  int32_t num_raw_paths = 0, num_det_paths = 0;
+  auto expected = BestPaths(raw, &num_raw_paths);
+  auto paths = BestPaths(det, &num_det_paths);
+
+  // Each word sequence has a single path, with the best cost
+  EXPECT_EQ(num_det_paths, static_cast<int32_t>(paths.size()));
+  ASSERT_EQ(paths.size(), expected.size());
+  for (const auto &p : expected) {
+    ASSERT_EQ(paths.count(p.first), 1);
+    EXPECT_NEAR(paths[p.first].first, p.second.first, 1e-3);
+  }
+}
+
+TEST(DeterminizeLattice, Errors) {
+  using Arc = fst::LatticeArc;
+  using Weight = fst::LatticeWeight;
+
+  fst::Lattice lat, det;
+  lat.AddState();
+  lat.AddState();
+  lat.SetStart(0);
+  lat.AddArc(0, Arc(1, 1, Weight::One(), 1));
+
+  // No final state
+  EXPECT_FALSE(DeterminizeLattice(lat, &det));
+  EXPECT_EQ(det.NumStates(), 0);
+
+  lat.SetFinal(1, Weight::One());
+  lat.AddArc(1, Arc(1, 1, Weight::One(), 0));
+  EXPECT_THROW(DeterminizeLattice(lat, &det), std::runtime_error);
+}
+
+}  // namespace kaldi_decoder
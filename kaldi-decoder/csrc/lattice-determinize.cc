@@ -0,0 +1,523 @@
+// kaldi-decoder/csrc/lattice-determinize.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/lattice-determinize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "kaldi-decoder/csrc/log.h"
+
+namespace kaldi_decoder {
+
+namespace {
+
+using Weight = fst::LatticeWeight;
+using Label = fst::LatticeArc::Label;
+using StateId = fst::LatticeArc::StateId;
+
+// Residual weights are quantized with this step when comparing subsets, so
+// that subsets differing only by rounding errors are merged.
+constexpr float kQuantizationDelta = 1.0f / 1024;
+
+inline double Cost(const Weight &w) {
+  return static_cast<double>(w.Value1()) + w.Value2();
+}
+
+// Returns true if the path with weight "a" and input labels "a_str" is
+// better than the one with "b" and "b_str". The total cost decides; ties are
+// broken by the graph cost and then by the input labels, so that the result
+// does not depend on the order in which paths are visited.
+inline bool Better(const Weight &a, const std::vector<Label> &a_str,
+                   const Weight &b, const std::vector<Label> &b_str) {
+  double ca = Cost(a), cb = Cost(b);
+  if (ca != cb) return ca < cb;
+  if (a.Value1() != b.Value1()) return a.Value1() < b.Value1();
+  return a_str < b_str;
+}
+
+struct VectorHasher {
+  size_t operator()(const std::vector<int32_t> &v) const {
+    size_t ans = v.size();
+    for (int32_t i : v) {
+      ans = ans * 7853 + static_cast<size_t>(i);
+    }
+    return ans;
+  }
+};
+
+class LatticeDeterminizer {
+ public:
+  LatticeDeterminizer(const fst::Lattice &ifst, float beam)
+      : ifst_(ifst), beam_(beam) {}
+
+  bool Determinize(fst::Lattice *ofst) {
+    ofst->DeleteStates();
+    if (!Prepare()) {
+      return false;
+    }
+
+    // The initial subset is not normalized, since there is no arc to put
+    // the common weight and labels on.
+    std::vector<Element> subset = {{ifst_.Start(), Weight::One(), {}}};
+    EpsilonClosure(&subset);
+    double backward_cost = BackwardCost(subset);
+    int32_t id = FindOrAddSubset(std::move(subset), 0, backward_cost);
+    queue_.emplace(backward_cost, id);
+
+    // Subsets are expanded best first, as in Kaldi's pruned determinization,
+    // so that the forward cost of a subset is final when it is expanded.
+    while (!queue_.empty()) {
+      id = queue_.top().second;
+      queue_.pop();
+      if (!processed_[id]) {
+        ProcessSubset(id);
+        processed_[id] = true;
+      }
+    }
+
+    Output(ofst);
+    return true;
+  }
+
+ private:
+  // An element of a subset: a state of the input, with the weight and the
+  // input labels of the best path to it that have not been output yet.
+  struct Element {
+    StateId state;
+    Weight weight;
+    std::vector<Label> str;
+  };
+
+  struct InArc {
+    Label ilabel;
+    Label olabel;
+    Weight weight;
+    StateId nextstate;
+  };
+
+  struct OutArc {
+    Label olabel;
+    Weight weight;
+    std::vector<Label> str;
+    int32_t nextstate;
+  };
+
+  // Sorts the states topologically, computes the forward and backward costs
+  // and keeps in arcs_ and finals_ only the arcs and final weights on
+  // successful paths within the beam. Returns false if there is no
+  // successful path.
+  bool Prepare() {
+    StateId num_states = ifst_.NumStates();
+    StateId start = ifst_.Start();
+    if (start == fst::kNoStateId || num_states == 0) {
+      return false;
+    }
+
+    // Iterative depth-first search; order holds the states in reverse
+    // topological order.
+    std::vector<int8_t> color(num_states, 0);  // 0: new, 1: open, 2: done
+    std::vector<StateId> order;
+    std::vector<std::pair<StateId, size_t>> stack = {{start, 0}};
+    color[start] = 1;
+    while (!stack.empty()) {
+      StateId s = stack.back().first;
+      size_t i = stack.back().second++;
+      if (i == ifst_.NumArcs(s)) {
+        color[s] = 2;
+        order.push_back(s);
+        stack.pop_back();
+        continue;
+      }
+
+      fst::ArcIterator<fst::Lattice> aiter(ifst_, s);
+      aiter.Seek(i);
+      StateId n = aiter.Value().nextstate;
+      if (color[n] == 1) {
+        KALDI_DECODER_ERR << "DeterminizeLattice: the input lattice has a "
+                          << "cycle at state " << n;
+      }
+      if (color[n] == 0) {
+        color[n] = 1;
+        stack.emplace_back(n, 0);
+      }
+    }
+    std::reverse(order.begin(), order.end());
+
+    topo_pos_.assign(num_states, -1);
+    for (size_t i = 0; i != order.size(); ++i) {
+      topo_pos_[order[i]] = static_cast<int32_t>(i);
+    }
+
+    double inf = std::numeric_limits<double>::infinity();
+    std::vector<double> alpha(num_states, inf), beta(num_states, inf);
+    alpha[start] = 0;
+    for (StateId s : order) {
+      for (fst::ArcIterator<fst::Lattice> aiter(ifst_, s); !aiter.Done();
+           aiter.Next()) {
+        const auto &arc = aiter.Value();
+        alpha[arc.nextstate] =
+            std::min(alpha[arc.nextstate], alpha[s] + Cost(arc.weight));
+      }
+    }
+
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+      StateId s = *it;
+      beta[s] = Cost(ifst_.Final(s));
+      for (fst::ArcIterator<fst::Lattice> aiter(ifst_, s); !aiter.Done();
+           aiter.Next()) {
+        const auto &arc = aiter.Value();
+        beta[s] = std::min(beta[s], Cost(arc.weight) + beta[arc.nextstate]);
+      }
+    }
+
+    beta_ = beta;
+    double best = beta[start];
+    if (!(best < inf)) {
+      return false;
+    }
+
+    // Paths must be successful, i.e., have a finite cost, and be within the
+    // beam, which may be infinite
+    cutoff_ = best + beam_;
+    double cutoff = cutoff_;
+    auto keep = [inf, cutoff](double cost) {
+      return cost < inf && cost <= cutoff;
+    };
+
+    arcs_.assign(num_states, {});
+    finals_.assign(num_states, Weight::Zero());
+    for (StateId s : order) {
+      if (!keep(alpha[s] + beta[s])) {
+        continue;
+      }
+
+      if (keep(alpha[s] + Cost(ifst_.Final(s)))) {
+        finals_[s] = ifst_.Final(s);
+      }
+
+      for (fst::ArcIterator<fst::Lattice> aiter(ifst_, s); !aiter.Done();
+           aiter.Next()) {
+        const auto &arc = aiter.Value();
+        if (keep(alpha[s] + Cost(arc.weight) + beta[arc.nextstate])) {
+          arcs_[s].push_back(
+              {arc.ilabel, arc.olabel, arc.weight, arc.nextstate});
+        }
+      }
+    }
+
+    return true;
+  }
+
+  // Adds the states reachable from the subset via arcs without words, and
+  // then keeps only the states that have arcs with words or are final.
+  void EpsilonClosure(std::vector<Element> *subset) {
+    std::unordered_map<StateId, size_t> index;
+    using Item = std::pair<int32_t, StateId>;  // (topo_pos, state)
+    std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+
+    for (size_t i = 0; i != subset->size(); ++i) {
+      StateId s = (*subset)[i].state;
+      index[s] = i;
+      queue.emplace(topo_pos_[s], s);
+    }
+
+    // States are expanded in topological order, so each of them is
+    // expanded once, after all the paths to it have been seen.
+    while (!queue.empty()) {
+      StateId s = queue.top().second;
+      queue.pop();
+      while (!queue.empty() && queue.top().second == s) {
+        queue.pop();
+      }
+
+      for (const auto &arc : arcs_[s]) {
+        if (arc.olabel != 0) {
+          continue;
+        }
+
+        const Element &e = (*subset)[index[s]];
+        Weight w = fst::Times(e.weight, arc.weight);
+        std::vector<Label> str = e.str;
+        if (arc.ilabel != 0) {
+          str.push_back(arc.ilabel);
+        }
+
+        auto iter = index.find(arc.nextstate);
+        if (iter == index.end()) {
+          index[arc.nextstate] = subset->size();
+          subset->push_back({arc.nextstate, w, std::move(str)});
+          queue.emplace(topo_pos_[arc.nextstate], arc.nextstate);
+        } else {
+          Element &old = (*subset)[iter->second];
+          if (Better(w, str, old.weight, old.str)) {
+            old.weight = w;
+            old.str = std::move(str);
+          }
+        }
+      }
+    }
+
+    auto is_useless = [this](const Element &e) {
+      if (finals_[e.state] != Weight::Zero()) {
+        return false;
+      }
+      for (const auto &arc : arcs_[e.state]) {
+        if (arc.olabel != 0) {
+          return false;
+        }
+      }
+      return true;
+    };
+    subset->erase(std::remove_if(subset->begin(), subset->end(), is_useless),
+                  subset->end());
+  }
+
+  // Removes the best weight and the common prefix of the input labels from
+  // the elements of the subset and returns them in "weight" and "prefix".
+  void Normalize(std::vector<Element> *subset, Weight *weight,
+                 std::vector<Label> *prefix) {
+    KALDI_DECODER_ASSERT(!subset->empty());
+    const Element *best = &subset->front();
+    size_t prefix_len = best->str.size();
+    for (const auto &e : *subset) {
+      if (Better(e.weight, e.str, best->weight, best->str)) {
+        best = &e;
+      }
+      size_t n = 0;
+      while (n < prefix_len && n < e.str.size() &&
+             e.str[n] == subset->front().str[n]) {
+        ++n;
+      }
+      prefix_len = n;
+    }
+
+    *weight = best->weight;
+    prefix->assign(subset->front().str.begin(),
+                   subset->front().str.begin() + prefix_len);
+
+    for (auto &e : *subset) {
+      e.weight = fst::Divide(e.weight, *weight);
+      e.str.erase(e.str.begin(), e.str.begin() + prefix_len);
+    }
+  }
+
+  // Returns the best cost of the paths from the states of the subset to the
+  // final states, including the weights of the elements.
+  double BackwardCost(const std::vector<Element> &subset) const {
+    double ans = std::numeric_limits<double>::infinity();
+    for (const auto &e : subset) {
+      ans = std::min(ans, Cost(e.weight) + beta_[e.state]);
+    }
+    return ans;
+  }
+
+  // Returns the id of the subset, which is added if it is new. A subset
+  // that has not been expanded yet is queued again if the new forward cost
+  // is better.
+  int32_t FindOrAddSubset(std::vector<Element> subset, double forward_cost,
+                          double backward_cost) {
+    std::sort(subset.begin(), subset.end(),
+              [](const Element &a, const Element &b) {
+                return a.state < b.state;
+              });
+
+    std::vector<int32_t> key;
+    for (const auto &e : subset) {
+      key.push_back(e.state);
+      key.push_back(
+          static_cast<int32_t>(std::round(e.weight.Value1() /
+                                          kQuantizationDelta)));
+      key.push_back(
+          static_cast<int32_t>(std::round(e.weight.Value2() /
+                                          kQuantizationDelta)));
+      key.push_back(static_cast<int32_t>(e.str.size()));
+      key.insert(key.end(), e.str.begin(), e.str.end());
+    }
+
+    auto iter = subset_ids_.find(key);
+    if (iter != subset_ids_.end()) {
+      int32_t id = iter->second;
+      if (!processed_[id] && forward_cost < forward_costs_[id]) {
+        forward_costs_[id] = forward_cost;
+        queue_.emplace(forward_cost + backward_cost, id);
+      }
+      return id;
+    }
+
+    int32_t id = static_cast<int32_t>(subsets_.size());
+    subset_ids_.emplace(std::move(key), id);
+    subsets_.push_back(std::move(subset));
+    forward_costs_.push_back(forward_cost);
+    processed_.push_back(false);
+    out_arcs_.emplace_back();
+    out_finals_.emplace_back(Weight::Zero(), std::vector<Label>());
+    queue_.emplace(forward_cost + backward_cost, id);
+    return id;
+  }
+
+  void ProcessSubset(int32_t id) {
+    // subsets_ may grow below; work on a copy
+    std::vector<Element> subset = subsets_[id];
+    double forward_cost = forward_costs_[id];
+
+    Weight final_weight = Weight::Zero();
+    std::vector<Label> final_str;
+    for (const auto &e : subset) {
+      if (finals_[e.state] == Weight::Zero()) {
+        continue;
+      }
+      Weight w = fst::Times(e.weight, finals_[e.state]);
+      if (forward_cost + Cost(w) > cutoff_) {
+        continue;
+      }
+      if (final_weight == Weight::Zero() ||
+          Better(w, e.str, final_weight, final_str)) {
+        final_weight = w;
+        final_str = e.str;
+      }
+    }
+    out_finals_[id] = {final_weight, std::move(final_str)};
+
+    // All the transitions with a word, as (word, element); for each pair of
+    // word and next state only the best one is kept.
+    std::vector<std::pair<Label, Element>> next;
+    for (const auto &e : subset) {
+      for (const auto &arc : arcs_[e.state]) {
+        if (arc.olabel == 0) {
+          continue;
+        }
+        std::vector<Label> str = e.str;
+        if (arc.ilabel != 0) {
+          str.push_back(arc.ilabel);
+        }
+        next.push_back({arc.olabel,
+                        {arc.nextstate, fst::Times(e.weight, arc.weight),
+                         std::move(str)}});
+      }
+    }
+
+    std::sort(next.begin(), next.end(), [](const auto &a, const auto &b) {
+      if (a.first != b.first) return a.first < b.first;
+      if (a.second.state != b.second.state) {
+        return a.second.state < b.second.state;
+      }
+      return Better(a.second.weight, a.second.str, b.second.weight,
+                    b.second.str);
+    });
+
+    std::vector<OutArc> out_arcs;
+    for (size_t i = 0; i != next.size();) {
+      Label olabel = next[i].first;
+      std::vector<Element> dest;
+      for (; i != next.size() && next[i].first == olabel; ++i) {
+        if (dest.empty() || dest.back().state != next[i].second.state) {
+          dest.push_back(std::move(next[i].second));
+        }
+      }
+
+      EpsilonClosure(&dest);
+      if (dest.empty()) {
+        continue;
+      }
+
+      OutArc arc;
+      arc.olabel = olabel;
+      Normalize(&dest, &arc.weight, &arc.str);
+
+      // Arcs to subsets whose best path is outside of the beam are pruned
+      double next_forward_cost = forward_cost + Cost(arc.weight);
+      double backward_cost = BackwardCost(dest);
+      if (next_forward_cost + backward_cost > cutoff_) {
+        continue;
+      }
+
+      arc.nextstate =
+          FindOrAddSubset(std::move(dest), next_forward_cost, backward_cost);
+      out_arcs.push_back(std::move(arc));
+    }
+    out_arcs_[id] = std::move(out_arcs);
+  }
+
+  // Converts the result to a Lattice; each output arc becomes a chain with
+  // one arc per input label.
+  void Output(fst::Lattice *ofst) const {
+    int32_t num_subsets = static_cast<int32_t>(subsets_.size());
+    for (int32_t i = 0; i != num_subsets; ++i) {
+      ofst->AddState();
+    }
+    ofst->SetStart(0);
+
+    for (int32_t s = 0; s != num_subsets; ++s) {
+      for (const auto &arc : out_arcs_[s]) {
+        AddChain(s, arc.olabel, arc.weight, arc.str, arc.nextstate, ofst);
+      }
+
+      const auto &f = out_finals_[s];
+      if (f.first == Weight::Zero()) {
+        continue;
+      }
+      if (f.second.empty()) {
+        ofst->SetFinal(s, f.first);
+      } else {
+        StateId t = ofst->AddState();
+        ofst->SetFinal(t, Weight::One());
+        AddChain(s, 0, f.first, f.second, t, ofst);
+      }
+    }
+  }
+
+  static void AddChain(StateId s, Label olabel, const Weight &weight,
+                       const std::vector<Label> &str, StateId nextstate,
+                       fst::Lattice *ofst) {
+    if (str.empty()) {
+      ofst->AddArc(s, fst::LatticeArc(0, olabel, weight, nextstate));
+      return;
+    }
+
+    StateId cur = s;
+    for (size_t i = 0; i != str.size(); ++i) {
+      StateId n = (i + 1 == str.size()) ? nextstate : ofst->AddState();
+      ofst->AddArc(cur, fst::LatticeArc(str[i], i == 0 ? olabel : 0,
+                                        i == 0 ? weight : Weight::One(), n));
+      cur = n;
+    }
+  }
+
+  const fst::Lattice &ifst_;
+  float beam_;
+
+  std::vector<int32_t> topo_pos_;
+  std::vector<std::vector<InArc>> arcs_;
+  std::vector<Weight> finals_;
+  std::vector<double> beta_;  // backward costs of the states of the input
+  double cutoff_ = 0;         // the best cost plus the beam
+
+  std::vector<std::vector<Element>> subsets_;
+  std::vector<double> forward_costs_;
+  std::vector<bool> processed_;
+  using QueueItem = std::pair<double, int32_t>;  // (priority, subset)
+  std::priority_queue<QueueItem, std::vector<QueueItem>,
+                      std::greater<QueueItem>>
+      queue_;
+  std::unordered_map<std::vector<int32_t>, int32_t, VectorHasher> subset_ids_;
+  std::vector<std::vector<OutArc>> out_arcs_;
+  std::vector<std::pair<Weight, std::vector<Label>>> out_finals_;
+};
+
+}  // namespace
+
+bool DeterminizeLattice(const fst::Lattice &ifst, fst::Lattice *ofst,
+                        float beam /*= infinity*/) {
+  LatticeDeterminizer determinizer(ifst, beam);
+  return determinizer.Determinize(ofst);
+}
+
+}  // namespace kaldi_decoder
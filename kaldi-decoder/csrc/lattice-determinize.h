@@ -0,0 +1,43 @@
+// kaldi-decoder/csrc/lattice-determinize.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_LATTICE_DETERMINIZE_H_
+#define KALDI_DECODER_CSRC_LATTICE_DETERMINIZE_H_
+
+#include <limits>
+
+#include "kaldifst/csrc/lattice-weight.h"
+
+namespace kaldi_decoder {
+
+/** Determinizes an acyclic lattice, e.g., the output of GetRawLattice(), on
+    its output labels (words), with the semantics of Kaldi's lattice
+    determinization: for each word sequence, only the best path is kept,
+    together with its input labels (the alignment) and its graph and
+    acoustic costs.
+
+    The output is in the format of a CompactLattice converted back to a
+    Lattice: each arc of the determinized lattice becomes a chain of arcs
+    whose first arc has the word, the weight and the first input label, and
+    whose other arcs have the remaining input labels. So for any state, the
+    words on the arcs leaving it are distinct.
+
+    @param ifst The input lattice. It must be acyclic; it throws otherwise.
+    @param beam Paths whose cost is more than "beam" above the best path are
+                pruned. As in Kaldi's pruned determinization, the pruning is
+                also applied to the states of the output while they are
+                created, which keeps the output small when the input has
+                very many word sequences. With infinity, all the paths are
+                kept, and the output can be exponentially larger than the
+                input.
+    @param ofst The output lattice.
+    @return Returns false if the input has no successful path, in which case
+            ofst is empty.
+ */
+bool DeterminizeLattice(const fst::Lattice &ifst, fst::Lattice *ofst,
+                        float beam = std::numeric_limits<float>::infinity());
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_LATTICE_DETERMINIZE_H_
@@ -0,0 +1,92 @@
+// kaldi-decoder/csrc/lattice-incremental-decoder-benchmark.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+// Measures the latency of LatticeIncrementalDecoder::GetLattice() at the end
+// of utterances of increasing length, i.e., the time from the last frame to
+// the determinized lattice, and compares it with DeterminizeLattice() of
+// GetRawLattice(). The frames are decoded in pieces of 10 frames, as in
+// streaming. The log-probs are random, with peaks along a random sequence
+// of labels.
+//
+// Usage:
+//   ./bin/lattice-incremental-decoder-benchmark [max_num_frames] [num_labels]
+
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/lattice-determinize.h"
+#include "kaldi-decoder/csrc/lattice-incremental-decoder.h"
+#include "kaldi-decoder/csrc/test-utils.h"
+
+namespace kaldi_decoder {
+
+// Each label lasts 3 to 8 frames. Label i of the graph is column i - 1.
+static std::vector<int32_t> FrameTokens(int32_t num_frames,
+                                        int32_t num_labels) {
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int32_t> duration(3, 8);
+  std::uniform_int_distribution<int32_t> column(0, num_labels - 1);
+
+  std::vector<int32_t> ans;
+  while (static_cast<int32_t>(ans.size()) < num_frames) {
+    ans.insert(ans.end(), duration(gen), column(gen));
+  }
+  ans.resize(num_frames);
+  return ans;
+}
+
+static void Run(int32_t num_frames, int32_t num_labels) {
+  fst::StdVectorFst g = BuildLoopGraph(num_labels, 2);
+  FloatMatrix log_probs = PeakyLogProbs(FrameTokens(num_frames, num_labels),
+                                        num_labels, 4, 1, /*seed=*/0);
+  DecodableCtc decodable(log_probs);
+
+  LatticeSimpleDecoderConfig decoder_config(10.0, 4.0);
+  LatticeIncrementalDecoder decoder(
+      g, LatticeIncrementalDecoderConfig(decoder_config));
+
+  auto start = std::chrono::steady_clock::now();
+  decoder.InitDecoding();
+  while (decoder.NumFramesDecoded() < num_frames) {
+    decoder.AdvanceDecoding(&decodable, 10);
+  }
+  decoder.FinalizeDecoding();
+  double decode_ms = ElapsedMs(start);
+
+  start = std::chrono::steady_clock::now();
+  fst::Lattice lat;
+  bool ok = decoder.GetLattice(&lat);
+  double incremental_ms = ElapsedMs(start);
+
+  start = std::chrono::steady_clock::now();
+  fst::Lattice raw, full;
+  decoder.GetRawLattice(&raw);
+  DeterminizeLattice(raw, &full, decoder_config.lattice_beam);
+  double full_ms = ElapsedMs(start);
+
+  fprintf(stderr, "%7d | %9.1f | %10.2f | %10.2f | %7d%s\n", num_frames,
+          decode_ms, incremental_ms, full_ms, lat.NumStates(),
+          ok ? "" : " (failed)");
+}
+
+}  // namespace kaldi_decoder
+
+int main(int argc, char *argv[]) {
+  int32_t max_num_frames = argc > 1 ? atoi(argv[1]) : 64000;
+  int32_t num_labels = argc > 2 ? atoi(argv[2]) : 20;
+
+  fprintf(stderr, "num_labels: %d. Times are in ms.\n", num_labels);
+  fprintf(stderr, "%7s | %9s | %10s | %10s | %7s\n", "frames", "decode",
+          "GetLattice", "full det", "states");
+  for (int32_t num_frames = 250; num_frames <= max_num_frames;
+       num_frames *= 2) {
+    kaldi_decoder::Run(num_frames, num_labels);
+  }
+  return 0;
+}
@@ -0,0 +1,140 @@
+// kaldi-decoder/csrc/lattice-incremental-decoder-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/lattice-incremental-decoder.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/lattice-determinize.h"
+#include "kaldi-decoder/csrc/test-utils.h"
+
+namespace kaldi_decoder {
+
+// Returns the cost of each word sequence of a determinized lattice. It
+// checks that each word sequence has a single path.
+static std::map<std::vector<int32_t>, double> WordSequences(
+    const fst::Lattice &lat) {
+  std::map<std::vector<int32_t>, double> ans;
+
+  struct Item {
+    int32_t state;
+    double cost;
+    std::vector<int32_t> words;
+  };
+  std::vector<Item> stack = {{lat.Start(), 0, {}}};
+  while (!stack.empty()) {
+    Item item = std::move(stack.back());
+    stack.pop_back();
+
+    fst::LatticeWeight w = lat.Final(item.state);
+    if (w != fst::LatticeWeight::Zero()) {
+      EXPECT_EQ(ans.count(item.words), 0);
+      ans[item.words] = item.cost + w.Value1() + w.Value2();
+    }
+
+    for (fst::ArcIterator<fst::Lattice> aiter(lat, item.state); !aiter.Done();
+         aiter.Next()) {
+      const auto &arc = aiter.Value();
+      Item next = item;
+      next.state = arc.nextstate;
+      next.cost += arc.weight.Value1() + arc.weight.Value2();
+      if (arc.olabel != 0) next.words.push_back(arc.olabel);
+      stack.push_back(std::move(next));
+    }
+  }
+  return ans;
+}
+
+// The lattice of the incremental decoder has the word sequences within the
+// lattice beam of the determinized raw lattice, with the same costs. Both
+// can have other paths outside of the beam, which are not compared.
+static void ExpectSameLattice(const fst::Lattice &lat,
+                              const fst::Lattice &expected, float beam) {
+  auto sequences = WordSequences(lat);
+  auto expected_sequences = WordSequences(expected);
+  ASSERT_FALSE(expected_sequences.empty());
+
+  double best = expected_sequences.begin()->second;
+  for (const auto &p : expected_sequences) {
+    best = std::min(best, p.second);
+  }
+
+  for (const auto &p : expected_sequences) {
+    if (p.second <= best + beam) {
+      ASSERT_EQ(sequences.count(p.first), 1);
+      EXPECT_NEAR(sequences[p.first], p.second, 1e-3);
+    }
+  }
+
+  for (const auto &p : sequences) {
+    EXPECT_GE(p.second, best - 1e-3);
+    if (p.second <= best + beam - 1e-3) {
+      EXPECT_EQ(expected_sequences.count(p.first), 1);
+    }
+  }
+}
+
+TEST(LatticeIncrementalDecoder, Decode) {
+  int32_t num_labels = 3;
+  fst::StdVectorFst g = BuildLoopGraph(num_labels, 2);
+  FloatMatrix log_probs = RandnMatrix(80, num_labels);
+  DecodableCtc decodable(log_probs);
+
+  LatticeSimpleDecoderConfig decoder_config(6.0, 2.0, 5);
+  LatticeIncrementalDecoder decoder(
+      g, LatticeIncrementalDecoderConfig(decoder_config, 10, 4));
+  decoder.Decode(&decodable);
+  EXPECT_GT(decoder.NumFramesDeterminized(), 40);
+
+  fst::Lattice lat;
+  ASSERT_TRUE(decoder.GetLattice(&lat));
+
+  fst::Lattice raw, expected;
+  decoder.GetRawLattice(&raw);
+  DeterminizeLattice(raw, &expected, decoder_config.lattice_beam);
+  ExpectSameLattice(lat, expected, decoder_config.lattice_beam);
+}
+
+TEST(LatticeIncrementalDecoder, AdvanceDecoding) {
+  int32_t num_labels = 3;
+  fst::StdVectorFst g = BuildLoopGraph(num_labels, 2);
+  FloatMatrix log_probs = RandnMatrix(80, num_labels);
+  DecodableCtc decodable(log_probs);
+
+  LatticeSimpleDecoderConfig decoder_config(6.0, 2.0, 5);
+  LatticeIncrementalDecoder decoder(
+      g, LatticeIncrementalDecoderConfig(decoder_config, 10, 4));
+
+  for (int32_t utt = 0; utt != 2; ++utt) {
+    decoder.InitDecoding();
+    EXPECT_EQ(decoder.NumFramesDeterminized(), 0);
+
+    while (decoder.NumFramesDecoded() < decodable.NumFramesReady()) {
+      decoder.AdvanceDecoding(&decodable, 7);
+
+      // The partial lattice, without final-probs
+      fst::Lattice lat, raw, expected;
+      ASSERT_TRUE(decoder.GetLattice(&lat, false));
+      decoder.GetRawLattice(&raw, false);
+      DeterminizeLattice(raw, &expected, decoder_config.lattice_beam);
+      ExpectSameLattice(lat, expected, decoder_config.lattice_beam);
+    }
+    EXPECT_GT(decoder.NumFramesDeterminized(), 40);
+
+    decoder.FinalizeDecoding();
+    fst::Lattice lat, raw, expected;
+    ASSERT_TRUE(decoder.GetLattice(&lat));
+    decoder.GetRawLattice(&raw);
+    DeterminizeLattice(raw, &expected, decoder_config.lattice_beam);
+    ExpectSameLattice(lat, expected, decoder_config.lattice_beam);
+  }
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,722 @@
+// kaldi-decoder/csrc/lattice-incremental-decoder.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/lattice-incremental-decoder.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <utility>
+
+#include "kaldi-decoder/csrc/lattice-determinize.h"
+
+namespace kaldi_decoder {
+
+// The words that the raw lattice of a chunk has besides those of the graph:
+// kEntryLabelOffset + i is on the arc from its start state for the i-th
+// entry of the redeterminized states, and kEndLabelOffset + i is on the arc
+// from token i of its last frame. The words of the graph must be smaller.
+static constexpr int32_t kEntryLabelOffset = 1 << 29;
+static constexpr int32_t kEndLabelOffset = 1 << 30;
+
+static inline float Cost(const fst::LatticeWeight &w) {
+  return w.Value1() + w.Value2();
+}
+
+// Adds the arcs of a CompactLattice arc from s to nextstate in the format
+// of DeterminizeLattice(): a chain whose first arc has the word, the weight
+// and the first input label.
+static void AddChain(fst::LatticeArc::StateId s, int32_t word,
+                     const fst::LatticeWeight &weight,
+                     const std::vector<int32_t> &ilabels,
+                     fst::LatticeArc::StateId nextstate, fst::Lattice *ofst) {
+  if (ilabels.empty()) {
+    ofst->AddArc(s, fst::LatticeArc(0, word, weight, nextstate));
+    return;
+  }
+
+  fst::LatticeArc::StateId cur = s;
+  for (size_t i = 0; i != ilabels.size(); ++i) {
+    fst::LatticeArc::StateId n =
+        (i + 1 == ilabels.size()) ? nextstate : ofst->AddState();
+    ofst->AddArc(cur, fst::LatticeArc(
+                          ilabels[i], i == 0 ? word : 0,
+                          i == 0 ? weight : fst::LatticeWeight::One(), n));
+    cur = n;
+  }
+}
+
+// The inverse of AddChain(): follows the chain of arcs that starts with
+// "arc" in the output of DeterminizeLattice() and returns the state where
+// it ends. It outputs the weight and the input labels of the chain.
+static fst::LatticeArc::StateId FollowChain(const fst::Lattice &lat,
+                                            const fst::LatticeArc &arc,
+                                            fst::LatticeWeight *weight,
+                                            std::vector<int32_t> *ilabels) {
+  *weight = arc.weight;
+  ilabels->clear();
+  if (arc.ilabel != 0) {
+    ilabels->push_back(arc.ilabel);
+  }
+
+  fst::LatticeArc::StateId cur = arc.nextstate;
+  while (lat.Final(cur) == fst::LatticeWeight::Zero() &&
+         lat.NumArcs(cur) == 1) {
+    const fst::LatticeArc &next =
+        fst::ArcIterator<fst::Lattice>(lat, cur).Value();
+    if (next.olabel != 0) {
+      break;
+    }
+    *weight = fst::Times(*weight, next.weight);
+    if (next.ilabel != 0) {
+      ilabels->push_back(next.ilabel);
+    }
+    cur = next.nextstate;
+  }
+  return cur;
+}
+
+LatticeIncrementalDecoder::LatticeIncrementalDecoder(
+    const fst::Fst<fst::StdArc> &fst,
+    const LatticeIncrementalDecoderConfig &config)
+    : LatticeSimpleDecoder(fst, config.decoder_config),
+      incremental_config_(config) {
+  config.Check();
+}
+
+void LatticeIncrementalDecoder::ResetChunks() {
+  determinized_.clear();
+  num_frames_determinized_ = 0;
+  tail_begin_ = 0;
+  tail_sources_.clear();
+  boundary_ = ChunkBoundary();
+}
+
+void LatticeIncrementalDecoder::InitDecoding() {
+  LatticeSimpleDecoder::InitDecoding();
+  ResetChunks();
+}
+
+void LatticeIncrementalDecoder::Reset() {
+  LatticeSimpleDecoder::Reset();
+  ResetChunks();
+}
+
+void LatticeIncrementalDecoder::Restore(std::istream &is) {
+  LatticeSimpleDecoder::Restore(is);
+  ResetChunks();
+}
+
+void LatticeIncrementalDecoder::AdvanceDecoding(DecodableInterface *decodable,
+                                                int32_t max_num_frames) {
+  LatticeSimpleDecoder::AdvanceDecoding(decodable, max_num_frames);
+  DeterminizeChunks();
+}
+
+bool LatticeIncrementalDecoder::Decode(DecodableInterface *decodable) {
+  InitDecoding();
+
+  while (!decodable->IsLastFrame(NumFramesDecoded() - 1)) {
+    DecodeOneFrame(decodable);
+    DeterminizeChunks();
+  }
+  FinalizeDecoding();
+
+  return !final_costs_.empty();
+}
+
+int32_t LatticeIncrementalDecoder::FindChunkEnd(int32_t begin_frame,
+                                                int32_t end_frame) const {
+  int32_t best_frame = end_frame;
+  int32_t best_num_toks = -1;
+  for (int32_t f = end_frame; f >= begin_frame; --f) {
+    int32_t num_toks = 0;
+    for (const Token *tok = active_toks_[f].toks; tok != nullptr;
+         tok = tok->next) {
+      ++num_toks;
+    }
+    if (best_num_toks < 0 || num_toks < best_num_toks) {
+      best_frame = f;
+      best_num_toks = num_toks;
+    }
+  }
+  return best_frame;
+}
+
+void LatticeIncrementalDecoder::DeterminizeChunks() {
+  // Tokens on frames before num_frames_pruned_ have been pruned with the
+  // links of later frames, so they are good places to end a chunk.
+  int32_t last_frame = num_frames_pruned_ - 1;
+  while (last_frame - num_frames_determinized_ >=
+         incremental_config_.determinize_max_delay) {
+    int32_t end_frame = FindChunkEnd(
+        num_frames_determinized_ +
+            incremental_config_.determinize_min_chunk_size,
+        last_frame);
+
+    fst::Lattice raw, chunk;
+    ChunkBoundary end_boundary;
+    Redeterminized redet;
+    if (GetRawChunk(num_frames_determinized_, end_frame, false, &end_boundary,
+                    &redet, &raw) &&
+        DeterminizeLattice(raw, &chunk, config_.lattice_beam)) {
+      std::vector<CompactState> tail;
+      int32_t num_kept = 0;
+      std::vector<std::pair<LatticeStateId, std::vector<CompactArc>>> sources;
+      SpliceChunk(chunk, redet, &tail, &num_kept, &sources);
+
+      for (auto &p : sources) {
+        determinized_[p.first].arcs = std::move(p.second);
+      }
+      determinized_.resize(tail_begin_);
+      determinized_.insert(determinized_.end(),
+                           std::make_move_iterator(tail.begin()),
+                           std::make_move_iterator(tail.end()));
+
+      // The new tail is the chunk; the states with arcs to it are among the
+      // sources and the kept states.
+      LatticeStateId chunk_begin = tail_begin_ + num_kept;
+      auto has_arc_to_chunk = [this, chunk_begin](LatticeStateId s) {
+        for (const CompactArc &arc : determinized_[s].arcs) {
+          if (arc.nextstate >= chunk_begin) {
+            return true;
+          }
+        }
+        return false;
+      };
+
+      std::vector<LatticeStateId> tail_sources;
+      for (const auto &p : sources) {
+        if (has_arc_to_chunk(p.first)) {
+          tail_sources.push_back(p.first);
+        }
+      }
+      for (LatticeStateId s = tail_begin_; s != chunk_begin; ++s) {
+        if (has_arc_to_chunk(s)) {
+          tail_sources.push_back(s);
+        }
+      }
+      tail_sources_ = std::move(tail_sources);
+      tail_begin_ = chunk_begin;
+    } else {
+      // No path survived; later chunks cannot be connected to the start.
+      determinized_.clear();
+      tail_begin_ = 0;
+      tail_sources_.clear();
+    }
+
+    boundary_ = std::move(end_boundary);
+    num_frames_determinized_ = end_frame;
+  }
+}
+
+void LatticeIncrementalDecoder::FindRedeterminized(
+    Redeterminized *redet) const {
+  LatticeStateId num_states = static_cast<LatticeStateId>(determinized_.size());
+  std::vector<uint8_t> &is_redeterminized = redet->is_redeterminized;
+  is_redeterminized.assign(num_states - tail_begin_, 0);
+  redet->states.clear();
+  redet->entries.clear();
+
+  // The states with arcs to the boundary, and those reachable from them
+  std::vector<LatticeStateId> stack;
+  for (LatticeStateId s = tail_begin_; s != num_states; ++s) {
+    for (const CompactArc &arc : determinized_[s].arcs) {
+      if (arc.word >= kEndLabelOffset) {
+        is_redeterminized[s - tail_begin_] = 1;
+        stack.push_back(s);
+        break;
+      }
+    }
+  }
+  while (!stack.empty()) {
+    LatticeStateId s = stack.back();
+    stack.pop_back();
+    for (const CompactArc &arc : determinized_[s].arcs) {
+      if (arc.nextstate == fst::kNoStateId) {
+        continue;
+      }
+      KALDI_DECODER_ASSERT(arc.nextstate >= tail_begin_);
+      if (!is_redeterminized[arc.nextstate - tail_begin_]) {
+        is_redeterminized[arc.nextstate - tail_begin_] = 1;
+        stack.push_back(arc.nextstate);
+      }
+    }
+  }
+
+  for (LatticeStateId s = tail_begin_; s != num_states; ++s) {
+    if (is_redeterminized[s - tail_begin_]) {
+      redet->states.push_back(s);
+    }
+  }
+
+  // The start state is 0
+  redet->from_start = (tail_begin_ == 0 && is_redeterminized[0]);
+  if (redet->from_start) {
+    return;
+  }
+
+  auto add_entries = [this, redet](LatticeStateId s) {
+    const std::vector<CompactArc> &arcs = determinized_[s].arcs;
+    for (int32_t j = 0; j != static_cast<int32_t>(arcs.size()); ++j) {
+      LatticeStateId n = arcs[j].nextstate;
+      if (n >= tail_begin_ && redet->is_redeterminized[n - tail_begin_]) {
+        redet->entries.emplace_back(s, j);
+      }
+    }
+  };
+  for (LatticeStateId s : tail_sources_) {
+    add_entries(s);
+  }
+  for (LatticeStateId s = tail_begin_; s != num_states; ++s) {
+    if (!is_redeterminized[s - tail_begin_]) {
+      add_entries(s);
+    }
+  }
+}
+
+bool LatticeIncrementalDecoder::GetRawChunk(
+    int32_t begin_frame, int32_t end_frame, bool use_final_probs,
+    ChunkBoundary *end_boundary, Redeterminized *redet,
+    fst::Lattice *ofst) const {
+  using Arc = fst::LatticeArc;
+  using Weight = Arc::Weight;
+
+  ofst->DeleteStates();
+  *redet = Redeterminized();
+  if (begin_frame != 0) {
+    if (determinized_.empty()) {
+      // No path survived an earlier chunk
+      return false;
+    }
+    FindRedeterminized(redet);
+  }
+
+  // The copies of the redeterminized states, indexed by state - tail_begin_
+  std::vector<LatticeStateId> copies(redet->is_redeterminized.size(),
+                                     fst::kNoStateId);
+  LatticeStateId start_state = fst::kNoStateId;
+  if (begin_frame != 0 && !redet->from_start) {
+    start_state = ofst->AddState();
+  }
+  for (LatticeStateId s : redet->states) {
+    copies[s - tail_begin_] = ofst->AddState();
+  }
+  if (begin_frame != 0 && redet->from_start) {
+    start_state = copies[0];
+  }
+
+  // A chunk is small, so a map is used for the states instead of
+  // Token::lattice_state, which belongs to ExtendRawLattice().
+  std::unordered_map<const Token *, LatticeStateId> states;
+  for (int32_t f = begin_frame; f <= end_frame; ++f) {
+    if (active_toks_[f].toks == nullptr) {
+      KALDI_DECODER_WARN << "GetRawChunk: no tokens active on frame " << f;
+      ofst->DeleteStates();
+      return false;
+    }
+    for (const Token *tok = active_toks_[f].toks; tok != nullptr;
+         tok = tok->next) {
+      LatticeStateId s = ofst->AddState();
+      states[tok] = s;
+      // The start token is the last one of frame 0; see GetRawLattice().
+      if (f == 0) {
+        start_state = s;
+      }
+    }
+  }
+  ofst->SetStart(start_state);
+
+  if (begin_frame != 0) {
+    // The tokens of begin_frame that are still active, by label
+    std::vector<LatticeStateId> boundary_states(
+        boundary_.backward_costs.size(), fst::kNoStateId);
+    for (const Token *tok = active_toks_[begin_frame].toks; tok != nullptr;
+         tok = tok->next) {
+      auto iter = boundary_.labels.find(tok);
+      if (iter != boundary_.labels.end()) {
+        boundary_states[iter->second] = states[tok];
+      }
+    }
+
+    for (LatticeStateId s : redet->states) {
+      LatticeStateId src = copies[s - tail_begin_];
+      for (const CompactArc &arc : determinized_[s].arcs) {
+        if (arc.word < kEndLabelOffset) {
+          AddChain(src, arc.word, arc.weight, arc.ilabels,
+                   copies[arc.nextstate - tail_begin_], ofst);
+          continue;
+        }
+
+        // The paths continue from the token, without the word and the
+        // backward cost that marked it
+        int32_t label = arc.word - kEndLabelOffset;
+        if (boundary_states[label] != fst::kNoStateId) {
+          AddChain(src, 0,
+                   fst::Divide(arc.weight,
+                               Weight(boundary_.backward_costs[label], 0)),
+                   arc.ilabels, boundary_states[label], ofst);
+        }
+      }
+    }
+
+    // The arcs from the other states of determinized_ come after a word
+    // that identifies them and the forward cost of their state.
+    for (size_t i = 0; i != redet->entries.size(); ++i) {
+      const auto &entry = redet->entries[i];
+      const CompactArc &arc = determinized_[entry.first].arcs[entry.second];
+      LatticeStateId s = ofst->AddState();
+      ofst->AddArc(start_state,
+                   Arc(0, kEntryLabelOffset + static_cast<int32_t>(i),
+                       Weight(determinized_[entry.first].forward_cost, 0),
+                       s));
+      AddChain(s, arc.word, arc.weight, arc.ilabels,
+               copies[arc.nextstate - tail_begin_], ofst);
+    }
+  }
+
+  int32_t end_links_frame =
+      (end_boundary != nullptr) ? end_frame : end_frame + 1;
+  for (int32_t f = begin_frame; f < end_links_frame; ++f) {
+    for (const Token *tok = active_toks_[f].toks; tok != nullptr;
+         tok = tok->next) {
+      LatticeStateId s = states[tok];
+      for (const ForwardLink *l = Link(tok->links); l != nullptr;
+           l = Link(l->next)) {
+        if (l->olabel >= kEntryLabelOffset) {
+          KALDI_DECODER_ERR << "LatticeIncrementalDecoder: word " << l->olabel
+                            << " is too large; words must be smaller than "
+                            << kEntryLabelOffset;
+        }
+        auto iter = states.find(Tok(l->next_tok));
+        KALDI_DECODER_ASSERT(iter != states.end());
+        ofst->AddArc(s, Arc(l->ilabel, l->olabel,
+                            Weight(l->graph_cost, l->acoustic_cost),
+                            iter->second));
+      }
+    }
+  }
+
+  if (end_boundary != nullptr) {
+    LatticeStateId final_state = ofst->AddState();
+    ofst->SetFinal(final_state, Weight::One());
+    *end_boundary = ChunkBoundary();
+    int32_t i = 0;
+    for (const Token *tok = active_toks_[end_frame].toks; tok != nullptr;
+         tok = tok->next, ++i) {
+      float backward_cost = tok->extra_cost - tok->tot_cost;
+      end_boundary->labels[tok] = i;
+      end_boundary->backward_costs.push_back(backward_cost);
+      ofst->AddArc(states[tok], Arc(0, kEndLabelOffset + i,
+                                    Weight(backward_cost, 0), final_state));
+    }
+    return true;
+  }
+
+  FinalCostMap final_costs_local;
+  const FinalCostMap &final_costs =
+      (decoding_finalized_ ? final_costs_ : final_costs_local);
+  if (!decoding_finalized_ && use_final_probs) {
+    ComputeFinalCosts(&final_costs_local, nullptr, nullptr);
+  }
+
+  for (const Token *tok = active_toks_[end_frame].toks; tok != nullptr;
+       tok = tok->next) {
+    if (use_final_probs && !final_costs.empty()) {
+      auto iter = final_costs.find(const_cast<Token *>(tok));
+      if (iter != final_costs.end()) {
+        ofst->SetFinal(states[tok], Weight(iter->second, 0));
+      }
+    } else {
+      ofst->SetFinal(states[tok], Weight::One());
+    }
+  }
+
+  return true;
+}
+
+void LatticeIncrementalDecoder::SpliceChunk(
+    const fst::Lattice &chunk, const Redeterminized &redet,
+    std::vector<CompactState> *tail, int32_t *num_kept,
+    std::vector<std::pair<LatticeStateId, std::vector<CompactArc>>> *sources)
+    const {
+  using Arc = fst::LatticeArc;
+  using Weight = Arc::Weight;
+
+  // The states of the chunk in the form of a CompactLattice. Its start state
+  // is the one of the lattice if redet.from_start; otherwise, its arcs are
+  // the entries, each to a state with a single arc, which replaces the arc
+  // of the entry.
+  std::vector<CompactState> chunk_states;
+  std::vector<LatticeStateId> chunk_ids;  // the state of the chunk of each
+  std::unordered_map<LatticeStateId, LatticeStateId> ids;
+  auto get_id = [&chunk_states, &chunk_ids, &ids](LatticeStateId s) {
+    auto p = ids.emplace(s, static_cast<LatticeStateId>(ids.size()));
+    if (p.second) {
+      chunk_states.emplace_back();
+      chunk_ids.push_back(s);
+    }
+    return p.first->second;
+  };
+
+  // The arcs that replace the entries; kNoStateId if they are pruned
+  std::vector<CompactArc> entry_arcs(
+      redet.entries.size(), {0, Weight::Zero(), {}, fst::kNoStateId});
+
+  Weight weight;
+  std::vector<int32_t> ilabels;
+  if (redet.from_start) {
+    get_id(chunk.Start());
+  } else {
+    for (fst::ArcIterator<fst::Lattice> aiter(chunk, chunk.Start());
+         !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      KALDI_DECODER_ASSERT(arc.olabel >= kEntryLabelOffset &&
+                           arc.olabel < kEndLabelOffset);
+      LatticeStateId s = FollowChain(chunk, arc, &weight, &ilabels);
+      if (chunk.NumArcs(s) == 0) {
+        continue;
+      }
+      KALDI_DECODER_ASSERT(chunk.NumArcs(s) == 1 && ilabels.empty());
+
+      // The forward cost on the arc with the entry word is already on the
+      // paths to the state of the entry.
+      const auto &entry = redet.entries[arc.olabel - kEntryLabelOffset];
+      const Arc &next = fst::ArcIterator<fst::Lattice>(chunk, s).Value();
+      CompactArc &entry_arc = entry_arcs[arc.olabel - kEntryLabelOffset];
+      LatticeStateId n =
+          FollowChain(chunk, next, &entry_arc.weight, &entry_arc.ilabels);
+      entry_arc.word = next.olabel;
+      entry_arc.weight = fst::Divide(
+          fst::Times(weight, entry_arc.weight),
+          Weight(determinized_[entry.first].forward_cost, 0));
+      entry_arc.nextstate = get_id(n);
+    }
+  }
+
+  for (size_t k = 0; k != chunk_ids.size(); ++k) {
+    LatticeStateId s = chunk_ids[k];
+    CompactState state;
+    state.final = chunk.Final(s);
+    for (fst::ArcIterator<fst::Lattice> aiter(chunk, s); !aiter.Done();
+         aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      LatticeStateId n = FollowChain(chunk, arc, &weight, &ilabels);
+      if (arc.olabel == 0) {
+        // A chain to a final state, for the input labels of the final
+        // weight
+        KALDI_DECODER_ASSERT(chunk.NumArcs(n) == 0);
+        state.final = fst::Times(weight, chunk.Final(n));
+        state.final_ilabels = ilabels;
+      } else if (arc.olabel >= kEndLabelOffset) {
+        KALDI_DECODER_ASSERT(chunk.Final(n) != Weight::Zero());
+        state.arcs.push_back({arc.olabel, fst::Times(weight, chunk.Final(n)),
+                              ilabels, fst::kNoStateId});
+      } else {
+        KALDI_DECODER_ASSERT(arc.olabel < kEntryLabelOffset);
+        state.arcs.push_back({arc.olabel, weight, ilabels, get_id(n)});
+      }
+    }
+    chunk_states[k] = std::move(state);
+  }
+
+  // The forward costs, in topological order
+  LatticeStateId num_chunk_states =
+      static_cast<LatticeStateId>(chunk_states.size());
+  std::vector<int32_t> num_in_arcs(num_chunk_states, 0);
+  for (const CompactState &state : chunk_states) {
+    for (const CompactArc &arc : state.arcs) {
+      if (arc.nextstate != fst::kNoStateId) {
+        ++num_in_arcs[arc.nextstate];
+      }
+    }
+  }
+
+  std::vector<float> forward_costs(num_chunk_states,
+                                   std::numeric_limits<float>::infinity());
+  if (redet.from_start) {
+    forward_costs[0] = 0;
+  }
+  for (size_t i = 0; i != entry_arcs.size(); ++i) {
+    const CompactArc &arc = entry_arcs[i];
+    if (arc.nextstate != fst::kNoStateId) {
+      float cost = determinized_[redet.entries[i].first].forward_cost +
+                   Cost(arc.weight);
+      forward_costs[arc.nextstate] =
+          std::min(forward_costs[arc.nextstate], cost);
+    }
+  }
+
+  std::vector<LatticeStateId> queue;
+  for (LatticeStateId s = 0; s != num_chunk_states; ++s) {
+    if (num_in_arcs[s] == 0) {
+      queue.push_back(s);
+    }
+  }
+  while (!queue.empty()) {
+    LatticeStateId s = queue.back();
+    queue.pop_back();
+    chunk_states[s].forward_cost = forward_costs[s];
+    for (const CompactArc &arc : chunk_states[s].arcs) {
+      if (arc.nextstate == fst::kNoStateId) {
+        continue;
+      }
+      forward_costs[arc.nextstate] = std::min(
+          forward_costs[arc.nextstate], forward_costs[s] + Cost(arc.weight));
+      if (--num_in_arcs[arc.nextstate] == 0) {
+        queue.push_back(arc.nextstate);
+      }
+    }
+  }
+
+  // The states of the tail that are kept are renumbered from tail_begin_
+  // on, and the states of the chunk come after them.
+  LatticeStateId num_states = static_cast<LatticeStateId>(determinized_.size());
+  std::vector<LatticeStateId> new_ids(num_states - tail_begin_,
+                                      fst::kNoStateId);
+  *num_kept = 0;
+  if (!redet.from_start) {
+    for (LatticeStateId s = tail_begin_; s != num_states; ++s) {
+      if (!redet.is_redeterminized[s - tail_begin_]) {
+        new_ids[s - tail_begin_] = tail_begin_ + (*num_kept)++;
+      }
+    }
+  }
+  LatticeStateId chunk_begin = tail_begin_ + *num_kept;
+
+  std::map<std::pair<LatticeStateId, int32_t>, size_t> entry_indexes;
+  for (size_t i = 0; i != redet.entries.size(); ++i) {
+    entry_indexes[redet.entries[i]] = i;
+  }
+
+  auto update_arcs = [&](LatticeStateId s) {
+    const std::vector<CompactArc> &arcs = determinized_[s].arcs;
+    std::vector<CompactArc> ans;
+    ans.reserve(arcs.size());
+    for (int32_t j = 0; j != static_cast<int32_t>(arcs.size()); ++j) {
+      const CompactArc &arc = arcs[j];
+      if (arc.nextstate < tail_begin_) {
+        ans.push_back(arc);
+      } else if (!redet.is_redeterminized[arc.nextstate - tail_begin_]) {
+        ans.push_back(arc);
+        ans.back().nextstate = new_ids[arc.nextstate - tail_begin_];
+      } else {
+        const CompactArc &entry_arc = entry_arcs[entry_indexes.at({s, j})];
+        if (entry_arc.nextstate != fst::kNoStateId) {
+          ans.push_back(entry_arc);
+          ans.back().nextstate += chunk_begin;
+        }
+      }
+    }
+    return ans;
+  };
+
+  sources->clear();
+  tail->clear();
+  if (!redet.from_start) {
+    for (LatticeStateId s : tail_sources_) {
+      sources->emplace_back(s, update_arcs(s));
+    }
+    for (LatticeStateId s = tail_begin_; s != num_states; ++s) {
+      if (!redet.is_redeterminized[s - tail_begin_]) {
+        CompactState state;
+        state.arcs = update_arcs(s);
+        state.forward_cost = determinized_[s].forward_cost;
+        tail->push_back(std::move(state));
+      }
+    }
+  }
+
+  for (CompactState &state : chunk_states) {
+    for (CompactArc &arc : state.arcs) {
+      if (arc.nextstate != fst::kNoStateId) {
+        arc.nextstate += chunk_begin;
+      }
+    }
+    tail->push_back(std::move(state));
+  }
+}
+
+bool LatticeIncrementalDecoder::GetLattice(fst::Lattice *ofst,
+                                           bool use_final_probs) const {
+  if (decoding_finalized_ && !use_final_probs) {
+    KALDI_DECODER_ERR << "You cannot call FinalizeDecoding() and then call "
+                      << "GetLattice() with use_final_probs == false";
+  }
+
+  ofst->DeleteStates();
+  int32_t num_frames = NumFramesDecoded();
+  KALDI_DECODER_ASSERT(num_frames > 0);
+
+  float lattice_beam = config_.lattice_beam;
+
+  fst::Lattice raw;
+  Redeterminized redet;
+  if (!GetRawChunk(num_frames_determinized_, num_frames, use_final_probs,
+                   nullptr, &redet, &raw)) {
+    return false;
+  }
+
+  if (redet.from_start) {
+    return DeterminizeLattice(raw, ofst, lattice_beam);
+  }
+
+  fst::Lattice chunk;
+  if (!DeterminizeLattice(raw, &chunk, lattice_beam)) {
+    return false;
+  }
+
+  std::vector<CompactState> tail;
+  int32_t num_kept = 0;
+  std::vector<std::pair<LatticeStateId, std::vector<CompactArc>>> sources;
+  SpliceChunk(chunk, redet, &tail, &num_kept, &sources);
+
+  // The states before the tail are output as they are, except for the arcs
+  // of the sources.
+  LatticeStateId num_states =
+      tail_begin_ + static_cast<LatticeStateId>(tail.size());
+  for (LatticeStateId s = 0; s != num_states; ++s) {
+    ofst->AddState();
+  }
+  ofst->SetStart(0);
+
+  auto add_state = [ofst](LatticeStateId s, const CompactState &state,
+                          const std::vector<CompactArc> &arcs) {
+    for (const CompactArc &arc : arcs) {
+      AddChain(s, arc.word, arc.weight, arc.ilabels, arc.nextstate, ofst);
+    }
+
+    if (state.final == fst::LatticeWeight::Zero()) {
+      return;
+    }
+    if (state.final_ilabels.empty()) {
+      ofst->SetFinal(s, state.final);
+    } else {
+      LatticeStateId t = ofst->AddState();
+      ofst->SetFinal(t, fst::LatticeWeight::One());
+      AddChain(s, 0, state.final, state.final_ilabels, t, ofst);
+    }
+  };
+
+  size_t k = 0;
+  for (LatticeStateId s = 0; s != tail_begin_; ++s) {
+    const CompactState &state = determinized_[s];
+    if (k != sources.size() && sources[k].first == s) {
+      add_state(s, state, sources[k++].second);
+    } else {
+      add_state(s, state, state.arcs);
+    }
+  }
+  for (size_t i = 0; i != tail.size(); ++i) {
+    add_state(tail_begin_ + i, tail[i], tail[i].arcs);
+  }
+
+  // States whose arcs to the last chunk have all been pruned have no
+  // successful path.
+  fst::Connect(ofst);
+  return ofst->Start() != fst::kNoStateId;
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,224 @@
+// kaldi-decoder/csrc/lattice-incremental-decoder.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_LATTICE_INCREMENTAL_DECODER_H_
+#define KALDI_DECODER_CSRC_LATTICE_INCREMENTAL_DECODER_H_
+
+#include <cstdint>
+#include <istream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "kaldi-decoder/csrc/lattice-simple-decoder.h"
+
+namespace kaldi_decoder {
+
+struct LatticeIncrementalDecoderConfig {
+  LatticeSimpleDecoderConfig decoder_config;
+
+  // A chunk of frames is determinized once the frames that have been pruned
+  // (see LatticeSimpleDecoderConfig::prune_interval) but not determinized
+  // reach this number. Smaller values make GetLattice() faster at the end of
+  // the utterance, at the cost of more work during decoding.
+  int32_t determinize_max_delay;
+
+  // Minimum number of frames in a chunk. Within the allowed range, the
+  // chunk ends at the frame with the fewest tokens.
+  int32_t determinize_min_chunk_size;
+
+  LatticeIncrementalDecoderConfig(
+      const LatticeSimpleDecoderConfig &decoder_config = {},
+      int32_t determinize_max_delay = 60,
+      int32_t determinize_min_chunk_size = 20)
+      : decoder_config(decoder_config),
+        determinize_max_delay(determinize_max_delay),
+        determinize_min_chunk_size(determinize_min_chunk_size) {}
+
+  void Check() const {
+    decoder_config.Check();
+    KALDI_DECODER_ASSERT(determinize_min_chunk_size > 0 &&
+                         determinize_max_delay >= determinize_min_chunk_size);
+  }
+
+  std::string ToString() const {
+    std::ostringstream os;
+
+    os << "LatticeIncrementalDecoderConfig(";
+    os << "decoder_config=" << decoder_config.ToString() << ", ";
+    os << "determinize_max_delay=" << determinize_max_delay << ", ";
+    os << "determinize_min_chunk_size=" << determinize_min_chunk_size << ")";
+
+    return os.str();
+  }
+};
+
+/** A LatticeSimpleDecoder that determinizes the lattice in chunks while
+    decoding, in the spirit of Kaldi's LatticeIncrementalDecoder, so that the
+    determinized lattice is available shortly after the last frame instead
+    of after a determinization of the whole raw lattice.
+
+    Chunks end at frames that have been pruned already (see
+    LatticeSimpleDecoderConfig::prune_interval). The raw lattice of a chunk
+    ends at the tokens of its last frame, which are marked with special words
+    that identify the token. Paths with the same words can go through
+    different tokens of that frame, so the states of the determinized lattice
+    that lead to these words are not final: as in Kaldi's
+    LatticeIncrementalDeterminizer, they are determinized again with the
+    next chunk, whose raw lattice continues from them. The rest of the
+    determinized lattice is never touched again, so GetLattice() only
+    determinizes the frames after the last chunk and the states before them;
+    the cost of that does not depend on the length of the utterance, only
+    copying the output does.
+
+    Links that are determinized in a chunk are kept even if later pruning
+    removes them from the decoder, so the lattice can have slightly more
+    paths than DeterminizeLattice() of GetRawLattice(); they are outside of
+    the lattice beam in most cases.
+ */
+class LatticeIncrementalDecoder : public LatticeSimpleDecoder {
+ public:
+  LatticeIncrementalDecoder(const fst::Fst<fst::StdArc> &fst,
+                            const LatticeIncrementalDecoderConfig &config);
+
+  // The functions below hide the ones of LatticeSimpleDecoder with the same
+  // names; they also maintain the determinized chunks.
+
+  void InitDecoding();
+
+  void AdvanceDecoding(DecodableInterface *decodable,
+                       int32_t max_num_frames = -1);
+
+  void Reset();
+
+  bool Decode(DecodableInterface *decodable);
+
+  /// Restores the decoding state as LatticeSimpleDecoder::Restore() does.
+  /// The snapshot contains no determinized chunks, so the next call of
+  /// GetLattice() determinizes all the frames.
+  void Restore(std::istream &is);
+
+  /// Outputs the determinized lattice of the frames decoded so far, in the
+  /// format of DeterminizeLattice(), pruned with the lattice beam. It can be
+  /// called between calls of AdvanceDecoding() or after FinalizeDecoding();
+  /// see GetRawLattice() for "use_final_probs". Returns false if the lattice
+  /// is empty.
+  bool GetLattice(fst::Lattice *ofst, bool use_final_probs = true) const;
+
+  /// Returns the number of frames that are in determinized chunks.
+  int32_t NumFramesDeterminized() const { return num_frames_determinized_; }
+
+  const LatticeIncrementalDecoderConfig &GetIncrementalOptions() const {
+    return incremental_config_;
+  }
+
+ private:
+  using LatticeStateId = fst::LatticeArc::StateId;
+
+  // Determinizes chunks while enough frames have been pruned.
+  void DeterminizeChunks();
+
+  // Returns the frame in [begin_frame, end_frame] with the fewest tokens.
+  int32_t FindChunkEnd(int32_t begin_frame, int32_t end_frame) const;
+
+  // The tokens of the last frame of a chunk
+  struct ChunkBoundary {
+    // The word identifying each token is kEndLabelOffset + its label
+    std::unordered_map<const Token *, int32_t> labels;
+
+    // Indexed by label; the extra cost of each token minus its forward cost.
+    // It is put on the arcs with the words so that the paths of a chunk can
+    // be pruned with the lattice beam, and removed when the chunk is
+    // continued.
+    std::vector<float> backward_costs;
+  };
+
+  // An arc of the determinized lattice, i.e., of a CompactLattice: the
+  // chain of arcs that DeterminizeLattice() outputs for it. The arcs to the
+  // last chunk boundary have the word kEndLabelOffset + the label of the
+  // token and no next state.
+  struct CompactArc {
+    int32_t word;
+    fst::LatticeWeight weight;
+    std::vector<int32_t> ilabels;
+    LatticeStateId nextstate;
+  };
+
+  struct CompactState {
+    std::vector<CompactArc> arcs;
+    fst::LatticeWeight final = fst::LatticeWeight::Zero();
+    std::vector<int32_t> final_ilabels;
+
+    // The cost of the best path from the start state
+    float forward_cost = 0;
+  };
+
+  // The states of determinized_ that are determinized again with the next
+  // chunk: those from which an arc to the last chunk boundary can be
+  // reached. They are all in the tail.
+  struct Redeterminized {
+    // Indexed by state - tail_begin_
+    std::vector<uint8_t> is_redeterminized;
+    std::vector<LatticeStateId> states;
+
+    // The arcs from the other states to them, as (state, arc index). In the
+    // raw lattice of the chunk, the start state has an arc with the word
+    // kEntryLabelOffset + i for the i-th of them.
+    std::vector<std::pair<LatticeStateId, int32_t>> entries;
+
+    // True if the start state is determinized again, or if there is no
+    // determinized lattice yet; then the chunk replaces all of it.
+    bool from_start = true;
+  };
+
+  // Outputs the raw lattice of the frames from begin_frame to end_frame,
+  // preceded by the redeterminized states of determinized_, which are
+  // stored in "redet".
+  // If end_boundary is not nullptr, the tokens of end_frame get an arc to a
+  // new final state with the word that identifies them, which is stored in
+  // end_boundary. Otherwise, the links of end_frame are included and the
+  // final-probs are used as for GetRawLattice().
+  bool GetRawChunk(int32_t begin_frame, int32_t end_frame,
+                   bool use_final_probs, ChunkBoundary *end_boundary,
+                   Redeterminized *redet, fst::Lattice *ofst) const;
+
+  // Finds the redeterminized states of determinized_ and their entries
+  void FindRedeterminized(Redeterminized *redet) const;
+
+  // Splices the determinized chunk "chunk" into determinized_ in place of
+  // the redeterminized states. It outputs the states that replace those
+  // from tail_begin_ on: first the ones that are kept, whose number is
+  // num_kept, and then those of the chunk. The states before tail_begin_
+  // whose arcs change, i.e., those in tail_sources_, are output with their
+  // new arcs in "sources".
+  void SpliceChunk(
+      const fst::Lattice &chunk, const Redeterminized &redet,
+      std::vector<CompactState> *tail, int32_t *num_kept,
+      std::vector<std::pair<LatticeStateId, std::vector<CompactArc>>>
+          *sources) const;
+
+  void ResetChunks();
+
+  LatticeIncrementalDecoderConfig incremental_config_;
+
+  // The determinized chunks. It has no final states; its paths end with the
+  // arcs to the tokens of frame num_frames_determinized_.
+  std::vector<CompactState> determinized_;
+  int32_t num_frames_determinized_ = 0;
+
+  // The states from tail_begin_ on are the last determinized chunk, which
+  // contains the redeterminized states. tail_sources_ are the states before
+  // it with arcs to it, in increasing order.
+  LatticeStateId tail_begin_ = 0;
+  std::vector<LatticeStateId> tail_sources_;
+
+  // The tokens on frame num_frames_determinized_
+  ChunkBoundary boundary_;
+};
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_LATTICE_INCREMENTAL_DECODER_H_
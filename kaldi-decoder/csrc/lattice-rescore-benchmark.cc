@@ -0,0 +1,171 @@
+// kaldi-decoder/csrc/lattice-rescore-benchmark.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+// Measures the throughput of LatticeRescorer::RescoreBatch() with 1, 2, 4,
+// ... threads. The lattices are decoded from random log-probs with a
+// unigram graph, and rescored with a random trigram ARPA LM.
+//
+// Usage:
+//   ./bin/lattice-rescore-benchmark [num_utterances] [max_threads]
+//                                   [num_frames] [num_words]
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "kaldi-decoder/csrc/backoff-lm.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/lattice-determinize.h"
+#include "kaldi-decoder/csrc/lattice-rescore.h"
+#include "kaldi-decoder/csrc/lattice-simple-decoder.h"
+#include "kaldi-decoder/csrc/test-utils.h"
+
+namespace kaldi_decoder {
+
+static constexpr float kWordPenalty = 4.0;
+
+// Word i has the input label i and the output label i, with a unigram cost
+// of log(num_words) and a word insertion penalty, which keeps the number of
+// word sequences in the lattices realistic.
+static fst::StdVectorFst BuildGraph(int32_t num_words) {
+  float cost = std::log(static_cast<float>(num_words)) + kWordPenalty;
+  fst::StdVectorFst g;
+  g.AddState();
+  g.SetStart(0);
+  g.SetFinal(0, 0);
+  for (int32_t i = 1; i <= num_words; ++i) {
+    int32_t s = g.AddState();
+    g.AddArc(0, fst::StdArc(i, i, cost, s));
+    g.AddArc(s, fst::StdArc(i, 0, 0.05, s));
+    g.AddArc(s, fst::StdArc(0, 0, 0.2, 0));
+    g.SetFinal(s, 0.5);
+  }
+  return g;
+}
+
+// Returns a random trigram LM in the ARPA format whose words are "w1",
+// "w2", ...
+static std::string BuildArpa(int32_t num_words) {
+  std::mt19937 gen(2023);
+  std::uniform_real_distribution<float> logprob(-3.0, -0.5);
+  std::uniform_real_distribution<float> backoff(-1.0, 0.0);
+  std::uniform_int_distribution<int32_t> word(1, num_words);
+
+  int32_t num_bigrams = num_words * 20;
+  int32_t num_trigrams = num_words * 50;
+
+  std::ostringstream os;
+  os << "\\data\\\n";
+  os << "ngram 1=" << num_words + 2 << "\n";
+  os << "ngram 2=" << num_bigrams << "\n";
+  os << "ngram 3=" << num_trigrams << "\n\n";
+
+  os << "\\1-grams:\n";
+  os << "-1.0\t</s>\n";
+  os << "-99\t<s>\t" << backoff(gen) << "\n";
+  for (int32_t i = 1; i <= num_words; ++i) {
+    os << logprob(gen) << "\tw" << i << "\t" << backoff(gen) << "\n";
+  }
+
+  // Duplicate n-grams overwrite the earlier ones
+  os << "\n\\2-grams:\n";
+  for (int32_t i = 0; i != num_bigrams; ++i) {
+    os << logprob(gen) << "\tw" << word(gen) << " w" << word(gen) << "\t"
+       << backoff(gen) << "\n";
+  }
+
+  os << "\n\\3-grams:\n";
+  for (int32_t i = 0; i != num_trigrams; ++i) {
+    os << logprob(gen) << "\tw" << word(gen) << " w" << word(gen) << " w"
+       << word(gen) << "\n";
+  }
+
+  os << "\n\\end\\\n";
+  return os.str();
+}
+
+static void Run(int32_t num_utterances, int32_t max_threads,
+                int32_t num_frames, int32_t num_words) {
+  fst::StdVectorFst g = BuildGraph(num_words);
+
+  std::unordered_map<std::string, int32_t> symbol_table;
+  for (int32_t i = 1; i <= num_words; ++i) {
+    symbol_table["w" + std::to_string(i)] = i;
+  }
+  std::istringstream is(BuildArpa(num_words));
+  ArpaBackoffLm new_lm(is, symbol_table);
+
+  // The old LM is the unigram of the graph
+  fst::StdVectorFst g_lm;
+  g_lm.AddState();
+  g_lm.SetStart(0);
+  g_lm.SetFinal(0, 0);
+  for (int32_t i = 1; i <= num_words; ++i) {
+    g_lm.AddArc(0, fst::StdArc(i, i, std::log(num_words), 0));
+  }
+  FstBackoffLm old_lm(g_lm);
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<fst::Lattice> lattices(num_utterances);
+  size_t num_arcs = 0;
+  LatticeSimpleDecoder decoder(g, LatticeSimpleDecoderConfig(8.0, 5.0));
+  for (int32_t i = 0; i != num_utterances; ++i) {
+    fst::Lattice &lat = lattices[i];
+    FloatMatrix log_probs =
+        RandnMatrix(num_frames, num_words, 0, 1, /*seed=*/i);
+    DecodableCtc decodable(log_probs);
+    decoder.Decode(&decodable);
+
+    fst::Lattice raw;
+    decoder.GetRawLattice(&raw);
+    DeterminizeLattice(raw, &lat, 5.0);
+    for (int32_t s = 0; s != lat.NumStates(); ++s) {
+      num_arcs += lat.NumArcs(s);
+    }
+  }
+  fprintf(stderr, "Decoded %d utterances of %d frames in %.1f ms\n",
+          num_utterances, num_frames, ElapsedMs(start));
+  fprintf(stderr, "Average lattice: %.1f arcs\n",
+          static_cast<double>(num_arcs) / num_utterances);
+  fprintf(stderr, "New LM: %d states\n", new_lm.NumStates());
+
+  LatticeRescorer rescorer(&old_lm, new_lm, LatticeRescoreOptions());
+  double one_thread_ms = 0;
+  for (int32_t num_threads = 1; num_threads <= max_threads;
+       num_threads *= 2) {
+    std::vector<fst::Lattice> rescored;
+    start = std::chrono::steady_clock::now();
+    rescorer.RescoreBatch(lattices, &rescored, num_threads);
+    double ms = ElapsedMs(start);
+    if (num_threads == 1) {
+      one_thread_ms = ms;
+    }
+
+    fprintf(stderr,
+            "threads: %2d, %.1f ms, %.1f utterances/s, speedup: %.2f\n",
+            num_threads, ms, num_utterances * 1000 / ms, one_thread_ms / ms);
+  }
+}
+
+}  // namespace kaldi_decoder
+
+int main(int argc, char *argv[]) {
+  int32_t num_utterances = argc > 1 ? atoi(argv[1]) : 200;
+  int32_t max_threads =
+      argc > 2 ? atoi(argv[2])
+               : std::max<int32_t>(1, std::thread::hardware_concurrency());
+  int32_t num_frames = argc > 3 ? atoi(argv[3]) : 300;
+  int32_t num_words = argc > 4 ? atoi(argv[4]) : 50;
+  kaldi_decoder::Run(num_utterances, max_threads, num_frames, num_words);
+  return 0;
+}
@@ -0,0 +1,242 @@
+// kaldi-decoder/csrc/lattice-rescore-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/lattice-rescore.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/backoff-lm.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/lattice-determinize.h"
+#include "kaldi-decoder/csrc/lattice-simple-decoder.h"
+#include "kaldi-decoder/csrc/test-utils.h"
+
+namespace kaldi_decoder {
+
+// The old LM: the unigram costs of the graph, as a back-off FST
+static fst::StdVectorFst BuildOldLm(int32_t num_labels) {
+  fst::StdVectorFst g;
+  g.AddState();
+  g.SetStart(0);
+  g.SetFinal(0, 0);
+  for (int32_t i = 1; i <= num_labels; ++i) {
+    g.AddArc(0, fst::StdArc(100 + i, 100 + i, 2 + 0.1 * i, 0));
+  }
+  return g;
+}
+
+// The new LM: a bigram
+static const char *kArpa = R"(
+\data\
+ngram 1=5
+ngram 2=3
+
+\1-grams:
+-0.8	</s>
+-99	<s>	-0.2
+-0.5	w1	-0.3
+-0.6	w2	-0.1
+-0.7	w3
+
+\2-grams:
+-0.1	<s> w2
+-0.2	w1 w2
+-0.4	w2 w1
+
+\end\
+)";
+
+// Returns the cost of a word sequence, or infinity if it is not accepted
+static double LmCost(const DeterministicLm &lm,
+                     const std::vector<int32_t> &words) {
+  double inf = std::numeric_limits<double>::infinity();
+  int32_t state = lm.Start();
+  double ans = 0;
+  for (int32_t w : words) {
+    float cost;
+    if (!lm.GetArc(state, w, &state, &cost)) {
+      return inf;
+    }
+    ans += cost;
+  }
+  return ans + lm.Final(state);
+}
+
+// Returns the best cost of each word sequence of an acyclic lattice
+static std::map<std::vector<int32_t>, double> WordSequences(
+    const fst::Lattice &lat) {
+  std::map<std::vector<int32_t>, double> ans;
+  if (lat.Start() == fst::kNoStateId) {
+    return ans;
+  }
+
+  struct Item {
+    int32_t state;
+    double cost;
+    std::vector<int32_t> words;
+  };
+  std::vector<Item> stack = {{lat.Start(), 0, {}}};
+  while (!stack.empty()) {
+    Item item = std::move(stack.back());
+    stack.pop_back();
+
+    fst::LatticeWeight w = lat.Final(item.state);
+    if (w != fst::LatticeWeight::Zero()) {
+      double cost = item.cost + w.Value1() + w.Value2();
+      auto iter = ans.find(item.words);
+      if (iter == ans.end() || cost < iter->second) {
+        ans[item.words] = cost;
+      }
+    }
+
+    for (fst::ArcIterator<fst::Lattice> aiter(lat, item.state); !aiter.Done();
+         aiter.Next()) {
+      const auto &arc = aiter.Value();
+      Item next = item;
+      next.state = arc.nextstate;
+      next.cost += arc.weight.Value1() + arc.weight.Value2();
+      if (arc.olabel != 0) next.words.push_back(arc.olabel);
+      stack.push_back(std::move(next));
+    }
+  }
+  return ans;
+}
+
+static fst::Lattice DecodeLattice(const fst::StdVectorFst &g,
+                                  int32_t num_frames, int32_t num_labels) {
+  FloatMatrix log_probs = RandnMatrix(num_frames, num_labels);
+  DecodableCtc decodable(log_probs);
+  LatticeSimpleDecoder decoder(g, LatticeSimpleDecoderConfig(6.0, 3.0));
+  decoder.Decode(&decodable);
+
+  fst::Lattice raw, det;
+  decoder.GetRawLattice(&raw);
+  DeterminizeLattice(raw, &det);
+  return det;
+}
+
+class LatticeRescoreTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    std::istringstream is(kArpa);
+    new_lm_ = std::make_unique<ArpaBackoffLm>(
+        is, std::unordered_map<std::string, int32_t>{
+                {"w1", 101}, {"w2", 102}, {"w3", 103}});
+    old_lm_ = std::make_unique<FstBackoffLm>(BuildOldLm(kNumLabels));
+  }
+
+  // Checks that ofst has the word sequences of ifst that the new LM
+  // accepts, within the beam, with the old LM costs replaced by the new
+  // ones.
+  void ExpectRescored(const fst::Lattice &ifst, const fst::Lattice &ofst,
+                      const LatticeRescoreOptions &opts) {
+    std::map<std::vector<int32_t>, double> expected;
+    double best = std::numeric_limits<double>::infinity();
+    for (const auto &p : WordSequences(ifst)) {
+      double new_cost = LmCost(*new_lm_, p.first);
+      if (new_cost == std::numeric_limits<double>::infinity()) {
+        continue;
+      }
+      double cost = p.second + opts.new_lm_scale * new_cost -
+                    opts.old_lm_scale * LmCost(*old_lm_, p.first);
+      expected[p.first] = cost;
+      best = std::min(best, cost);
+    }
+    ASSERT_FALSE(expected.empty());
+
+    auto sequences = WordSequences(ofst);
+    for (const auto &p : expected) {
+      if (p.second <= best + opts.beam - 1e-3) {
+        ASSERT_EQ(sequences.count(p.first), 1);
+        EXPECT_NEAR(sequences[p.first], p.second, 1e-3);
+      }
+    }
+
+    // Pruning keeps the arcs on paths within the beam, so other paths made
+    // of such arcs can be kept too; they still have the right costs.
+    for (const auto &p : sequences) {
+      ASSERT_EQ(expected.count(p.first), 1);
+      EXPECT_NEAR(p.second, expected[p.first], 1e-3);
+    }
+  }
+
+  static constexpr int32_t kNumLabels = 3;
+  std::unique_ptr<ArpaBackoffLm> new_lm_;
+  std::unique_ptr<FstBackoffLm> old_lm_;
+};
+
+TEST_F(LatticeRescoreTest, Rescore) {
+  fst::StdVectorFst g = BuildLoopGraph(kNumLabels, 2);
+  fst::Lattice lat = DecodeLattice(g, 12, kNumLabels);
+
+  for (float beam : {1.0f, 4.0f, 1000.0f}) {
+    LatticeRescoreOptions opts(1.0, 0.5, beam);
+    fst::Lattice rescored;
+    ASSERT_TRUE(RescoreLattice(lat, old_lm_.get(), *new_lm_, opts, &rescored));
+    ExpectRescored(lat, rescored, opts);
+  }
+
+  // Without the old LM, the new LM costs are added to the graph costs
+  LatticeRescoreOptions opts(0.0, 1.0, 1000.0);
+  fst::Lattice rescored;
+  ASSERT_TRUE(RescoreLattice(lat, nullptr, *new_lm_, opts, &rescored));
+  ExpectRescored(lat, rescored, opts);
+}
+
+TEST_F(LatticeRescoreTest, RescoreBatch) {
+  fst::StdVectorFst g = BuildLoopGraph(kNumLabels, 2);
+  std::vector<fst::Lattice> lattices;
+  for (int32_t i = 0; i != 20; ++i) {
+    lattices.push_back(DecodeLattice(g, 5 + i % 7, kNumLabels));
+  }
+
+  LatticeRescorer rescorer(old_lm_.get(), *new_lm_,
+                           LatticeRescoreOptions(1.0, 1.0, 4.0));
+  for (int32_t num_threads : {1, 4}) {
+    std::vector<fst::Lattice> rescored;
+    std::vector<bool> ok = rescorer.RescoreBatch(lattices, &rescored,
+                                                 num_threads);
+    ASSERT_EQ(ok.size(), lattices.size());
+    ASSERT_EQ(rescored.size(), lattices.size());
+
+    for (size_t i = 0; i != lattices.size(); ++i) {
+      fst::Lattice expected;
+      EXPECT_EQ(ok[i], rescorer.Rescore(lattices[i], &expected));
+      EXPECT_EQ(WordSequences(rescored[i]), WordSequences(expected));
+    }
+  }
+}
+
+TEST_F(LatticeRescoreTest, Errors) {
+  using Arc = fst::LatticeArc;
+  using Weight = fst::LatticeWeight;
+
+  // Word 104 is not accepted by the new LM
+  fst::Lattice lat, rescored;
+  for (int32_t i = 0; i != 3; ++i) {
+    lat.AddState();
+  }
+  lat.SetStart(0);
+  lat.AddArc(0, Arc(1, 103, Weight::One(), 1));
+  lat.AddArc(1, Arc(1, 104, Weight::One(), 2));
+  lat.SetFinal(2, Weight::One());
+  EXPECT_FALSE(RescoreLattice(lat, old_lm_.get(), *new_lm_, {}, &rescored));
+  EXPECT_EQ(rescored.NumStates(), 0);
+
+  lat.AddArc(2, Arc(1, 103, Weight::One(), 0));
+  EXPECT_THROW(RescoreLattice(lat, old_lm_.get(), *new_lm_, {}, &rescored),
+               std::runtime_error);
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,366 @@
+// kaldi-decoder/csrc/lattice-rescore.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/lattice-rescore.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <limits>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <utility>
+
+namespace kaldi_decoder {
+
+namespace {
+
+using Weight = fst::LatticeWeight;
+using StateId = fst::LatticeArc::StateId;
+
+inline double Cost(const Weight &w) {
+  return static_cast<double>(w.Value1()) + w.Value2();
+}
+
+// A state of the composition: a state of the lattice and the states of the
+// old and the new LM
+struct Tuple {
+  StateId state;
+  int32_t old_lm_state;
+  int32_t new_lm_state;
+
+  bool operator==(const Tuple &other) const {
+    return state == other.state && old_lm_state == other.old_lm_state &&
+           new_lm_state == other.new_lm_state;
+  }
+};
+
+struct TupleHasher {
+  size_t operator()(const Tuple &t) const {
+    return static_cast<size_t>(t.state) * 7853 +
+           static_cast<size_t>(t.old_lm_state) * 1000003 +
+           static_cast<size_t>(t.new_lm_state);
+  }
+};
+
+class LatticeRescoreComposer {
+ public:
+  LatticeRescoreComposer(const fst::Lattice &ifst,
+                         const DeterministicLm *old_lm,
+                         const DeterministicLm &new_lm,
+                         const LatticeRescoreOptions &opts)
+      : ifst_(ifst), old_lm_(old_lm), new_lm_(new_lm), opts_(opts) {}
+
+  bool Compose(fst::Lattice *ofst) {
+    ofst->DeleteStates();
+    if (!Prepare()) {
+      return false;
+    }
+
+    int32_t old_lm_start = old_lm_ != nullptr ? old_lm_->Start() : 0;
+    FindOrAddState({ifst_.Start(), old_lm_start, new_lm_.Start()}, 0);
+
+    // In topological order, all the states of the composition for a state
+    // of the lattice exist, with their final forward costs, before the
+    // first of them is expanded.
+    for (StateId s : order_) {
+      const std::vector<int32_t> &ids = states_of_[s];
+      if (ids.empty()) {
+        continue;
+      }
+
+      double best = std::numeric_limits<double>::infinity();
+      for (int32_t id : ids) {
+        best = std::min(best, forward_costs_[id]);
+      }
+
+      // They differ only in the LM histories, and the paths from them have
+      // the same costs except for the LM. So the ones much worse than the
+      // best one are unlikely to be on a path within the beam.
+      for (int32_t id : ids) {
+        if (forward_costs_[id] <= best + opts_.beam) {
+          ExpandState(id);
+        }
+      }
+    }
+
+    return Output(ofst);
+  }
+
+ private:
+  // Sorts the states of the input topologically. Returns false if there is
+  // no state.
+  bool Prepare() {
+    StateId num_states = ifst_.NumStates();
+    StateId start = ifst_.Start();
+    if (start == fst::kNoStateId || num_states == 0) {
+      return false;
+    }
+
+    // Iterative depth-first search; order_ holds the states in reverse
+    // topological order until it is reversed.
+    std::vector<int8_t> color(num_states, 0);  // 0: new, 1: open, 2: done
+    std::vector<std::pair<StateId, size_t>> stack = {{start, 0}};
+    color[start] = 1;
+    while (!stack.empty()) {
+      StateId s = stack.back().first;
+      size_t i = stack.back().second++;
+      if (i == ifst_.NumArcs(s)) {
+        color[s] = 2;
+        order_.push_back(s);
+        stack.pop_back();
+        continue;
+      }
+
+      fst::ArcIterator<fst::Lattice> aiter(ifst_, s);
+      aiter.Seek(i);
+      StateId n = aiter.Value().nextstate;
+      if (color[n] == 1) {
+        KALDI_DECODER_ERR << "RescoreLattice: the input lattice has a "
+                          << "cycle at state " << n;
+      }
+      if (color[n] == 0) {
+        color[n] = 1;
+        stack.emplace_back(n, 0);
+      }
+    }
+    std::reverse(order_.begin(), order_.end());
+
+    states_of_.assign(num_states, {});
+
+    return true;
+  }
+
+  // Returns the ID of the state for the tuple, or -1 if it is new and the
+  // maximum number of states has been reached. Updates its forward cost if
+  // forward_cost is better.
+  int32_t FindOrAddState(const Tuple &tuple, double forward_cost) {
+    auto iter = state_map_.find(tuple);
+    if (iter != state_map_.end()) {
+      int32_t id = iter->second;
+      forward_costs_[id] = std::min(forward_costs_[id], forward_cost);
+      return id;
+    }
+
+    if (opts_.max_states > 0 &&
+        static_cast<int32_t>(tuples_.size()) >= opts_.max_states) {
+      return -1;
+    }
+
+    int32_t id = static_cast<int32_t>(tuples_.size());
+    state_map_[tuple] = id;
+    tuples_.push_back(tuple);
+    forward_costs_.push_back(forward_cost);
+    arcs_.emplace_back();
+    finals_.push_back(Weight::Zero());
+    states_of_[tuple.state].push_back(id);
+    return id;
+  }
+
+  void ExpandState(int32_t id) {
+    Tuple tuple = tuples_[id];
+    double forward_cost = forward_costs_[id];
+
+    Weight final_weight = ifst_.Final(tuple.state);
+    if (final_weight != Weight::Zero()) {
+      float new_cost = new_lm_.Final(tuple.new_lm_state);
+      if (new_cost != std::numeric_limits<float>::infinity()) {
+        float old_cost = 0;
+        if (old_lm_ != nullptr) {
+          old_cost = old_lm_->Final(tuple.old_lm_state);
+          if (old_cost == std::numeric_limits<float>::infinity()) {
+            old_cost = 0;
+          }
+        }
+
+        Weight w(final_weight.Value1() + opts_.new_lm_scale * new_cost -
+                     opts_.old_lm_scale * old_cost,
+                 final_weight.Value2());
+        finals_[id] = w;
+      }
+    }
+
+    for (fst::ArcIterator<fst::Lattice> aiter(ifst_, tuple.state);
+         !aiter.Done(); aiter.Next()) {
+      fst::LatticeArc arc = aiter.Value();
+      Tuple next = {arc.nextstate, tuple.old_lm_state, tuple.new_lm_state};
+
+      if (arc.olabel != 0) {
+        float new_cost;
+        if (!new_lm_.GetArc(tuple.new_lm_state, arc.olabel,
+                            &next.new_lm_state, &new_cost)) {
+          continue;
+        }
+
+        float old_cost = 0;
+        if (old_lm_ != nullptr &&
+            !old_lm_->GetArc(tuple.old_lm_state, arc.olabel,
+                             &next.old_lm_state, &old_cost)) {
+          old_cost = 0;
+        }
+
+        arc.weight = Weight(arc.weight.Value1() +
+                                opts_.new_lm_scale * new_cost -
+                                opts_.old_lm_scale * old_cost,
+                            arc.weight.Value2());
+      }
+
+      int32_t next_id =
+          FindOrAddState(next, forward_cost + Cost(arc.weight));
+      if (next_id != -1) {
+        arc.nextstate = next_id;
+        arcs_[id].push_back(arc);
+      }
+    }
+  }
+
+  // Computes the exact forward and backward costs of the composition, which
+  // is acyclic, and outputs its states and arcs within the beam in
+  // topological order.
+  bool Output(fst::Lattice *ofst) const {
+    int32_t num_states = static_cast<int32_t>(tuples_.size());
+    std::vector<int32_t> order;
+    order.reserve(num_states);
+    for (StateId s : order_) {
+      order.insert(order.end(), states_of_[s].begin(), states_of_[s].end());
+    }
+
+    double inf = std::numeric_limits<double>::infinity();
+    std::vector<double> alpha(num_states, inf), beta(num_states, inf);
+    alpha[0] = 0;
+    for (int32_t s : order) {
+      for (const auto &arc : arcs_[s]) {
+        alpha[arc.nextstate] =
+            std::min(alpha[arc.nextstate], alpha[s] + Cost(arc.weight));
+      }
+    }
+
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+      int32_t s = *it;
+      beta[s] = Cost(finals_[s]);
+      for (const auto &arc : arcs_[s]) {
+        beta[s] = std::min(beta[s], Cost(arc.weight) + beta[arc.nextstate]);
+      }
+    }
+
+    double best = beta[0];
+    if (!(best < inf)) {
+      return false;
+    }
+
+    double cutoff = best + opts_.beam;
+    auto keep = [inf, cutoff](double cost) {
+      return cost < inf && cost <= cutoff;
+    };
+
+    std::vector<StateId> state_map(num_states, fst::kNoStateId);
+    for (int32_t s : order) {
+      if (keep(alpha[s] + beta[s])) {
+        state_map[s] = ofst->AddState();
+      }
+    }
+    ofst->SetStart(state_map[0]);
+
+    for (int32_t s : order) {
+      if (state_map[s] == fst::kNoStateId) {
+        continue;
+      }
+
+      if (keep(alpha[s] + Cost(finals_[s]))) {
+        ofst->SetFinal(state_map[s], finals_[s]);
+      }
+
+      for (auto arc : arcs_[s]) {
+        if (keep(alpha[s] + Cost(arc.weight) + beta[arc.nextstate])) {
+          arc.nextstate = state_map[arc.nextstate];
+          ofst->AddArc(state_map[s], arc);
+        }
+      }
+    }
+
+    return true;
+  }
+
+  const fst::Lattice &ifst_;
+  const DeterministicLm *old_lm_;
+  const DeterministicLm &new_lm_;
+  const LatticeRescoreOptions &opts_;
+
+  // The states of the input in topological order
+  std::vector<StateId> order_;
+
+  // For each state of the input, the states of the composition with it
+  std::vector<std::vector<int32_t>> states_of_;
+
+  // Indexed by the states of the composition
+  std::vector<Tuple> tuples_;
+  std::vector<double> forward_costs_;
+  std::vector<std::vector<fst::LatticeArc>> arcs_;
+  std::vector<Weight> finals_;
+
+  std::unordered_map<Tuple, int32_t, TupleHasher> state_map_;
+};
+
+}  // namespace
+
+bool RescoreLattice(const fst::Lattice &ifst, const DeterministicLm *old_lm,
+                    const DeterministicLm &new_lm,
+                    const LatticeRescoreOptions &opts, fst::Lattice *ofst) {
+  opts.Check();
+  LatticeRescoreComposer composer(ifst, old_lm, new_lm, opts);
+  return composer.Compose(ofst);
+}
+
+std::vector<bool> LatticeRescorer::RescoreBatch(
+    const std::vector<fst::Lattice> &ifsts, std::vector<fst::Lattice> *ofsts,
+    int32_t num_threads /*= 1*/) const {
+  KALDI_DECODER_ASSERT(num_threads > 0);
+
+  int32_t num_lattices = static_cast<int32_t>(ifsts.size());
+  ofsts->resize(num_lattices);
+
+  // Not std::vector<bool>, whose elements cannot be written concurrently
+  std::vector<char> ok(num_lattices, 0);
+
+  std::atomic<int32_t> next_index(0);
+  std::exception_ptr error;
+  std::mutex error_mutex;
+
+  auto worker = [&]() {
+    while (true) {
+      int32_t i = next_index++;
+      if (i >= num_lattices) {
+        return;
+      }
+
+      try {
+        ok[i] = Rescore(ifsts[i], &(*ofsts)[i]);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    }
+  };
+
+  num_threads = std::min(num_threads, num_lattices);
+  std::vector<std::thread> threads;
+  for (int32_t i = 1; i < num_threads; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();  // the calling thread is one of the workers
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  return std::vector<bool>(ok.begin(), ok.end());
+}
+
+}  // namespace kaldi_decoder
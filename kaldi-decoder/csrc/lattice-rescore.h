@@ -0,0 +1,142 @@
+// kaldi-decoder/csrc/lattice-rescore.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_LATTICE_RESCORE_H_
+#define KALDI_DECODER_CSRC_LATTICE_RESCORE_H_
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "kaldi-decoder/csrc/deterministic-lm.h"
+#include "kaldi-decoder/csrc/log.h"
+#include "kaldifst/csrc/lattice-weight.h"
+
+namespace kaldi_decoder {
+
+struct LatticeRescoreOptions {
+  // The LM costs of the old LM, i.e., the one in the decoding graph, are
+  // scaled by this value before they are subtracted from the graph costs.
+  float old_lm_scale;
+
+  // The LM costs of the new LM are scaled by this value before they are
+  // added to the graph costs.
+  float new_lm_scale;
+
+  // Pruning beam of the composition: a state of the result is not expanded
+  // if its forward cost is more than "beam" above the best one among the
+  // states with the same lattice state, and the paths more than "beam"
+  // above the best one are removed from the result.
+  float beam;
+
+  // If positive, the composition stops expanding states once the result
+  // has this many states. It bounds the work on huge lattices.
+  int32_t max_states;
+
+  LatticeRescoreOptions(float old_lm_scale = 1.0, float new_lm_scale = 1.0,
+                        float beam = 8.0, int32_t max_states = -1)
+      : old_lm_scale(old_lm_scale),
+        new_lm_scale(new_lm_scale),
+        beam(beam),
+        max_states(max_states) {}
+
+  void Check() const { KALDI_DECODER_ASSERT(beam > 0); }
+
+  std::string ToString() const {
+    std::ostringstream os;
+
+    os << "LatticeRescoreOptions(";
+    os << "old_lm_scale=" << old_lm_scale << ", ";
+    os << "new_lm_scale=" << new_lm_scale << ", ";
+    os << "beam=" << beam << ", ";
+    os << "max_states=" << max_states << ")";
+
+    return os.str();
+  }
+};
+
+/** Rescores an acyclic lattice, e.g., the output of GetRawLattice() or of
+    DeterminizeLattice(), with a new LM: the scores of the old LM are
+    removed from the graph costs of the word arcs and the scores of the new
+    LM are added, as Kaldi's lattice-lmrescore does with a negated old LM
+    and then with the new one.
+
+    The lattice is composed on its output labels with both LMs at once, in
+    topological order of the lattice. The composition is pruned: the states
+    of the result that share a lattice state differ only in their LM
+    histories, and those whose forward cost is beyond the beam of the best
+    of them are not expanded. This is approximate, since a worse history
+    can lead to better LM costs later, but it bounds the number of LM
+    histories per lattice state. The LMs are only queried for the words of
+    the lattice, so they can be much larger than what fits into a decoding
+    graph.
+
+    @param ifst   The input lattice. It must be acyclic; it throws otherwise.
+    @param old_lm The LM whose scores are in the graph costs of ifst. Words
+                  it does not accept keep their graph costs. If it is
+                  nullptr, no scores are subtracted.
+    @param new_lm The new LM. Arcs with words it does not accept are
+                  removed.
+    @param opts   The options.
+    @param ofst   The rescored lattice, whose states are connected. Its
+                  acoustic costs and input labels are those of ifst.
+    @return Returns false if the rescored lattice has no successful path, in
+            which case ofst is empty.
+ */
+bool RescoreLattice(const fst::Lattice &ifst, const DeterministicLm *old_lm,
+                    const DeterministicLm &new_lm,
+                    const LatticeRescoreOptions &opts, fst::Lattice *ofst);
+
+/** Rescores the lattices of many utterances with the same LMs, using
+    several threads. Since the LMs are shared and read-only, a single copy of
+    a large LM serves all the threads.
+
+    \code{.cc}
+      ArpaBackoffLm new_lm(arpa_stream, symbol_table);
+      FstBackoffLm old_lm(g_fst);
+      LatticeRescorer rescorer(&old_lm, new_lm, LatticeRescoreOptions());
+
+      std::vector<fst::Lattice> lattices = ...;  // from GetRawLattice()
+      std::vector<fst::Lattice> rescored;
+      rescorer.RescoreBatch(lattices, &rescored, 8);
+    \endcode
+
+    The LMs must outlive the rescorer.
+ */
+class LatticeRescorer {
+ public:
+  LatticeRescorer(const DeterministicLm *old_lm, const DeterministicLm &new_lm,
+                  const LatticeRescoreOptions &opts)
+      : old_lm_(old_lm), new_lm_(new_lm), opts_(opts) {
+    opts_.Check();
+  }
+
+  /// Rescores one lattice; see RescoreLattice(). It can be called from
+  /// several threads at the same time.
+  bool Rescore(const fst::Lattice &ifst, fst::Lattice *ofst) const {
+    return RescoreLattice(ifst, old_lm_, new_lm_, opts_, ofst);
+  }
+
+  /// Rescores ifsts[i] into (*ofsts)[i] for each i, using "num_threads"
+  /// threads, each of which takes the next lattice when it is done with one.
+  /// If rescoring throws, the first exception is rethrown once all the
+  /// threads have finished.
+  ///
+  /// @return Returns the return values of Rescore() for each lattice.
+  std::vector<bool> RescoreBatch(const std::vector<fst::Lattice> &ifsts,
+                                 std::vector<fst::Lattice> *ofsts,
+                                 int32_t num_threads = 1) const;
+
+  const LatticeRescoreOptions &GetOptions() const { return opts_; }
+
+ private:
+  const DeterministicLm *old_lm_;
+  const DeterministicLm &new_lm_;
+  LatticeRescoreOptions opts_;
+};
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_LATTICE_RESCORE_H_
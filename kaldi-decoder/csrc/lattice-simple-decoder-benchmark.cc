@@ -0,0 +1,65 @@
+// kaldi-decoder/csrc/lattice-simple-decoder-benchmark.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+// Measures the time of LatticeSimpleDecoder::GetRawLattice() on a long
+// utterance. By default, it decodes 60000 frames, i.e., 10 minutes of audio
+// at 100 frames per second.
+//
+// Usage:
+//   ./bin/lattice-simple-decoder-benchmark [num_frames] [num_labels]
+
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstdlib>
+
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/lattice-simple-decoder.h"
+#include "kaldi-decoder/csrc/test-utils.h"
+
+namespace kaldi_decoder {
+
+static void Run(int32_t num_frames, int32_t num_labels) {
+  fst::StdVectorFst g = BuildLoopGraph(num_labels, 0, 0.01, 0);
+  FloatMatrix log_probs = RandnMatrix(num_frames, num_labels, 0, 1, /*seed=*/0);
+  DecodableCtc decodable(log_probs);
+
+  LatticeSimpleDecoder decoder(g, LatticeSimpleDecoderConfig(10.0, 6.0));
+
+  auto start = std::chrono::steady_clock::now();
+  decoder.Decode(&decodable);
+  double decode_ms = ElapsedMs(start);
+
+  const int32_t num_runs = 5;
+  double best_ms = 0;
+  fst::Lattice lat;
+  for (int32_t i = 0; i != num_runs; ++i) {
+    start = std::chrono::steady_clock::now();
+    decoder.GetRawLattice(&lat);
+    double ms = ElapsedMs(start);
+    if (i == 0 || ms < best_ms) {
+      best_ms = ms;
+    }
+  }
+
+  size_t num_arcs = 0;
+  for (int32_t s = 0; s != lat.NumStates(); ++s) {
+    num_arcs += lat.NumArcs(s);
+  }
+
+  fprintf(stderr, "num_frames: %d, num_labels: %d\n", num_frames, num_labels);
+  fprintf(stderr, "Decode: %.1f ms\n", decode_ms);
+  fprintf(stderr, "GetRawLattice: %.1f ms (best of %d), %d states, %zu arcs\n",
+          best_ms, num_runs, lat.NumStates(), num_arcs);
+  fprintf(stderr, "%s\n", decoder.GetMemoryStats().ToString().c_str());
+}
+
+}  // namespace kaldi_decoder
+
+int main(int argc, char *argv[]) {
+  int32_t num_frames = argc > 1 ? atoi(argv[1]) : 60000;
+  int32_t num_labels = argc > 2 ? atoi(argv[2]) : 100;
+  kaldi_decoder::Run(num_frames, num_labels);
+  return 0;
+}
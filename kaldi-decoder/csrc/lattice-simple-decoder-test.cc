@@ -0,0 +1,355 @@
+// kaldi-decoder/csrc/lattice-simple-decoder-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/lattice-simple-decoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/test-utils.h"
+
+namespace kaldi_decoder {
+
+// Computes the forward and backward costs of the states of an acyclic
+// lattice, by relaxing all arcs until nothing changes
+static void ForwardBackward(const fst::Lattice &lat, std::vector<double> *alpha,
+                            std::vector<double> *beta) {
+  int32_t num_states = lat.NumStates();
+  double inf = std::numeric_limits<double>::infinity();
+
+  alpha->assign(num_states, inf);
+  beta->assign(num_states, inf);
+  (*alpha)[lat.Start()] = 0;
+  for (int32_t s = 0; s != num_states; ++s) {
+    fst::LatticeWeight w = lat.Final(s);
+    if (w != fst::LatticeWeight::Zero()) {
+      (*beta)[s] = w.Value1() + w.Value2();
+    }
+  }
+
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (int32_t s = 0; s != num_states; ++s) {
+      for (fst::ArcIterator<fst::Lattice> aiter(lat, s); !aiter.Done();
+           aiter.Next()) {
+        const auto &arc = aiter.Value();
+        double c = arc.weight.Value1() + arc.weight.Value2();
+        if ((*alpha)[s] + c < (*alpha)[arc.nextstate]) {
+          (*alpha)[arc.nextstate] = (*alpha)[s] + c;
+          changed = true;
+        }
+        if (c + (*beta)[arc.nextstate] < (*beta)[s]) {
+          (*beta)[s] = c + (*beta)[arc.nextstate];
+          changed = true;
+        }
+      }
+    }
+  }
+}
+
+// Returns the number of arcs on successful paths and the cost of the best
+// path of an acyclic lattice, which do not depend on how the states are
+// numbered.
+static std::pair<int32_t, double> Summarize(const fst::Lattice &lat) {
+  std::vector<double> alpha, beta;
+  ForwardBackward(lat, &alpha, &beta);
+  double inf = std::numeric_limits<double>::infinity();
+
+  int32_t num_arcs = 0;
+  for (int32_t s = 0; s != lat.NumStates(); ++s) {
+    for (fst::ArcIterator<fst::Lattice> aiter(lat, s); !aiter.Done();
+         aiter.Next()) {
+      if (alpha[s] != inf && beta[aiter.Value().nextstate] != inf) {
+        ++num_arcs;
+      }
+    }
+  }
+  return {num_arcs, beta[lat.Start()]};
+}
+
+// Returns how much worse than the best path the best path through each state
+// of an acyclic lattice is, at most. It is infinite if a state is not on any
+// successful path.
+static double MaxExtraCost(const fst::Lattice &lat) {
+  std::vector<double> alpha, beta;
+  ForwardBackward(lat, &alpha, &beta);
+  double best = beta[lat.Start()];
+
+  double ans = 0;
+  for (int32_t s = 0; s != lat.NumStates(); ++s) {
+    ans = std::max(ans, alpha[s] + beta[s] - best);
+  }
+  return ans;
+}
+
+// FinalizeDecoding() prunes the last frame with the tightened lattice beam
+// of a memory-capped decode too, so that no token off the lattice is kept
+TEST(LatticeSimpleDecoder, FinalizeDecodingMemoryCap) {
+  int32_t num_labels = 4;
+  fst::StdVectorFst g = BuildLoopGraph(num_labels);
+  FloatMatrix log_probs = RandnMatrix(40, num_labels, 0, 1, /*seed=*/0);
+  DecodableCtc decodable(log_probs);
+
+  // Any cap below the memory of the first frame tightens the beams down to
+  // kMinBeamScale
+  LatticeSimpleDecoderConfig config(8.0, 4.0, 10);
+  config.max_mem_bytes = 1;
+
+  LatticeSimpleDecoder decoder(g, config);
+  decoder.Decode(&decodable);
+  EXPECT_EQ(decoder.GetMemoryStats().num_tightened_frames, 39);
+
+  fst::Lattice lat;
+  decoder.GetRawLattice(&lat);
+  EXPECT_LE(MaxExtraCost(lat), config.lattice_beam * kMinBeamScale + 1e-3);
+}
+
+TEST(LatticeSimpleDecoder, ExtendRawLattice) {
+  int32_t num_labels = 4;
+  fst::StdVectorFst g = BuildLoopGraph(num_labels);
+  FloatMatrix log_probs = RandnMatrix(60, num_labels);
+  DecodableCtc decodable(log_probs);
+
+  LatticeSimpleDecoder decoder(g, LatticeSimpleDecoderConfig(8.0, 4.0, 10));
+  decoder.InitDecoding();
+
+  fst::Lattice partial;
+  int32_t num_exported = 0;
+  while (decoder.NumFramesDecoded() < decodable.NumFramesReady()) {
+    decoder.AdvanceDecoding(&decodable, 3);
+
+    int32_t n = decoder.ExtendRawLattice(&partial);
+    EXPECT_GE(n, num_exported);
+    EXPECT_LE(n, decoder.NumFramesDecoded());
+    num_exported = n;
+
+    // It does not disturb GetRawLattice() and vice versa
+    fst::Lattice lat;
+    decoder.GetRawLattice(&lat, false);
+  }
+  EXPECT_GT(num_exported, 40);
+
+  decoder.FinalizeDecoding();
+  EXPECT_EQ(decoder.ExtendRawLattice(&partial),
+            decoder.NumFramesDecoded() + 1);
+
+  fst::Lattice lat;
+  decoder.GetRawLattice(&lat);
+  // It may keep arcs that were pruned after they were exported
+  auto partial_summary = Summarize(partial);
+  auto summary = Summarize(lat);
+  EXPECT_GE(partial.NumStates(), lat.NumStates());
+  EXPECT_GE(partial_summary.first, summary.first);
+  EXPECT_LT(partial_summary.first, summary.first * 1.1);
+  EXPECT_NEAR(partial_summary.second, summary.second, 1e-3);
+
+  // A new utterance starts a new lattice
+  decoder.InitDecoding();
+  decoder.AdvanceDecoding(&decodable, 30);
+  decoder.ExtendRawLattice(&partial);
+  EXPECT_LT(partial.NumStates(), lat.NumStates());
+}
+
+// Returns the (cost, words) of all the successful paths of a small acyclic
+// lattice, best first.
+static std::vector<std::pair<double, std::vector<int32_t>>> AllPaths(
+    const fst::Lattice &lat) {
+  std::vector<std::pair<double, std::vector<int32_t>>> ans;
+
+  struct Item {
+    int32_t state;
+    double cost;
+    std::vector<int32_t> words;
+  };
+  std::vector<Item> stack = {{lat.Start(), 0, {}}};
+  while (!stack.empty()) {
+    Item item = std::move(stack.back());
+    stack.pop_back();
+
+    fst::LatticeWeight w = lat.Final(item.state);
+    if (w != fst::LatticeWeight::Zero()) {
+      ans.emplace_back(item.cost + w.Value1() + w.Value2(), item.words);
+    }
+
+    for (fst::ArcIterator<fst::Lattice> aiter(lat, item.state); !aiter.Done();
+         aiter.Next()) {
+      const auto &arc = aiter.Value();
+      Item next = item;
+      next.state = arc.nextstate;
+      next.cost += arc.weight.Value1() + arc.weight.Value2();
+      if (arc.olabel != 0) next.words.push_back(arc.olabel);
+      stack.push_back(std::move(next));
+    }
+  }
+
+  std::sort(ans.begin(), ans.end());
+  return ans;
+}
+
+TEST(LatticeSimpleDecoder, GetNBest) {
+  int32_t num_labels = 3;
+  fst::StdVectorFst g = BuildLoopGraph(num_labels);
+  FloatMatrix log_probs = RandnMatrix(10, num_labels);
+  DecodableCtc decodable(log_probs);
+
+  LatticeSimpleDecoder decoder(g, LatticeSimpleDecoderConfig(5.0, 2.0));
+  decoder.Decode(&decodable);
+
+  fst::Lattice lat;
+  decoder.GetRawLattice(&lat);
+  auto paths = AllPaths(lat);
+  ASSERT_GT(paths.size(), 10);
+
+  // All paths
+  int32_t n = 10;
+  std::vector<NBestHypothesis> hyps = decoder.GetNBest(n, true, false);
+  ASSERT_EQ(hyps.size(), n);
+  for (int32_t i = 0; i != n; ++i) {
+    EXPECT_NEAR(hyps[i].TotalCost(), paths[i].first, 1e-3);
+    EXPECT_EQ(hyps[i].alignment.size(), decoder.NumFramesDecoded());
+    EXPECT_EQ(hyps[i].words.size(), hyps[i].word_frames.size());
+  }
+
+  // The best path of each word sequence. Paths can have the same cost, so
+  // the words are compared through their costs.
+  std::vector<std::pair<double, std::vector<int32_t>>> unique_paths;
+  std::map<std::vector<int32_t>, double> costs;
+  for (const auto &p : paths) {
+    if (costs.emplace(p.second, p.first).second) {
+      unique_paths.push_back(p);
+    }
+  }
+
+  hyps = decoder.GetNBest(n);
+  ASSERT_EQ(hyps.size(), std::min<size_t>(n, unique_paths.size()));
+  std::set<std::vector<int32_t>> seen;
+  for (size_t i = 0; i != hyps.size(); ++i) {
+    EXPECT_NEAR(hyps[i].TotalCost(), unique_paths[i].first, 1e-3);
+    EXPECT_TRUE(seen.insert(hyps[i].words).second);
+    ASSERT_EQ(costs.count(hyps[i].words), 1);
+    EXPECT_NEAR(costs[hyps[i].words], hyps[i].TotalCost(), 1e-3);
+
+    for (size_t k = 0; k != hyps[i].words.size(); ++k) {
+      int32_t label = hyps[i].words[k] - 100;
+      int32_t frame = hyps[i].word_frames[k];
+      EXPECT_EQ(hyps[i].alignment[frame], label);
+      EXPECT_TRUE(k == 0 || hyps[i].word_frames[k - 1] < frame);
+    }
+  }
+
+  // Asking for more paths than the lattice has
+  hyps = decoder.GetNBest(unique_paths.size() + 5);
+  EXPECT_EQ(hyps.size(), unique_paths.size());
+}
+
+// Returns the posterior of each (frame, word) of a small lattice by
+// enumerating its paths
+static std::map<std::pair<int32_t, int32_t>, double> EnumerateWordPosteriors(
+    const fst::Lattice &lat, float acoustic_scale) {
+  struct Item {
+    int32_t state;
+    int32_t frame;
+    double cost;
+    std::vector<std::pair<int32_t, int32_t>> words;  // (frame, word)
+  };
+
+  std::vector<std::pair<double, std::vector<std::pair<int32_t, int32_t>>>>
+      paths;
+  std::vector<Item> stack = {{lat.Start(), 0, 0, {}}};
+  while (!stack.empty()) {
+    Item item = std::move(stack.back());
+    stack.pop_back();
+
+    fst::LatticeWeight w = lat.Final(item.state);
+    if (w != fst::LatticeWeight::Zero()) {
+      double cost = item.cost + w.Value1() + acoustic_scale * w.Value2();
+      paths.emplace_back(cost, item.words);
+    }
+
+    for (fst::ArcIterator<fst::Lattice> aiter(lat, item.state); !aiter.Done();
+         aiter.Next()) {
+      const auto &arc = aiter.Value();
+      Item next = item;
+      next.state = arc.nextstate;
+      next.cost += arc.weight.Value1() + acoustic_scale * arc.weight.Value2();
+      if (arc.olabel != 0) next.words.emplace_back(item.frame, arc.olabel);
+      if (arc.ilabel != 0) ++next.frame;
+      stack.push_back(std::move(next));
+    }
+  }
+
+  double total = 0;
+  for (const auto &p : paths) {
+    total += std::exp(-p.first);
+  }
+
+  std::map<std::pair<int32_t, int32_t>, double> ans;
+  for (const auto &p : paths) {
+    for (const auto &w : p.second) {
+      ans[w] += std::exp(-p.first) / total;
+    }
+  }
+  return ans;
+}
+
+TEST(LatticeSimpleDecoder, GetWordPosteriors) {
+  int32_t num_labels = 3;
+  fst::StdVectorFst g = BuildLoopGraph(num_labels);
+  FloatMatrix log_probs = RandnMatrix(10, num_labels);
+  DecodableCtc decodable(log_probs);
+
+  LatticeSimpleDecoder decoder(g, LatticeSimpleDecoderConfig(5.0, 2.0));
+  decoder.Decode(&decodable);
+
+  fst::Lattice lat;
+  decoder.GetRawLattice(&lat);
+
+  for (float acoustic_scale : {1.0f, 0.5f}) {
+    auto expected = EnumerateWordPosteriors(lat, acoustic_scale);
+    std::vector<WordPosterior> posteriors =
+        decoder.GetWordPosteriors(acoustic_scale);
+    ASSERT_EQ(posteriors.size(), expected.size());
+    for (const auto &w : posteriors) {
+      auto key = std::make_pair(w.frame, w.word);
+      ASSERT_EQ(expected.count(key), 1);
+      EXPECT_NEAR(w.posterior, expected[key], 1e-4);
+    }
+  }
+
+  std::vector<ConfusionBin> bins = decoder.GetConfusionNetwork();
+  ASSERT_FALSE(bins.empty());
+  for (const auto &bin : bins) {
+    double sum = 0;
+    for (size_t i = 0; i != bin.words.size(); ++i) {
+      sum += bin.words[i].posterior;
+      EXPECT_TRUE(i == 0 ||
+                  bin.words[i - 1].posterior >= bin.words[i].posterior);
+    }
+    EXPECT_NEAR(sum, 1, 1e-4);
+  }
+
+  // Each word of the best path has a bin
+  std::vector<NBestHypothesis> best = decoder.GetNBest(1);
+  ASSERT_EQ(best.size(), 1);
+  for (size_t k = 0; k != best[0].words.size(); ++k) {
+    bool found = false;
+    for (const auto &bin : bins) {
+      for (const auto &w : bin.words) {
+        found |= (w.word == best[0].words[k] &&
+                  std::abs(w.frame - best[0].word_frames[k]) <= 10);
+      }
+    }
+    EXPECT_TRUE(found);
+  }
+}
+
+}  // namespace kaldi_decoder
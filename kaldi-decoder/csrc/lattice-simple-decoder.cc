@@ -10,12 +10,25 @@
 
 #include "kaldi-decoder/csrc/lattice-simple-decoder.h"
 
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "kaldi-decoder/csrc/io-funcs.h"
 #include "kaldi-decoder/csrc/kaldi-math.h"
 
 namespace kaldi_decoder {
 
-void LatticeSimpleDecoder::InitDecoding() {
-  // clean up from last time:
+// Increase it whenever the format written by LatticeSimpleDecoder::Snapshot()
+// changes.
+static constexpr int32_t kLatticeSimpleDecoderSnapshotVersion = 2;
+
+void LatticeSimpleDecoder::Reset() {
   cur_toks_.clear();
   prev_toks_.clear();
   ClearActiveTokens();
@@ -23,10 +36,66 @@ void LatticeSimpleDecoder::InitDecoding() {
   decoding_finalized_ = false;
   final_costs_.clear();
   num_toks_ = 0;
+  num_frames_pruned_ = 0;
+  num_frames_exported_ = 0;
+  num_frames_with_states_ = 0;
+  peak_bytes_ = 0;
+  beam_scale_ = 1;
+  num_tightened_frames_ = 0;
+}
+
+DecoderMemoryStats LatticeSimpleDecoder::GetMemoryStats() const {
+  DecoderMemoryStats stats;
+  stats.token_bytes = token_pool_.NumInUse() * token_pool_.ElemSize();
+  stats.link_bytes = link_pool_.NumInUse() * link_pool_.ElemSize();
+
+  // The buckets of std::unordered_map are arrays of pointers
+  size_t num_buckets = cur_toks_.bucket_count() + prev_toks_.bucket_count() +
+                       final_costs_.bucket_count();
+  stats.hash_bytes = map_pool_.NumInUse() * map_pool_.ElemSize() +
+                     num_buckets * sizeof(void *);
+
+  stats.frame_list_bytes = active_toks_.capacity() * sizeof(TokenList);
+
+  stats.free_bytes =
+      (token_pool_.NumAllocated() - token_pool_.NumInUse()) *
+          token_pool_.ElemSize() +
+      (link_pool_.NumAllocated() - link_pool_.NumInUse()) *
+          link_pool_.ElemSize() +
+      (map_pool_.NumAllocated() - map_pool_.NumInUse()) * map_pool_.ElemSize();
+
+  stats.peak_bytes = std::max(peak_bytes_, stats.LiveBytes());
+  stats.num_tightened_frames = num_tightened_frames_;
+  return stats;
+}
+
+void LatticeSimpleDecoder::UpdateMemoryUsage() {
+  int64_t live_bytes = GetMemoryStats().LiveBytes();
+  peak_bytes_ = std::max(peak_bytes_, live_bytes);
+
+  float prev_beam_scale = beam_scale_;
+  beam_scale_ = UpdateBeamScale(beam_scale_, live_bytes, config_.max_mem_bytes);
+  if (beam_scale_ < prev_beam_scale) {
+    KALDI_DECODER_WARN << "Memory use " << live_bytes << " exceeds "
+                       << config_.max_mem_bytes << " bytes at frame "
+                       << NumFramesDecoded() << ". Tightening the beams to "
+                       << Beam() << " and " << LatticeBeam();
+
+    // Most of the memory is in the lattice of the frames already decoded,
+    // so prune it now with the tighter lattice beam instead of waiting for
+    // the next prune_interval.
+    PruneActiveTokens(LatticeBeam() * config_.prune_scale);
+  }
+}
+
+void LatticeSimpleDecoder::InitDecoding() {
+  // clean up from last time:
+  Reset();
   StateId start_state = fst_.Start();
   KALDI_DECODER_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
-  Token *start_tok = new Token(0.0, 0.0, nullptr, nullptr);
+  int32_t context_state = context_graph_ ? context_graph_->Root() : 0;
+  Token *start_tok = NewToken(0.0, 0.0, nullptr, context_state);
   active_toks_[0].toks = start_tok;
   cur_toks_[start_state] = start_tok;
   num_toks_++;
@@ -39,9 +108,9 @@ void LatticeSimpleDecoder::ClearActiveTokens() {  // a cleanup routine, at utt
     // Delete all tokens alive on this frame, and any forward
     // links they may have.
     for (Token *tok = active_toks_[i].toks; tok != nullptr;) {
-      tok->DeleteForwardLinks();
+      tok->DeleteForwardLinks(&link_pool_);
       Token *next_tok = tok->next;
-      delete tok;
+      token_pool_.Delete(tok->index);
       num_toks_--;
       tok = next_tok;
     }
@@ -54,16 +123,7 @@ bool LatticeSimpleDecoder::Decode(DecodableInterface *decodable) {
   InitDecoding();
 
   while (!decodable->IsLastFrame(NumFramesDecoded() - 1)) {
-    if (NumFramesDecoded() % config_.prune_interval == 0) {
-      PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
-    }
-
-    ProcessEmitting(decodable);
-    // Important to call PruneCurrentTokens before ProcessNonemitting, or we
-    // would get dangling forward pointers.  Anyway, ProcessNonemitting uses the
-    // beam.
-    PruneCurrentTokens(config_.beam, &cur_toks_);
-    ProcessNonemitting();
+    DecodeOneFrame(decodable);
   }
   FinalizeDecoding();
 
@@ -72,6 +132,48 @@ bool LatticeSimpleDecoder::Decode(DecodableInterface *decodable) {
   return !final_costs_.empty();
 }
 
+void LatticeSimpleDecoder::AdvanceDecoding(DecodableInterface *decodable,
+                                           int32_t max_num_frames /*=-1*/) {
+  KALDI_DECODER_ASSERT(!active_toks_.empty() && !decoding_finalized_ &&
+                       "You must call InitDecoding() before AdvanceDecoding");
+
+  int32_t num_frames_ready = decodable->NumFramesReady();
+
+  // num_frames_ready must be >= num_frames_decoded, or else
+  // the number of frames ready must have decreased (which doesn't
+  // make sense) or the decodable object changed between calls
+  // (which isn't allowed).
+  KALDI_DECODER_ASSERT(num_frames_ready >= NumFramesDecoded());
+
+  int32_t target_frames_decoded = num_frames_ready;
+  if (max_num_frames >= 0) {
+    target_frames_decoded =
+        std::min(target_frames_decoded, NumFramesDecoded() + max_num_frames);
+  }
+
+  while (NumFramesDecoded() < target_frames_decoded) {
+    DecodeOneFrame(decodable);
+  }
+}
+
+void LatticeSimpleDecoder::DecodeOneFrame(DecodableInterface *decodable) {
+  if (NumFramesDecoded() % config_.prune_interval == 0) {
+    PruneActiveTokens(LatticeBeam() * config_.prune_scale);
+  }
+
+  if (beam_scale_ < 1) {
+    ++num_tightened_frames_;
+  }
+
+  ProcessEmitting(decodable);
+  // Important to call PruneCurrentTokens before ProcessNonemitting, or we
+  // would get dangling forward pointers.  Anyway, ProcessNonemitting uses the
+  // beam.
+  PruneCurrentTokens(Beam(), &cur_toks_);
+  ProcessNonemitting();
+  UpdateMemoryUsage();
+}
+
 // FindOrAddToken either locates a token in cur_toks_, or if necessary inserts a
 // new, empty token (i.e. with no forward links) for the current frame.  [note:
 // it's inserted if necessary into cur_toks_ and also into the singly linked
@@ -80,8 +182,8 @@ bool LatticeSimpleDecoder::Decode(DecodableInterface *decodable) {
 // Returns the Token pointer.  Sets "changed" (if non-NULL) to true
 // if the token was newly created or the cost changed.
 LatticeSimpleDecoder::Token *LatticeSimpleDecoder::FindOrAddToken(
-    StateId state, int32_t frame, float tot_cost, bool emitting,
-    bool *changed) {
+    StateId state, int32_t frame, float tot_cost, int32_t context_state,
+    bool emitting, bool *changed) {
   KALDI_DECODER_ASSERT(frame < active_toks_.size());
   Token *&toks = active_toks_[frame].toks;
 
@@ -92,7 +194,7 @@ LatticeSimpleDecoder::Token *LatticeSimpleDecoder::FindOrAddToken(
     // tokens on the currently final frame have zero extra_cost
     // as any of them could end up
     // on the winning path.
-    Token *new_tok = new Token(tot_cost, extra_cost, nullptr, toks);
+    Token *new_tok = NewToken(tot_cost, extra_cost, toks, context_state);
     toks = new_tok;
     num_toks_++;
     cur_toks_[state] = new_tok;
@@ -107,6 +209,7 @@ LatticeSimpleDecoder::Token *LatticeSimpleDecoder::FindOrAddToken(
         find_iter->second;  // There is an existing Token for this state.
     if (tok->tot_cost > tot_cost) {
       tok->tot_cost = tot_cost;
+      tok->context_state = context_state;
       if (changed) {
         *changed = true;
       }
@@ -131,7 +234,9 @@ void LatticeSimpleDecoder::ProcessNonemitting() {
   // it may cause us to process states unnecessarily (e.g. more than once),
   // but in the baseline code, turning this vector into a set to fix this
   // problem did not improve overall speed.
-  std::vector<StateId> queue;
+  // queue_ is a class member so that its memory is reused.
+  std::vector<StateId> &queue = queue_;
+  queue.clear();
   float best_cost = std::numeric_limits<float>::infinity();
   for (auto iter = cur_toks_.begin(); iter != cur_toks_.end(); ++iter) {
     StateId state = iter->first;
@@ -151,7 +256,7 @@ void LatticeSimpleDecoder::ProcessNonemitting() {
       warned_ = true;
     }
   }
-  float cutoff = best_cost + config_.beam;
+  float cutoff = best_cost + Beam();
 
   while (!queue.empty()) {
     StateId state = queue.back();
@@ -161,23 +266,22 @@ void LatticeSimpleDecoder::ProcessNonemitting() {
     // because we're about to regenerate them.  This is a kind
     // of non-optimality (remember, this is the simple decoder),
     // but since most states are emitting it's not a huge issue.
-    tok->DeleteForwardLinks();
-    tok->links = nullptr;
+    tok->DeleteForwardLinks(&link_pool_);
     for (fst::ArcIterator<fst::Fst<Arc>> aiter(fst_, state); !aiter.Done();
          aiter.Next()) {
       const Arc &arc = aiter.Value();
       if (arc.ilabel == 0) {  // propagate nonemitting only...
-        float graph_cost = arc.weight.Value();
+        int32_t context_state;
+        float graph_cost = GraphCost(arc, tok, &context_state);
         float cur_cost = tok->tot_cost;
         float tot_cost = cur_cost + graph_cost;
 
         if (tot_cost < cutoff) {
           bool changed;
           Token *new_tok = FindOrAddToken(arc.nextstate, frame + 1, tot_cost,
-                                          false, &changed);
+                                          context_state, false, &changed);
 
-          tok->links = new ForwardLink(new_tok, 0, arc.olabel, graph_cost, 0,
-                                       tok->links);
+          AddLink(tok, new_tok, 0, arc.olabel, graph_cost, 0);
 
           // "changed" tells us whether the new token has a different
           // cost from before, or is new [if so, add into queue].
@@ -220,6 +324,8 @@ void LatticeSimpleDecoder::PruneActiveTokens(float delta) {
   }
   KALDI_DECODER_LOG << "PruneActiveTokens: pruned tokens from "
                     << num_toks_begin << " to " << num_toks_;
+
+  num_frames_pruned_ = cur_frame_plus_one;
 }
 
 // delta is the amount by which the extra_costs must
@@ -251,9 +357,9 @@ void LatticeSimpleDecoder::PruneForwardLinks(int32_t frame,
       ForwardLink *link, *prev_link = nullptr;
       // will recompute tok_extra_cost.
       float tok_extra_cost = std::numeric_limits<float>::infinity();
-      for (link = tok->links; link != nullptr;) {
+      for (link = Link(tok->links); link != nullptr;) {
         // See if we need to excise this link...
-        Token *next_tok = link->next_tok;
+        const Token *next_tok = Tok(link->next_tok);
         float link_extra_cost =
             next_tok->extra_cost +
             ((tok->tot_cost + link->acoustic_cost + link->graph_cost) -
@@ -261,16 +367,13 @@ void LatticeSimpleDecoder::PruneForwardLinks(int32_t frame,
         KALDI_DECODER_ASSERT(link_extra_cost ==
                              link_extra_cost);  // check for NaN
 
-        if (link_extra_cost > config_.lattice_beam) {  // excise link
-          ForwardLink *next_link = link->next;
-          if (prev_link != nullptr) {
-            prev_link->next = next_link;
-          } else {
-            tok->links = next_link;
-          }
-
-          delete link;
-          link = next_link;  // advance link but leave prev_link the same.
+        if (link_extra_cost > LatticeBeam()) {  // excise link
+          // The index of link, in the previous link or in tok
+          uint32_t &index = prev_link != nullptr ? prev_link->next : tok->links;
+          uint32_t next_link = link->next;
+          link_pool_.Delete(index);
+          index = next_link;
+          link = Link(next_link);  // advance link but leave prev_link the same.
           *links_pruned = true;
         } else {  // keep the link and update the tok_extra_cost if needed.
           if (link_extra_cost < 0.0) {  // this is just a precaution.
@@ -284,7 +387,7 @@ void LatticeSimpleDecoder::PruneForwardLinks(int32_t frame,
           }
 
           prev_link = link;
-          link = link->next;
+          link = Link(link->next);
         }
       }
       if (fabs(tok_extra_cost - tok->extra_cost) > delta) {
@@ -325,7 +428,7 @@ void LatticeSimpleDecoder::PruneTokensForFrame(int32_t frame) {
       } else {
         toks = tok->next;
       }
-      delete tok;
+      token_pool_.Delete(tok->index);
       num_toks_--;
     } else {
       prev_tok = tok;
@@ -336,8 +439,7 @@ void LatticeSimpleDecoder::PruneTokensForFrame(int32_t frame) {
 // PruneCurrentTokens deletes the tokens from the "toks" map, but not
 // from the active_toks_ list, which could cause dangling forward pointers
 // (will delete it during regular pruning operation).
-void LatticeSimpleDecoder::PruneCurrentTokens(
-    float beam, std::unordered_map<StateId, Token *> *toks) {
+void LatticeSimpleDecoder::PruneCurrentTokens(float beam, TokenMap *toks) {
   if (toks->empty()) {
     KALDI_DECODER_LOG << "No tokens to prune.\n";
     return;
@@ -346,19 +448,17 @@ void LatticeSimpleDecoder::PruneCurrentTokens(
   for (auto iter = toks->begin(); iter != toks->end(); ++iter) {
     best_cost = std::min(best_cost, static_cast<float>(iter->second->tot_cost));
   }
-  std::vector<StateId> retained;
+  // Erase in place rather than building a new map, so that the buckets of
+  // the map are reused from frame to frame.
   float cutoff = best_cost + beam;
-  for (auto iter = toks->begin(); iter != toks->end(); ++iter) {
+  for (auto iter = toks->begin(); iter != toks->end();) {
     if (iter->second->tot_cost < cutoff) {
-      retained.push_back(iter->first);
+      ++iter;
+    } else {
+      iter = toks->erase(iter);
     }
   }
-  std::unordered_map<StateId, Token *> tmp;
-  for (size_t i = 0; i < retained.size(); i++) {
-    tmp[retained[i]] = (*toks)[retained[i]];
-  }
-  KALDI_DECODER_LOG << "Pruned to " << (retained.size()) << " toks.\n";
-  tmp.swap(*toks);
+  // KALDI_DECODER_LOG << "Pruned to " << toks->size() << " toks.\n";
 }
 
 void LatticeSimpleDecoder::ProcessEmitting(DecodableInterface *decodable) {
@@ -380,22 +480,23 @@ void LatticeSimpleDecoder::ProcessEmitting(DecodableInterface *decodable) {
          aiter.Next()) {
       const Arc &arc = aiter.Value();
       if (arc.ilabel != 0) {  // propagate..
+        int32_t context_state;
         float ac_cost = -decodable->LogLikelihood(frame, arc.ilabel),
-              graph_cost = arc.weight.Value(), cur_cost = tok->tot_cost,
+              graph_cost = GraphCost(arc, tok, &context_state),
+              cur_cost = tok->tot_cost,
               tot_cost = cur_cost + ac_cost + graph_cost;
         if (tot_cost >= cutoff) {
           continue;
-        } else if (tot_cost + config_.beam < cutoff) {
-          cutoff = tot_cost + config_.beam;
+        } else if (tot_cost + Beam() < cutoff) {
+          cutoff = tot_cost + Beam();
         }
 
         // AddToken adds the next_tok to cur_toks_ (if not already present).
-        Token *next_tok =
-            FindOrAddToken(arc.nextstate, frame + 1, tot_cost, true, NULL);
+        Token *next_tok = FindOrAddToken(arc.nextstate, frame + 1, tot_cost,
+                                         context_state, true, NULL);
 
         // Add ForwardLink from tok to next_tok (put on head of list tok->links)
-        tok->links = new ForwardLink(next_tok, arc.ilabel, arc.olabel,
-                                     graph_cost, ac_cost, tok->links);
+        AddLink(tok, next_tok, arc.ilabel, arc.olabel, graph_cost, ac_cost);
       }
     }
   }
@@ -468,22 +569,20 @@ void LatticeSimpleDecoder::PruneForwardLinksFinal() {
       // tok_extra_cost will be a "min" over either directly being final, or
       // being indirectly final through other links, and the loop below may
       // decrease its value:
-      for (link = tok->links; link != nullptr;) {
+      for (link = Link(tok->links); link != nullptr;) {
         // See if we need to excise this link...
-        Token *next_tok = link->next_tok;
+        const Token *next_tok = Tok(link->next_tok);
         float link_extra_cost =
             next_tok->extra_cost +
             ((tok->tot_cost + link->acoustic_cost + link->graph_cost) -
              next_tok->tot_cost);
-        if (link_extra_cost > config_.lattice_beam) {  // excise link
-          ForwardLink *next_link = link->next;
-          if (prev_link != nullptr) {
-            prev_link->next = next_link;
-          } else {
-            tok->links = next_link;
-          }
-          delete link;
-          link = next_link;  // advance link but leave prev_link the same.
+        if (link_extra_cost > LatticeBeam()) {  // excise link
+          // The index of link, in the previous link or in tok
+          uint32_t &index = prev_link != nullptr ? prev_link->next : tok->links;
+          uint32_t next_link = link->next;
+          link_pool_.Delete(index);
+          index = next_link;
+          link = Link(next_link);  // advance link but leave prev_link the same.
         } else {  // keep the link and update the tok_extra_cost if needed.
           if (link_extra_cost < 0.0) {  // this is just a precaution.
             if (link_extra_cost < -0.01) {
@@ -497,14 +596,14 @@ void LatticeSimpleDecoder::PruneForwardLinksFinal() {
           }
 
           prev_link = link;
-          link = link->next;
+          link = Link(link->next);
         }
       }
       // prune away tokens worse than lattice_beam above best path.  This step
       // was not necessary in the non-final case because then, this case
       // showed up as having no forward links.  Here, the tok_extra_cost has
       // an extra component relating to the final-prob.
-      if (tok_extra_cost > config_.lattice_beam) {
+      if (tok_extra_cost > LatticeBeam()) {
         tok_extra_cost = std::numeric_limits<float>::infinity();
       }
       // to be pruned in PruneTokensForFrame
@@ -520,7 +619,7 @@ void LatticeSimpleDecoder::PruneForwardLinksFinal() {
 }
 
 void LatticeSimpleDecoder::ComputeFinalCosts(
-    std::unordered_map<Token *, float> *final_costs, float *final_relative_cost,
+    FinalCostMap *final_costs, float *final_relative_cost,
     float *final_best_cost) const {
   KALDI_DECODER_ASSERT(!decoding_finalized_);
   if (final_costs != nullptr) {
@@ -534,6 +633,10 @@ void LatticeSimpleDecoder::ComputeFinalCosts(
     StateId state = iter->first;
     Token *tok = iter->second;
     float final_cost = fst_.Final(state).Value();
+    if (context_graph_ != nullptr && final_cost != infinity) {
+      // take back the bonus of a partially matched context phrase
+      final_cost += context_graph_->Finalize(tok->context_state);
+    }
     float cost = tok->tot_cost, cost_with_final = cost + final_cost;
     best_cost = std::min(cost, best_cost);
     best_cost_with_final = std::min(cost_with_final, best_cost_with_final);
@@ -586,7 +689,6 @@ bool LatticeSimpleDecoder::GetRawLattice(fst::Lattice *ofst,
   using Arc = fst::LatticeArc;
   using StateId = Arc::StateId;
   using Weight = Arc::Weight;
-  using Label = Arc::Label;
 
   // Note: you can't use the old interface (Decode()) if you want to
   // get the lattice with use_final_probs = false.  You'd have to do
@@ -596,9 +698,9 @@ bool LatticeSimpleDecoder::GetRawLattice(fst::Lattice *ofst,
                       << "GetRawLattice() with use_final_probs == false";
   }
 
-  std::unordered_map<Token *, float> final_costs_local;
+  FinalCostMap final_costs_local;
 
-  const std::unordered_map<Token *, float> &final_costs =
+  const FinalCostMap &final_costs =
       (decoding_finalized_ ? final_costs_ : final_costs_local);
 
   if (!decoding_finalized_ && use_final_probs) {
@@ -608,9 +710,21 @@ bool LatticeSimpleDecoder::GetRawLattice(fst::Lattice *ofst,
   ofst->DeleteStates();
   int32_t num_frames = NumFramesDecoded();
   KALDI_DECODER_ASSERT(num_frames > 0);
-  const int32_t bucket_count = num_toks_ / 2 + 3;
-  std::unordered_map<Token *, StateId> tok_map(bucket_count);
-  // First create all states.
+
+  // The numbering below overwrites the states that ExtendRawLattice() has
+  // given to the tokens of its next frame; they are restored at the end.
+  std::vector<StateId> partial_states;
+  if (num_frames_with_states_ > num_frames_exported_) {
+    for (const Token *tok = active_toks_[num_frames_exported_].toks;
+         tok != nullptr; tok = tok->next) {
+      partial_states.push_back(tok->lattice_state);
+    }
+  }
+
+  // First number the tokens frame by frame, so that the lattice states can
+  // be created in one go and each link can find its next state in its token.
+  StateId num_states = 0;
+  StateId start_state = fst::kNoStateId;
   for (int32_t f = 0; f <= num_frames; f++) {
     if (active_toks_[f].toks == nullptr) {
       KALDI_DECODER_WARN << "GetRawLattice: no tokens active on frame " << f
@@ -618,25 +732,37 @@ bool LatticeSimpleDecoder::GetRawLattice(fst::Lattice *ofst,
       return false;
     }
     for (Token *tok = active_toks_[f].toks; tok != nullptr; tok = tok->next) {
-      tok_map[tok] = ofst->AddState();
+      tok->lattice_state = num_states++;
     }
-    // The next statement sets the start state of the output FST.
-    // Because we always add new states to the head of the list
-    // active_toks_[f].toks, and the start state was the first one
-    // added, it will be the last one added to ofst.
-    if (f == 0 && ofst->NumStates() > 0) {
-      ofst->SetStart(ofst->NumStates() - 1);
+    // Because we always add new tokens to the head of the list
+    // active_toks_[f].toks, and the start token was the first one added, it
+    // is the last one numbered.
+    if (f == 0) {
+      start_state = num_states - 1;
     }
   }
-  StateId cur_state = 0;  // we rely on the fact that we numbered these
-  // consecutively (AddState() returns the numbers in order..)
+
+  ofst->ReserveStates(num_states);
+  for (StateId s = 0; s != num_states; ++s) {
+    ofst->AddState();
+  }
+  ofst->SetStart(start_state);
+
+  StateId cur_state = 0;  // the tokens are visited in the order numbered above
   for (int32_t f = 0; f <= num_frames; f++) {
     for (Token *tok = active_toks_[f].toks; tok != nullptr;
          tok = tok->next, cur_state++) {
-      for (ForwardLink *l = tok->links; l != nullptr; l = l->next) {
-        auto iter = tok_map.find(l->next_tok);
-        StateId nextstate = iter->second;
-        KALDI_DECODER_ASSERT(iter != tok_map.end());
+      size_t num_arcs = 0;
+      for (const ForwardLink *l = Link(tok->links); l != nullptr;
+           l = Link(l->next)) {
+        ++num_arcs;
+      }
+      ofst->ReserveArcs(cur_state, num_arcs);
+
+      for (const ForwardLink *l = Link(tok->links); l != nullptr;
+           l = Link(l->next)) {
+        StateId nextstate = Tok(l->next_tok)->lattice_state;
+        KALDI_DECODER_ASSERT(nextstate >= 0 && nextstate < num_states);
         Arc arc(l->ilabel, l->olabel, Weight(l->graph_cost, l->acoustic_cost),
                 nextstate);
         ofst->AddArc(cur_state, arc);
@@ -653,7 +779,805 @@ bool LatticeSimpleDecoder::GetRawLattice(fst::Lattice *ofst,
     }
   }
   KALDI_DECODER_ASSERT(cur_state == ofst->NumStates());
+
+  if (!partial_states.empty()) {
+    auto iter = partial_states.begin();
+    for (Token *tok = active_toks_[num_frames_exported_].toks; tok != nullptr;
+         tok = tok->next) {
+      tok->lattice_state = *iter++;
+    }
+  }
+
   return (cur_state != 0);
 }
 
+std::vector<NBestHypothesis> LatticeSimpleDecoder::GetNBest(
+    int32_t n, bool use_final_probs /*= true*/,
+    bool unique_word_sequences /*= true*/) const {
+  if (decoding_finalized_ && !use_final_probs) {
+    KALDI_DECODER_ERR << "You cannot call FinalizeDecoding() and then call "
+                      << "GetNBest() with use_final_probs == false";
+  }
+
+  std::vector<NBestHypothesis> ans;
+  int32_t num_frames = NumFramesDecoded();
+  if (n <= 0 || num_frames < 0 || active_toks_[0].toks == nullptr) {
+    return ans;
+  }
+
+  FinalCostMap final_costs_local;
+  const FinalCostMap &final_costs =
+      (decoding_finalized_ ? final_costs_ : final_costs_local);
+  if (!decoding_finalized_ && use_final_probs) {
+    ComputeFinalCosts(&final_costs_local, nullptr, nullptr);
+  }
+
+  double infinity = std::numeric_limits<double>::infinity();
+  auto final_cost = [&](const Token *tok) -> double {
+    if (!use_final_probs || final_costs.empty()) {
+      return 0;
+    }
+    auto iter = final_costs.find(const_cast<Token *>(tok));
+    return iter == final_costs.end() ? infinity : iter->second;
+  };
+
+  // The cost of the best path from each token to the end. Frames are
+  // visited backward; within a frame, the input-epsilon links are relaxed
+  // until nothing changes, as in PruneForwardLinks().
+  std::unordered_map<const Token *, double> backward_costs;
+  for (int32_t f = num_frames; f >= 0; --f) {
+    for (const Token *tok = active_toks_[f].toks; tok != nullptr;
+         tok = tok->next) {
+      backward_costs[tok] = (f == num_frames) ? final_cost(tok) : infinity;
+    }
+
+    for (bool changed = true; changed;) {
+      changed = false;
+      for (const Token *tok = active_toks_[f].toks; tok != nullptr;
+           tok = tok->next) {
+        double &cost = backward_costs[tok];
+        for (const ForwardLink *l = Link(tok->links); l != nullptr;
+             l = Link(l->next)) {
+          auto iter = backward_costs.find(Tok(l->next_tok));
+          if (iter == backward_costs.end()) {
+            continue;  // the link points past the frames decoded
+          }
+          double c = l->graph_cost + l->acoustic_cost + iter->second;
+          if (c < cost) {
+            cost = c;
+            changed = true;
+          }
+        }
+      }
+    }
+  }
+
+  // Partial paths form a tree; each node is a path that ends at tok, or
+  // a complete path if tok is nullptr. Since the backward costs are exact,
+  // paths are popped from the queue in the order of their total costs.
+  struct Node {
+    const Token *tok;
+    const ForwardLink *link;  // the last link of the path
+    int32_t parent;
+    int32_t frame;
+    int32_t prefix;  // id of the word sequence so far
+    double graph_cost;
+    double acoustic_cost;
+  };
+  std::vector<Node> nodes;
+  using QueueItem = std::pair<double, int32_t>;  // (total cost, node)
+  std::priority_queue<QueueItem, std::vector<QueueItem>,
+                      std::greater<QueueItem>>
+      queue;
+
+  // The start token is the last one of frame 0; see GetRawLattice().
+  const Token *start = active_toks_[0].toks;
+  while (start->next != nullptr) {
+    start = start->next;
+  }
+  if (backward_costs[start] == infinity) {
+    return ans;
+  }
+  nodes.push_back({start, nullptr, -1, 0, 0, 0, 0});
+  queue.emplace(backward_costs[start], 0);
+
+  // Word sequences are numbered as the nodes of a trie; 0 is the empty one.
+  std::unordered_map<uint64_t, int32_t> prefixes;
+  auto extend_prefix = [&prefixes](int32_t prefix, Label word) {
+    uint64_t key = (static_cast<uint64_t>(prefix) << 32) |
+                   static_cast<uint32_t>(word);
+    auto iter = prefixes.find(key);
+    if (iter != prefixes.end()) {
+      return iter->second;
+    }
+    int32_t id = static_cast<int32_t>(prefixes.size()) + 1;
+    prefixes.emplace(key, id);
+    return id;
+  };
+
+  // (token, word sequence) pairs that have been expanded
+  std::unordered_set<uint64_t> expanded;
+  std::unordered_map<const Token *, int32_t> token_ids;
+
+  while (!queue.empty() && static_cast<int32_t>(ans.size()) < n) {
+    int32_t id = queue.top().second;
+    queue.pop();
+    Node node = nodes[id];
+
+    if (unique_word_sequences) {
+      // The first path popped is the best one with these words from here
+      auto iter = token_ids.emplace(node.tok, token_ids.size()).first;
+      uint64_t key = (static_cast<uint64_t>(iter->second) << 32) |
+                     static_cast<uint32_t>(node.prefix);
+      if (!expanded.insert(key).second) {
+        continue;
+      }
+    }
+
+    if (node.tok == nullptr) {
+      NBestHypothesis hyp;
+      hyp.graph_cost = node.graph_cost;
+      hyp.acoustic_cost = node.acoustic_cost;
+      hyp.alignment.resize(num_frames);
+      for (int32_t i = nodes[id].parent; nodes[i].link != nullptr;
+           i = nodes[i].parent) {
+        const Node &m = nodes[i];
+        const ForwardLink *l = m.link;
+        int32_t frame = nodes[m.parent].frame;
+        if (l->olabel != 0) {
+          hyp.words.push_back(l->olabel);
+          hyp.word_frames.push_back(frame);
+        }
+        if (l->ilabel != 0) {
+          hyp.alignment[frame] = l->ilabel;
+        }
+      }
+      std::reverse(hyp.words.begin(), hyp.words.end());
+      std::reverse(hyp.word_frames.begin(), hyp.word_frames.end());
+      ans.push_back(std::move(hyp));
+      continue;
+    }
+
+    if (node.frame == num_frames) {
+      double c = final_cost(node.tok);
+      if (c != infinity) {
+        nodes.push_back({nullptr, nullptr, id, node.frame, node.prefix,
+                         node.graph_cost + c, node.acoustic_cost});
+        queue.emplace(node.graph_cost + c + node.acoustic_cost,
+                      nodes.size() - 1);
+      }
+    }
+
+    for (const ForwardLink *l = Link(node.tok->links); l != nullptr;
+         l = Link(l->next)) {
+      auto iter = backward_costs.find(Tok(l->next_tok));
+      if (iter == backward_costs.end() || iter->second == infinity) {
+        continue;
+      }
+      Node next = {Tok(l->next_tok),
+                   l,
+                   id,
+                   node.frame + (l->ilabel != 0 ? 1 : 0),
+                   l->olabel != 0 ? extend_prefix(node.prefix, l->olabel)
+                                  : node.prefix,
+                   node.graph_cost + l->graph_cost,
+                   node.acoustic_cost + l->acoustic_cost};
+      nodes.push_back(next);
+      queue.emplace(next.graph_cost + next.acoustic_cost + iter->second,
+                    nodes.size() - 1);
+    }
+  }
+
+  return ans;
+}
+
+std::vector<WordPosterior> LatticeSimpleDecoder::GetWordPosteriors(
+    float acoustic_scale /*= 1.0*/, bool use_final_probs /*= true*/) const {
+  std::vector<WordPosterior> ans;
+  ForwardBackward(acoustic_scale, use_final_probs, &ans, nullptr);
+  return ans;
+}
+
+std::vector<ConfusionBin> LatticeSimpleDecoder::GetConfusionNetwork(
+    const ConfusionNetworkOptions &opts /*= {}*/,
+    bool use_final_probs /*= true*/) const {
+  opts.Check();
+  std::vector<WordPosterior> posteriors, best_path;
+  ForwardBackward(opts.acoustic_scale, use_final_probs, &posteriors,
+                  &best_path);
+  return BuildConfusionNetwork(posteriors, best_path, opts);
+}
+
+void LatticeSimpleDecoder::ForwardBackward(
+    float acoustic_scale, bool use_final_probs,
+    std::vector<WordPosterior> *posteriors,
+    std::vector<WordPosterior> *best_path) const {
+  if (decoding_finalized_ && !use_final_probs) {
+    KALDI_DECODER_ERR << "You cannot call FinalizeDecoding() and then call "
+                      << "GetWordPosteriors() with use_final_probs == false";
+  }
+
+  posteriors->clear();
+  if (best_path != nullptr) {
+    best_path->clear();
+  }
+
+  int32_t num_frames = NumFramesDecoded();
+  if (num_frames < 0 || active_toks_[0].toks == nullptr) {
+    return;
+  }
+
+  FinalCostMap final_costs_local;
+  const FinalCostMap &final_costs =
+      (decoding_finalized_ ? final_costs_ : final_costs_local);
+  if (!decoding_finalized_ && use_final_probs) {
+    ComputeFinalCosts(&final_costs_local, nullptr, nullptr);
+  }
+
+  double infinity = std::numeric_limits<double>::infinity();
+  auto final_cost = [&](const Token *tok) -> double {
+    if (!use_final_probs || final_costs.empty()) {
+      return 0;
+    }
+    auto iter = final_costs.find(const_cast<Token *>(tok));
+    return iter == final_costs.end() ? infinity : iter->second;
+  };
+
+  // Sort the tokens topologically: frame by frame and, within a frame, in
+  // the order of the input-epsilon links between them, so that all the
+  // links of a token go to tokens after it.
+  std::unordered_map<const Token *, int32_t> index;
+  std::vector<const Token *> toks;
+  std::vector<int32_t> frames;
+  for (int32_t f = 0; f <= num_frames; ++f) {
+    int32_t begin = static_cast<int32_t>(toks.size());
+    std::vector<const Token *> frame_toks;
+    for (const Token *tok = active_toks_[f].toks; tok != nullptr;
+         tok = tok->next) {
+      index[tok] = begin + static_cast<int32_t>(frame_toks.size());
+      frame_toks.push_back(tok);
+    }
+
+    std::vector<int32_t> in_degree(frame_toks.size(), 0);
+    for (const Token *tok : frame_toks) {
+      for (const ForwardLink *l = Link(tok->links); l != nullptr;
+           l = Link(l->next)) {
+        if (l->ilabel == 0) {
+          ++in_degree[index[Tok(l->next_tok)] - begin];
+        }
+      }
+    }
+
+    std::vector<const Token *> queue;
+    for (size_t i = 0; i != frame_toks.size(); ++i) {
+      if (in_degree[i] == 0) {
+        queue.push_back(frame_toks[i]);
+      }
+    }
+    for (size_t i = 0; i != queue.size(); ++i) {
+      for (const ForwardLink *l = Link(queue[i]->links); l != nullptr;
+           l = Link(l->next)) {
+        if (l->ilabel == 0 &&
+            --in_degree[index[Tok(l->next_tok)] - begin] == 0) {
+          queue.push_back(Tok(l->next_tok));
+        }
+      }
+    }
+    if (queue.size() != frame_toks.size()) {
+      KALDI_DECODER_ERR << "The links of frame " << f
+                        << " have an input-epsilon cycle";
+    }
+
+    for (const Token *tok : queue) {
+      index[tok] = static_cast<int32_t>(toks.size());
+      toks.push_back(tok);
+      frames.push_back(f);
+    }
+  }
+
+  int32_t num_toks = static_cast<int32_t>(toks.size());
+  auto link_cost = [acoustic_scale](const ForwardLink *l) -> double {
+    return l->graph_cost + acoustic_scale * l->acoustic_cost;
+  };
+
+  // The start token is the last one of frame 0; see GetRawLattice().
+  const Token *start = active_toks_[0].toks;
+  while (start->next != nullptr) {
+    start = start->next;
+  }
+
+  // Forward pass, in log-probabilities, together with the Viterbi costs
+  // and back-pointers of the best path
+  std::vector<double> alpha(num_toks, -infinity);
+  std::vector<double> viterbi(num_toks, infinity);
+  std::vector<const ForwardLink *> best_link(num_toks, nullptr);
+  std::vector<int32_t> best_prev(num_toks, -1);
+  alpha[index[start]] = 0;
+  viterbi[index[start]] = 0;
+  for (int32_t i = 0; i != num_toks; ++i) {
+    if (alpha[i] == -infinity) {
+      continue;
+    }
+    for (const ForwardLink *l = Link(toks[i]->links); l != nullptr;
+         l = Link(l->next)) {
+      auto iter = index.find(Tok(l->next_tok));
+      if (iter == index.end()) {
+        continue;  // the link points past the frames decoded
+      }
+      int32_t j = iter->second;
+      double c = link_cost(l);
+      alpha[j] = LogAdd(alpha[j], alpha[i] - c);
+      if (viterbi[i] + c < viterbi[j]) {
+        viterbi[j] = viterbi[i] + c;
+        best_link[j] = l;
+        best_prev[j] = i;
+      }
+    }
+  }
+
+  // Backward pass
+  std::vector<double> beta(num_toks, -infinity);
+  for (int32_t i = num_toks - 1; i >= 0; --i) {
+    if (frames[i] == num_frames) {
+      beta[i] = -final_cost(toks[i]);
+    }
+    for (const ForwardLink *l = Link(toks[i]->links); l != nullptr;
+         l = Link(l->next)) {
+      auto iter = index.find(Tok(l->next_tok));
+      if (iter != index.end()) {
+        beta[i] = LogAdd(beta[i], beta[iter->second] - link_cost(l));
+      }
+    }
+  }
+
+  double total = beta[index[start]];
+  if (total == -infinity) {
+    return;
+  }
+
+  std::map<std::pair<int32_t, Label>, double> word_posteriors;
+  for (int32_t i = 0; i != num_toks; ++i) {
+    if (alpha[i] == -infinity) {
+      continue;
+    }
+    for (const ForwardLink *l = Link(toks[i]->links); l != nullptr;
+         l = Link(l->next)) {
+      auto iter = index.find(Tok(l->next_tok));
+      if (l->olabel == 0 || iter == index.end()) {
+        continue;
+      }
+      double p =
+          std::exp(alpha[i] - link_cost(l) + beta[iter->second] - total);
+      if (p > 0) {
+        word_posteriors[{frames[i], l->olabel}] += p;
+      }
+    }
+  }
+
+  posteriors->reserve(word_posteriors.size());
+  for (const auto &p : word_posteriors) {
+    float posterior = std::min(p.second, 1.0);
+    posteriors->push_back({p.first.second, p.first.first, posterior});
+  }
+
+  if (best_path == nullptr) {
+    return;
+  }
+
+  int32_t best = -1;
+  double best_cost = infinity;
+  for (int32_t i = 0; i != num_toks; ++i) {
+    if (frames[i] != num_frames) {
+      continue;
+    }
+    double cost = viterbi[i] + final_cost(toks[i]);
+    if (cost < best_cost) {
+      best_cost = cost;
+      best = i;
+    }
+  }
+
+  for (int32_t i = best; i != -1 && best_link[i] != nullptr;
+       i = best_prev[i]) {
+    const ForwardLink *l = best_link[i];
+    if (l->olabel != 0) {
+      int32_t frame = frames[best_prev[i]];
+      float posterior = std::min(word_posteriors[{frame, l->olabel}], 1.0);
+      best_path->push_back({l->olabel, frame, posterior});
+    }
+  }
+  std::reverse(best_path->begin(), best_path->end());
+}
+
+int32_t LatticeSimpleDecoder::ExtendRawLattice(fst::Lattice *lat) {
+  using Arc = fst::LatticeArc;
+  using StateId = Arc::StateId;
+  using Weight = Arc::Weight;
+
+  KALDI_DECODER_ASSERT(!active_toks_.empty() &&
+                       "You must call InitDecoding() before ExtendRawLattice");
+
+  if (num_frames_with_states_ == 0) {
+    lat->DeleteStates();
+  }
+
+  // Frames whose tokens get arcs in this call. After FinalizeDecoding()
+  // nothing can change any more, so all the remaining frames are exported.
+  int32_t end_frame =
+      decoding_finalized_ ? NumFramesDecoded() + 1 : num_frames_pruned_;
+
+  // The tokens of a frame are given states before the frame is exported,
+  // when they first appear as the destination of an arc, i.e., up to the
+  // frame after end_frame.
+  int32_t end_states_frame =
+      std::min(end_frame + 1, static_cast<int32_t>(active_toks_.size()));
+  for (int32_t f = num_frames_with_states_; f < end_states_frame; ++f) {
+    for (Token *tok = active_toks_[f].toks; tok != nullptr; tok = tok->next) {
+      tok->lattice_state = lat->AddState();
+    }
+
+    // The start token was the first one added to frame 0, so it is the last
+    // one in its list; see also GetRawLattice().
+    if (f == 0 && active_toks_[0].toks != nullptr) {
+      const Token *tok = active_toks_[0].toks;
+      while (tok->next != nullptr) {
+        tok = tok->next;
+      }
+      lat->SetStart(tok->lattice_state);
+    }
+  }
+  num_frames_with_states_ = std::max(num_frames_with_states_, end_states_frame);
+
+  int32_t num_frames = NumFramesDecoded();
+  for (int32_t f = num_frames_exported_; f < end_frame; ++f) {
+    for (Token *tok = active_toks_[f].toks; tok != nullptr; tok = tok->next) {
+      StateId state = tok->lattice_state;
+
+      size_t num_arcs = 0;
+      for (const ForwardLink *l = Link(tok->links); l != nullptr;
+           l = Link(l->next)) {
+        ++num_arcs;
+      }
+      lat->ReserveArcs(state, num_arcs);
+
+      for (const ForwardLink *l = Link(tok->links); l != nullptr;
+           l = Link(l->next)) {
+        StateId nextstate = Tok(l->next_tok)->lattice_state;
+        KALDI_DECODER_ASSERT(nextstate >= 0 && nextstate < lat->NumStates());
+        lat->AddArc(state, Arc(l->ilabel, l->olabel,
+                               Weight(l->graph_cost, l->acoustic_cost),
+                               nextstate));
+      }
+
+      if (f == num_frames) {
+        // Only reached after FinalizeDecoding()
+        if (!final_costs_.empty()) {
+          auto iter = final_costs_.find(tok);
+          if (iter != final_costs_.end()) {
+            lat->SetFinal(state, Weight(iter->second, 0));
+          }
+        } else {
+          lat->SetFinal(state, Weight::One());
+        }
+      }
+    }
+  }
+  num_frames_exported_ = std::max(num_frames_exported_, end_frame);
+
+  return num_frames_exported_;
+}
+
+void LatticeSimpleDecoder::Snapshot(std::ostream &os) const {
+  KALDI_DECODER_ASSERT(!active_toks_.empty() &&
+                       "You must call InitDecoding() before Snapshot()");
+
+  // Tokens are numbered frame by frame, in the order of the per-frame lists
+  std::unordered_map<const Token *, int32_t> tok_ids(num_toks_ / 2 + 3);
+  for (const auto &list : active_toks_) {
+    for (const Token *tok = list.toks; tok != nullptr; tok = tok->next) {
+      int32_t id = static_cast<int32_t>(tok_ids.size());
+      tok_ids[tok] = id;
+    }
+  }
+
+  WriteMarker(os, "<LatticeSimpleDecoder>");
+  WriteBasicType(os, kLatticeSimpleDecoderSnapshotVersion);
+  WriteBasicType(os, context_graph_ != nullptr);
+  WriteBasicType(os, warned_);
+  WriteBasicType(os, num_frames_pruned_);
+  WriteBasicType(os, beam_scale_);
+  WriteBasicType(os, num_tightened_frames_);
+
+  WriteBasicType(os, static_cast<int32_t>(active_toks_.size()));
+  for (const auto &list : active_toks_) {
+    int32_t n = 0;
+    for (const Token *tok = list.toks; tok != nullptr; tok = tok->next) {
+      ++n;
+    }
+    WriteBasicType(os, list.must_prune_forward_links);
+    WriteBasicType(os, list.must_prune_tokens);
+    WriteBasicType(os, n);
+  }
+
+  for (const auto &list : active_toks_) {
+    for (const Token *tok = list.toks; tok != nullptr; tok = tok->next) {
+      int32_t num_links = 0;
+      for (const ForwardLink *l = Link(tok->links); l != nullptr;
+           l = Link(l->next)) {
+        ++num_links;
+      }
+
+      WriteBasicType(os, tok->tot_cost);
+      WriteBasicType(os, tok->extra_cost);
+      WriteBasicType(os, tok->context_state);
+      WriteBasicType(os, num_links);
+      for (const ForwardLink *l = Link(tok->links); l != nullptr;
+           l = Link(l->next)) {
+        WriteBasicType(os, tok_ids.at(Tok(l->next_tok)));
+        WriteBasicType(os, l->ilabel);
+        WriteBasicType(os, l->olabel);
+        WriteBasicType(os, l->graph_cost);
+        WriteBasicType(os, l->acoustic_cost);
+      }
+    }
+  }
+
+  WriteBasicType(os, static_cast<int32_t>(cur_toks_.size()));
+  for (const auto &p : cur_toks_) {
+    WriteBasicType(os, p.first);
+    WriteBasicType(os, tok_ids.at(p.second));
+  }
+
+  WriteBasicType(os, decoding_finalized_);
+  if (decoding_finalized_) {
+    // FinalizeDecoding() may have deleted some of the tokens in final_costs_;
+    // they are skipped.
+    std::vector<std::pair<int32_t, float>> final_costs;
+    for (const auto &p : final_costs_) {
+      auto iter = tok_ids.find(p.first);
+      if (iter != tok_ids.end()) {
+        final_costs.emplace_back(iter->second, p.second);
+      }
+    }
+
+    WriteBasicType(os, static_cast<int32_t>(final_costs.size()));
+    for (const auto &p : final_costs) {
+      WriteBasicType(os, p.first);
+      WriteBasicType(os, p.second);
+    }
+    WriteBasicType(os, final_relative_cost_);
+    WriteBasicType(os, final_best_cost_);
+  }
+
+  if (!os) {
+    KALDI_DECODER_ERR << "Failed to write the snapshot";
+  }
+}
+
+void LatticeSimpleDecoder::Restore(std::istream &is) {
+  ExpectMarker(is, "<LatticeSimpleDecoder>");
+
+  int32_t version;
+  ReadBasicType(is, &version);
+  if (version != kLatticeSimpleDecoderSnapshotVersion) {
+    KALDI_DECODER_ERR << "Unsupported snapshot version " << version
+                      << ". Expected: " << kLatticeSimpleDecoderSnapshotVersion;
+  }
+
+  bool has_context_graph;
+  ReadBasicType(is, &has_context_graph);
+  if (has_context_graph != (context_graph_ != nullptr)) {
+    KALDI_DECODER_ERR << "The snapshot was written by a decoder "
+                      << (has_context_graph ? "with" : "without")
+                      << " a context graph, but this decoder "
+                      << (context_graph_ ? "has" : "has no")
+                      << " context graph";
+  }
+
+  bool warned;
+  ReadBasicType(is, &warned);
+
+  // Read everything before touching the current state, so that a malformed
+  // input leaves the decoder unchanged.
+  int32_t num_frames_pruned;
+  float beam_scale;
+  int32_t num_tightened_frames;
+  ReadBasicType(is, &num_frames_pruned);
+  ReadBasicType(is, &beam_scale);
+  ReadBasicType(is, &num_tightened_frames);
+  if (!(beam_scale >= kMinBeamScale && beam_scale <= 1)) {
+    KALDI_DECODER_ERR << "Invalid beam scale: " << beam_scale;
+  }
+  if (num_tightened_frames < 0) {
+    KALDI_DECODER_ERR << "Invalid number of tightened frames: "
+                      << num_tightened_frames;
+  }
+
+  int32_t num_lists;
+  ReadBasicType(is, &num_lists);
+  if (num_lists <= 0) {
+    KALDI_DECODER_ERR << "Invalid number of frames: " << num_lists;
+  }
+  if (num_frames_pruned < 0 || num_frames_pruned > num_lists) {
+    KALDI_DECODER_ERR << "Invalid number of pruned frames: "
+                      << num_frames_pruned;
+  }
+
+  std::vector<TokenList> lists(num_lists);
+  std::vector<int32_t> list_sizes(num_lists);
+  int64_t num_toks = 0;
+  for (int32_t f = 0; f != num_lists; ++f) {
+    ReadBasicType(is, &lists[f].must_prune_forward_links);
+    ReadBasicType(is, &lists[f].must_prune_tokens);
+    ReadBasicType(is, &list_sizes[f]);
+    if (list_sizes[f] < 0) {
+      KALDI_DECODER_ERR << "Invalid number of tokens on frame " << f << ": "
+                        << list_sizes[f];
+    }
+    num_toks += list_sizes[f];
+  }
+
+  if (num_toks > std::numeric_limits<int32_t>::max()) {
+    KALDI_DECODER_ERR << "Too many tokens: " << num_toks;
+  }
+
+  struct LinkInfo {
+    int32_t next_tok;
+    Label ilabel;
+    Label olabel;
+    float graph_cost;
+    float acoustic_cost;
+  };
+
+  std::vector<Token> toks(num_toks);
+  // links of token i are links[links_begin[i]:links_begin[i+1]]
+  std::vector<int32_t> links_begin(num_toks + 1, 0);
+  std::vector<LinkInfo> links;
+  for (int32_t i = 0; i != num_toks; ++i) {
+    int32_t num_links;
+    ReadBasicType(is, &toks[i].tot_cost);
+    ReadBasicType(is, &toks[i].extra_cost);
+    ReadBasicType(is, &toks[i].context_state);
+    ReadBasicType(is, &num_links);
+
+    if (toks[i].context_state < 0 ||
+        (context_graph_ ? toks[i].context_state >= context_graph_->NumStates()
+                        : toks[i].context_state != 0)) {
+      KALDI_DECODER_ERR << "Invalid context state " << toks[i].context_state
+                        << " of token " << i
+                        << ". Is it the same context graph?";
+    }
+
+    if (num_links < 0) {
+      KALDI_DECODER_ERR << "Invalid number of links of token " << i << ": "
+                        << num_links;
+    }
+
+    for (int32_t k = 0; k != num_links; ++k) {
+      LinkInfo l;
+      ReadBasicType(is, &l.next_tok);
+      ReadBasicType(is, &l.ilabel);
+      ReadBasicType(is, &l.olabel);
+      ReadBasicType(is, &l.graph_cost);
+      ReadBasicType(is, &l.acoustic_cost);
+      if (l.next_tok < 0 || l.next_tok >= num_toks) {
+        KALDI_DECODER_ERR << "Invalid link from token " << i << " to "
+                          << l.next_tok;
+      }
+      links.push_back(l);
+    }
+    links_begin[i + 1] = static_cast<int32_t>(links.size());
+  }
+
+  auto read_tok_id = [&is, num_toks]() -> int32_t {
+    int32_t id;
+    ReadBasicType(is, &id);
+    if (id < 0 || id >= num_toks) {
+      KALDI_DECODER_ERR << "Invalid token " << id;
+    }
+    return id;
+  };
+
+  int32_t num_cur_toks;
+  ReadBasicType(is, &num_cur_toks);
+  if (num_cur_toks < 0) {
+    KALDI_DECODER_ERR << "Invalid number of current tokens: " << num_cur_toks;
+  }
+
+  // The states of the current tokens can only be checked against the
+  // number of states of an expanded graph; see also FasterDecoder::Restore().
+  StateId num_states = -1;
+  if (fst_.Properties(fst::kExpanded, false) != 0) {
+    num_states =
+        static_cast<const fst::ExpandedFst<fst::StdArc> &>(fst_).NumStates();
+  }
+
+  std::vector<std::pair<StateId, int32_t>> cur_toks(num_cur_toks);
+  std::unordered_set<StateId> cur_states;
+  for (auto &p : cur_toks) {
+    ReadBasicType(is, &p.first);
+    p.second = read_tok_id();
+    if (p.first < 0 || (num_states != -1 && p.first >= num_states)) {
+      KALDI_DECODER_ERR << "Invalid state " << p.first << " of token "
+                        << p.second << ". Is it the same graph?";
+    }
+    if (!cur_states.insert(p.first).second) {
+      KALDI_DECODER_ERR << "Duplicate state " << p.first;
+    }
+  }
+
+  bool decoding_finalized;
+  ReadBasicType(is, &decoding_finalized);
+
+  std::vector<std::pair<int32_t, float>> final_costs;
+  float final_relative_cost = 0;
+  float final_best_cost = 0;
+  if (decoding_finalized) {
+    int32_t num_final_costs;
+    ReadBasicType(is, &num_final_costs);
+    if (num_final_costs < 0) {
+      KALDI_DECODER_ERR << "Invalid number of final costs: "
+                        << num_final_costs;
+    }
+    final_costs.resize(num_final_costs);
+    for (auto &p : final_costs) {
+      p.first = read_tok_id();
+      ReadBasicType(is, &p.second);
+    }
+    ReadBasicType(is, &final_relative_cost);
+    ReadBasicType(is, &final_best_cost);
+  }
+
+  // Now replace the current state
+  Reset();
+
+  std::vector<Token *> tok_ptrs(num_toks);
+  for (int32_t i = 0; i != num_toks; ++i) {
+    tok_ptrs[i] = NewToken(toks[i].tot_cost, toks[i].extra_cost, nullptr,
+                           toks[i].context_state);
+  }
+  num_toks_ = static_cast<int32_t>(num_toks);
+
+  active_toks_ = std::move(lists);
+  int32_t i = 0;
+  for (int32_t f = 0; f != num_lists; ++f) {
+    Token **tail = &active_toks_[f].toks;
+    for (int32_t n = 0; n != list_sizes[f]; ++n, ++i) {
+      *tail = tok_ptrs[i];
+      tail = &tok_ptrs[i]->next;
+
+      // Prepend in reverse so that the original order of links is kept
+      for (int32_t k = links_begin[i + 1] - 1; k >= links_begin[i]; --k) {
+        const LinkInfo &l = links[k];
+        AddLink(tok_ptrs[i], tok_ptrs[l.next_tok], l.ilabel, l.olabel,
+                l.graph_cost, l.acoustic_cost);
+      }
+    }
+    *tail = nullptr;
+  }
+
+  for (const auto &p : cur_toks) {
+    cur_toks_[p.first] = tok_ptrs[p.second];
+  }
+
+  for (const auto &p : final_costs) {
+    final_costs_[tok_ptrs[p.first]] = p.second;
+  }
+
+  warned_ = warned;
+  decoding_finalized_ = decoding_finalized;
+  final_relative_cost_ = final_relative_cost;
+  final_best_cost_ = final_best_cost;
+
+  // The memory cap keeps the beams it had reached, and ExtendRawLattice()
+  // exports the same frames as in the decoder that wrote the snapshot.
+  // Since Restore() starts a new lattice, nothing has been exported yet, and
+  // the peak memory is that of this decoder, which Reset() has cleared.
+  num_frames_pruned_ = num_frames_pruned;
+  beam_scale_ = beam_scale;
+  num_tightened_frames_ = num_tightened_frames;
+  num_frames_exported_ = 0;
+  num_frames_with_states_ = 0;
+}
+
 }  // namespace kaldi_decoder
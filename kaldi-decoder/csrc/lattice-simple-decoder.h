@@ -9,14 +9,22 @@
 // kaldi/src/decoder/lattice-simple-decoder.h
 #ifndef KALDI_DECODER_CSRC_LATTICE_SIMPLE_DECODER_H_
 #define KALDI_DECODER_CSRC_LATTICE_SIMPLE_DECODER_H_
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <ostream>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "fst/fst.h"
 #include "fst/fstlib.h"
+#include "kaldi-decoder/csrc/confusion-network.h"
+#include "kaldi-decoder/csrc/context-graph.h"
 #include "kaldi-decoder/csrc/decodable-itf.h"
+#include "kaldi-decoder/csrc/decoder-memory-stats.h"
 #include "kaldi-decoder/csrc/log.h"
+#include "kaldi-decoder/csrc/memory-pool.h"
 #include "kaldifst/csrc/lattice-weight.h"
 
 namespace kaldi_decoder {
@@ -32,20 +40,27 @@ struct LatticeSimpleDecoderConfig {
   float prune_scale;  // Note: we don't make this configurable on the command
                       // line, it's not a very important parameter.  It affects
                       // the algorithm that prunes the tokens as we go.
+
+  // If positive, beam and lattice_beam are tightened while the memory used by
+  // the decoder, i.e., DecoderMemoryStats::LiveBytes(), exceeds this number
+  // of bytes. 0 means no limit.
+  int64_t max_mem_bytes;
   // fst::DeterminizeLatticePhonePrunedOptions det_opts;
 
   LatticeSimpleDecoderConfig(float beam = 16.0, float lattice_beam = 10.0,
                              int32_t prune_interval = 25,
                              bool determinize_lattice = true,
                              bool prune_lattice = true, float beam_ratio = 0.9,
-                             float prune_scale = 0.1)
+                             float prune_scale = 0.1,
+                             int64_t max_mem_bytes = 0)
       : beam(beam),
         lattice_beam(lattice_beam),
         prune_interval(prune_interval),
         determinize_lattice(determinize_lattice),
         prune_lattice(prune_lattice),
         beam_ratio(beam_ratio),
-        prune_scale(prune_scale) {}
+        prune_scale(prune_scale),
+        max_mem_bytes(max_mem_bytes) {}
 #if 0
   void Register(OptionsItf *opts) {
     det_opts.Register(opts);
@@ -77,12 +92,30 @@ struct LatticeSimpleDecoderConfig {
 
     os << "prune_lattice=" << prune_lattice << ", ";
     os << "beam_ratio=" << beam_ratio << ", ";
-    os << "prune_scale=" << prune_scale << ")";
+    os << "prune_scale=" << prune_scale << ", ";
+    os << "max_mem_bytes=" << max_mem_bytes << ")";
 
     return os.str();
   }
 };
 
+/// A path of the lattice, as returned by LatticeSimpleDecoder::GetNBest().
+struct NBestHypothesis {
+  // The output labels (words) on the path, without epsilons
+  std::vector<int32_t> words;
+
+  // The frame of each word, i.e., of the token from which its link leaves
+  std::vector<int32_t> word_frames;
+
+  // The input label consumed on each frame
+  std::vector<int32_t> alignment;
+
+  float graph_cost = 0;     // including the final cost, if any
+  float acoustic_cost = 0;  // acoustic cost (pre-scaled)
+
+  float TotalCost() const { return graph_cost + acoustic_cost; }
+};
+
 /** Simplest possible decoder, included largely for didactic purposes and as a
     means to debug more highly optimized decoders.  See \ref decoders_simple
     for more information.
@@ -97,7 +130,12 @@ class LatticeSimpleDecoder {
   // instantiate this class once for each thing you have to decode.
   LatticeSimpleDecoder(const fst::Fst<fst::StdArc> &fst,
                        const LatticeSimpleDecoderConfig &config)
-      : fst_(fst), config_(config), num_toks_(0) {
+      : fst_(fst),
+        config_(config),
+        num_toks_(0),
+        cur_toks_(TokenMap::allocator_type(&map_pool_)),
+        prev_toks_(TokenMap::allocator_type(&map_pool_)),
+        final_costs_(FinalCostMap::allocator_type(&map_pool_)) {
     config.Check();
   }
 
@@ -107,6 +145,20 @@ class LatticeSimpleDecoder {
   /// utterance and want to start with a new utterance.
   void InitDecoding();
 
+  /// This will decode until there are no more frames ready in the decodable
+  /// object, but if max_num_frames is >= 0 it will decode no more than
+  /// that many frames. Call FinalizeDecoding() after the last frame, if you
+  /// want the lattice to be pruned with the final-probs.
+  void AdvanceDecoding(DecodableInterface *decodable,
+                       int32_t max_num_frames = -1);
+
+  /// Releases the state of the current utterance. The memory of the tokens,
+  /// links and hash nodes is kept in internal free lists so that later
+  /// utterances reuse it instead of allocating. InitDecoding() calls it;
+  /// call it directly to release a decoder that stays idle, e.g., before
+  /// returning it to a DecoderPool.
+  void Reset();
+
   /// This function may be optionally called after AdvanceDecoding(), when you
   /// do not plan to decode any further.  It does an extra pruning step that
   /// will help to prune the lattices output by GetLattice and (particularly)
@@ -135,8 +187,59 @@ class LatticeSimpleDecoder {
   // If "use_final_probs" is true AND we reached the final-state
   // of the graph then it will include those as final-probs, else
   // it will treat all final-probs as one.
+  // Note: it stores the state ids of the lattice in the tokens, so it must
+  // not be called by several threads at the same time on the same decoder.
   bool GetRawLattice(fst::Lattice *lat, bool use_final_probs = true) const;
 
+  /// Returns the n best paths through the lattice, best first, that is, the
+  /// ones that the n-best of GetRawLattice() would return, but it searches
+  /// the tokens directly instead of building the lattice. If
+  /// unique_word_sequences is true, only the best path of each word
+  /// sequence is returned, which is usually what rescoring wants; the
+  /// search then never extends two partial paths with the same words from
+  /// the same token, so the many alignments of a word sequence do not slow
+  /// it down. See GetRawLattice() for "use_final_probs". Fewer than n
+  /// paths are returned if the lattice does not have that many.
+  std::vector<NBestHypothesis> GetNBest(
+      int32_t n, bool use_final_probs = true,
+      bool unique_word_sequences = true) const;
+
+  /// Returns the posterior of each word of the lattice, i.e., of each
+  /// output label on a link, computed with the forward-backward algorithm
+  /// over the tokens and the graph and acoustic costs of their links, so
+  /// that no lattice is built. The occurrences of a word that leave tokens
+  /// of the same frame are merged. The output is sorted by frame and word.
+  /// See GetRawLattice() for "use_final_probs".
+  std::vector<WordPosterior> GetWordPosteriors(
+      float acoustic_scale = 1.0, bool use_final_probs = true) const;
+
+  /// Returns the confusion network of the lattice, built from the output of
+  /// GetWordPosteriors() and the best path under the same scaled costs;
+  /// see BuildConfusionNetwork(). Pass it to MbrDecode() for the minimum
+  /// Bayes risk words with their confidences.
+  std::vector<ConfusionBin> GetConfusionNetwork(
+      const ConfusionNetworkOptions &opts = {},
+      bool use_final_probs = true) const;
+
+  /// Streaming version of GetRawLattice(), for use between calls of
+  /// AdvanceDecoding(). It appends to "lat" the states and arcs of the
+  /// frames that have been pruned by the periodic pruning (see
+  /// prune_interval) since the last call, so that the cost of a call is
+  /// proportional to the number of new frames. Pruning never adds links, so
+  /// the exported arcs are never extended later; however, later pruning,
+  /// which knows about more frames, may remove some of them from the decoder.
+  /// So "lat" is a superset of the output of GetRawLattice(): it keeps those
+  /// arcs, and the states of pruned tokens, which have no arcs. Apply
+  /// fst::Connect() to the result if that matters.
+  ///
+  /// Pass the same lattice to every call of an utterance and do not modify
+  /// it in between; the first call after InitDecoding() clears it. After
+  /// FinalizeDecoding(), a call exports all the remaining frames, with the
+  /// final-probs. Restore() starts a new lattice.
+  ///
+  /// Returns the number of frames whose arcs are in "lat".
+  int32_t ExtendRawLattice(fst::Lattice *lat);
+
   ~LatticeSimpleDecoder() { ClearActiveTokens(); }
 
   /// FinalRelativeCost() serves the same purpose as ReachedFinal(), but gives
@@ -151,26 +254,65 @@ class LatticeSimpleDecoder {
 
   const LatticeSimpleDecoderConfig &GetOptions() const { return config_; }
 
+  /// Attaches a ContextGraph for contextual biasing (e.g., hotwords), or
+  /// detaches it if context_graph is nullptr. Call it before InitDecoding();
+  /// changing it in the middle of an utterance is not supported. The graph is
+  /// not owned by the decoder and must outlive it; it can be shared with
+  /// other decoders. The biasing costs are included in the graph costs of the
+  /// lattice.
+  void SetContextGraph(const ContextGraph *context_graph) {
+    context_graph_ = context_graph;
+  }
+
   int32_t NumFramesDecoded() const { return active_toks_.size() - 1; }
 
+  /// Returns the memory held by the decoder. It is cheap enough to be called
+  /// after every frame. The peak is over the frames decoded since
+  /// InitDecoding().
+  DecoderMemoryStats GetMemoryStats() const;
+
   // Returns true if any kind of traceback is available (not necessarily from
   // a final state).
   bool Decode(DecodableInterface *decodable);
 
- private:
+  /// Writes the decoding state, i.e., the tokens and links of all frames
+  /// decoded so far, to "os" in a compact binary format, e.g., to move a
+  /// session to another host or to checkpoint a long decode. It can also be
+  /// called after FinalizeDecoding(). See also Restore().
+  void Snapshot(std::ostream &os) const;
+
+  /// Replaces the decoding state with the one written by Snapshot().
+  /// This decoder must use the same decoding graph and, if any, the same
+  /// ContextGraph as the one that wrote the snapshot; the options may
+  /// differ. Afterwards, GetRawLattice() and friends return the same
+  /// results as the decoder that wrote the snapshot.
+  ///
+  /// It throws if the input is malformed, or if it refers to states that
+  /// the graph does not have (only checked for expanded graphs); the
+  /// decoder is unchanged in that case.
+  void Restore(std::istream &is);
+
+ protected:
+  // The index of no token or link, like nullptr for pointers
+  static constexpr uint32_t kNoIndex = std::numeric_limits<uint32_t>::max();
+
   struct Token;
   // ForwardLinks are the links from a token to a token on the next frame.
   // or sometimes on the current frame (for input-epsilon links).
+  // Tokens and links refer to each other by their 32-bit indexes in
+  // token_pool_ and link_pool_ instead of pointers, which makes a link 24
+  // bytes instead of 32; use Tok() and Link() to get them.
   struct ForwardLink {
-    Token *next_tok;      // the next token [or NULL if represents final-state]
+    uint32_t next_tok;    // the next token [or kNoIndex if represents
+                          // final-state]
     Label ilabel;         // ilabel on link.
     Label olabel;         // olabel on link.
     float graph_cost;     // graph cost of traversing link (contains LM, etc.)
     float acoustic_cost;  // acoustic cost (pre-scaled) of traversing link
-    ForwardLink *next;    // next in singly-linked list of forward links from a
-                          // token.
-    ForwardLink(Token *next_tok, Label ilabel, Label olabel, float graph_cost,
-                float acoustic_cost, ForwardLink *next)
+    uint32_t next;        // next in singly-linked list of forward links from a
+                          // token, or kNoIndex.
+    ForwardLink(uint32_t next_tok, Label ilabel, Label olabel,
+                float graph_cost, float acoustic_cost, uint32_t next)
         : next_tok(next_tok),
           ilabel(ilabel),
           olabel(olabel),
@@ -192,31 +334,86 @@ class LatticeSimpleDecoder {
     // eventually succeed (e.g. if you were to take the currently active states
     // one by one and compute this difference, and then take the minimum).
 
-    ForwardLink *links;  // Head of singly linked list of ForwardLinks
+    uint32_t links;  // Head of singly linked list of ForwardLinks
+
+    // Index of this token in token_pool_, which links to it store
+    uint32_t index;
 
     Token *next;  // Next in list of tokens for this frame.
 
-    Token(float tot_cost, float extra_cost, ForwardLink *links, Token *next)
+    // State in context_graph_ of the best path into this token; it is always
+    // 0 if there is no context graph.
+    int32_t context_state;
+
+    // State of this token in the output of GetRawLattice(), which numbers
+    // the tokens before creating the states, so that it needs no map from
+    // tokens to states. It is only valid during GetRawLattice().
+    int32_t lattice_state;
+
+    Token(float tot_cost, float extra_cost, Token *next,
+          int32_t context_state)
         : tot_cost(tot_cost),
           extra_cost(extra_cost),
-          links(links),
-          next(next) {}
+          links(kNoIndex),
+          index(kNoIndex),
+          next(next),
+          context_state(context_state),
+          lattice_state(-1) {}
 
     Token() = default;
 
-    void DeleteForwardLinks() {
-      ForwardLink *l = links;
-      ForwardLink *m;
-
-      while (l != nullptr) {
-        m = l->next;
-        delete l;
+    void DeleteForwardLinks(IndexPool<ForwardLink> *pool) {
+      uint32_t l = links;
+      while (l != kNoIndex) {
+        uint32_t m = (*pool)[l].next;
+        pool->Delete(l);
         l = m;
       }
-      links = nullptr;
+      links = kNoIndex;
     }
   };
 
+  // Return the token or link with the given index, or nullptr for kNoIndex
+  Token *Tok(uint32_t i) {
+    return i == kNoIndex ? nullptr : &token_pool_[i];
+  }
+  const Token *Tok(uint32_t i) const {
+    return i == kNoIndex ? nullptr : &token_pool_[i];
+  }
+  ForwardLink *Link(uint32_t i) {
+    return i == kNoIndex ? nullptr : &link_pool_[i];
+  }
+  const ForwardLink *Link(uint32_t i) const {
+    return i == kNoIndex ? nullptr : &link_pool_[i];
+  }
+
+  // Creates a token in token_pool_ with no forward links
+  Token *NewToken(float tot_cost, float extra_cost, Token *next,
+                  int32_t context_state) {
+    uint32_t i = token_pool_.New(tot_cost, extra_cost, next, context_state);
+    Token *tok = &token_pool_[i];
+    tok->index = i;
+    return tok;
+  }
+
+  // Adds a link to the head of the list of links of "tok"
+  void AddLink(Token *tok, const Token *next_tok, Label ilabel, Label olabel,
+               float graph_cost, float acoustic_cost) {
+    tok->links = link_pool_.New(next_tok->index, ilabel, olabel, graph_cost,
+                                acoustic_cost, tok->links);
+  }
+
+  // The hash maps below take their nodes from map_pool_.
+  using TokenMap =
+      std::unordered_map<StateId, Token *, std::hash<StateId>,
+                         std::equal_to<StateId>,
+                         PoolAllocator<std::pair<const StateId, Token *>>>;
+
+  using FinalCostMap =
+      std::unordered_map<Token *, float, std::hash<Token *>,
+                         std::equal_to<Token *>,
+                         PoolAllocator<std::pair<Token *const, float>>>;
+
   // head and tail of per-frame list of Tokens (list is in topological order),
   // and something saying whether we ever pruned it using PruneForwardLinks.
   struct TokenList {
@@ -236,9 +433,26 @@ class LatticeSimpleDecoder {
   // active_toks_[frame]).
   //
   // Returns the Token pointer.  Sets "changed" (if non-NULL) to true
-  // if the token was newly created or the cost changed.
+  // if the token was newly created or the cost changed.  context_state is
+  // stored in the token if it is newly created or its cost is improved.
   inline Token *FindOrAddToken(StateId state, int32_t frame_plus_one,
-                               float tot_cost, bool emitting, bool *changed);
+                               float tot_cost, int32_t context_state,
+                               bool emitting, bool *changed);
+
+  // Returns the graph cost of leaving "tok" via "arc", including the
+  // contextual-biasing cost, and sets "context_state" to the context state
+  // of the destination.
+  inline float GraphCost(const Arc &arc, const Token *tok,
+                         int32_t *context_state) const {
+    *context_state = tok->context_state;
+    if (context_graph_ == nullptr || arc.olabel == 0) {
+      return arc.weight.Value();
+    }
+
+    return arc.weight.Value() + context_graph_->ForwardOneStep(
+                                    tok->context_state, arc.olabel,
+                                    context_state);
+  }
 
   // delta is the amount by which the extra_costs must
   // change before it sets "extra_costs_changed" to true.  If delta is larger,
@@ -273,7 +487,7 @@ class LatticeSimpleDecoder {
   // were no final-probs active on the final frame.
   // You cannot call this after FinalizeDecoding() has been called; in that
   // case you should get the answer from class-member variables.
-  void ComputeFinalCosts(std::unordered_map<Token *, float> *final_costs,
+  void ComputeFinalCosts(FinalCostMap *final_costs,
                          float *final_relative_cost,
                          float *final_best_cost) const;
 
@@ -289,19 +503,48 @@ class LatticeSimpleDecoder {
   // PruneCurrentTokens deletes the tokens from the "toks" map, but not
   // from the active_toks_ list, which could cause dangling forward pointers
   // (will delete it during regular pruning operation).
-  void PruneCurrentTokens(float beam,
-                          std::unordered_map<StateId, Token *> *toks);
+  void PruneCurrentTokens(float beam, TokenMap *toks);
 
   void ProcessEmitting(DecodableInterface *decodable);
 
- private:
+  // Runs the forward-backward algorithm over the tokens for
+  // GetWordPosteriors() and GetConfusionNetwork(). Outputs the word
+  // posteriors and, if best_path is not nullptr, the words of the best path
+  // with their posteriors.
+  void ForwardBackward(float acoustic_scale, bool use_final_probs,
+                       std::vector<WordPosterior> *posteriors,
+                       std::vector<WordPosterior> *best_path) const;
+
+  // Decodes the next frame; used by Decode() and AdvanceDecoding().
+  void DecodeOneFrame(DecodableInterface *decodable);
+
+  // Called after each frame. It updates peak_bytes_ and, if
+  // config_.max_mem_bytes is set, beam_scale_.
+  void UpdateMemoryUsage();
+
+  // The beams used while decoding; they are tighter than the ones in config_
+  // if config_.max_mem_bytes has been exceeded.
+  float Beam() const { return config_.beam * beam_scale_; }
+  float LatticeBeam() const { return config_.lattice_beam * beam_scale_; }
+
   const fst::Fst<fst::StdArc> &fst_;
   LatticeSimpleDecoderConfig config_;
+  // Not owned; nullptr if contextual biasing is disabled.
+  const ContextGraph *context_graph_ = nullptr;
   int32_t num_toks_;  // current total #toks allocated...
   bool warned_;
 
-  std::unordered_map<StateId, Token *> cur_toks_;
-  std::unordered_map<StateId, Token *> prev_toks_;
+  // Tokens, links and the nodes of the hash maps are allocated from these
+  // pools; they have to be declared before the containers using them.
+  IndexPool<Token> token_pool_;
+  IndexPool<ForwardLink> link_pool_;
+  FixedSizePool map_pool_;
+
+  TokenMap cur_toks_;
+  TokenMap prev_toks_;
+
+  // temp variable used in ProcessNonemitting
+  std::vector<StateId> queue_;
   std::vector<TokenList> active_toks_;  // Lists of tokens, indexed by frame
 
   /// decoding_finalized_ is true if someone called FinalizeDecoding().  [note,
@@ -314,9 +557,21 @@ class LatticeSimpleDecoder {
   bool decoding_finalized_;
   /// For the meaning of the next 3 variables, see the comment for
   /// decoding_finalized_ above., and ComputeFinalCosts().
-  std::unordered_map<Token *, float> final_costs_;
+  FinalCostMap final_costs_;
   float final_relative_cost_;
   float final_best_cost_;
+
+  // For ExtendRawLattice(): the number of frames pruned by the last call of
+  // PruneActiveTokens(), the number of frames exported so far, and the
+  // number of frames whose tokens have states in the partial lattice.
+  int32_t num_frames_pruned_ = 0;
+  int32_t num_frames_exported_ = 0;
+  int32_t num_frames_with_states_ = 0;
+
+  // See GetMemoryStats() and UpdateMemoryUsage()
+  int64_t peak_bytes_ = 0;
+  float beam_scale_ = 1;
+  int32_t num_tightened_frames_ = 0;
 };
 
 }  // namespace kaldi_decoder
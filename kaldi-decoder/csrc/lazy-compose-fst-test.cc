@@ -0,0 +1,214 @@
+// kaldi-decoder/csrc/lazy-compose-fst-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/lazy-compose-fst.h"
+
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/faster-decoder.h"
+
+namespace kaldi_decoder {
+
+// A lexicon loop: the tokens of word w are words[w - 101]. The word label is
+// on the first arc of a word, and an epsilon arc goes back to the start.
+static fst::StdVectorFst BuildHcl() {
+  std::vector<std::vector<int32_t>> words = {
+      {1}, {2, 3}, {3, 3}, {1, 2, 4}, {4}, {2, 1}};
+
+  fst::StdVectorFst hcl;
+  hcl.AddState();
+  hcl.SetStart(0);
+  hcl.SetFinal(0, 0);
+  for (size_t w = 0; w != words.size(); ++w) {
+    int32_t prev = 0;
+    for (size_t i = 0; i != words[w].size(); ++i) {
+      int32_t s = hcl.AddState();
+      int32_t olabel = i == 0 ? 101 + w : 0;
+      hcl.AddArc(prev, fst::StdArc(words[w][i], olabel, 0, s));
+      hcl.AddArc(s, fst::StdArc(words[w][i], 0, 0.1, s));
+      prev = s;
+    }
+    hcl.AddArc(prev, fst::StdArc(0, 0, 0, 0));
+  }
+  return hcl;
+}
+
+// A bigram LM over the words 101 to 106: state 0 is the back-off state and
+// state w - 100 is the history w. Only some bigrams are seen; the others
+// back off with an epsilon arc. All states are final, so every state of
+// HCL o G is coaccessible and fst::Compose(), which trims the result, keeps
+// them all.
+static fst::StdVectorFst BuildG() {
+  const int32_t num_words = 6;
+  fst::StdVectorFst g;
+  for (int32_t s = 0; s <= num_words; ++s) {
+    g.AddState();
+    g.SetFinal(s, 0.5 + 0.1 * s);
+  }
+  g.SetStart(0);
+
+  for (int32_t w = 1; w <= num_words; ++w) {
+    g.AddArc(0, fst::StdArc(100 + w, 100 + w, 2 + 0.2 * w, w));
+
+    // Bigrams "w, w + 1" and "w, w + 3"
+    for (int32_t next : {w + 1, w + 3}) {
+      if (next <= num_words) {
+        g.AddArc(w, fst::StdArc(100 + next, 100 + next, 0.5 + 0.1 * w, next));
+      }
+    }
+    g.AddArc(w, fst::StdArc(0, 0, 1.5, 0));
+  }
+
+  fst::ArcSort(&g, fst::ILabelCompare<fst::StdArc>());
+  return g;
+}
+
+// Expects that the parts of a and b reachable from their start states are
+// the same, up to the numbering of the states; both are visited in
+// breadth-first order, so the lazy one only expands reachable states.
+static void ExpectEquivalent(const fst::StdFst &a, const fst::StdFst &b) {
+  ASSERT_NE(a.Start(), fst::kNoStateId);
+  ASSERT_NE(b.Start(), fst::kNoStateId);
+
+  std::unordered_map<int32_t, int32_t> a_to_b = {{a.Start(), b.Start()}};
+  std::queue<int32_t> queue;
+  queue.push(a.Start());
+  while (!queue.empty()) {
+    int32_t sa = queue.front();
+    int32_t sb = a_to_b.at(sa);
+    queue.pop();
+
+    EXPECT_TRUE(fst::ApproxEqual(a.Final(sa), b.Final(sb)))
+        << "state " << sa << ": " << a.Final(sa).Value() << " vs "
+        << b.Final(sb).Value();
+    ASSERT_EQ(a.NumArcs(sa), b.NumArcs(sb)) << "state " << sa;
+
+    fst::ArcIterator<fst::StdFst> aiter(a, sa);
+    fst::ArcIterator<fst::StdFst> biter(b, sb);
+    for (; !aiter.Done(); aiter.Next(), biter.Next()) {
+      const auto &arc_a = aiter.Value();
+      const auto &arc_b = biter.Value();
+      EXPECT_EQ(arc_a.ilabel, arc_b.ilabel);
+      EXPECT_EQ(arc_a.olabel, arc_b.olabel);
+      EXPECT_TRUE(fst::ApproxEqual(arc_a.weight, arc_b.weight));
+
+      auto p = a_to_b.emplace(arc_a.nextstate, arc_b.nextstate);
+      if (p.second) {
+        queue.push(arc_a.nextstate);
+      } else {
+        EXPECT_EQ(p.first->second, arc_b.nextstate);
+      }
+    }
+  }
+}
+
+// Returns the input and output labels of a linear lattice, and its cost
+static void WalkBestPath(const fst::Lattice &best_path,
+                         std::vector<int32_t> *labels, double *cost) {
+  *cost = 0;
+  int32_t s = best_path.Start();
+  for (;;) {
+    fst::ArcIterator<fst::Lattice> aiter(best_path, s);
+    if (aiter.Done()) {
+      break;
+    }
+    const auto &arc = aiter.Value();
+    labels->push_back(arc.ilabel);
+    labels->push_back(arc.olabel);
+    *cost += arc.weight.Value1() + arc.weight.Value2();
+    s = arc.nextstate;
+  }
+  *cost += best_path.Final(s).Value1() + best_path.Final(s).Value2();
+}
+
+TEST(LazyComposeFst, SameAsCompose) {
+  fst::StdVectorFst hcl = BuildHcl();
+  fst::StdVectorFst g = BuildG();
+
+  fst::StdVectorFst expected;
+  fst::Compose(hcl, g, &expected);
+
+  LazyComposeFst lazy(hcl, g, LazyComposeFstOptions());
+  ExpectEquivalent(lazy.GetFst(), expected);
+
+  // A cache that is garbage collected all the time gives the same FST; its
+  // states are expanded again when they are visited again.
+  LazyComposeFst small_cache(hcl, g, LazyComposeFstOptions(1));
+  ExpectEquivalent(small_cache.GetFst(), expected);
+  ExpectEquivalent(small_cache.GetFst(), expected);
+}
+
+TEST(LazyComposeFst, FasterDecoder) {
+  fst::StdVectorFst hcl = BuildHcl();
+  fst::StdVectorFst g = BuildG();
+
+  fst::StdVectorFst hclg;
+  fst::Compose(hcl, g, &hclg);
+
+  LazyComposeFst lazy(hcl, g, LazyComposeFstOptions());
+
+  FasterDecoderOptions opts(16.0);
+  for (int32_t i = 0; i != 5; ++i) {
+    // Tokens 1 to 4 are in columns 0 to 3
+    FloatMatrix log_probs = RandnMatrix(30, 4, 0, 2, /*seed=*/i);
+    DecodableCtc decodable(log_probs);
+
+    FasterDecoder expected_decoder(hclg, opts);
+    expected_decoder.Decode(&decodable);
+    fst::Lattice expected;
+    ASSERT_TRUE(expected_decoder.GetBestPath(&expected));
+
+    FasterDecoder decoder(lazy.GetFst(), opts);
+    decoder.Decode(&decodable);
+    fst::Lattice best_path;
+    ASSERT_TRUE(decoder.GetBestPath(&best_path));
+    EXPECT_EQ(decoder.ReachedFinal(), expected_decoder.ReachedFinal());
+
+    std::vector<int32_t> labels, expected_labels;
+    double cost, expected_cost;
+    WalkBestPath(best_path, &labels, &cost);
+    WalkBestPath(expected, &expected_labels, &expected_cost);
+    EXPECT_EQ(labels, expected_labels);
+    EXPECT_NEAR(cost, expected_cost, 1e-3);
+  }
+}
+
+TEST(LazyComposeFst, InvalidInput) {
+  fst::StdVectorFst hcl = BuildHcl();
+  fst::StdVectorFst g = BuildG();
+
+  EXPECT_THROW(LazyComposeFst(fst::StdVectorFst(), g, LazyComposeFstOptions()),
+               std::runtime_error);
+  EXPECT_THROW(LazyComposeFst(hcl, fst::StdVectorFst(),
+                              LazyComposeFstOptions()),
+               std::runtime_error);
+
+  // Neither g nor hcl is sorted on the labels to match
+  fst::StdVectorFst unsorted_hcl = hcl;
+  unsorted_hcl.AddArc(0, fst::StdArc(0, 0, 5, 0));
+
+  fst::StdVectorFst unsorted_g;
+  unsorted_g.AddState();
+  unsorted_g.SetStart(0);
+  unsorted_g.SetFinal(0, 0);
+  unsorted_g.AddArc(0, fst::StdArc(102, 102, 1, 0));
+  unsorted_g.AddArc(0, fst::StdArc(101, 101, 1, 0));
+  EXPECT_THROW(
+      LazyComposeFst(unsorted_hcl, unsorted_g, LazyComposeFstOptions()),
+      std::runtime_error);
+
+  // It is enough that one of them is sorted
+  fst::StdVectorFst sorted_hcl = hcl;
+  fst::ArcSort(&sorted_hcl, fst::OLabelCompare<fst::StdArc>());
+  LazyComposeFst lazy(sorted_hcl, unsorted_g, LazyComposeFstOptions());
+  EXPECT_NE(lazy.GetFst().Start(), fst::kNoStateId);
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,43 @@
+// kaldi-decoder/csrc/lazy-compose-fst.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/lazy-compose-fst.h"
+
+#include "kaldi-decoder/csrc/log.h"
+
+namespace kaldi_decoder {
+
+LazyComposeFst::LazyComposeFst(const fst::Fst<fst::StdArc> &hcl,
+                               const fst::Fst<fst::StdArc> &g,
+                               const LazyComposeFstOptions &opts)
+    : opts_(opts) {
+  KALDI_DECODER_ASSERT(opts_.cache_size > 0);
+
+  if (hcl.Start() == fst::kNoStateId) {
+    KALDI_DECODER_ERR << "The HCL FST is empty";
+  }
+
+  if (g.Start() == fst::kNoStateId) {
+    KALDI_DECODER_ERR << "The G FST is empty";
+  }
+
+  // The label-sorted matchers used by fst::ComposeFst require that at least
+  // one side is sorted on the labels being matched. Note: Properties() with
+  // test == true computes the property if it is not already known, which is
+  // a one-time linear pass over the FST.
+  bool g_sorted = g.Properties(fst::kILabelSorted, true) != 0;
+  bool hcl_sorted = hcl.Properties(fst::kOLabelSorted, true) != 0;
+  if (!g_sorted && !hcl_sorted) {
+    KALDI_DECODER_ERR << "Either G has to be sorted on input labels or HCL has "
+                      << "to be sorted on output labels. Please use "
+                      << "fst::ArcSort() before creating a LazyComposeFst";
+  }
+
+  fst::CacheOptions cache_opts(opts_.gc,
+                              static_cast<size_t>(opts_.cache_size));
+
+  fst_ = std::make_unique<fst::ComposeFst<fst::StdArc>>(hcl, g, cache_opts);
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,94 @@
+// kaldi-decoder/csrc/lazy-compose-fst.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_LAZY_COMPOSE_FST_H_
+#define KALDI_DECODER_CSRC_LAZY_COMPOSE_FST_H_
+
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "fst/fst.h"
+#include "fst/fstlib.h"
+
+namespace kaldi_decoder {
+
+struct LazyComposeFstOptions {
+  // Maximum number of bytes used to cache the expanded states of the
+  // composed FST. Once the cache grows beyond this limit, states that are
+  // not referenced by any arc iterator are garbage collected and will be
+  // re-expanded on demand if the search visits them again.
+  int64_t cache_size;
+
+  // If false, the cache is never garbage collected, i.e., every state the
+  // search has ever visited stays expanded. Mostly useful for debugging.
+  bool gc;
+
+  /*implicit*/ LazyComposeFstOptions(int64_t cache_size = (1 << 26),
+                                     bool gc = true)
+      : cache_size(cache_size), gc(gc) {}
+
+  std::string ToString() const {
+    std::ostringstream os;
+
+    os << "LazyComposeFstOptions(";
+    os << "cache_size=" << cache_size << ", ";
+    os << "gc=" << (gc ? "True" : "False") << ")";
+
+    return os.str();
+  }
+};
+
+/** LazyComposeFst composes a lexicon/topology FST (e.g., HCL, or the CTC
+    topology H composed with L) with a grammar FST G on the fly.
+
+    Instead of building the full static HCLG, whose size grows with the
+    product of the lexicon and the LM, only the states of HCL o G that the
+    search actually visits are expanded, and they are kept in a bounded cache
+    (see LazyComposeFstOptions). Memory use is therefore proportional to the
+    active search space rather than to the size of the full graph.
+
+    GetFst() returns an fst::Fst<fst::StdArc>, so any decoder in this library
+    can be run on it unchanged, e.g.,
+
+    \code{.cc}
+      LazyComposeFst graph(hcl, g, LazyComposeFstOptions());
+      FasterDecoder decoder(graph.GetFst(), FasterDecoderOptions());
+    \endcode
+
+    Requirements:
+      - The output labels of hcl and the input labels of g must share the
+        same symbol table (word IDs), and disambiguation symbols must have
+        been removed (replaced by epsilons) from both of them.
+      - Either g is sorted on input labels (preferred, see fst::ArcSort with
+        fst::ILabelCompare) or hcl is sorted on output labels.
+
+    Caution: expanding a state modifies the cache, so the FST returned by
+    GetFst() must not be shared between threads; create one LazyComposeFst
+    per decoding thread instead, or expand it into a SharedGraph. The input
+    FSTs themselves are only read and can be shared. This object has to
+    outlive any decoder that uses it.
+ */
+class LazyComposeFst {
+ public:
+  LazyComposeFst(const fst::Fst<fst::StdArc> &hcl,
+                 const fst::Fst<fst::StdArc> &g,
+                 const LazyComposeFstOptions &opts);
+
+  LazyComposeFst(const LazyComposeFst &) = delete;
+  LazyComposeFst &operator=(const LazyComposeFst &) = delete;
+
+  const fst::Fst<fst::StdArc> &GetFst() const { return *fst_; }
+
+  const LazyComposeFstOptions &GetOptions() const { return opts_; }
+
+ private:
+  LazyComposeFstOptions opts_;
+  std::unique_ptr<fst::ComposeFst<fst::StdArc>> fst_;
+};
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_LAZY_COMPOSE_FST_H_
@@ -0,0 +1,245 @@
+// kaldi-decoder/csrc/linear-aligner-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/linear-aligner.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/test-utils.h"
+
+namespace kaldi_decoder {
+
+// Viterbi over the whole (num_frames x num_states) grid
+static float FullViterbiCost(const LinearAlignmentGraph &graph,
+                             DecodableInterface *decodable) {
+  float infinity = std::numeric_limits<float>::infinity();
+  int32_t num_states = static_cast<int32_t>(graph.states.size());
+  std::vector<float> prev(num_states, infinity);
+  prev[0] = 0;
+
+  for (int32_t t = 0; t != decodable->NumFramesReady(); ++t) {
+    std::vector<float> cur(num_states, infinity);
+    for (int32_t s = 0; s != num_states; ++s) {
+      const auto &state = graph.states[s];
+      if (prev[s] == infinity) continue;
+
+      int32_t labels[3] = {state.loop_label, state.next_label,
+                           state.skip_label};
+      float costs[3] = {state.loop_cost, state.next_cost, state.skip_cost};
+      for (int32_t k = 0; k != 3; ++k) {
+        if (labels[k] == 0) continue;
+        float c =
+            prev[s] + costs[k] - decodable->LogLikelihood(t, labels[k]);
+        cur[s + k] = std::min(cur[s + k], c);
+      }
+    }
+    prev.swap(cur);
+  }
+
+  float ans = infinity;
+  for (int32_t s = 0; s != num_states; ++s) {
+    ans = std::min(ans, prev[s] + graph.states[s].final_cost);
+  }
+  return ans;
+}
+
+// Removes repeats and then blanks
+static std::vector<int32_t> CollapseCtc(const std::vector<int32_t> &alignment,
+                                        int32_t blank_id) {
+  std::vector<int32_t> ans;
+  int32_t prev = -1;
+  for (int32_t label : alignment) {
+    int32_t token = label - 1;
+    if (token != prev && token != blank_id) {
+      ans.push_back(token);
+    }
+    prev = token;
+  }
+  return ans;
+}
+
+TEST(LinearAligner, CtcGraph) {
+  LinearAlignmentGraph graph = BuildCtcAlignmentGraph({3, 3, 5}, 0);
+
+  // start, blank, 3, blank, 3, blank, 5, blank
+  ASSERT_EQ(graph.states.size(), 8);
+  const auto &s = graph.states;
+
+  EXPECT_EQ(s[0].loop_label, 0);
+  EXPECT_EQ(s[0].next_label, 1);
+  EXPECT_EQ(s[0].skip_label, 4);
+
+  EXPECT_EQ(s[2].loop_label, 4);
+  EXPECT_EQ(s[2].next_label, 1);
+  EXPECT_EQ(s[2].skip_label, 0);  // the blank between equal tokens
+
+  EXPECT_EQ(s[4].skip_label, 6);
+  EXPECT_EQ(s[6].skip_label, 0);
+  EXPECT_EQ(s[7].next_label, 0);
+
+  for (int32_t i = 0; i != 6; ++i) {
+    EXPECT_EQ(s[i].final_cost, std::numeric_limits<float>::infinity());
+  }
+  EXPECT_EQ(s[6].final_cost, 0);
+  EXPECT_EQ(s[7].final_cost, 0);
+
+  EXPECT_THROW(BuildCtcAlignmentGraph({3, 0}, 0), std::runtime_error);
+}
+
+TEST(LinearAligner, CtcMatchesFullViterbi) {
+  int32_t vocab_size = 10;
+  for (int32_t iter = 0; iter != 20; ++iter) {
+    int32_t num_tokens = 1 + std::rand() % 8;
+    std::vector<int32_t> tokens(num_tokens);
+    for (auto &t : tokens) {
+      t = 1 + std::rand() % (vocab_size - 1);
+    }
+    int32_t num_frames = 2 * num_tokens + std::rand() % 20;
+
+    LinearAlignmentGraph graph = BuildCtcAlignmentGraph(tokens);
+    FloatMatrix log_probs = RandnMatrix(num_frames, vocab_size);
+    DecodableCtc decodable(log_probs);
+
+    // The band covers the whole graph
+    LinearAligner aligner(graph, LinearAlignerOptions(1000));
+    std::vector<int32_t> alignment;
+    std::vector<int32_t> states;
+    ASSERT_TRUE(aligner.Align(&decodable, &alignment, &states));
+    ASSERT_EQ(alignment.size(), num_frames);
+    ASSERT_EQ(states.size(), num_frames);
+
+    EXPECT_NEAR(aligner.TotalCost(), FullViterbiCost(graph, &decodable),
+                1e-3);
+    EXPECT_EQ(CollapseCtc(alignment, 0), tokens);
+
+    float cost = 0;
+    for (int32_t t = 0; t != num_frames; ++t) {
+      cost -= decodable.LogLikelihood(t, alignment[t]);
+      if (t > 0) {
+        EXPECT_LE(states[t - 1], states[t]);
+        EXPECT_LE(states[t], states[t - 1] + 2);
+      }
+    }
+    EXPECT_NEAR(aligner.TotalCost(), cost, 1e-3);
+  }
+}
+
+TEST(LinearAligner, Band) {
+  int32_t vocab_size = 30;
+  int32_t num_tokens = 200;
+  int32_t num_frames = 1000;
+  std::vector<int32_t> tokens(num_tokens);
+  for (auto &t : tokens) {
+    t = 1 + std::rand() % (vocab_size - 1);
+  }
+
+  // Each token gets the same share of the frames, starting with a blank
+  std::vector<int32_t> frame_tokens(num_frames);
+  for (int32_t t = 0; t != num_frames; ++t) {
+    int32_t i = t * num_tokens / num_frames;
+    int32_t first = (i * num_frames + num_tokens - 1) / num_tokens;
+    frame_tokens[t] = t == first ? 0 : tokens[i];
+  }
+
+  LinearAlignmentGraph graph = BuildCtcAlignmentGraph(tokens);
+  FloatMatrix log_probs =
+      PeakyLogProbs(frame_tokens, vocab_size, 5, 1, /*seed=*/0);
+  DecodableCtc decodable(log_probs);
+
+  // The band covers 20 of the 402 states
+  LinearAligner aligner(graph, LinearAlignerOptions(20));
+  std::vector<int32_t> alignment;
+  ASSERT_TRUE(aligner.Align(&decodable, &alignment));
+  EXPECT_NEAR(aligner.TotalCost(), FullViterbiCost(graph, &decodable), 1e-2);
+  EXPECT_EQ(CollapseCtc(alignment, 0), tokens);
+}
+
+TEST(LinearAligner, Retry) {
+  // A chain of 10 states whose only final state is state 3
+  LinearAlignmentGraph graph;
+  graph.states.resize(10);
+  for (int32_t s = 0; s != 10; ++s) {
+    if (s > 0) {
+      graph.states[s].loop_label = s + 1;
+    }
+    if (s < 9) {
+      graph.states[s].next_label = s + 2;
+    }
+  }
+  graph.states[3].final_cost = 0;
+
+  // The later states have better scores, so a narrow band moves past it
+  FloatMatrix log_probs(20, 10);
+  for (int32_t j = 0; j != 10; ++j) {
+    log_probs.col(j).setConstant(-1 + 0.1 * j);
+  }
+  DecodableCtc decodable(log_probs);
+
+  std::vector<int32_t> alignment;
+  LinearAligner narrow(graph, LinearAlignerOptions(3));
+  EXPECT_FALSE(narrow.Align(&decodable, &alignment));
+
+  LinearAligner retry(graph, LinearAlignerOptions(3, 10));
+  std::vector<int32_t> states;
+  ASSERT_TRUE(retry.Align(&decodable, &alignment, &states));
+  EXPECT_NEAR(retry.TotalCost(), FullViterbiCost(graph, &decodable), 1e-3);
+  EXPECT_EQ(states.back(), 3);
+}
+
+TEST(LinearAligner, TooFewFrames) {
+  LinearAlignmentGraph graph = BuildCtcAlignmentGraph({1, 1, 2});
+  FloatMatrix log_probs = RandnMatrix(3, 3);
+  DecodableCtc decodable(log_probs);
+
+  // "1 1 2" needs at least 4 frames: 1 blank 1 2
+  LinearAligner aligner(graph);
+  std::vector<int32_t> alignment;
+  EXPECT_FALSE(aligner.Align(&decodable, &alignment));
+}
+
+TEST(LinearAligner, FromFst) {
+  // A 3-state HMM for each of 2 phones, with transition costs
+  fst::StdVectorFst f;
+  for (int32_t s = 0; s != 7; ++s) {
+    f.AddState();
+  }
+  f.SetStart(0);
+  for (int32_t s = 0; s != 6; ++s) {
+    if (s > 0) {
+      f.AddArc(s, fst::StdArc(2 * s + 1, 0, 0.7, s));
+    }
+    f.AddArc(s, fst::StdArc(2 * s + 2, s == 0 ? 10 : 0, 0.3, s + 1));
+  }
+  f.AddArc(6, fst::StdArc(13, 0, 0.7, 6));
+  f.SetFinal(6, 0.5);
+
+  LinearAlignmentGraph graph = LinearAlignmentGraphFromFst(f);
+  ASSERT_EQ(graph.states.size(), 7);
+  EXPECT_EQ(graph.states[0].loop_label, 0);
+  EXPECT_EQ(graph.states[0].next_label, 2);
+  EXPECT_EQ(graph.states[3].loop_label, 7);
+  EXPECT_FLOAT_EQ(graph.states[3].loop_cost, 0.7);
+  EXPECT_EQ(graph.states[3].next_label, 8);
+  EXPECT_EQ(graph.states[3].skip_label, 0);
+  EXPECT_FLOAT_EQ(graph.states[6].final_cost, 0.5);
+
+  FloatMatrix log_probs = RandnMatrix(20, 13);
+  DecodableCtc decodable(log_probs);
+  LinearAligner aligner(graph);
+  std::vector<int32_t> alignment;
+  ASSERT_TRUE(aligner.Align(&decodable, &alignment));
+  EXPECT_NEAR(aligner.TotalCost(), FullViterbiCost(graph, &decodable), 1e-3);
+
+  // Not left-to-right
+  f.AddArc(3, fst::StdArc(1, 0, 0, 1));
+  EXPECT_THROW(LinearAlignmentGraphFromFst(f), std::runtime_error);
+}
+
+}  // namespace kaldi_decoder
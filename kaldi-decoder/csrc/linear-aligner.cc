@@ -0,0 +1,312 @@
+// kaldi-decoder/csrc/linear-aligner.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/linear-aligner.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace kaldi_decoder {
+
+LinearAlignmentGraph BuildCtcAlignmentGraph(const std::vector<int32_t> &tokens,
+                                            int32_t blank_id /*= 0*/) {
+  for (int32_t t : tokens) {
+    if (t < 0 || t == blank_id) {
+      KALDI_DECODER_ERR << "Invalid token " << t << " (blank is " << blank_id
+                        << ")";
+    }
+  }
+
+  // Position j of the extended sequence, i.e., with blanks around the tokens
+  int32_t num_positions = 2 * static_cast<int32_t>(tokens.size()) + 1;
+  auto position = [&tokens, blank_id](int32_t j) {
+    return j % 2 == 0 ? blank_id : tokens[j / 2];
+  };
+
+  LinearAlignmentGraph graph;
+  graph.states.resize(num_positions + 1);
+
+  // State 0 is the start state and state j + 1 the one after position j
+  for (int32_t s = 0; s <= num_positions; ++s) {
+    LinearAlignmentGraph::State &state = graph.states[s];
+    int32_t j = s - 1;  // -1 for the start state
+
+    if (j >= 0) {
+      state.loop_label = position(j) + 1;
+    }
+
+    if (j + 1 < num_positions) {
+      state.next_label = position(j + 1) + 1;
+    }
+
+    // Only a blank can be skipped, and not the one between equal tokens
+    if (j + 2 < num_positions && (j + 2) % 2 == 1 &&
+        (j < 0 || position(j) != position(j + 2))) {
+      state.skip_label = position(j + 2) + 1;
+    }
+  }
+
+  graph.states[num_positions].final_cost = 0;
+  if (num_positions > 1) {
+    graph.states[num_positions - 1].final_cost = 0;
+  } else {
+    // No tokens: an empty input is also accepted
+    graph.states[0].final_cost = 0;
+  }
+
+  return graph;
+}
+
+LinearAlignmentGraph LinearAlignmentGraphFromFst(
+    const fst::Fst<fst::StdArc> &fst) {
+  using StateId = fst::StdArc::StateId;
+
+  StateId num_states = 0;
+  for (fst::StateIterator<fst::Fst<fst::StdArc>> siter(fst); !siter.Done();
+       siter.Next()) {
+    num_states = std::max(num_states, siter.Value() + 1);
+  }
+
+  if (fst.Start() != 0) {
+    KALDI_DECODER_ERR << "The start state should be 0. Given: "
+                      << fst.Start();
+  }
+
+  LinearAlignmentGraph graph;
+  graph.states.resize(num_states);
+  for (StateId s = 0; s != num_states; ++s) {
+    LinearAlignmentGraph::State &state = graph.states[s];
+    state.final_cost = fst.Final(s).Value();
+
+    for (fst::ArcIterator<fst::Fst<fst::StdArc>> aiter(fst, s); !aiter.Done();
+         aiter.Next()) {
+      const auto &arc = aiter.Value();
+      if (arc.ilabel == 0) {
+        KALDI_DECODER_ERR << "State " << s
+                          << " has an arc with an epsilon input label";
+      }
+
+      int32_t *label = nullptr;
+      float *cost = nullptr;
+      switch (arc.nextstate - s) {
+        case 0:
+          label = &state.loop_label;
+          cost = &state.loop_cost;
+          break;
+        case 1:
+          label = &state.next_label;
+          cost = &state.next_cost;
+          break;
+        case 2:
+          label = &state.skip_label;
+          cost = &state.skip_cost;
+          break;
+        default:
+          KALDI_DECODER_ERR << "The arc from state " << s << " to state "
+                            << arc.nextstate
+                            << " is not left-to-right. Please sort the "
+                               "states topologically";
+      }
+
+      if (*label != 0) {
+        KALDI_DECODER_ERR << "State " << s << " has several arcs to state "
+                          << arc.nextstate;
+      }
+      *label = arc.ilabel;
+      *cost = arc.weight.Value();
+    }
+  }
+
+  return graph;
+}
+
+LinearAligner::LinearAligner(const LinearAlignmentGraph &graph,
+                             const LinearAlignerOptions &opts)
+    : opts_(opts) {
+  opts_.Check();
+
+  const auto &states = graph.states;
+  int32_t num_states = static_cast<int32_t>(states.size());
+  if (num_states == 0) {
+    KALDI_DECODER_ERR << "The alignment graph is empty";
+  }
+
+  for (int32_t k = 0; k != 3; ++k) {
+    in_labels_[k].resize(num_states, 0);
+    in_costs_[k].resize(num_states, 0);
+  }
+  final_costs_.resize(num_states);
+
+  first_final_ = -1;
+  for (int32_t s = 0; s != num_states; ++s) {
+    const LinearAlignmentGraph::State &state = states[s];
+    if ((state.next_label != 0 && s + 1 >= num_states) ||
+        (state.skip_label != 0 && s + 2 >= num_states)) {
+      KALDI_DECODER_ERR << "State " << s << " has an arc past the last state";
+    }
+
+    in_labels_[0][s] = state.loop_label;
+    in_costs_[0][s] = state.loop_cost;
+
+    if (s + 1 < num_states) {
+      in_labels_[1][s + 1] = state.next_label;
+      in_costs_[1][s + 1] = state.next_cost;
+    }
+
+    if (s + 2 < num_states) {
+      in_labels_[2][s + 2] = state.skip_label;
+      in_costs_[2][s + 2] = state.skip_cost;
+    }
+
+    final_costs_[s] = state.final_cost;
+    if (first_final_ == -1 &&
+        state.final_cost != std::numeric_limits<float>::infinity()) {
+      first_final_ = s;
+    }
+  }
+
+  if (first_final_ == -1) {
+    KALDI_DECODER_ERR << "The alignment graph has no final state";
+  }
+}
+
+bool LinearAligner::Align(DecodableInterface *decodable,
+                          std::vector<int32_t> *alignment,
+                          std::vector<int32_t> *states /*= nullptr*/) {
+  if (AlignWithBand(decodable, opts_.band_width, alignment, states)) {
+    return true;
+  }
+
+  if (opts_.retry_band_width > opts_.band_width) {
+    KALDI_DECODER_WARN << "Retrying with band width "
+                       << opts_.retry_band_width;
+    return AlignWithBand(decodable, opts_.retry_band_width, alignment,
+                         states);
+  }
+
+  return false;
+}
+
+bool LinearAligner::AlignWithBand(DecodableInterface *decodable,
+                                  int32_t band_width,
+                                  std::vector<int32_t> *alignment,
+                                  std::vector<int32_t> *states) {
+  constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+  int32_t num_states = static_cast<int32_t>(final_costs_.size());
+  int32_t num_frames = decodable->NumFramesReady();
+  total_cost_ = kInfinity;
+
+  // No arc skips more than one state
+  if (first_final_ > 2 * num_frames) {
+    return false;
+  }
+
+  int32_t width = std::min(band_width, num_states);
+
+  // The costs of the band of a frame are at index 2 and up, so that the
+  // states before it can be read as infinite costs. The last two are for
+  // the states after it.
+  prev_costs_.assign(width + 4, kInfinity);
+  cur_costs_.assign(width + 4, kInfinity);
+  for (auto &v : arc_costs_) {
+    v.resize(width);
+  }
+  band_begin_.resize(num_frames);
+  back_pointers_.resize(static_cast<size_t>(num_frames) * width);
+
+  // Before the first frame, the band starts at the start state
+  int32_t prev_begin = 0;
+  int32_t prev_best = 0;
+  prev_costs_[2] = 0;
+
+  for (int32_t t = 0; t != num_frames; ++t) {
+    // States from which no final state can be reached are left out. Then
+    // the band is centered on the best state if possible. It cannot move
+    // back and it cannot move by more than 2 states, since the states
+    // after that cannot be reached.
+    int32_t min_begin = first_final_ - 2 * (num_frames - 1 - t);
+    int32_t begin = std::max(prev_best - width / 2, min_begin);
+    begin = std::max(begin, prev_begin);
+    begin = std::min({begin, prev_begin + 2, num_states - width});
+    band_begin_[t] = begin;
+
+    for (int32_t k = 0; k != 3; ++k) {
+      const int32_t *labels = &in_labels_[k][begin];
+      const float *costs = &in_costs_[k][begin];
+      float *arc_costs = arc_costs_[k].data();
+      for (int32_t i = 0; i != width; ++i) {
+        arc_costs[i] = labels[i] == 0 ? kInfinity
+                                      : costs[i] - decodable->LogLikelihood(
+                                                       t, labels[i]);
+      }
+    }
+
+    // The dense part, which the compiler vectorizes
+    const float *prev = prev_costs_.data() + (begin - prev_begin);
+    const float *loop_costs = arc_costs_[0].data();
+    const float *next_costs = arc_costs_[1].data();
+    const float *skip_costs = arc_costs_[2].data();
+    float *cur = cur_costs_.data() + 2;
+    uint8_t *back_pointers = &back_pointers_[static_cast<size_t>(t) * width];
+    for (int32_t i = 0; i != width; ++i) {
+      float c0 = prev[i + 2] + loop_costs[i];
+      float c1 = prev[i + 1] + next_costs[i];
+      float c2 = prev[i] + skip_costs[i];
+
+      // Selecting the back-pointer with arithmetic instead of a conditional
+      // keeps the loop free of control flow
+      int32_t b1 = c1 < c0;
+      float c = c1 < c0 ? c1 : c0;
+      int32_t b2 = c2 < c;
+      c = c2 < c ? c2 : c;
+
+      cur[i] = c;
+      back_pointers[i] = static_cast<uint8_t>(b1 + b2 * (2 - b1));
+    }
+
+    int32_t best = std::min_element(cur, cur + width) - cur;
+    if (cur[best] == kInfinity) {
+      return false;
+    }
+
+    std::swap(prev_costs_, cur_costs_);
+    prev_begin = begin;
+    prev_best = begin + best;
+  }
+
+  int32_t end = -1;
+  for (int32_t i = 0; i != width; ++i) {
+    float c = prev_costs_[i + 2] + final_costs_[prev_begin + i];
+    if (c < total_cost_) {
+      total_cost_ = c;
+      end = prev_begin + i;
+    }
+  }
+
+  if (end == -1) {
+    return false;
+  }
+
+  alignment->resize(num_frames);
+  if (states) {
+    states->resize(num_frames);
+  }
+
+  int32_t s = end;
+  for (int32_t t = num_frames - 1; t >= 0; --t) {
+    int32_t k =
+        back_pointers_[static_cast<size_t>(t) * width + s - band_begin_[t]];
+    (*alignment)[t] = in_labels_[k][s];
+    if (states) {
+      (*states)[t] = s;
+    }
+    s -= k;
+  }
+  KALDI_DECODER_ASSERT(s == 0);
+
+  return true;
+}
+
+}  // namespace kaldi_decoder
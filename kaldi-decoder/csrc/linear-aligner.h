@@ -0,0 +1,159 @@
+// kaldi-decoder/csrc/linear-aligner.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_LINEAR_ALIGNER_H_
+#define KALDI_DECODER_CSRC_LINEAR_ALIGNER_H_
+
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "fst/fst.h"
+#include "kaldi-decoder/csrc/decodable-itf.h"
+#include "kaldi-decoder/csrc/log.h"
+
+namespace kaldi_decoder {
+
+/// A left-to-right alignment graph, e.g., the training graph of a single
+/// utterance. Its states form a chain: each state has at most one arc to
+/// itself, one to the next state and one to the state after it. Every arc
+/// consumes a frame. State 0 is the start state.
+///
+/// The labels are the indexes passed to DecodableInterface::LogLikelihood(),
+/// i.e., they are one-based. Label 0 means that there is no such arc.
+struct LinearAlignmentGraph {
+  struct State {
+    int32_t loop_label = 0;
+    float loop_cost = 0;
+
+    int32_t next_label = 0;  // arc to the next state
+    float next_cost = 0;
+
+    int32_t skip_label = 0;  // arc to the state after the next one
+    float skip_cost = 0;
+
+    float final_cost = std::numeric_limits<float>::infinity();
+  };
+
+  std::vector<State> states;
+};
+
+/** Builds the graph for the CTC forced alignment of a token sequence.
+
+    State 0 is the start state and state i + 1 is reached after emitting
+    position i of the token sequence extended with blanks, i.e.,
+    blank, tokens[0], blank, tokens[1], ..., blank. A token can be
+    repeated over several frames, the blanks can be skipped, except the one
+    between two equal tokens, and the alignment ends on the last token or on
+    the last blank. So for L tokens it has 2 * L + 2 states.
+
+    @param tokens    The token IDs, as the columns of the CTC output.
+    @param blank_id  The ID of the blank.
+    @return The graph. Its labels are token IDs plus 1, as in the CTC
+            topology used with DecodableCtc.
+ */
+LinearAlignmentGraph BuildCtcAlignmentGraph(const std::vector<int32_t> &tokens,
+                                            int32_t blank_id = 0);
+
+/// Converts an FST whose arcs only go from a state s to the state s, s + 1
+/// or s + 2, with at most one arc for each, to a LinearAlignmentGraph. The
+/// start state must be 0 and the input labels must not be epsilons; the
+/// output labels are ignored. It throws if the FST is not of that form.
+LinearAlignmentGraph LinearAlignmentGraphFromFst(
+    const fst::Fst<fst::StdArc> &fst);
+
+struct LinearAlignerOptions {
+  // Number of consecutive states of the graph that are kept for each frame.
+  // The band follows the best state, so it does not need to cover the whole
+  // graph. The memory for the back-pointers is num_frames * band_width
+  // bytes, independent of the size of the graph.
+  int32_t band_width;
+
+  // If positive and no alignment is found within band_width, it retries
+  // with this band width.
+  int32_t retry_band_width;
+
+  LinearAlignerOptions(int32_t band_width = 200, int32_t retry_band_width = 0)
+      : band_width(band_width), retry_band_width(retry_band_width) {}
+
+  void Check() const {
+    KALDI_DECODER_ASSERT(band_width >= 3 &&
+                         (retry_band_width <= 0 || retry_band_width >= 3));
+  }
+
+  std::string ToString() const {
+    std::ostringstream os;
+
+    os << "LinearAlignerOptions(";
+    os << "band_width=" << band_width << ", ";
+    os << "retry_band_width=" << retry_band_width << ")";
+
+    return os.str();
+  }
+};
+
+/** Viterbi alignment for LinearAlignmentGraph.
+
+    Unlike FasterDecoder, which treats such a graph like any other one, it
+    keeps no tokens and no hash table: for each frame, the costs of a band of
+    consecutive states are computed from those of the previous frame with a
+    branch-free loop over arrays, which the compiler vectorizes. The band
+    moves along the graph following the best state, at most two states per
+    frame since no arc goes further.
+ */
+class LinearAligner {
+ public:
+  // It copies the graph
+  LinearAligner(const LinearAlignmentGraph &graph,
+                const LinearAlignerOptions &opts = LinearAlignerOptions());
+
+  const LinearAlignerOptions &GetOptions() const { return opts_; }
+
+  /** Aligns all the frames of the decodable.
+
+      @param decodable  The acoustic scores.
+      @param alignment  On success, the label of the arc taken on each frame.
+      @param states     If not NULL, on success, the state reached after
+                        each frame.
+      @return true if the graph could be aligned, i.e., a final state was
+              reached after the last frame.
+   */
+  bool Align(DecodableInterface *decodable, std::vector<int32_t> *alignment,
+             std::vector<int32_t> *states = nullptr);
+
+  /// Returns the cost of the last successful alignment, including the
+  /// graph and the final costs.
+  float TotalCost() const { return total_cost_; }
+
+ private:
+  bool AlignWithBand(DecodableInterface *decodable, int32_t band_width,
+                     std::vector<int32_t> *alignment,
+                     std::vector<int32_t> *states);
+
+  LinearAlignerOptions opts_;
+
+  // Arcs entering each state, indexed by [kind][state], where kind 0 is the
+  // self-loop, kind 1 the arc from the previous state and kind 2 the arc
+  // from the state before it.
+  std::vector<int32_t> in_labels_[3];
+  std::vector<float> in_costs_[3];
+
+  std::vector<float> final_costs_;
+  int32_t first_final_ = 0;  // smallest final state
+
+  // Buffers, kept to avoid reallocations between utterances
+  std::vector<float> prev_costs_;
+  std::vector<float> cur_costs_;
+  std::vector<float> arc_costs_[3];
+  std::vector<int32_t> band_begin_;
+  std::vector<uint8_t> back_pointers_;
+
+  float total_cost_ = std::numeric_limits<float>::infinity();
+};
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_LINEAR_ALIGNER_H_
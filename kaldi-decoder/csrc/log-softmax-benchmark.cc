@@ -0,0 +1,81 @@
+// kaldi-decoder/csrc/log-softmax-benchmark.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+// Compares LogSoftmaxRows() with the per-row LogSumExp() that callers used
+// before, and its exact mode with the approximate one, on random logits of
+// the size of the CTC output of an utterance.
+//
+// Usage:
+//   ./bin/log-softmax-benchmark [num_frames] [num_tokens] [num_threads]
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/test-utils.h"
+
+namespace kaldi_decoder {
+
+template <class F>
+static double BestOf(int32_t num_runs, const FloatMatrix &logits,
+                     FloatMatrix *out, F f) {
+  double best = 0;
+  for (int32_t i = 0; i != num_runs; ++i) {
+    *out = logits;
+    auto start = std::chrono::steady_clock::now();
+    f(out);
+    double ms = ElapsedMs(start);
+    best = i == 0 ? ms : std::min(best, ms);
+  }
+  return best;
+}
+
+static void Run(int32_t num_frames, int32_t num_tokens, int32_t num_threads) {
+  FloatMatrix logits = RandnMatrix(num_frames, num_tokens, 0, 4, /*seed=*/0);
+
+  fprintf(stderr, "num_frames: %d, num_tokens: %d, num_threads: %d\n",
+          num_frames, num_tokens, num_threads);
+
+  const int32_t num_runs = 10;
+  FloatMatrix expected;
+  double row_ms = BestOf(num_runs, logits, &expected, [](FloatMatrix *m) {
+    for (int32_t r = 0; r != m->rows(); ++r) {
+      m->row(r).array() -= LogSumExp(m->row(r).transpose());
+    }
+  });
+
+  FloatMatrix exact;
+  double exact_ms =
+      BestOf(num_runs, logits, &exact, [num_threads](FloatMatrix *m) {
+        LogSoftmaxRows(m, false, num_threads);
+      });
+
+  FloatMatrix approx;
+  double approx_ms =
+      BestOf(num_runs, logits, &approx, [num_threads](FloatMatrix *m) {
+        LogSoftmaxRows(m, true, num_threads);
+      });
+
+  fprintf(stderr, "LogSumExp per row: %.2f ms (best of %d)\n", row_ms,
+          num_runs);
+  fprintf(stderr, "LogSoftmaxRows, exact: %.2f ms\n", exact_ms);
+  fprintf(stderr, "LogSoftmaxRows, approximate: %.2f ms\n", approx_ms);
+  fprintf(stderr, "Speedup of approximate: %.2f\n", row_ms / approx_ms);
+  fprintf(stderr, "Max abs error of exact: %g, of approximate: %g\n",
+          (exact - expected).cwiseAbs().maxCoeff(),
+          (approx - expected).cwiseAbs().maxCoeff());
+}
+
+}  // namespace kaldi_decoder
+
+int main(int argc, char *argv[]) {
+  int32_t num_frames = argc > 1 ? atoi(argv[1]) : 2000;
+  int32_t num_tokens = argc > 2 ? atoi(argv[2]) : 500;
+  int32_t num_threads = argc > 3 ? atoi(argv[3]) : 1;
+  kaldi_decoder::Run(num_frames, num_tokens, num_threads);
+  return 0;
+}
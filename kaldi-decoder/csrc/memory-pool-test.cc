@@ -0,0 +1,143 @@
+// kaldi-decoder/csrc/memory-pool-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/memory-pool.h"
+
+#include <unordered_map>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace kaldi_decoder {
+
+namespace {
+
+struct Foo {
+  Foo(int32_t a, double b) : a(a), b(b) {}
+  int32_t a;
+  double b;
+};
+
+}  // namespace
+
+TEST(MemoryPool, ReuseFreedElements) {
+  MemoryPool<Foo> pool;
+  std::vector<Foo *> v;
+  for (int32_t i = 0; i != 3000; ++i) {
+    v.push_back(pool.New(i, i * 0.5));
+  }
+  EXPECT_EQ(pool.NumInUse(), 3000);
+
+  for (int32_t i = 0; i != 3000; ++i) {
+    EXPECT_EQ(v[i]->a, i);
+    EXPECT_EQ(v[i]->b, i * 0.5);
+  }
+
+  size_t num_allocated = pool.NumAllocated();
+  EXPECT_GE(num_allocated, 3000);
+
+  for (int32_t k = 0; k != 3; ++k) {
+    for (auto p : v) {
+      pool.Delete(p);
+    }
+    EXPECT_EQ(pool.NumInUse(), 0);
+
+    for (int32_t i = 0; i != 3000; ++i) {
+      v[i] = pool.New(i, 0);
+    }
+
+    // No more memory is allocated for the same number of elements
+    EXPECT_EQ(pool.NumAllocated(), num_allocated);
+  }
+
+  for (auto p : v) {
+    pool.Delete(p);
+  }
+}
+
+TEST(IndexPool, ReuseFreedElements) {
+  IndexPool<Foo> pool;
+  EXPECT_EQ(pool.ElemSize(), sizeof(Foo));
+
+  std::vector<uint32_t> v;
+  std::vector<Foo *> addresses;
+  for (int32_t i = 0; i != 3000; ++i) {
+    v.push_back(pool.New(i, i * 0.5));
+    addresses.push_back(&pool[v.back()]);
+  }
+  EXPECT_EQ(pool.NumInUse(), 3000);
+
+  // Elements do not move when the pool grows
+  for (int32_t i = 0; i != 3000; ++i) {
+    EXPECT_EQ(&pool[v[i]], addresses[i]);
+    EXPECT_EQ(pool[v[i]].a, i);
+    EXPECT_EQ(pool[v[i]].b, i * 0.5);
+  }
+
+  size_t num_allocated = pool.NumAllocated();
+  EXPECT_GE(num_allocated, 3000);
+
+  for (int32_t k = 0; k != 3; ++k) {
+    for (auto i : v) {
+      pool.Delete(i);
+    }
+    EXPECT_EQ(pool.NumInUse(), 0);
+
+    for (int32_t i = 0; i != 3000; ++i) {
+      v[i] = pool.New(i, 0);
+      EXPECT_LT(v[i], num_allocated);
+    }
+
+    EXPECT_EQ(pool.NumAllocated(), num_allocated);
+  }
+
+  for (auto i : v) {
+    pool.Delete(i);
+  }
+}
+
+TEST(PoolAllocator, UnorderedMap) {
+  using Map =
+      std::unordered_map<int32_t, float, std::hash<int32_t>,
+                         std::equal_to<int32_t>,
+                         PoolAllocator<std::pair<const int32_t, float>>>;
+  FixedSizePool pool;
+  {
+    Map a{Map::allocator_type(&pool)};
+    Map b{Map::allocator_type(&pool)};
+    for (int32_t i = 0; i != 2000; ++i) {
+      a[i] = i;
+    }
+    EXPECT_EQ(pool.NumInUse(), 2000);
+
+    // Like the maps for the previous and current frames in a decoder
+    size_t num_allocated = 0;
+    for (int32_t k = 0; k != 4; ++k) {
+      a.swap(b);
+      EXPECT_TRUE(a.empty());
+      for (int32_t i = 0; i != 2000; ++i) {
+        a[i] = i + k;
+      }
+      EXPECT_EQ(pool.NumInUse(), 4000);
+      b.clear();
+      EXPECT_EQ(pool.NumInUse(), 2000);
+
+      if (k == 0) {
+        num_allocated = pool.NumAllocated();
+      } else {
+        EXPECT_EQ(pool.NumAllocated(), num_allocated);
+      }
+    }
+
+    EXPECT_EQ(a.at(10), 13);
+  }
+  EXPECT_EQ(pool.NumInUse(), 0);
+
+  // Without a pool, it behaves like std::allocator
+  Map c;
+  c[1] = 2;
+  EXPECT_EQ(c.at(1), 2);
+}
+
+}  // namespace kaldi_decoder
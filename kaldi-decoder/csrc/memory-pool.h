@@ -0,0 +1,322 @@
+// kaldi-decoder/csrc/memory-pool.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_MEMORY_POOL_H_
+#define KALDI_DECODER_CSRC_MEMORY_POOL_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "kaldi-decoder/csrc/log.h"
+
+/* This header provides the free-list allocators used by the decoders to
+   avoid a new/delete for every token and link. It follows the scheme used for
+   the Elems of HashList: memory is obtained from the system in blocks, freed
+   elements are kept in a singly linked free list and reused, and nothing is
+   given back to the system before the pool is destroyed. Once a decoder has
+   seen its peak number of tokens, decoding further utterances with it does
+   not allocate at all.
+
+   None of the classes here is thread-safe; each decoder owns its pools.
+*/
+
+namespace kaldi_decoder {
+
+/// A pool of fixed-size, untyped memory chunks. The chunk size is either
+/// given to the constructor or, if it is 0, fixed by the first call to
+/// Accepts().
+class FixedSizePool {
+ public:
+  explicit FixedSizePool(size_t elem_size = 0) {
+    if (elem_size != 0) {
+      SetElemSize(elem_size);
+    }
+  }
+
+  FixedSizePool(const FixedSizePool &) = delete;
+  FixedSizePool &operator=(const FixedSizePool &) = delete;
+
+  ~FixedSizePool() {
+    if (num_in_use_ != 0) {
+      KALDI_DECODER_WARN << "Possible memory leak: " << num_in_use_
+                         << " elements are still in use";
+    }
+  }
+
+  /// Returns true if chunks of this pool can hold "size" bytes. If the chunk
+  /// size has not been fixed yet, it is set to "size".
+  bool Accepts(size_t size) {
+    if (elem_size_ == 0) {
+      SetElemSize(size);
+    }
+    return RoundUp(size) == elem_size_;
+  }
+
+  inline void *Allocate() {
+    if (freed_head_ == nullptr) {
+      AllocateBlock();
+    }
+
+    FreeElem *ans = freed_head_;
+    freed_head_ = freed_head_->next;
+    ++num_in_use_;
+    return ans;
+  }
+
+  inline void Free(void *p) {
+    FreeElem *e = static_cast<FreeElem *>(p);
+    e->next = freed_head_;
+    freed_head_ = e;
+    --num_in_use_;
+  }
+
+  /// Size in bytes of each chunk
+  size_t ElemSize() const { return elem_size_; }
+
+  /// Number of chunks obtained from the system, i.e., the capacity
+  size_t NumAllocated() const { return blocks_.size() * kBlockSize; }
+
+  /// Number of chunks handed out by Allocate() and not yet freed
+  size_t NumInUse() const { return num_in_use_; }
+
+ private:
+  struct FreeElem {
+    FreeElem *next;
+  };
+
+  // Number of elements to allocate in one block.
+  static constexpr size_t kBlockSize = 1024;
+  static constexpr size_t kAlign = alignof(std::max_align_t);
+
+  static size_t RoundUp(size_t size) {
+    size = std::max(size, sizeof(FreeElem));
+    return (size + kAlign - 1) / kAlign * kAlign;
+  }
+
+  void SetElemSize(size_t elem_size) {
+    KALDI_DECODER_ASSERT(elem_size_ == 0);
+    elem_size_ = RoundUp(elem_size);
+  }
+
+  void AllocateBlock() {
+    KALDI_DECODER_ASSERT(elem_size_ != 0);
+    // new char[] returns memory aligned for any fundamental type
+    blocks_.emplace_back(new char[elem_size_ * kBlockSize]);
+    char *p = blocks_.back().get();
+    for (size_t i = 0; i != kBlockSize; ++i) {
+      FreeElem *e = reinterpret_cast<FreeElem *>(p + i * elem_size_);
+      e->next = freed_head_;
+      freed_head_ = e;
+    }
+  }
+
+  size_t elem_size_ = 0;
+  FreeElem *freed_head_ = nullptr;
+  size_t num_in_use_ = 0;
+  std::vector<std::unique_ptr<char[]>> blocks_;
+};
+
+/// A typed object pool, e.g., for the tokens of a decoder. Use New() and
+/// Delete() in place of operator new and delete.
+template <class T>
+class MemoryPool {
+ public:
+  static_assert(alignof(T) <= alignof(std::max_align_t),
+                "Over-aligned types are not supported");
+
+  MemoryPool() : pool_(sizeof(T)) {}
+
+  template <typename... Args>
+  inline T *New(Args &&...args) {
+    return new (pool_.Allocate()) T(std::forward<Args>(args)...);
+  }
+
+  inline void Delete(T *t) {
+    t->~T();
+    pool_.Free(t);
+  }
+
+  size_t NumAllocated() const { return pool_.NumAllocated(); }
+
+  size_t NumInUse() const { return pool_.NumInUse(); }
+
+  size_t ElemSize() const { return pool_.ElemSize(); }
+
+ private:
+  FixedSizePool pool_;
+};
+
+/// A typed object pool whose elements are referred to by 32-bit indexes
+/// instead of pointers, e.g., for the links of a lattice: an index takes
+/// half the space of a pointer, and the elements are packed without the
+/// padding of FixedSizePool. Use New() and Delete() in place of operator
+/// new and delete, and operator[] to get the element of an index.
+///
+/// Elements are stored in blocks and never move, so pointers to them stay
+/// valid until they are deleted.
+template <class T>
+class IndexPool {
+ public:
+  static_assert(sizeof(T) >= sizeof(uint32_t),
+                "An element must be able to hold the index of the next free "
+                "element");
+  static_assert(alignof(T) <= alignof(std::max_align_t),
+                "Over-aligned types are not supported");
+
+  /// An index that refers to no element, like nullptr for pointers
+  static constexpr uint32_t kNoIndex = std::numeric_limits<uint32_t>::max();
+
+  IndexPool() = default;
+  IndexPool(const IndexPool &) = delete;
+  IndexPool &operator=(const IndexPool &) = delete;
+
+  ~IndexPool() {
+    if (num_in_use_ != 0) {
+      KALDI_DECODER_WARN << "Possible memory leak: " << num_in_use_
+                         << " elements are still in use";
+    }
+  }
+
+  template <typename... Args>
+  inline uint32_t New(Args &&...args) {
+    uint32_t i = freed_head_;
+    if (i != kNoIndex) {
+      std::memcpy(&freed_head_, Address(i), sizeof(uint32_t));
+    } else {
+      if (num_allocated_ == blocks_.size() * kBlockSize) {
+        AllocateBlock();
+      }
+      i = num_allocated_++;
+    }
+
+    new (Address(i)) T(std::forward<Args>(args)...);
+    ++num_in_use_;
+    return i;
+  }
+
+  inline void Delete(uint32_t i) {
+    (*this)[i].~T();
+    std::memcpy(Address(i), &freed_head_, sizeof(uint32_t));
+    freed_head_ = i;
+    --num_in_use_;
+  }
+
+  inline T &operator[](uint32_t i) {
+    return *reinterpret_cast<T *>(Address(i));
+  }
+
+  inline const T &operator[](uint32_t i) const {
+    return *reinterpret_cast<const T *>(
+        blocks_[i >> kBlockBits].get() + (i & (kBlockSize - 1)) * sizeof(T));
+  }
+
+  /// Number of elements obtained from the system, i.e., the capacity
+  size_t NumAllocated() const { return blocks_.size() * kBlockSize; }
+
+  /// Number of elements created by New() and not yet deleted
+  size_t NumInUse() const { return num_in_use_; }
+
+  /// Size in bytes of each element
+  size_t ElemSize() const { return sizeof(T); }
+
+ private:
+  // Number of elements in one block, as for FixedSizePool
+  static constexpr uint32_t kBlockBits = 10;
+  static constexpr uint32_t kBlockSize = 1 << kBlockBits;
+
+  char *Address(uint32_t i) {
+    return blocks_[i >> kBlockBits].get() + (i & (kBlockSize - 1)) * sizeof(T);
+  }
+
+  void AllocateBlock() {
+    if (NumAllocated() + kBlockSize > kNoIndex) {
+      KALDI_DECODER_ERR << "Too many elements for 32-bit indexes";
+    }
+    // new char[] returns memory aligned for any fundamental type
+    blocks_.emplace_back(new char[sizeof(T) * kBlockSize]);
+  }
+
+  // The freed elements form a singly linked list; the index of the next
+  // one is stored in the memory of an element.
+  uint32_t freed_head_ = kNoIndex;
+
+  // Elements [0, num_allocated_) have been handed out by New() at least once
+  uint32_t num_allocated_ = 0;
+  size_t num_in_use_ = 0;
+  std::vector<std::unique_ptr<char[]>> blocks_;
+};
+
+/// An STL allocator that takes single elements from a FixedSizePool, so that
+/// the nodes of node-based containers such as std::unordered_map are
+/// recycled. Allocations of arrays (e.g., the buckets of a hash table) and of
+/// elements that do not fit in the chunks of the pool go to the system.
+/// A default-constructed allocator does not use a pool at all.
+///
+/// Containers sharing the same pool can be swapped with each other.
+template <class T>
+class PoolAllocator {
+ public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  PoolAllocator() = default;
+
+  explicit PoolAllocator(FixedSizePool *pool) : pool_(pool) {}
+
+  template <class U>
+  PoolAllocator(const PoolAllocator<U> &other)  // NOLINT
+      : pool_(other.pool()) {}
+
+  T *allocate(size_t n) {
+    if (UsePool(n)) {
+      return static_cast<T *>(pool_->Allocate());
+    }
+    return static_cast<T *>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T *p, size_t n) {
+    if (UsePool(n)) {
+      pool_->Free(p);
+    } else {
+      ::operator delete(p);
+    }
+  }
+
+  FixedSizePool *pool() const { return pool_; }
+
+ private:
+  // The decision only depends on n and sizeof(T) once the chunk size of the
+  // pool is fixed, so deallocate() always agrees with allocate().
+  bool UsePool(size_t n) const {
+    return pool_ != nullptr && n == 1 &&
+           alignof(T) <= alignof(std::max_align_t) &&
+           pool_->Accepts(sizeof(T));
+  }
+
+  FixedSizePool *pool_ = nullptr;
+};
+
+template <class T, class U>
+bool operator==(const PoolAllocator<T> &a, const PoolAllocator<U> &b) {
+  return a.pool() == b.pool();
+}
+
+template <class T, class U>
+bool operator!=(const PoolAllocator<T> &a, const PoolAllocator<U> &b) {
+  return a.pool() != b.pool();
+}
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_MEMORY_POOL_H_
@@ -0,0 +1,49 @@
+// kaldi-decoder/csrc/numa-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/numa.h"
+
+#include <set>
+#include <thread>  // NOLINT
+
+#include "gtest/gtest.h"
+
+namespace kaldi_decoder {
+
+TEST(Numa, NodeCpus) {
+  ASSERT_GE(NumNumaNodes(), 1);
+
+  std::set<int32_t> cpus;
+  for (const auto &node : NumaNodeCpus()) {
+    EXPECT_FALSE(node.empty());
+    for (int32_t cpu : node) {
+      EXPECT_GE(cpu, 0);
+      EXPECT_TRUE(cpus.insert(cpu).second) << "CPU " << cpu << " twice";
+    }
+  }
+
+  int32_t node = CurrentNumaNode();
+  EXPECT_GE(node, 0);
+  EXPECT_LT(node, NumNumaNodes());
+}
+
+TEST(Numa, ScopedBinding) {
+  for (int32_t n = 0; n != NumNumaNodes() + 1; ++n) {
+    std::thread t([n]() {
+      ScopedNumaBinding binding(n);
+      // It fails if the node has none of the CPUs the thread may run on
+      if (binding.Node() == -1) {
+        return;
+      }
+      EXPECT_EQ(binding.Node(), n % NumNumaNodes());
+      for (int32_t i = 0; i != 10; ++i) {
+        EXPECT_EQ(CurrentNumaNode(), binding.Node());
+        std::this_thread::yield();
+      }
+    });
+    t.join();
+  }
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,165 @@
+// kaldi-decoder/csrc/numa.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/numa.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "kaldi-decoder/csrc/log.h"
+
+namespace kaldi_decoder {
+
+#if defined(__linux__)
+
+// Parses a list like "0-3,8-11" of /sys/devices/system/node
+static std::vector<int32_t> ReadList(const std::string &filename) {
+  std::vector<int32_t> ans;
+  std::ifstream is(filename);
+  std::string line;
+  if (!std::getline(is, line)) {
+    return ans;
+  }
+
+  std::istringstream ss(line);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    int32_t begin = 0;
+    int32_t end = 0;
+    char dash = 0;
+    std::istringstream rs(range);
+    if (!(rs >> begin)) {
+      continue;
+    }
+    end = (rs >> dash >> end) ? end : begin;
+    for (int32_t i = begin; i <= end; ++i) {
+      ans.push_back(i);
+    }
+  }
+  return ans;
+}
+
+static std::vector<std::vector<int32_t>> ReadNumaNodeCpus() {
+  std::vector<std::vector<int32_t>> ans;
+  const std::string dir = "/sys/devices/system/node/";
+  for (int32_t id : ReadList(dir + "online")) {
+    std::vector<int32_t> cpus =
+        ReadList(dir + "node" + std::to_string(id) + "/cpulist");
+    // Nodes with only memory are skipped
+    if (!cpus.empty()) {
+      ans.push_back(std::move(cpus));
+    }
+  }
+  return ans;
+}
+
+#else
+
+static std::vector<std::vector<int32_t>> ReadNumaNodeCpus() { return {}; }
+
+#endif
+
+const std::vector<std::vector<int32_t>> &NumaNodeCpus() {
+  static const std::vector<std::vector<int32_t>> ans = []() {
+    std::vector<std::vector<int32_t>> nodes = ReadNumaNodeCpus();
+    if (nodes.empty()) {
+      nodes.emplace_back();
+      int32_t n = std::max(1u, std::thread::hardware_concurrency());
+      for (int32_t i = 0; i != n; ++i) {
+        nodes[0].push_back(i);
+      }
+    }
+    return nodes;
+  }();
+  return ans;
+}
+
+int32_t CurrentNumaNode() {
+#if defined(__linux__)
+  // cpu_to_node[cpu] is the node of a CPU
+  static const std::vector<int32_t> cpu_to_node = []() {
+    std::vector<int32_t> ans;
+    const auto &nodes = NumaNodeCpus();
+    for (int32_t n = 0; n != static_cast<int32_t>(nodes.size()); ++n) {
+      for (int32_t cpu : nodes[n]) {
+        if (cpu >= static_cast<int32_t>(ans.size())) {
+          ans.resize(cpu + 1, 0);
+        }
+        ans[cpu] = n;
+      }
+    }
+    return ans;
+  }();
+
+  int32_t cpu = sched_getcpu();
+  if (cpu >= 0 && cpu < static_cast<int32_t>(cpu_to_node.size())) {
+    return cpu_to_node[cpu];
+  }
+#endif
+  return 0;
+}
+
+ScopedNumaBinding::ScopedNumaBinding(int32_t node) {
+#if defined(__linux__)
+  KALDI_DECODER_ASSERT(node >= 0);
+  node %= NumNumaNodes();
+
+  cpu_set_t old_set;
+  CPU_ZERO(&old_set);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(old_set), &old_set) !=
+      0) {
+    KALDI_DECODER_WARN << "Failed to get the CPU affinity of the thread";
+    return;
+  }
+
+  // Only the CPUs the thread may already run on, e.g., within the cpuset of
+  // a container
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int32_t cpu : NumaNodeCpus()[node]) {
+    if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &old_set)) {
+      CPU_SET(cpu, &set);
+    }
+  }
+
+  if (CPU_COUNT(&set) == 0 ||
+      pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+    KALDI_DECODER_WARN << "Failed to bind the thread to NUMA node " << node;
+    return;
+  }
+
+  for (int32_t cpu = 0; cpu != CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &old_set)) {
+      old_cpus_.push_back(cpu);
+    }
+  }
+  node_ = node;
+#endif
+}
+
+ScopedNumaBinding::~ScopedNumaBinding() {
+#if defined(__linux__)
+  if (node_ == -1) {
+    return;
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int32_t cpu : old_cpus_) {
+    CPU_SET(cpu, &set);
+  }
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,59 @@
+// kaldi-decoder/csrc/numa.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_NUMA_H_
+#define KALDI_DECODER_CSRC_NUMA_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace kaldi_decoder {
+
+// The CPUs of each NUMA node that has any, read once from
+// /sys/devices/system/node. NUMA nodes are referred to by their index in
+// this vector, which is not always the node ID of the kernel.
+//
+// On systems without NUMA support, e.g., macOS and Windows, there is a
+// single node with all the CPUs.
+const std::vector<std::vector<int32_t>> &NumaNodeCpus();
+
+inline int32_t NumNumaNodes() {
+  return static_cast<int32_t>(NumaNodeCpus().size());
+}
+
+// The NUMA node of the CPU the calling thread is running on, or 0 if it is
+// not known. Unless the thread is bound to a node (see ScopedNumaBinding),
+// the scheduler can move it to another node at any time.
+int32_t CurrentNumaNode();
+
+/** Binds the calling thread to the CPUs of a NUMA node until the end of the
+    scope, after which it can run on its previous CPUs again.
+
+    On Linux, memory is allocated by default on the node of the thread that
+    first writes to it, so the memory allocated by a bound thread is local
+    to its node.
+
+    It does nothing on systems without NUMA support.
+ */
+class ScopedNumaBinding {
+ public:
+  // node is an index into NumaNodeCpus(), modulo NumNumaNodes()
+  explicit ScopedNumaBinding(int32_t node);
+  ~ScopedNumaBinding();
+
+  ScopedNumaBinding(const ScopedNumaBinding &) = delete;
+  ScopedNumaBinding &operator=(const ScopedNumaBinding &) = delete;
+
+  // The node the thread is bound to, or -1 if binding failed or is not
+  // supported
+  int32_t Node() const { return node_; }
+
+ private:
+  int32_t node_ = -1;
+  std::vector<int32_t> old_cpus_;
+};
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_NUMA_H_
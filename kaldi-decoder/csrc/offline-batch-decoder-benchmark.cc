@@ -0,0 +1,94 @@
+// kaldi-decoder/csrc/offline-batch-decoder-benchmark.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+// Decodes a corpus of utterances of random lengths with OfflineBatchDecoder
+// and FasterDecoder, for 1, 2, 4, ... threads up to max_threads, and prints
+// the real-time factor, the speedup and the utilization of the threads.
+//
+// Usage:
+//   ./bin/offline-batch-decoder-benchmark [num_utterances] [max_threads]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/faster-decoder.h"
+#include "kaldi-decoder/csrc/offline-batch-decoder.h"
+#include "kaldi-decoder/csrc/test-utils.h"
+
+namespace kaldi_decoder {
+
+static void Run(int32_t num_utterances, int32_t max_threads) {
+  const int32_t num_labels = 500;
+  fst::StdVectorFst g = BuildLoopGraph(num_labels, 0, 0.01, 0);
+
+  // Between 1 and 30 seconds at 25 frames per second
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int32_t> length(25, 750);
+  std::vector<std::pair<std::string, FloatMatrix>> utterances;
+  for (int32_t i = 0; i != num_utterances; ++i) {
+    utterances.emplace_back(
+        "utt-" + std::to_string(i),
+        RandnMatrix(length(gen), num_labels, 0, 1, /*seed=*/i, max_threads));
+  }
+
+  OfflineBatchDecoderConfig config;
+  config.frame_shift_in_seconds = 0.04;
+
+  fprintf(stderr, "num_utterances: %d, hardware threads: %u\n",
+          num_utterances, std::thread::hardware_concurrency());
+
+  double one_thread_seconds = 0;
+  for (int32_t num_threads = 1; num_threads <= max_threads;
+       num_threads *= 2) {
+    config.num_threads = num_threads;
+    OfflineBatchDecoder<FasterDecoder> batch_decoder(
+        [&g]() {
+          return std::make_unique<FasterDecoder>(
+              g, FasterDecoderOptions(10, 2000));
+        },
+        config);
+
+    int64_t num_states = 0;
+    OfflineBatchStats stats = batch_decoder.Decode(
+        utterances,
+        [](FasterDecoder *decoder) {
+          fst::Lattice best_path;
+          decoder->GetBestPath(&best_path);
+          return best_path.NumStates();
+        },
+        [&](const std::string &, int32_t n) { num_states += n; });
+
+    if (num_threads == 1) {
+      one_thread_seconds = stats.wall_seconds;
+    }
+
+    double min_utilization = *std::min_element(stats.utilization.begin(),
+                                               stats.utilization.end());
+    fprintf(stderr,
+            "%2d threads: %.2f s, RTF %.4f, speedup %.2f, min utilization "
+            "%.2f, %d steals\n",
+            num_threads, stats.wall_seconds, stats.rtf,
+            one_thread_seconds / stats.wall_seconds, min_utilization,
+            stats.num_steals);
+  }
+}
+
+}  // namespace kaldi_decoder
+
+int main(int argc, char *argv[]) {
+  int32_t num_utterances = argc > 1 ? atoi(argv[1]) : 200;
+  int32_t max_threads =
+      argc > 2 ? atoi(argv[2])
+               : std::max(1u, std::thread::hardware_concurrency());
+  kaldi_decoder::Run(num_utterances, max_threads);
+  return 0;
+}
@@ -0,0 +1,215 @@
+// kaldi-decoder/csrc/offline-batch-decoder-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/offline-batch-decoder.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/faster-decoder.h"
+#include "kaldi-decoder/csrc/lattice-simple-decoder.h"
+#include "kaldi-decoder/csrc/numa.h"
+#include "kaldi-decoder/csrc/shared-graph.h"
+#include "kaldi-decoder/csrc/test-utils.h"
+
+namespace kaldi_decoder {
+
+static std::vector<int32_t> GetWords(const fst::Lattice &best_path) {
+  std::vector<int32_t> ans;
+  for (int32_t s = best_path.Start(); s != fst::kNoStateId;) {
+    fst::ArcIterator<fst::Lattice> aiter(best_path, s);
+    if (aiter.Done()) {
+      break;
+    }
+    if (aiter.Value().olabel != 0) {
+      ans.push_back(aiter.Value().olabel);
+    }
+    s = aiter.Value().nextstate;
+  }
+  return ans;
+}
+
+// Utterances of random lengths
+static std::vector<std::pair<std::string, FloatMatrix>> BuildCorpus(
+    int32_t num_utterances, int32_t num_labels) {
+  std::vector<std::pair<std::string, FloatMatrix>> ans;
+  for (int32_t i = 0; i != num_utterances; ++i) {
+    int32_t num_frames = 5 + (i * 37) % 120;
+    ans.emplace_back("utt-" + std::to_string(i),
+                     RandnMatrix(num_frames, num_labels, 0, 1, /*seed=*/i));
+  }
+  return ans;
+}
+
+TEST(OfflineBatchDecoder, SameAsSequential) {
+  fst::StdVectorFst g = BuildLoopGraph(6);
+  auto utterances = BuildCorpus(50, 6);
+
+  std::map<std::string, std::vector<int32_t>> expected;
+  FasterDecoder decoder(g, FasterDecoderOptions());
+  for (const auto &u : utterances) {
+    DecodableCtc decodable(u.second);
+    decoder.Decode(&decodable);
+    fst::Lattice best_path;
+    decoder.GetBestPath(&best_path);
+    expected[u.first] = GetWords(best_path);
+  }
+
+  OfflineBatchDecoderConfig config;
+  config.num_threads = 4;
+  std::atomic<int32_t> num_decoders(0);
+  OfflineBatchDecoder<FasterDecoder> batch_decoder(
+      [&]() {
+        ++num_decoders;
+        return std::make_unique<FasterDecoder>(g, FasterDecoderOptions());
+      },
+      config);
+
+  // Twice, to check that the decoders are reused
+  for (int32_t k = 0; k != 2; ++k) {
+    std::map<std::string, std::vector<int32_t>> results;
+    std::atomic<int32_t> num_writers(0);
+    OfflineBatchStats stats = batch_decoder.Decode(
+        utterances,
+        [](FasterDecoder *d) {
+          fst::Lattice best_path;
+          d->GetBestPath(&best_path);
+          return GetWords(best_path);
+        },
+        [&](const std::string &utt_id, std::vector<int32_t> &&words) {
+          // The writes are serialized
+          EXPECT_EQ(num_writers++, 0);
+          EXPECT_EQ(results.count(utt_id), 0);
+          results[utt_id] = std::move(words);
+          --num_writers;
+        });
+
+    EXPECT_EQ(results, expected);
+    EXPECT_EQ(stats.num_utterances, 50);
+
+    int64_t num_frames = 0;
+    for (const auto &u : utterances) {
+      num_frames += u.second.rows();
+    }
+    EXPECT_EQ(stats.num_frames, num_frames);
+    EXPECT_FLOAT_EQ(stats.audio_seconds, num_frames * 0.04);
+    EXPECT_GT(stats.rtf, 0);
+    ASSERT_EQ(stats.utilization.size(), 4);
+    for (double u : stats.utilization) {
+      EXPECT_GE(u, 0);
+      EXPECT_LE(u, 1.0 + 1e-6);
+    }
+  }
+  EXPECT_LE(num_decoders, 4);
+}
+
+TEST(OfflineBatchDecoder, LatticeDecoder) {
+  fst::StdVectorFst g = BuildLoopGraph(4);
+  auto utterances = BuildCorpus(9, 4);
+
+  OfflineBatchDecoderConfig config;
+  config.num_threads = 20;  // more threads than utterances
+  OfflineBatchDecoder<LatticeSimpleDecoder> batch_decoder(
+      [&]() {
+        return std::make_unique<LatticeSimpleDecoder>(
+            g, LatticeSimpleDecoderConfig(8.0, 4.0));
+      },
+      config);
+
+  std::vector<std::string> ids;
+  OfflineBatchStats stats = batch_decoder.Decode(
+      utterances,
+      [](LatticeSimpleDecoder *d) {
+        fst::Lattice lat;
+        d->GetRawLattice(&lat);
+        return lat.NumStates();
+      },
+      [&](const std::string &utt_id, int32_t num_states) {
+        EXPECT_GT(num_states, 0);
+        ids.push_back(utt_id);
+      });
+
+  EXPECT_EQ(ids.size(), 9);
+  EXPECT_EQ(stats.utilization.size(), 9);
+}
+
+TEST(OfflineBatchDecoder, BindNumaNodes) {
+  SharedGraph graph(BuildLoopGraph(6), SharedGraphConfig(true));
+  auto utterances = BuildCorpus(20, 6);
+
+  OfflineBatchDecoderConfig config;
+  config.num_threads = 3;
+  config.bind_numa_nodes = true;
+  OfflineBatchDecoder<FasterDecoder> batch_decoder(
+      [&]() {
+        // The copy of the node of the worker
+        return std::make_unique<FasterDecoder>(graph.GetFst(),
+                                               FasterDecoderOptions());
+      },
+      config);
+
+  int32_t num_written = 0;
+  OfflineBatchStats stats = batch_decoder.Decode(
+      utterances, [](FasterDecoder *d) { return d->NumFramesDecoded(); },
+      [&](const std::string &, int32_t) { ++num_written; });
+  EXPECT_EQ(num_written, 20);
+
+  ASSERT_EQ(stats.numa_nodes.size(), 3);
+  ASSERT_EQ(stats.thread_num_frames.size(), 3);
+  int64_t num_frames = 0;
+  for (int32_t t = 0; t != 3; ++t) {
+    if (stats.numa_nodes[t] != -1) {
+      EXPECT_EQ(stats.numa_nodes[t], t % NumNumaNodes());
+    }
+    num_frames += stats.thread_num_frames[t];
+  }
+  EXPECT_EQ(num_frames, stats.num_frames);
+}
+
+TEST(OfflineBatchDecoder, Error) {
+  fst::StdVectorFst g = BuildLoopGraph(4);
+  auto utterances = BuildCorpus(10, 4);
+
+  OfflineBatchDecoderConfig config;
+  config.num_threads = 3;
+  OfflineBatchDecoder<FasterDecoder> batch_decoder(
+      [&]() {
+        return std::make_unique<FasterDecoder>(g, FasterDecoderOptions());
+      },
+      config);
+
+  // The other utterances are still written
+  int32_t num_written = 0;
+  EXPECT_THROW(batch_decoder.Decode(
+                   utterances,
+                   [](FasterDecoder *d) {
+                     return d->NumFramesDecoded();
+                   },
+                   [&](const std::string &utt_id, int32_t) {
+                     if (utt_id == "utt-3") {
+                       KALDI_DECODER_ERR << "Cannot write " << utt_id;
+                     }
+                     ++num_written;
+                   }),
+               std::runtime_error);
+  EXPECT_EQ(num_written, 9);
+
+  config.num_threads = 0;
+  EXPECT_THROW((OfflineBatchDecoder<FasterDecoder>(
+                   [&]() {
+                     return std::make_unique<FasterDecoder>(
+                         g, FasterDecoderOptions());
+                   },
+                   config)),
+               std::runtime_error);
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,46 @@
+// kaldi-decoder/csrc/offline-batch-decoder.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/offline-batch-decoder.h"
+
+#include <sstream>
+
+namespace kaldi_decoder {
+
+std::string OfflineBatchDecoderConfig::ToString() const {
+  std::ostringstream os;
+
+  os << "OfflineBatchDecoderConfig(";
+  os << "num_threads=" << num_threads << ", ";
+  os << "frame_shift_in_seconds=" << frame_shift_in_seconds << ", ";
+  os << "bind_numa_nodes=" << (bind_numa_nodes ? "True" : "False") << ")";
+
+  return os.str();
+}
+
+std::string OfflineBatchStats::ToString() const {
+  std::ostringstream os;
+
+  os << "OfflineBatchStats(";
+  os << "num_utterances=" << num_utterances << ", ";
+  os << "num_frames=" << num_frames << ", ";
+  os << "audio_seconds=" << audio_seconds << ", ";
+  os << "wall_seconds=" << wall_seconds << ", ";
+  os << "rtf=" << rtf << ", ";
+  os << "num_steals=" << num_steals << ", ";
+  os << "utilization=[";
+  for (size_t i = 0; i != utilization.size(); ++i) {
+    os << (i ? ", " : "") << utilization[i];
+  }
+  os << "], ";
+  os << "numa_nodes=[";
+  for (size_t i = 0; i != numa_nodes.size(); ++i) {
+    os << (i ? ", " : "") << numa_nodes[i];
+  }
+  os << "])";
+
+  return os.str();
+}
+
+}  // namespace kaldi_decoder
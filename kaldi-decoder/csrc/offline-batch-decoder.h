@@ -0,0 +1,302 @@
+// kaldi-decoder/csrc/offline-batch-decoder.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_OFFLINE_BATCH_DECODER_H_
+#define KALDI_DECODER_CSRC_OFFLINE_BATCH_DECODER_H_
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <numeric>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/log.h"
+#include "kaldi-decoder/csrc/numa.h"
+
+namespace kaldi_decoder {
+
+struct OfflineBatchDecoderConfig {
+  // Number of threads, including the calling thread. Each one has its own
+  // decoder.
+  int32_t num_threads = 1;
+
+  // Duration of a frame of the log-probs, for the real-time factor
+  float frame_shift_in_seconds = 0.04;
+
+  // If true, thread t is bound to NUMA node t % NumNumaNodes() (see numa.h)
+  // during Decode(). Its decoder is created by the factory after the thread
+  // is bound, so with a SharedGraph replicated per NUMA node, each decoder
+  // reads the copy local to its thread.
+  bool bind_numa_nodes = false;
+
+  std::string ToString() const;
+};
+
+struct OfflineBatchStats {
+  int32_t num_utterances = 0;
+  int64_t num_frames = 0;
+
+  // num_frames times frame_shift_in_seconds
+  double audio_seconds = 0;
+
+  // From the start to the end of OfflineBatchDecoder::Decode()
+  double wall_seconds = 0;
+
+  // Real-time factor: wall_seconds / audio_seconds
+  double rtf = 0;
+
+  // Number of utterances that a thread took from the queue of another one
+  int32_t num_steals = 0;
+
+  // For each thread, the time spent decoding and extracting results, and
+  // its ratio to wall_seconds
+  std::vector<double> busy_seconds;
+  std::vector<double> utilization;
+
+  // For each thread, the number of frames it decoded, and the NUMA node it
+  // was bound to, or -1
+  std::vector<int64_t> thread_num_frames;
+  std::vector<int32_t> numa_nodes;
+
+  std::string ToString() const;
+};
+
+/** Decodes a corpus of utterances with a fixed number of threads, each of
+    which owns a decoder that is reused for all its utterances. The decoders
+    are created by a factory, e.g., with the same const graph, which is then
+    shared by all the threads.
+
+    The utterances are sorted by decreasing number of frames and dealt to
+    per-thread queues. A thread decodes the longest utterance of its own
+    queue, and when its queue is empty, it steals the shortest one of
+    another queue. Long utterances are thus started first and the short ones
+    fill in the end, so all the threads finish at about the same time.
+
+    Decoder is any decoder with Decode(DecodableInterface *), e.g.,
+    FasterDecoder, CtcDecoder or LatticeSimpleDecoder.
+
+    \code{.cc}
+      OfflineBatchDecoder<FasterDecoder> batch_decoder(
+          [&]() { return std::make_unique<FasterDecoder>(graph, opts); },
+          config);
+
+      OfflineBatchStats stats = batch_decoder.Decode(
+          utterances,
+          [](FasterDecoder *decoder) {
+            fst::Lattice best_path;
+            decoder->GetBestPath(&best_path);
+            return best_path;
+          },
+          [&](const std::string &utt_id, fst::Lattice &&best_path) {
+            WriteResult(os, utt_id, best_path);
+          });
+    \endcode
+ */
+template <class Decoder>
+class OfflineBatchDecoder {
+ public:
+  using Factory = std::function<std::unique_ptr<Decoder>()>;
+
+  // An utterance ID and its log-probs, with one row per frame as for
+  // DecodableCtc
+  using Utterance = std::pair<std::string, FloatMatrix>;
+
+  OfflineBatchDecoder(Factory factory, const OfflineBatchDecoderConfig &config)
+      : factory_(std::move(factory)), config_(config) {
+    KALDI_DECODER_ASSERT(factory_ != nullptr);
+    if (config_.num_threads <= 0) {
+      KALDI_DECODER_ERR << "num_threads should be positive. Given: "
+                        << config_.num_threads;
+    }
+  }
+
+  /// Decodes all the utterances and returns when they are written.
+  ///
+  /// @param extract  Called as extract(Decoder *decoder) after an utterance
+  ///                 is decoded, on the thread of the decoder; it returns
+  ///                 the result of the utterance, e.g., its best path or its
+  ///                 lattice. The threads call it concurrently.
+  /// @param write    Called as write(utt_id, std::move(result)) for each
+  ///                 utterance, in the order in which they are finished.
+  ///                 The calls are serialized, so it can write to a stream
+  ///                 without locking.
+  ///
+  /// If decoding an utterance throws, the other utterances are still
+  /// decoded, and the first exception is rethrown at the end.
+  ///
+  /// Decode() must not be called by several threads at the same time.
+  template <class Extract, class Write>
+  OfflineBatchStats Decode(const std::vector<Utterance> &utterances,
+                           Extract extract, Write write) {
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+
+    int32_t num_utterances = static_cast<int32_t>(utterances.size());
+    int32_t num_threads = std::max(
+        1, std::min(config_.num_threads, num_utterances));
+
+    OfflineBatchStats stats;
+    stats.num_utterances = num_utterances;
+    for (const auto &u : utterances) {
+      stats.num_frames += u.second.rows();
+    }
+
+    // Longest first, dealt round-robin, so that each queue has about the
+    // same number of frames
+    std::vector<int32_t> order(num_utterances);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int32_t a, int32_t b) {
+      return utterances[a].second.rows() > utterances[b].second.rows();
+    });
+
+    std::vector<Queue> queues(num_threads);
+    for (int32_t i = 0; i != num_utterances; ++i) {
+      queues[i % num_threads].indexes.push_back(order[i]);
+    }
+
+    std::mutex write_mutex;
+    std::exception_ptr error;
+    std::vector<double> busy_seconds(num_threads, 0);
+    std::vector<int32_t> num_steals(num_threads, 0);
+    std::vector<int64_t> thread_num_frames(num_threads, 0);
+    std::vector<int32_t> numa_nodes(num_threads, -1);
+
+    if (static_cast<int32_t>(decoders_.size()) < num_threads) {
+      decoders_.resize(num_threads);
+    }
+
+    auto worker = [&](int32_t t) {
+      std::unique_ptr<ScopedNumaBinding> binding;
+      if (config_.bind_numa_nodes) {
+        binding = std::make_unique<ScopedNumaBinding>(t);
+        numa_nodes[t] = binding->Node();
+      }
+
+      // Created by the thread itself on its first use, so that its memory
+      // is local to the thread
+      std::unique_ptr<Decoder> &decoder = decoders_[t];
+      int32_t i;
+      while (Next(&queues, t, &i, &num_steals[t])) {
+        // Decoding and extraction; the writing is serialized
+        auto begin = Clock::now();
+        Clock::time_point end;
+        try {
+          if (decoder == nullptr) {
+            decoder = factory_();
+            KALDI_DECODER_ASSERT(decoder != nullptr);
+          }
+
+          const FloatMatrix &log_probs = utterances[i].second;
+          DecodableCtc decodable(log_probs.data(), log_probs.rows(),
+                                 log_probs.cols());
+          decoder->Decode(&decodable);
+          auto result = extract(decoder.get());
+          end = Clock::now();
+          thread_num_frames[t] += log_probs.rows();
+
+          std::lock_guard<std::mutex> lock(write_mutex);
+          write(utterances[i].first, std::move(result));
+        } catch (...) {
+          if (end == Clock::time_point()) {
+            end = Clock::now();
+          }
+          std::lock_guard<std::mutex> lock(write_mutex);
+          if (!error) {
+            error = std::current_exception();
+          }
+        }
+        busy_seconds[t] += Seconds(end - begin);
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for (int32_t t = 1; t < num_threads; ++t) {
+      threads.emplace_back(worker, t);
+    }
+    worker(0);  // the calling thread is one of the workers
+    for (auto &t : threads) {
+      t.join();
+    }
+
+    if (error) {
+      std::rethrow_exception(error);
+    }
+
+    stats.audio_seconds = stats.num_frames * config_.frame_shift_in_seconds;
+    stats.wall_seconds = Seconds(Clock::now() - start);
+    stats.rtf = stats.audio_seconds > 0
+                    ? stats.wall_seconds / stats.audio_seconds
+                    : 0;
+    for (int32_t t = 0; t != num_threads; ++t) {
+      stats.num_steals += num_steals[t];
+      stats.busy_seconds.push_back(busy_seconds[t]);
+      stats.utilization.push_back(
+          stats.wall_seconds > 0 ? busy_seconds[t] / stats.wall_seconds : 0);
+    }
+    stats.thread_num_frames = std::move(thread_num_frames);
+    stats.numa_nodes = std::move(numa_nodes);
+    return stats;
+  }
+
+ private:
+  // The utterances of a thread, longest first
+  struct Queue {
+    std::mutex mutex;
+    std::deque<int32_t> indexes;
+  };
+
+  template <class Duration>
+  static double Seconds(Duration d) {
+    return std::chrono::duration<double>(d).count();
+  }
+
+  // Takes the next utterance of thread t: the front of its own queue, or
+  // else the back of the first non-empty queue after it. Returns false when
+  // all the queues are empty.
+  static bool Next(std::vector<Queue> *queues, int32_t t, int32_t *i,
+                   int32_t *num_steals) {
+    int32_t n = static_cast<int32_t>(queues->size());
+    {
+      Queue &q = (*queues)[t];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      if (!q.indexes.empty()) {
+        *i = q.indexes.front();
+        q.indexes.pop_front();
+        return true;
+      }
+    }
+
+    for (int32_t k = 1; k < n; ++k) {
+      Queue &q = (*queues)[(t + k) % n];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      if (!q.indexes.empty()) {
+        *i = q.indexes.back();
+        q.indexes.pop_back();
+        ++*num_steals;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  Factory factory_;
+  OfflineBatchDecoderConfig config_;
+
+  // One per thread, kept across calls of Decode()
+  std::vector<std::unique_ptr<Decoder>> decoders_;
+};
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_OFFLINE_BATCH_DECODER_H_
@@ -0,0 +1,113 @@
+// kaldi-decoder/csrc/prefetch-benchmark.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+// Measures FasterDecoderOptions::prefetch_distance with FasterDecoder and
+// CtcDecoder on a random graph much larger than the last-level cache, so
+// that the arcs of almost every active state are a cache miss.
+//
+// Usage:
+//   ./bin/prefetch-benchmark [num_states] [num_frames] [max_active]
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "kaldi-decoder/csrc/ctc-decoder.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/faster-decoder.h"
+#include "kaldi-decoder/csrc/test-utils.h"
+
+namespace kaldi_decoder {
+
+// 8 arcs per state to random states, so that the tokens of a frame are
+// scattered over the whole graph
+static fst::StdVectorFst BuildGraph(int32_t num_states, int32_t num_labels) {
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int32_t> state(0, num_states - 1);
+  std::uniform_int_distribution<int32_t> label(1, num_labels);
+  std::uniform_real_distribution<float> weight(0, 2);
+
+  fst::StdVectorFst g;
+  for (int32_t s = 0; s != num_states; ++s) {
+    g.AddState();
+    g.SetFinal(s, weight(gen));
+  }
+  g.SetStart(0);
+  for (int32_t s = 0; s != num_states; ++s) {
+    for (int32_t i = 0; i != 8; ++i) {
+      int32_t l = label(gen);
+      g.AddArc(s, fst::StdArc(l, l, weight(gen), state(gen)));
+    }
+  }
+  return g;
+}
+
+// Returns the best time of a few runs of Decode() and GetBestPath()
+template <class Decoder>
+static double Time(const fst::StdConstFst &graph,
+                   const FasterDecoderOptions &opts,
+                   DecodableInterface *decodable, fst::Lattice *best_path) {
+  const int32_t num_runs = 3;
+  Decoder decoder(graph, opts);
+  double best_ms = 0;
+  for (int32_t i = 0; i != num_runs; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    decoder.Decode(decodable);
+    decoder.GetBestPath(best_path);
+    double ms = ElapsedMs(start);
+    best_ms = i == 0 ? ms : std::min(best_ms, ms);
+  }
+  return best_ms;
+}
+
+static void Run(int32_t num_states, int32_t num_frames, int32_t max_active) {
+  const int32_t num_labels = 500;
+  fst::StdConstFst graph(BuildGraph(num_states, num_labels));
+
+  FloatMatrix log_probs = RandnMatrix(num_frames, num_labels + 1);
+  DecodableCtc decodable(log_probs);
+
+  fprintf(stderr, "num_states: %d, num_frames: %d, max_active: %d\n",
+          num_states, num_frames, max_active);
+  fprintf(stderr, "%8s %18s %18s\n", "distance", "FasterDecoder (ms)",
+          "CtcDecoder (ms)");
+
+  fst::Lattice expected_faster;
+  fst::Lattice expected_ctc;
+  for (int32_t distance : {0, 1, 2, 4, 8, 16}) {
+    FasterDecoderOptions opts(16.0, max_active);
+    opts.prefetch_distance = distance;
+
+    fst::Lattice faster_path;
+    fst::Lattice ctc_path;
+    double faster_ms =
+        Time<FasterDecoder>(graph, opts, &decodable, &faster_path);
+    double ctc_ms = Time<CtcDecoder>(graph, opts, &decodable, &ctc_path);
+
+    fprintf(stderr, "%8d %18.1f %18.1f\n", distance, faster_ms, ctc_ms);
+
+    // Prefetching must not change the results
+    if (distance == 0) {
+      expected_faster = faster_path;
+      expected_ctc = ctc_path;
+    } else if (faster_path.NumStates() != expected_faster.NumStates() ||
+               ctc_path.NumStates() != expected_ctc.NumStates()) {
+      fprintf(stderr, "Different best paths with distance %d\n", distance);
+    }
+  }
+}
+
+}  // namespace kaldi_decoder
+
+int main(int argc, char *argv[]) {
+  int32_t num_states = argc > 1 ? atoi(argv[1]) : (1 << 21);
+  int32_t num_frames = argc > 2 ? atoi(argv[2]) : 200;
+  int32_t max_active = argc > 3 ? atoi(argv[3]) : 7000;
+  kaldi_decoder::Run(num_states, num_frames, max_active);
+  return 0;
+}
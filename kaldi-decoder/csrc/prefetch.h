@@ -0,0 +1,62 @@
+// kaldi-decoder/csrc/prefetch.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_PREFETCH_H_
+#define KALDI_DECODER_CSRC_PREFETCH_H_
+
+#include <algorithm>
+#include <cstddef>
+
+#include "fst/fst.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+namespace kaldi_decoder {
+
+// Size of a cache line on the CPUs we care about
+constexpr size_t kCacheLineSize = 64;
+
+// At most this many bytes of the arcs of a state are prefetched, so that a
+// state with many arcs, e.g., the unigram state of an LM, does not evict
+// the lines of the other states
+constexpr size_t kMaxPrefetchArcBytes = 4 * kCacheLineSize;
+
+/// Asks the CPU to load the cache line of "p", without waiting for it. It
+/// does nothing on compilers without a prefetch intrinsic.
+inline void Prefetch(const void *p) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(p, /*rw=*/0, /*locality=*/3);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  _mm_prefetch(static_cast<const char *>(p), _MM_HINT_T0);
+#else
+  (void)p;
+#endif
+}
+
+/// Prefetches the arcs leaving state "s". The FST must be expanded, i.e.,
+/// have the property fst::kExpanded, e.g., fst::ConstFst and
+/// fst::VectorFst; the arcs of a lazy FST are computed when they are
+/// visited, which is not something to do ahead of time.
+template <class Arc>
+inline void PrefetchArcs(const fst::Fst<Arc> &fst, typename Arc::StateId s) {
+  fst::ArcIterator<fst::Fst<Arc>> aiter(fst, s);
+  if (aiter.Done()) {
+    return;
+  }
+
+  const char *begin = reinterpret_cast<const char *>(&aiter.Value());
+  size_t num_bytes =
+      std::min(fst.NumArcs(s) * sizeof(Arc), kMaxPrefetchArcBytes);
+  for (size_t i = 0; i < num_bytes; i += kCacheLineSize) {
+    Prefetch(begin + i);
+  }
+  // The arcs need not start at the beginning of a line
+  Prefetch(begin + num_bytes - 1);
+}
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_PREFETCH_H_
@@ -0,0 +1,120 @@
+// kaldi-decoder/csrc/shared-graph-benchmark.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+// Decodes a corpus with OfflineBatchDecoder, with threads bound to NUMA
+// nodes, and a SharedGraph that is either shared by all the nodes or
+// replicated per node. Prints the throughput of each node.
+//
+// Usage:
+//   ./bin/shared-graph-benchmark [num_states] [num_threads]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/faster-decoder.h"
+#include "kaldi-decoder/csrc/numa.h"
+#include "kaldi-decoder/csrc/offline-batch-decoder.h"
+#include "kaldi-decoder/csrc/shared-graph.h"
+
+namespace kaldi_decoder {
+
+// A large graph with random arcs, so that the search reads it all over the
+// place instead of from the caches
+static fst::StdVectorFst BuildGraph(int32_t num_states, int32_t num_labels) {
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int32_t> state(0, num_states - 1);
+  std::uniform_int_distribution<int32_t> label(1, num_labels);
+  std::uniform_real_distribution<float> weight(0, 2);
+
+  fst::StdVectorFst g;
+  for (int32_t s = 0; s != num_states; ++s) {
+    g.AddState();
+    g.SetFinal(s, weight(gen));
+  }
+  g.SetStart(0);
+  for (int32_t s = 0; s != num_states; ++s) {
+    for (int32_t i = 0; i != 8; ++i) {
+      int32_t l = label(gen);
+      g.AddArc(s, fst::StdArc(l, l, weight(gen), state(gen)));
+    }
+  }
+  return g;
+}
+
+static void Run(int32_t num_states, int32_t num_threads) {
+  const int32_t num_labels = 500;
+  fst::StdVectorFst g = BuildGraph(num_states, num_labels);
+
+  std::vector<std::pair<std::string, FloatMatrix>> utterances;
+  for (int32_t i = 0; i != 4 * num_threads; ++i) {
+    utterances.emplace_back(
+        "utt-" + std::to_string(i),
+        RandnMatrix(100, num_labels, 0, 1, /*seed=*/i, num_threads));
+  }
+
+  fprintf(stderr, "num_states: %d, num_threads: %d, NUMA nodes: %d\n",
+          num_states, num_threads, NumNumaNodes());
+
+  for (bool replicate : {false, true}) {
+    SharedGraph graph(g, SharedGraphConfig(replicate));
+
+    OfflineBatchDecoderConfig config;
+    config.num_threads = num_threads;
+    config.bind_numa_nodes = true;
+    OfflineBatchDecoder<FasterDecoder> batch_decoder(
+        [&graph]() {
+          return std::make_unique<FasterDecoder>(
+              graph.GetFst(), FasterDecoderOptions(8, 2000));
+        },
+        config);
+
+    OfflineBatchStats stats = batch_decoder.Decode(
+        utterances, [](FasterDecoder *d) { return d->NumFramesDecoded(); },
+        [](const std::string &, int32_t) {});
+
+    fprintf(stderr, "%s: %.2f s, RTF %.4f\n",
+            replicate ? "replicated per node" : "one copy", stats.wall_seconds,
+            stats.rtf);
+
+    for (int32_t n = -1; n != NumNumaNodes(); ++n) {
+      int32_t node_threads = 0;
+      int64_t node_frames = 0;
+      double node_busy_seconds = 0;
+      for (size_t t = 0; t != stats.numa_nodes.size(); ++t) {
+        if (stats.numa_nodes[t] == n) {
+          ++node_threads;
+          node_frames += stats.thread_num_frames[t];
+          node_busy_seconds += stats.busy_seconds[t];
+        }
+      }
+      if (node_threads == 0) {
+        continue;
+      }
+      fprintf(stderr,
+              "  node %2d: %d threads, %.0f frames/s, %.0f frames/s per "
+              "busy thread\n",
+              n, node_threads, node_frames / stats.wall_seconds,
+              node_busy_seconds > 0 ? node_frames / node_busy_seconds : 0);
+    }
+  }
+}
+
+}  // namespace kaldi_decoder
+
+int main(int argc, char *argv[]) {
+  int32_t num_states = argc > 1 ? atoi(argv[1]) : (1 << 20);
+  int32_t num_threads =
+      argc > 2 ? atoi(argv[2])
+               : std::max(1u, std::thread::hardware_concurrency());
+  kaldi_decoder::Run(num_states, num_threads);
+  return 0;
+}
@@ -0,0 +1,148 @@
+// kaldi-decoder/csrc/shared-graph-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/shared-graph.h"
+
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/faster-decoder.h"
+#include "kaldi-decoder/csrc/lattice-simple-decoder.h"
+#include "kaldi-decoder/csrc/lazy-compose-fst.h"
+#include "kaldi-decoder/csrc/numa.h"
+#include "kaldi-decoder/csrc/test-utils.h"
+
+namespace kaldi_decoder {
+
+static std::vector<int32_t> GetWords(const fst::Lattice &best_path) {
+  std::vector<int32_t> ans;
+  for (int32_t s = best_path.Start(); s != fst::kNoStateId;) {
+    fst::ArcIterator<fst::Lattice> aiter(best_path, s);
+    if (aiter.Done()) {
+      break;
+    }
+    if (aiter.Value().olabel != 0) {
+      ans.push_back(aiter.Value().olabel);
+    }
+    s = aiter.Value().nextstate;
+  }
+  return ans;
+}
+
+TEST(SharedGraph, Construct) {
+  fst::StdVectorFst g = BuildLoopGraph(5);
+
+  SharedGraph from_vector(g);
+  EXPECT_EQ(from_vector.GetFst().Type(), "const");
+  EXPECT_EQ(from_vector.NumStates(), 6);
+  EXPECT_EQ(from_vector.NumArcs(), 15);
+  EXPECT_EQ(from_vector.Properties() & fst::kMutable, 0);
+
+  // The arcs of a ConstFst are not copied
+  fst::StdConstFst const_fst(g);
+  SharedGraph from_const(const_fst);
+  EXPECT_EQ(&fst::ArcIterator<fst::StdFst>(from_const.GetFst(), 0).Value(),
+            &fst::ArcIterator<fst::StdFst>(const_fst, 0).Value());
+
+  // A lazy FST is expanded
+  fst::StdVectorFst hcl = BuildLoopGraph(5);
+  fst::ArcSort(&g, fst::ILabelCompare<fst::StdArc>());
+  LazyComposeFst lazy(hcl, g, LazyComposeFstOptions());
+  SharedGraph from_lazy(lazy.GetFst());
+  EXPECT_EQ(from_lazy.GetFst().Type(), "const");
+
+  EXPECT_THROW((SharedGraph(fst::StdVectorFst())), std::runtime_error);
+}
+
+TEST(SharedGraph, ReplicatePerNumaNode) {
+  fst::StdConstFst const_fst(BuildLoopGraph(5));
+  SharedGraph graph(const_fst, SharedGraphConfig(true));
+  ASSERT_EQ(graph.NumReplicas(), NumNumaNodes());
+  EXPECT_EQ(graph.NumStates(), 6);
+  EXPECT_EQ(graph.NumArcs(), 15);
+
+  // Each node has its own copy
+  EXPECT_NE(&fst::ArcIterator<fst::StdFst>(graph.GetFst(0), 0).Value(),
+            &fst::ArcIterator<fst::StdFst>(const_fst, 0).Value());
+
+  for (int32_t n = 0; n != NumNumaNodes(); ++n) {
+    std::thread t([&graph, n]() {
+      ScopedNumaBinding binding(n);
+      if (binding.Node() != -1) {
+        EXPECT_EQ(&graph.GetFst(), &graph.GetFst(n));
+      }
+    });
+    t.join();
+  }
+}
+
+// Many threads, each with its own decoders, decode with the same graph at the
+// same time. Build with -DKALDI_DECODER_ENABLE_TSAN=ON to check for data
+// races.
+TEST(SharedGraph, ConcurrentDecoding) {
+  const int32_t num_labels = 20;
+  const int32_t num_utterances = 16;
+  const int32_t num_threads = 8;
+
+  auto graph = std::make_shared<const SharedGraph>(BuildLoopGraph(num_labels));
+
+  std::vector<FloatMatrix> utterances;
+  for (int32_t i = 0; i != num_utterances; ++i) {
+    utterances.push_back(
+        RandnMatrix(10 + 7 * i, num_labels, 0, 1, /*seed=*/i));
+  }
+
+  std::vector<std::vector<int32_t>> expected(num_utterances);
+  {
+    FasterDecoder decoder(graph->GetFst(), FasterDecoderOptions(10));
+    for (int32_t i = 0; i != num_utterances; ++i) {
+      DecodableCtc decodable(utterances[i]);
+      decoder.Decode(&decodable);
+      fst::Lattice best_path;
+      decoder.GetBestPath(&best_path);
+      expected[i] = GetWords(best_path);
+    }
+  }
+
+  std::vector<int32_t> num_errors(num_threads, 0);
+  auto worker = [&](int32_t t) {
+    FasterDecoder faster(graph->GetFst(), FasterDecoderOptions(10));
+    LatticeSimpleDecoder lattice(graph->GetFst(),
+                                 LatticeSimpleDecoderConfig(10, 4));
+
+    // Each thread starts at a different utterance
+    for (int32_t k = 0; k != 2 * num_utterances; ++k) {
+      int32_t i = (t + k) % num_utterances;
+      DecodableCtc decodable(utterances[i]);
+
+      fst::Lattice best_path;
+      faster.Decode(&decodable);
+      faster.GetBestPath(&best_path);
+      num_errors[t] += GetWords(best_path) != expected[i];
+
+      lattice.Decode(&decodable);
+      fst::Lattice lat;
+      lattice.GetRawLattice(&lat);
+      num_errors[t] += lat.NumStates() == 0;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int32_t t = 0; t != num_threads; ++t) {
+    threads.emplace_back(worker, t);
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  for (int32_t t = 0; t != num_threads; ++t) {
+    EXPECT_EQ(num_errors[t], 0) << "thread " << t;
+  }
+}
+
+}  // namespace kaldi_decoder
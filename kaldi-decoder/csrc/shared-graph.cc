@@ -0,0 +1,71 @@
+// kaldi-decoder/csrc/shared-graph.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/shared-graph.h"
+
+#include <sstream>
+#include <thread>  // NOLINT
+
+#include "kaldi-decoder/csrc/log.h"
+#include "kaldi-decoder/csrc/numa.h"
+
+namespace kaldi_decoder {
+
+std::string SharedGraphConfig::ToString() const {
+  std::ostringstream os;
+
+  os << "SharedGraphConfig(";
+  os << "replicate_per_numa_node="
+     << (replicate_per_numa_node ? "True" : "False") << ")";
+
+  return os.str();
+}
+
+SharedGraph::SharedGraph(const fst::Fst<fst::StdArc> &fst,
+                         const SharedGraphConfig &config /*= {}*/)
+    : config_(config) {
+  if (fst.Start() == fst::kNoStateId) {
+    KALDI_DECODER_ERR << "The graph is empty";
+  }
+
+  if (config_.replicate_per_numa_node) {
+    fsts_.resize(NumNumaNodes());
+    for (int32_t n = 0; n != NumNumaNodes(); ++n) {
+      // Copied by a thread bound to the node, so that the pages are
+      // allocated on it. One node at a time, since copying reads the
+      // properties of fst, which may update them.
+      std::thread t([&fst, n, this]() {
+        ScopedNumaBinding binding(n);
+        fsts_[n] = std::make_unique<fst::StdConstFst>(fst);
+      });
+      t.join();
+    }
+  } else if (auto const_fst = dynamic_cast<const fst::StdConstFst *>(&fst)) {
+    // The copy constructor of a ConstFst shares its arrays
+    fsts_.push_back(std::make_unique<fst::StdConstFst>(*const_fst));
+  } else {
+    fsts_.push_back(std::make_unique<fst::StdConstFst>(fst));
+  }
+
+  // Before the graph is shared, so that nothing is left to be cached
+  for (const auto &f : fsts_) {
+    properties_ = f->Properties(fst::kFstProperties, true);
+  }
+
+  num_states_ = fsts_[0]->NumStates();
+  for (int32_t s = 0; s != num_states_; ++s) {
+    num_arcs_ += fsts_[0]->NumArcs(s);
+  }
+}
+
+const fst::Fst<fst::StdArc> &SharedGraph::GetFst() const {
+  return fsts_.size() == 1 ? *fsts_[0] : GetFst(CurrentNumaNode());
+}
+
+const fst::Fst<fst::StdArc> &SharedGraph::GetFst(int32_t numa_node) const {
+  KALDI_DECODER_ASSERT(numa_node >= 0);
+  return *fsts_[numa_node % fsts_.size()];
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,112 @@
+// kaldi-decoder/csrc/shared-graph.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_SHARED_GRAPH_H_
+#define KALDI_DECODER_CSRC_SHARED_GRAPH_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fst/fst.h"
+#include "fst/fstlib.h"
+
+namespace kaldi_decoder {
+
+struct SharedGraphConfig {
+  // If true, the graph is copied once per NUMA node (see numa.h), into
+  // memory local to the node, and GetFst() returns the copy of the node of
+  // the calling thread. It takes NumNumaNodes() times the memory, but on
+  // multi-socket machines, decoders no longer read the graph across
+  // sockets.
+  bool replicate_per_numa_node = false;
+
+  /*implicit*/ SharedGraphConfig(bool replicate_per_numa_node = false)
+      : replicate_per_numa_node(replicate_per_numa_node) {}
+
+  std::string ToString() const;
+};
+
+/** SharedGraph holds a read-only decoding graph that any number of threads
+    can decode with at the same time, each with its own decoder, so the graph
+    is in memory only once.
+
+    \code{.cc}
+      auto graph = std::make_shared<const SharedGraph>(hclg);
+
+      // On each thread
+      FasterDecoder decoder(graph->GetFst(), opts);
+    \endcode
+
+    Thread-safety: the graph is always an fst::ConstFst, whose states and
+    arcs are stored in flat arrays that are never modified after
+    construction. The decoders of this library that take a graph
+    (SimpleDecoder, FasterDecoder, CtcDecoder, LatticeSimpleDecoder and
+    LatticeIncrementalDecoder, and thus the decoder pools built on them)
+    only call Start(), Final(), NumArcs(), NumInputEpsilons() and arc
+    iterators on their graph, which are pure reads for a ConstFst. The one exception in OpenFst is
+    Properties(mask, true), which may update the cached properties of the
+    FST; they are computed once in the constructor (see Properties() below),
+    and the decoders never call it.
+
+    This does not hold for lazy FSTs, e.g., fst::ComposeFst or the FST of a
+    LazyComposeFst, whose arc iterators expand states into a cache. They are
+    fully expanded when a SharedGraph is created from them, which can take a
+    lot of memory; for a large lazy graph, use one LazyComposeFst per thread
+    instead.
+
+    NUMA: with SharedGraphConfig::replicate_per_numa_node, a decoder uses
+    the copy of the node its thread runs on when GetFst() is called. The
+    thread should thus be bound to a node before it creates its decoder,
+    e.g., with ScopedNumaBinding or OfflineBatchDecoderConfig::bind_numa_nodes.
+
+    The SharedGraph must outlive the decoders that use it. It is usually
+    held by a std::shared_ptr<const SharedGraph>.
+ */
+class SharedGraph {
+ public:
+  /// If fst is an fst::StdConstFst and the graph is not replicated, its
+  /// arcs are shared with it and not copied; otherwise, it is copied into
+  /// new fst::StdConstFst objects.
+  explicit SharedGraph(const fst::Fst<fst::StdArc> &fst,
+                       const SharedGraphConfig &config = SharedGraphConfig());
+
+  SharedGraph(const SharedGraph &) = delete;
+  SharedGraph &operator=(const SharedGraph &) = delete;
+
+  /// The FST to pass to the decoders. If the graph is replicated, it is the
+  /// copy of the NUMA node of the calling thread.
+  const fst::Fst<fst::StdArc> &GetFst() const;
+
+  /// The copy of a NUMA node, i.e., an index into NumaNodeCpus(). It is
+  /// the same FST for all the nodes if the graph is not replicated.
+  const fst::Fst<fst::StdArc> &GetFst(int32_t numa_node) const;
+
+  /// 1 if the graph is not replicated, and NumNumaNodes() otherwise
+  int32_t NumReplicas() const { return static_cast<int32_t>(fsts_.size()); }
+
+  int32_t NumStates() const { return num_states_; }
+  int64_t NumArcs() const { return num_arcs_; }
+
+  /// The fst::kFstProperties of the graph, computed in the constructor.
+  /// Use it instead of GetFst().Properties(mask, true) from several threads.
+  uint64_t Properties() const { return properties_; }
+
+  const SharedGraphConfig &GetConfig() const { return config_; }
+
+ private:
+  SharedGraphConfig config_;
+
+  // One per NUMA node if the graph is replicated
+  std::vector<std::unique_ptr<const fst::StdConstFst>> fsts_;
+
+  int32_t num_states_ = 0;
+  int64_t num_arcs_ = 0;
+  uint64_t properties_ = 0;
+};
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_SHARED_GRAPH_H_
@@ -19,6 +19,7 @@ namespace kaldi_decoder {
 SimpleDecoder::~SimpleDecoder() {
   ClearToks(cur_toks_);
   ClearToks(prev_toks_);
+  ResetEndpoint();
 }
 
 bool SimpleDecoder::Decode(DecodableInterface *decodable) {
@@ -31,16 +32,18 @@ void SimpleDecoder::InitDecoding() {
   // clean up from last time:
   ClearToks(cur_toks_);
   ClearToks(prev_toks_);
+  ResetEndpoint();
+  peak_bytes_ = 0;
   // initialize decoding:
   StateId start_state = fst_.Start();
   KALDI_DECODER_ASSERT(start_state != fst::kNoStateId);
   StdArc dummy_arc(0, 0, StdWeight::One(), start_state);
-  cur_toks_[start_state] = new Token(dummy_arc, 0.0, nullptr);
+  cur_toks_[start_state] = token_pool_.New(dummy_arc, 0.0, nullptr);
   num_frames_decoded_ = 0;
   ProcessNonemitting();
 }
 
-void SimpleDecoder::AdvanceDecoding(DecodableInterface *decodable,
+bool SimpleDecoder::AdvanceDecoding(DecodableInterface *decodable,
                                     int32_t max_num_frames /*= -1*/) {
   KALDI_DECODER_ASSERT(num_frames_decoded_ >= 0 &&
                        "You must call InitDecoding() before AdvanceDecoding()");
@@ -62,8 +65,60 @@ void SimpleDecoder::AdvanceDecoding(DecodableInterface *decodable,
     cur_toks_.swap(prev_toks_);
     ProcessEmitting(decodable);
     ProcessNonemitting();
-    PruneToks(beam_, &cur_toks_);
+    Token *best_tok = PruneToks(beam_, &cur_toks_);
+    peak_bytes_ = std::max(peak_bytes_, GetMemoryStats().LiveBytes());
+
+    if (endpoint_.Enabled() && best_tok != nullptr) {
+      UpdateEndpoint(best_tok);
+      if (endpoint_detected_) {
+        break;
+      }
+    }
   }
+
+  return endpoint_detected_;
+}
+
+void SimpleDecoder::UpdateEndpoint(Token *best_tok) {
+  int32_t silence_frames = endpoint_.TrailingSilenceFrames(
+      best_tok, endpoint_tok_, endpoint_silence_frames_);
+
+  // Take the new reference first, as the old token may be kept alive only
+  // by the traceback of the new one
+  ++best_tok->ref_count_;
+  ResetEndpoint();
+  endpoint_tok_ = best_tok;
+  endpoint_silence_frames_ = silence_frames;
+
+  endpoint_detected_ =
+      endpoint_.Detect(num_frames_decoded_, silence_frames,
+                       [this]() { return FinalRelativeCost(); });
+}
+
+void SimpleDecoder::ResetEndpoint() {
+  if (endpoint_tok_ != nullptr) {
+    Token::TokenDelete(endpoint_tok_, &token_pool_);
+    endpoint_tok_ = nullptr;
+  }
+  endpoint_silence_frames_ = 0;
+  endpoint_detected_ = false;
+}
+
+DecoderMemoryStats SimpleDecoder::GetMemoryStats() const {
+  // A node of std::unordered_map holds the value and a pointer to the next
+  // node; the buckets are arrays of pointers
+  using Value = std::unordered_map<StateId, Token *>::value_type;
+  size_t num_nodes = cur_toks_.size() + prev_toks_.size();
+  size_t num_buckets = cur_toks_.bucket_count() + prev_toks_.bucket_count();
+
+  DecoderMemoryStats stats;
+  stats.token_bytes = token_pool_.NumInUse() * token_pool_.ElemSize();
+  stats.hash_bytes = num_nodes * (sizeof(Value) + sizeof(void *)) +
+                     num_buckets * sizeof(void *);
+  stats.free_bytes = (token_pool_.NumAllocated() - token_pool_.NumInUse()) *
+                     token_pool_.ElemSize();
+  stats.peak_bytes = std::max(peak_bytes_, stats.LiveBytes());
+  return stats;
 }
 
 bool SimpleDecoder::ReachedFinal() const {
@@ -175,16 +230,16 @@ void SimpleDecoder::ProcessEmitting(DecodableInterface *decodable) {
         cutoff = total_cost + beam_;
       }
 
-      Token *new_tok = new Token(arc, acoustic_cost, tok);
+      Token *new_tok = token_pool_.New(arc, acoustic_cost, tok);
       auto find_iter = cur_toks_.find(arc.nextstate);
       if (find_iter == cur_toks_.end()) {
         cur_toks_[arc.nextstate] = new_tok;
       } else {
         if (*(find_iter->second) < *new_tok) {
-          Token::TokenDelete(find_iter->second);
+          Token::TokenDelete(find_iter->second, &token_pool_);
           find_iter->second = new_tok;
         } else {
-          Token::TokenDelete(new_tok);
+          Token::TokenDelete(new_tok, &token_pool_);
         }
       }
     }
@@ -217,9 +272,9 @@ void SimpleDecoder::ProcessNonemitting() {
       }
 
       const float acoustic_cost = 0.0;
-      Token *new_tok = new Token(arc, acoustic_cost, tok);
+      Token *new_tok = token_pool_.New(arc, acoustic_cost, tok);
       if (new_tok->cost_ > cutoff) {
-        Token::TokenDelete(new_tok);
+        Token::TokenDelete(new_tok, &token_pool_);
       } else {
         auto find_iter = cur_toks_.find(arc.nextstate);
         if (find_iter == cur_toks_.end()) {
@@ -228,11 +283,11 @@ void SimpleDecoder::ProcessNonemitting() {
         } else {
           if (*(find_iter->second) < *new_tok) {
             // find_iter has a higher cost
-            Token::TokenDelete(find_iter->second);
+            Token::TokenDelete(find_iter->second, &token_pool_);
             find_iter->second = new_tok;
             queue.push_back(arc.nextstate);
           } else {
-            Token::TokenDelete(new_tok);
+            Token::TokenDelete(new_tok, &token_pool_);
           }
         }
       }
@@ -240,25 +295,26 @@ void SimpleDecoder::ProcessNonemitting() {
   }
 }
 
-// static
 void SimpleDecoder::ClearToks(std::unordered_map<StateId, Token *> &toks) {
   for (auto iter = toks.begin(); iter != toks.end(); ++iter) {
-    Token::TokenDelete(iter->second);
+    Token::TokenDelete(iter->second, &token_pool_);
   }
   toks.clear();
 }
 
-// static
-void SimpleDecoder::PruneToks(float beam,
-                              std::unordered_map<StateId, Token *> *toks) {
+SimpleDecoder::Token *SimpleDecoder::PruneToks(
+    float beam, std::unordered_map<StateId, Token *> *toks) {
   if (toks->empty()) {
     KALDI_DECODER_LOG << "No tokens to prune.\n";
-    return;
+    return nullptr;
   }
-  double best_cost = std::numeric_limits<double>::infinity();
+  Token *best_tok = nullptr;
   for (auto iter = toks->begin(); iter != toks->end(); ++iter) {
-    best_cost = std::min(best_cost, iter->second->cost_);
+    if (best_tok == nullptr || *best_tok < *iter->second) {
+      best_tok = iter->second;
+    }
   }
+  double best_cost = best_tok->cost_;
 
   std::vector<StateId> retained;
   double cutoff = best_cost + beam;
@@ -266,7 +322,7 @@ void SimpleDecoder::PruneToks(float beam,
     if (iter->second->cost_ < cutoff) {
       retained.push_back(iter->first);
     } else {
-      Token::TokenDelete(iter->second);
+      Token::TokenDelete(iter->second, &token_pool_);
     }
   }
 
@@ -278,6 +334,7 @@ void SimpleDecoder::PruneToks(float beam,
   KALDI_DECODER_LOG << "Pruned from " << toks->size() << "  to "
                     << (retained.size()) << " toks.\n";
   tmp.swap(*toks);
+  return best_tok;
 }
 
 }  // namespace kaldi_decoder
@@ -12,7 +12,10 @@
 #include "fst/fst.h"
 #include "fst/fstlib.h"
 #include "kaldi-decoder/csrc/decodable-itf.h"
+#include "kaldi-decoder/csrc/decoder-memory-stats.h"
+#include "kaldi-decoder/csrc/endpoint.h"
 #include "kaldi-decoder/csrc/log.h"
+#include "kaldi-decoder/csrc/memory-pool.h"
 #include "kaldifst/csrc/lattice-weight.h"
 
 namespace kaldi_decoder {
@@ -35,6 +38,12 @@ class SimpleDecoder {
   SimpleDecoder(const SimpleDecoder &) = delete;
   SimpleDecoder &operator=(const SimpleDecoder &) = delete;
 
+  /// Enables endpoint detection in AdvanceDecoding(). Call it before
+  /// InitDecoding().
+  void SetEndpointConfig(const EndpointConfig &config) {
+    endpoint_ = EndpointDetector(config);
+  }
+
   /// Decode this utterance.
   /// Returns true if any tokens reached the end of the file (regardless of
   /// whether they are in a final state); query ReachedFinal() after Decode()
@@ -69,14 +78,26 @@ class SimpleDecoder {
 
   /// This will decode until there are no more frames ready in the decodable
   /// object, but if max_num_frames is >= 0 it will decode no more than
-  /// that many frames.  If it returns false, then no tokens are alive,
-  /// which is a kind of error state.
-  void AdvanceDecoding(DecodableInterface *decodable,
+  /// that many frames.
+  ///
+  /// If endpoint detection is enabled (see SetEndpointConfig()), it also
+  /// stops after the frame where an endpoint is detected, so that the
+  /// utterance can be cut there. Returns EndpointDetected().
+  bool AdvanceDecoding(DecodableInterface *decodable,
                        int32_t max_num_frames = -1);
 
+  /// Returns true if an endpoint was detected on the last decoded frame. It
+  /// is always false if endpoint detection is disabled.
+  bool EndpointDetected() const { return endpoint_detected_; }
+
   /// Returns the number of frames already decoded.
   int32_t NumFramesDecoded() const { return num_frames_decoded_; }
 
+  /// Returns the memory held by the decoder. The hash bytes are an estimate,
+  /// as the nodes of std::unordered_map are allocated by the system. The
+  /// peak is over the frames decoded since InitDecoding().
+  DecoderMemoryStats GetMemoryStats() const;
+
  private:
   class Token {
    public:
@@ -101,10 +122,10 @@ class SimpleDecoder {
     }
     bool operator<(const Token &other) { return cost_ > other.cost_; }
 
-    static void TokenDelete(Token *tok) {
+    static void TokenDelete(Token *tok, MemoryPool<Token> *pool) {
       while (--tok->ref_count_ == 0) {
         Token *prev = tok->prev_;
-        delete tok;
+        pool->Delete(tok);
         if (prev == nullptr) {
           return;
         } else {
@@ -121,6 +142,9 @@ class SimpleDecoder {
 
   void ProcessNonemitting();
 
+  // Tokens are allocated from it; it has to be declared before cur_toks_.
+  MemoryPool<Token> token_pool_;
+
   std::unordered_map<StateId, Token *> cur_toks_;
   std::unordered_map<StateId, Token *> prev_toks_;
   const fst::Fst<fst::StdArc> &fst_;
@@ -128,9 +152,28 @@ class SimpleDecoder {
   // Keep track of the number of frames decoded in the current file.
   int32_t num_frames_decoded_ = -1;
 
-  static void ClearToks(std::unordered_map<StateId, Token *> &toks);  // NOLINT
+  // See GetMemoryStats()
+  int64_t peak_bytes_ = 0;
+
+  void ClearToks(std::unordered_map<StateId, Token *> &toks);  // NOLINT
+
+  // Returns the best token, which is never pruned
+  Token *PruneToks(float beam, std::unordered_map<StateId, Token *> *toks);
+
+  // Called after each frame with its best token if endpoint detection is
+  // enabled. It updates endpoint_detected_.
+  void UpdateEndpoint(Token *best_tok);
+
+  // Releases endpoint_tok_
+  void ResetEndpoint();
 
-  static void PruneToks(float beam, std::unordered_map<StateId, Token *> *toks);
+  // See SetEndpointConfig(). endpoint_tok_ is the best token of the last
+  // decoded frame, and endpoint_silence_frames_ the number of trailing
+  // silence frames of its traceback. The decoder holds a reference to it.
+  EndpointDetector endpoint_;
+  Token *endpoint_tok_ = nullptr;
+  int32_t endpoint_silence_frames_ = 0;
+  bool endpoint_detected_ = false;
 };
 
 }  // namespace kaldi_decoder
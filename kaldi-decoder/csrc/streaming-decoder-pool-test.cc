@@ -0,0 +1,175 @@
+// kaldi-decoder/csrc/streaming-decoder-pool-test.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/streaming-decoder-pool.h"
+
+#include <future>  // NOLINT
+#include <memory>
+#include <mutex>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/faster-decoder.h"
+#include "kaldi-decoder/csrc/test-utils.h"
+
+namespace kaldi_decoder {
+
+static std::vector<int32_t> OfflineWords(const fst::StdVectorFst &g,
+                                         const FloatMatrix &log_probs) {
+  FasterDecoder decoder(g, FasterDecoderOptions());
+  DecodableCtc decodable(log_probs);
+  decoder.Decode(&decodable);
+
+  fst::Lattice best_path;
+  decoder.GetBestPath(&best_path);
+
+  std::vector<int32_t> ans;
+  for (int32_t s = best_path.Start(); s != fst::kNoStateId;) {
+    fst::ArcIterator<fst::Lattice> aiter(best_path, s);
+    if (aiter.Done()) {
+      break;
+    }
+    if (aiter.Value().olabel != 0) {
+      ans.push_back(aiter.Value().olabel);
+    }
+    s = aiter.Value().nextstate;
+  }
+  return ans;
+}
+
+TEST(StreamingDecoderPool, SameAsOffline) {
+  fst::StdVectorFst g = BuildLoopGraph(5);
+  StreamingDecoderPoolConfig config;
+  config.num_threads = 3;
+  StreamingDecoderPool<FasterDecoder> pool(
+      [&g]() {
+        return std::make_unique<FasterDecoder>(g, FasterDecoderOptions());
+      },
+      config);
+
+  const int32_t num_sessions = 20;
+  const int32_t num_chunks = 8;
+  const int32_t chunk_size = 7;
+
+  std::vector<FloatMatrix> log_probs;
+  std::vector<std::shared_ptr<StreamingDecoderPool<FasterDecoder>::Session>>
+      sessions;
+  std::mutex mutex;
+  std::vector<std::vector<StreamingResult>> results(num_sessions);
+  for (int32_t i = 0; i != num_sessions; ++i) {
+    log_probs.push_back(
+        RandnMatrix(num_chunks * chunk_size, 5, 0, 1, /*seed=*/i));
+    sessions.push_back(pool.CreateSession([&, i](const StreamingResult &r) {
+      std::lock_guard<std::mutex> lock(mutex);
+      results[i].push_back(r);
+    }));
+  }
+
+  // The chunks of the sessions are interleaved, as from many clients
+  for (int32_t c = 0; c != num_chunks; ++c) {
+    for (int32_t i = 0; i != num_sessions; ++i) {
+      sessions[i]->AcceptChunk(
+          log_probs[i].middleRows(c * chunk_size, chunk_size));
+    }
+  }
+
+  std::vector<std::future<StreamingResult>> futures;
+  for (auto &s : sessions) {
+    futures.push_back(s->InputFinished());
+  }
+
+  for (int32_t i = 0; i != num_sessions; ++i) {
+    StreamingResult r = futures[i].get();
+    EXPECT_TRUE(r.is_final);
+    EXPECT_EQ(r.num_frames_decoded, num_chunks * chunk_size);
+    EXPECT_EQ(r.words, OfflineWords(g, log_probs[i]));
+
+    // The partial results come in order, and the callback also gets the
+    // final result
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_FALSE(results[i].empty());
+    for (size_t k = 1; k < results[i].size(); ++k) {
+      EXPECT_LE(results[i][k - 1].num_frames_decoded,
+                results[i][k].num_frames_decoded);
+    }
+    EXPECT_TRUE(results[i].back().is_final);
+    EXPECT_EQ(results[i].back().words, r.words);
+  }
+
+  // The decoders are back in the pool
+  EXPECT_EQ(pool.NumQueued(), 0);
+}
+
+TEST(StreamingDecoderPool, EarliestDeadlineFirst) {
+  fst::StdVectorFst g = BuildLoopGraph(3);
+  StreamingDecoderPoolConfig config;
+  config.num_threads = 1;
+  StreamingDecoderPool<FasterDecoder> pool(
+      [&g]() {
+        return std::make_unique<FasterDecoder>(g, FasterDecoderOptions());
+      },
+      config);
+
+  // The only worker is kept busy by the callback of the first session until
+  // the other sessions are queued
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  auto blocker = pool.CreateSession(
+      [released](const StreamingResult &) { released.wait(); });
+  blocker->AcceptChunk(RandnMatrix(2, 3));
+
+  std::mutex mutex;
+  std::vector<int32_t> order;
+  auto make_session = [&](int32_t id, float max_latency_ms) {
+    return pool.CreateSession(
+        [&, id](const StreamingResult &) {
+          std::lock_guard<std::mutex> lock(mutex);
+          order.push_back(id);
+        },
+        max_latency_ms);
+  };
+
+  auto relaxed = make_session(0, 10000);
+  auto urgent = make_session(1, 1);
+  auto medium = make_session(2, 500);
+  relaxed->AcceptChunk(RandnMatrix(2, 3));
+  urgent->AcceptChunk(RandnMatrix(2, 3));
+  medium->AcceptChunk(RandnMatrix(2, 3));
+
+  release.set_value();
+  pool.Shutdown();
+
+  EXPECT_EQ(order, (std::vector<int32_t>{1, 2, 0}));
+}
+
+TEST(StreamingDecoderPool, Errors) {
+  fst::StdVectorFst g = BuildLoopGraph(3);
+  StreamingDecoderPool<FasterDecoder> pool(
+      [&g]() {
+        return std::make_unique<FasterDecoder>(g, FasterDecoderOptions());
+      },
+      StreamingDecoderPoolConfig());
+
+  auto session = pool.CreateSession();
+  session->AcceptChunk(RandnMatrix(4, 3));
+  std::future<StreamingResult> f = session->InputFinished();
+  EXPECT_THROW(session->AcceptChunk(RandnMatrix(4, 3)), std::runtime_error);
+  EXPECT_THROW(session->InputFinished(), std::runtime_error);
+  EXPECT_EQ(f.get().num_frames_decoded, 4);
+
+  // An error while decoding is given to the future of the final result
+  auto bad = pool.CreateSession([](const StreamingResult &) {
+    KALDI_DECODER_ERR << "error in the callback";
+  });
+  bad->AcceptChunk(RandnMatrix(4, 3));
+  EXPECT_THROW(bad->InputFinished().get(), std::runtime_error);
+
+  pool.Shutdown();
+  EXPECT_THROW(pool.CreateSession()->AcceptChunk(RandnMatrix(4, 3)),
+               std::runtime_error);
+}
+
+}  // namespace kaldi_decoder
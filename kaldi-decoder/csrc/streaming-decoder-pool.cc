@@ -0,0 +1,39 @@
+// kaldi-decoder/csrc/streaming-decoder-pool.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/csrc/streaming-decoder-pool.h"
+
+#include <sstream>
+
+namespace kaldi_decoder {
+
+std::string StreamingDecoderPoolConfig::ToString() const {
+  std::ostringstream os;
+
+  os << "StreamingDecoderPoolConfig(";
+  os << "num_threads=" << num_threads << ", ";
+  os << "max_latency_ms=" << max_latency_ms << ", ";
+  os << "max_idle_decoders=" << max_idle_decoders << ")";
+
+  return os.str();
+}
+
+std::string StreamingResult::ToString() const {
+  std::ostringstream os;
+
+  os << "StreamingResult(";
+  os << "words=[";
+  for (size_t i = 0; i != words.size(); ++i) {
+    os << (i ? ", " : "") << words[i];
+  }
+  os << "], ";
+  os << "num_frames_decoded=" << num_frames_decoded << ", ";
+  os << "endpoint_detected=" << (endpoint_detected ? "True" : "False")
+     << ", ";
+  os << "is_final=" << (is_final ? "True" : "False") << ")";
+
+  return os.str();
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,417 @@
+// kaldi-decoder/csrc/streaming-decoder-pool.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_STREAMING_DECODER_POOL_H_
+#define KALDI_DECODER_CSRC_STREAMING_DECODER_POOL_H_
+
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>  // NOLINT
+#include <memory>
+#include <mutex>  // NOLINT
+#include <queue>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/decoder-pool.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/log.h"
+#include "kaldifst/csrc/lattice-weight.h"
+
+namespace kaldi_decoder {
+
+struct StreamingDecoderPoolConfig {
+  // Number of worker threads that run the decoders
+  int32_t num_threads = 1;
+
+  // A chunk is due this many milliseconds after it is accepted, unless the
+  // session overrides it. The workers decode first the session whose oldest
+  // pending chunk is due first (earliest deadline first).
+  float max_latency_ms = 100;
+
+  // Maximum number of idle decoders kept for new sessions; see DecoderPool
+  int32_t max_idle_decoders = 64;
+
+  std::string ToString() const;
+};
+
+/// The result of a session after a batch of its chunks is decoded
+struct StreamingResult {
+  // Output labels of the best path, without the epsilons
+  std::vector<int32_t> words;
+
+  int32_t num_frames_decoded = 0;
+
+  // EndpointDetected() of the decoder, if the factory of the pool enabled
+  // endpoint detection
+  bool endpoint_detected = false;
+
+  // True for the last result of a session, after InputFinished(). It uses
+  // the final probs of the graph if a final state was reached.
+  bool is_final = false;
+
+  std::string ToString() const;
+};
+
+/** StreamingDecoderPool runs many streaming decoding sessions, e.g., one per
+    client of a server, on a fixed number of worker threads.
+
+    A session accepts chunks of log-probs without blocking; its decoding is
+    queued and runs on a worker, which decodes all the chunks that are
+    pending when it takes the session. A session is decoded by one worker at
+    a time, and the workers take the sessions in the order of the deadline
+    of their oldest pending chunk, so a session with a burst of chunks does
+    not delay the others beyond their deadlines when it can be avoided.
+
+    Results are delivered by a callback of the session, called on a worker
+    after each batch of chunks, and by the future returned by
+    InputFinished().
+
+    Decoder is FasterDecoder or CtcDecoder, or any class with the same
+    InitDecoding(), AdvanceDecoding(), NumFramesDecoded(), EndpointDetected(),
+    GetBestPath() and Reset(). Decoders are reused across sessions through a
+    DecoderPool.
+
+    \code{.cc}
+      StreamingDecoderPool<FasterDecoder> pool(
+          [&]() { return std::make_unique<FasterDecoder>(graph, opts); },
+          config);
+
+      auto session = pool.CreateSession([](const StreamingResult &r) {
+        // Called on a worker thread; show the partial result
+      });
+      session->AcceptChunk(log_probs1);
+      session->AcceptChunk(log_probs2);
+      StreamingResult result = session->InputFinished().get();
+    \endcode
+
+    All the methods are thread-safe. The pool must outlive its sessions.
+ */
+template <class Decoder>
+class StreamingDecoderPool {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Factory = typename DecoderPool<Decoder>::Factory;
+  using Callback = std::function<void(const StreamingResult &)>;
+
+  class Session : public std::enable_shared_from_this<Session> {
+   public:
+    /// Queues the log-probs of the next frames, with one row per frame, as
+    /// for DecodableCtc. It returns immediately.
+    void AcceptChunk(FloatMatrix log_probs) {
+      pool_->Accept(this, std::move(log_probs), false);
+    }
+
+    /// Tells that there are no more chunks. The returned future gets the
+    /// final result after all the chunks are decoded, or the exception
+    /// thrown while decoding them. The decoder is then given back to the
+    /// pool.
+    std::future<StreamingResult> InputFinished() {
+      pool_->Accept(this, FloatMatrix(), true);
+      return final_result_.get_future();
+    }
+
+   private:
+    friend class StreamingDecoderPool;
+
+    Session(StreamingDecoderPool *pool, Callback callback,
+            Clock::duration max_latency)
+        : pool_(pool),
+          callback_(std::move(callback)),
+          max_latency_(max_latency) {}
+
+    StreamingDecoderPool *pool_;
+    Callback callback_;
+    Clock::duration max_latency_;
+
+    // Guarded by pool_->mutex_
+    std::deque<FloatMatrix> chunks_;
+    Clock::time_point oldest_deadline_;
+    bool input_finished_ = false;
+
+    // True while the session is in the queue or being decoded
+    bool scheduled_ = false;
+
+    // Only used by the worker that is decoding the session
+    typename DecoderPool<Decoder>::Ptr decoder_;
+    int32_t num_frames_ = 0;
+    std::exception_ptr error_;
+    std::promise<StreamingResult> final_result_;
+  };
+
+  StreamingDecoderPool(Factory factory,
+                       const StreamingDecoderPoolConfig &config)
+      : config_(config),
+        decoders_(std::move(factory), config.max_idle_decoders) {
+    if (config_.num_threads <= 0) {
+      KALDI_DECODER_ERR << "num_threads should be positive. Given: "
+                        << config_.num_threads;
+    }
+
+    for (int32_t i = 0; i != config_.num_threads; ++i) {
+      workers_.emplace_back([this]() { Work(); });
+    }
+  }
+
+  StreamingDecoderPool(const StreamingDecoderPool &) = delete;
+  StreamingDecoderPool &operator=(const StreamingDecoderPool &) = delete;
+
+  ~StreamingDecoderPool() { Shutdown(); }
+
+  /// @param callback        If not empty, it is called with the result of
+  ///                        each batch of chunks, on a worker thread. It
+  ///                        should return quickly.
+  /// @param max_latency_ms  If >= 0, it overrides the max_latency_ms of the
+  ///                        config for this session.
+  std::shared_ptr<Session> CreateSession(Callback callback = nullptr,
+                                         float max_latency_ms = -1) {
+    if (max_latency_ms < 0) {
+      max_latency_ms = config_.max_latency_ms;
+    }
+    auto max_latency = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<float, std::milli>(max_latency_ms));
+    return std::shared_ptr<Session>(
+        new Session(this, std::move(callback), max_latency));
+  }
+
+  /// Decodes all the queued chunks and stops the workers. Sessions cannot
+  /// accept chunks afterwards. It is called by the destructor.
+  void Shutdown() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stop_) {
+        return;
+      }
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto &t : workers_) {
+      t.join();
+    }
+  }
+
+  /// Number of sessions waiting for a worker
+  int32_t NumQueued() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<int32_t>(queue_.size());
+  }
+
+ private:
+  struct Entry {
+    Clock::time_point deadline;
+    int64_t seq;  // ties are broken by arrival
+    std::shared_ptr<Session> session;
+
+    // For a min-heap
+    bool operator<(const Entry &other) const {
+      return deadline != other.deadline ? deadline > other.deadline
+                                        : seq > other.seq;
+    }
+  };
+
+  void Accept(Session *s, FloatMatrix log_probs, bool input_finished) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stop_) {
+        KALDI_DECODER_ERR << "The pool has been shut down";
+      }
+
+      if (s->input_finished_) {
+        KALDI_DECODER_ERR << "InputFinished() has already been called";
+      }
+
+      Clock::time_point deadline = Clock::now() + s->max_latency_;
+      if (input_finished) {
+        s->input_finished_ = true;
+      } else if (log_probs.rows() == 0) {
+        return;
+      } else {
+        if (s->chunks_.empty()) {
+          s->oldest_deadline_ = deadline;
+        }
+        s->chunks_.push_back(std::move(log_probs));
+      }
+
+      if (s->scheduled_) {
+        // The worker that has it queues it again if needed
+        return;
+      }
+
+      s->scheduled_ = true;
+      Push(s, s->chunks_.empty() ? deadline : s->oldest_deadline_);
+    }
+    cv_.notify_one();
+  }
+
+  // Requires the lock. The queue shares the ownership of the session with
+  // the user, who may drop it before the session is decoded.
+  void Push(Session *s, Clock::time_point deadline) {
+    queue_.push({deadline, next_seq_++, s->shared_from_this()});
+  }
+
+  void Work() {
+    while (true) {
+      std::shared_ptr<Session> s;
+      std::vector<FloatMatrix> chunks;
+      bool input_finished;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) {
+          return;  // stop_ is true and all the work is done
+        }
+
+        s = queue_.top().session;
+        queue_.pop();
+        for (auto &c : s->chunks_) {
+          chunks.push_back(std::move(c));
+        }
+        s->chunks_.clear();
+        input_finished = s->input_finished_;
+      }
+
+      Process(s.get(), &chunks, input_finished);
+
+      bool again;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Chunks accepted while it was decoded
+        again = !s->chunks_.empty() || s->input_finished_ != input_finished;
+        if (again) {
+          Push(s.get(), s->chunks_.empty() ? Clock::now()
+                                           : s->oldest_deadline_);
+        } else {
+          s->scheduled_ = false;
+        }
+      }
+      if (again) {
+        cv_.notify_one();
+      }
+    }
+  }
+
+  void Process(Session *s, std::vector<FloatMatrix> *chunks,
+               bool input_finished) {
+    if (!s->error_) {
+      try {
+        StreamingResult result = Decode(s, chunks, input_finished);
+        if (s->callback_) {
+          s->callback_(result);
+        }
+
+        if (input_finished) {
+          s->final_result_.set_value(std::move(result));
+        }
+      } catch (...) {
+        s->error_ = std::current_exception();
+      }
+    }
+
+    if (s->error_ && s->decoder_) {
+      s->decoder_.reset();
+    }
+
+    if (input_finished && s->error_) {
+      s->final_result_.set_exception(s->error_);
+    }
+  }
+
+  StreamingResult Decode(Session *s, std::vector<FloatMatrix> *chunks,
+                         bool input_finished) {
+    if (!s->decoder_) {
+      s->decoder_ = decoders_.Acquire();
+      s->decoder_->InitDecoding();
+    }
+    Decoder *decoder = s->decoder_.get();
+
+    if (!chunks->empty()) {
+      FloatMatrix log_probs = Concatenate(chunks);
+      int32_t offset = s->num_frames_;
+      s->num_frames_ += static_cast<int32_t>(log_probs.rows());
+
+      DecodableCtc decodable(std::move(log_probs), offset);
+      // AdvanceDecoding() stops at an endpoint
+      while (decoder->NumFramesDecoded() < s->num_frames_) {
+        decoder->AdvanceDecoding(&decodable);
+      }
+    }
+
+    StreamingResult ans;
+    ans.num_frames_decoded = decoder->NumFramesDecoded();
+    ans.endpoint_detected = decoder->EndpointDetected();
+    ans.is_final = input_finished;
+
+    fst::Lattice best_path;
+    if (decoder->GetBestPath(&best_path, input_finished)) {
+      ans.words = GetWords(best_path);
+    }
+
+    if (input_finished) {
+      s->decoder_.reset();
+    }
+    return ans;
+  }
+
+  static FloatMatrix Concatenate(std::vector<FloatMatrix> *chunks) {
+    if (chunks->size() == 1) {
+      return std::move((*chunks)[0]);
+    }
+
+    int64_t num_rows = 0;
+    int64_t num_cols = (*chunks)[0].cols();
+    for (const auto &c : *chunks) {
+      if (c.cols() != num_cols) {
+        KALDI_DECODER_ERR << "The chunks of a session have different numbers "
+                          << "of columns: " << num_cols << " and "
+                          << c.cols();
+      }
+      num_rows += c.rows();
+    }
+
+    FloatMatrix ans(num_rows, num_cols);
+    int64_t row = 0;
+    for (const auto &c : *chunks) {
+      ans.middleRows(row, c.rows()) = c;
+      row += c.rows();
+    }
+    return ans;
+  }
+
+  static std::vector<int32_t> GetWords(const fst::Lattice &best_path) {
+    std::vector<int32_t> ans;
+    for (int32_t s = best_path.Start(); s != fst::kNoStateId;) {
+      fst::ArcIterator<fst::Lattice> aiter(best_path, s);
+      if (aiter.Done()) {
+        break;
+      }
+      if (aiter.Value().olabel != 0) {
+        ans.push_back(aiter.Value().olabel);
+      }
+      s = aiter.Value().nextstate;
+    }
+    return ans;
+  }
+
+  StreamingDecoderPoolConfig config_;
+  DecoderPool<Decoder> decoders_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::priority_queue<Entry> queue_;
+  int64_t next_seq_ = 0;
+  bool stop_ = false;
+
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_STREAMING_DECODER_POOL_H_
@@ -0,0 +1,79 @@
+// kaldi-decoder/csrc/test-utils.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_CSRC_TEST_UTILS_H_
+#define KALDI_DECODER_CSRC_TEST_UTILS_H_
+
+// Helpers shared by the tests and the benchmarks; they are not part of the
+// library.
+
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <vector>
+
+#include "fst/fst.h"
+#include "fst/fstlib.h"
+#include "kaldi-decoder/csrc/eigen.h"
+#include "kaldi-decoder/csrc/log.h"
+
+namespace kaldi_decoder {
+
+/// A small decoding graph with self-loops and epsilon arcs, so that the
+/// decoders keep many active tokens per frame. State 0 is the start state;
+/// for each label i in [1, num_labels], an arc i:(olabel_offset + i) of cost
+/// word_cost + label_cost * i goes to state i, which has a self-loop on i
+/// and an epsilon arc back to state 0. All states are final.
+inline fst::StdVectorFst BuildLoopGraph(int32_t num_labels,
+                                        float word_cost = 0,
+                                        float label_cost = 0.1,
+                                        int32_t olabel_offset = 100) {
+  fst::StdVectorFst g;
+  g.AddState();
+  g.SetStart(0);
+  g.SetFinal(0, 0);
+  for (int32_t i = 1; i <= num_labels; ++i) {
+    int32_t s = g.AddState();
+    g.AddArc(0, fst::StdArc(i, olabel_offset + i, word_cost + label_cost * i,
+                            s));
+    g.AddArc(s, fst::StdArc(i, 0, 0.05, s));
+    g.AddArc(s, fst::StdArc(0, 0, 0.2, 0));
+    g.SetFinal(s, 0.5);
+  }
+  return g;
+}
+
+/// Log-probs that look like the output of a CTC model: frame t has most of
+/// its probability on frame_tokens[t], e.g., 0 for the blank. Each row is
+/// normal noise of the given stddev with "peak" added to the column of its
+/// token, followed by a log-softmax.
+inline FloatMatrix PeakyLogProbs(const std::vector<int32_t> &frame_tokens,
+                                 int32_t num_tokens, float peak = 6,
+                                 float stddev = 1, int64_t seed = -1,
+                                 int32_t num_threads = 1) {
+  int32_t num_frames = static_cast<int32_t>(frame_tokens.size());
+  FloatMatrix ans = RandnMatrix(num_frames, num_tokens, 0, stddev, seed,
+                                num_threads);
+  for (int32_t t = 0; t != num_frames; ++t) {
+    int32_t token = frame_tokens[t];
+    if (token < 0 || token >= num_tokens) {
+      KALDI_DECODER_ERR << "Invalid token " << token << " at frame " << t
+                        << ". Number of tokens: " << num_tokens;
+    }
+    ans(t, token) += peak;
+  }
+
+  LogSoftmaxRows(&ans, /*approximate=*/false, num_threads);
+  return ans;
+}
+
+/// Milliseconds elapsed since "start"
+inline double ElapsedMs(std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double, std::milli> d =
+      std::chrono::steady_clock::now() - start;
+  return d.count();
+}
+
+}  // namespace kaldi_decoder
+
+#endif  // KALDI_DECODER_CSRC_TEST_UTILS_H_
@@ -0,0 +1,116 @@
+// kaldi-decoder/python/csrc/backoff-lm.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/python/csrc/backoff-lm.h"
+
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "kaldi-decoder/csrc/backoff-lm.h"
+#include "kaldi-decoder/csrc/log.h"
+
+namespace kaldi_decoder {
+
+namespace {
+
+// Allows to implement an LM in Python, e.g., a neural one. Its get_arc()
+// returns None if the word is not accepted, or (next_state, cost) otherwise.
+class PyDeterministicLm : public DeterministicLm {
+ public:
+  using DeterministicLm::DeterministicLm;
+
+  int32_t Start() const override {
+    PYBIND11_OVERRIDE_PURE_NAME(int32_t, DeterministicLm, "start", Start);
+  }
+
+  float Final(int32_t state) const override {
+    PYBIND11_OVERRIDE_PURE_NAME(float, DeterministicLm, "final", Final, state);
+  }
+
+  bool GetArc(int32_t state, int32_t word, int32_t *next_state,
+              float *cost) const override {
+    py::gil_scoped_acquire gil;
+    py::function override =
+        py::get_override(static_cast<const DeterministicLm *>(this), "get_arc");
+    if (!override) {
+      py::pybind11_fail(
+          "Tried to call pure virtual function \"DeterministicLm::get_arc\"");
+    }
+
+    py::object ans = override(state, word);
+    if (ans.is_none()) {
+      return false;
+    }
+
+    auto p = ans.cast<std::pair<int32_t, float>>();
+    *next_state = p.first;
+    *cost = p.second;
+    return true;
+  }
+};
+
+std::ifstream OpenFile(const std::string &filename) {
+  std::ifstream is(filename);
+  if (!is) {
+    KALDI_DECODER_ERR << "Failed to open " << filename;
+  }
+  return is;
+}
+
+}  // namespace
+
+static void PybindDeterministicLm(py::module *m) {
+  using PyClass = DeterministicLm;
+
+  py::class_<PyClass, PyDeterministicLm>(*m, "DeterministicLm")
+      .def(py::init<>())
+      .def("start", &PyClass::Start)
+      .def("final", &PyClass::Final, py::arg("state"))
+      .def(
+          "get_arc",
+          [](const PyClass &self, int32_t state,
+             int32_t word) -> std::optional<std::pair<int32_t, float>> {
+            int32_t next_state;
+            float cost;
+            if (!self.GetArc(state, word, &next_state, &cost)) {
+              return std::nullopt;
+            }
+            return std::make_pair(next_state, cost);
+          },
+          py::arg("state"), py::arg("word"));
+}
+
+void PybindBackoffLm(py::module *m) {
+  PybindDeterministicLm(m);
+
+  m->def(
+      "read_symbol_table",
+      [](const std::string &filename) {
+        std::ifstream is = OpenFile(filename);
+        return ReadSymbolTable(is);
+      },
+      py::arg("filename"));
+
+  py::class_<ArpaBackoffLm, DeterministicLm>(*m, "ArpaBackoffLm")
+      .def(py::init([](const std::string &filename,
+                       const std::unordered_map<std::string, int32_t>
+                           &symbol_table) {
+             std::ifstream is = OpenFile(filename);
+             return std::make_unique<ArpaBackoffLm>(is, symbol_table);
+           }),
+           py::arg("filename"), py::arg("symbol_table"))
+      .def("order", &ArpaBackoffLm::Order)
+      .def("num_states", &ArpaBackoffLm::NumStates);
+
+  py::class_<FstBackoffLm, DeterministicLm>(*m, "FstBackoffLm")
+      .def(py::init<const fst::Fst<fst::StdArc> &>(), py::arg("fst"))
+      .def(py::init<const fst::VectorFst<fst::StdArc> &>(), py::arg("fst"))
+      .def(py::init<const fst::ConstFst<fst::StdArc> &>(), py::arg("fst"));
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,50 @@
+// kaldi-decoder/python/csrc/confusion-network.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/python/csrc/confusion-network.h"
+
+#include "kaldi-decoder/csrc/confusion-network.h"
+
+namespace kaldi_decoder {
+
+static void PybindWordPosterior(py::module *m) {
+  using PyClass = WordPosterior;
+
+  py::class_<PyClass>(*m, "WordPosterior")
+      .def(py::init([](int32_t word, int32_t frame, float posterior) {
+             return PyClass{word, frame, posterior};
+           }),
+           py::arg("word"), py::arg("frame"), py::arg("posterior"))
+      .def_readwrite("word", &PyClass::word)
+      .def_readwrite("frame", &PyClass::frame)
+      .def_readwrite("posterior", &PyClass::posterior);
+}
+
+static void PybindConfusionNetworkOptions(py::module *m) {
+  using PyClass = ConfusionNetworkOptions;
+
+  py::class_<PyClass>(*m, "ConfusionNetworkOptions")
+      .def(py::init<float, int32_t, float>(), py::arg("acoustic_scale") = 1.0,
+           py::arg("max_shift") = 10, py::arg("min_posterior") = 1e-3)
+      .def_readwrite("acoustic_scale", &PyClass::acoustic_scale)
+      .def_readwrite("max_shift", &PyClass::max_shift)
+      .def_readwrite("min_posterior", &PyClass::min_posterior)
+      .def("__str__", &PyClass::ToString);
+}
+
+void PybindConfusionNetwork(py::module *m) {
+  PybindWordPosterior(m);
+  PybindConfusionNetworkOptions(m);
+
+  py::class_<ConfusionBin>(*m, "ConfusionBin")
+      .def_readonly("words", &ConfusionBin::words);
+
+  m->def("build_confusion_network", &BuildConfusionNetwork,
+         py::arg("posteriors"), py::arg("best_path"),
+         py::arg("opts") = ConfusionNetworkOptions());
+
+  m->def("mbr_decode", &MbrDecode, py::arg("bins"));
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,34 @@
+// kaldi-decoder/python/csrc/context-graph.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/python/csrc/context-graph.h"
+
+#include <vector>
+
+#include "kaldi-decoder/csrc/context-graph.h"
+
+namespace kaldi_decoder {
+
+void PybindContextGraph(py::module *m) {
+  using PyClass = ContextGraph;
+  py::class_<PyClass>(*m, "ContextGraph")
+      .def(py::init<const std::vector<std::vector<int32_t>> &, float,
+                    const std::vector<float> &>(),
+           py::arg("phrases"), py::arg("bonus"),
+           py::arg("bonuses") = std::vector<float>{})
+      .def_property_readonly("root", &PyClass::Root)
+      .def_property_readonly("num_states", &PyClass::NumStates)
+      .def(
+          "forward_one_step",
+          [](const PyClass &self, int32_t state,
+             int32_t label) -> std::pair<float, int32_t> {
+            int32_t next_state;
+            float cost = self.ForwardOneStep(state, label, &next_state);
+            return std::make_pair(cost, next_state);
+          },
+          py::arg("state"), py::arg("label"))
+      .def("finalize", &PyClass::Finalize, py::arg("state"));
+}
+
+}  // namespace kaldi_decoder
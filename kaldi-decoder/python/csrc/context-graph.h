@@ -0,0 +1,16 @@
+// kaldi-decoder/python/csrc/context-graph.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_PYTHON_CSRC_CONTEXT_GRAPH_H_
+#define KALDI_DECODER_PYTHON_CSRC_CONTEXT_GRAPH_H_
+
+#include "kaldi-decoder/python/csrc/kaldi-decoder.h"
+
+namespace kaldi_decoder {
+
+void PybindContextGraph(py::module *m);
+
+}
+
+#endif  // KALDI_DECODER_PYTHON_CSRC_CONTEXT_GRAPH_H_
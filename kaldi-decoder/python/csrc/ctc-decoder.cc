@@ -0,0 +1,49 @@
+// kaldi-decoder/python/csrc/ctc-decoder.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/python/csrc/ctc-decoder.h"
+
+#include <utility>
+
+#include "kaldi-decoder/csrc/ctc-decoder.h"
+
+namespace kaldi_decoder {
+
+void PybindCtcDecoder(py::module *m) {
+  using PyClass = CtcDecoder;
+  py::class_<PyClass>(*m, "CtcDecoder")
+      .def(py::init<const fst::Fst<fst::StdArc> &,
+                    const FasterDecoderOptions &>(),
+           py::arg("fst"), py::arg("config"))
+      .def(py::init<const fst::VectorFst<fst::StdArc> &,
+                    const FasterDecoderOptions &>(),
+           py::arg("fst"), py::arg("config"))
+      .def(py::init<const fst::ConstFst<fst::StdArc> &,
+                    const FasterDecoderOptions &>(),
+           py::arg("fst"), py::arg("config"))
+      .def("set_options", &PyClass::SetOptions, py::arg("config"))
+      .def("decode", &PyClass::Decode, py::arg("decodable"))
+      .def("reached_final", &PyClass::ReachedFinal)
+      .def("final_relative_cost", &PyClass::FinalRelativeCost)
+      .def(
+          "get_best_path",
+          [](PyClass &self, bool use_final_probs)
+              -> std::pair<bool, fst::VectorFst<fst::LatticeArc>> {
+            fst::VectorFst<fst::LatticeArc> fst;
+            bool ok = self.GetBestPath(&fst, use_final_probs);
+            return std::make_pair(ok, fst);
+          },
+          py::arg("use_final_probs") = true)
+      .def("init_decoding", &PyClass::InitDecoding)
+      .def("reset", &PyClass::Reset)
+      .def("advance_decoding", &PyClass::AdvanceDecoding, py::arg("decodable"),
+           py::arg("max_num_frames") = -1)
+      .def("set_endpoint_config", &PyClass::SetEndpointConfig,
+           py::arg("config"))
+      .def("endpoint_detected", &PyClass::EndpointDetected)
+      .def("num_frames_decoded", &PyClass::NumFramesDecoded)
+      .def("get_memory_stats", &PyClass::GetMemoryStats);
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,54 @@
+// kaldi-decoder/python/csrc/decodable-chunked.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/python/csrc/decodable-chunked.h"
+
+#include "kaldi-decoder/csrc/decodable-chunked.h"
+
+namespace kaldi_decoder {
+
+namespace {
+
+// Unlike PyDecodableInterface, LogLikelihood() is not overridden: Python is
+// only called by GetChunk(), once per chunk.
+class PyDecodableChunked : public DecodableChunked {
+ public:
+  using DecodableChunked::DecodableChunked;
+
+  FloatMatrix GetChunk(int32_t frame) override {
+    PYBIND11_OVERRIDE_PURE_NAME(FloatMatrix, DecodableChunked, "get_chunk",
+                                GetChunk, frame);
+  }
+
+  bool IsLastFrame(int32_t frame) const override {
+    PYBIND11_OVERRIDE_PURE_NAME(bool, DecodableChunked, "is_last_frame",
+                                IsLastFrame, frame);
+  }
+
+  int32_t NumFramesReady() const override {
+    PYBIND11_OVERRIDE_NAME(int32_t, DecodableChunked, "num_frames_ready",
+                           NumFramesReady);
+  }
+
+  int32_t NumIndices() const override {
+    PYBIND11_OVERRIDE_PURE_NAME(int32_t, DecodableChunked, "num_indices",
+                                NumIndices);
+  }
+};
+
+}  // namespace
+
+void PybindDecodableChunked(py::module *m) {
+  using PyClass = DecodableChunked;
+
+  // get_chunk(frame) returns a 2-d array of shape (num_frames, num_indices)
+  // with the log-likelihoods of the frames starting at "frame"
+  py::class_<PyClass, DecodableInterface, PyDecodableChunked>(
+      *m, "DecodableChunked")
+      .def(py::init<>())
+      .def("get_chunk", &PyClass::GetChunk, py::arg("frame"))
+      .def("clear_cache", &PyClass::ClearCache);
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,16 @@
+// kaldi-decoder/python/csrc/decodable-chunked.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_PYTHON_CSRC_DECODABLE_CHUNKED_H_
+#define KALDI_DECODER_PYTHON_CSRC_DECODABLE_CHUNKED_H_
+
+#include "kaldi-decoder/python/csrc/kaldi-decoder.h"
+
+namespace kaldi_decoder {
+
+void PybindDecodableChunked(py::module *m);
+
+}
+
+#endif  // KALDI_DECODER_PYTHON_CSRC_DECODABLE_CHUNKED_H_
@@ -4,15 +4,33 @@
 
 #include "kaldi-decoder/python/csrc/decodable-ctc.h"
 
+#include <memory>
+#include <utility>
+
 #include "kaldi-decoder/csrc/decodable-ctc.h"
+#include "kaldi-decoder/csrc/eigen.h"
 
 namespace kaldi_decoder {
 
 void PybindDecodableCtc(py::module *m) {
   using PyClass = DecodableCtc;
   py::class_<PyClass, DecodableInterface>(*m, "DecodableCtc")
-      .def(py::init<const FloatMatrix &, int32_t>(), py::arg("feats"),
-           py::arg("offset") = 0);
+      .def(py::init([](FloatMatrix feats, int32_t offset,
+                       bool apply_log_softmax) {
+             // feats is already a copy of the numpy array, so it is moved
+             return std::make_unique<PyClass>(std::move(feats), offset,
+                                              apply_log_softmax);
+           }),
+           py::arg("feats"), py::arg("offset") = 0,
+           py::arg("apply_log_softmax") = false);
+
+  m->def(
+      "log_softmax_rows",
+      [](FloatMatrix m, bool approximate, int32_t num_threads) {
+        LogSoftmaxRows(&m, approximate, num_threads);
+        return m;
+      },
+      py::arg("m"), py::arg("approximate") = false, py::arg("num_threads") = 1);
 }
 
 }  // namespace kaldi_decoder
@@ -0,0 +1,26 @@
+// kaldi-decoder/python/csrc/decoder-memory-stats.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/python/csrc/decoder-memory-stats.h"
+
+#include "kaldi-decoder/csrc/decoder-memory-stats.h"
+
+namespace kaldi_decoder {
+
+void PybindDecoderMemoryStats(py::module *m) {
+  using PyClass = DecoderMemoryStats;
+  py::class_<PyClass>(*m, "DecoderMemoryStats")
+      .def(py::init<>())
+      .def_readonly("token_bytes", &PyClass::token_bytes)
+      .def_readonly("link_bytes", &PyClass::link_bytes)
+      .def_readonly("hash_bytes", &PyClass::hash_bytes)
+      .def_readonly("frame_list_bytes", &PyClass::frame_list_bytes)
+      .def_readonly("free_bytes", &PyClass::free_bytes)
+      .def_readonly("peak_bytes", &PyClass::peak_bytes)
+      .def_readonly("num_tightened_frames", &PyClass::num_tightened_frames)
+      .def_property_readonly("live_bytes", &PyClass::LiveBytes)
+      .def("__str__", &PyClass::ToString);
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,16 @@
+// kaldi-decoder/python/csrc/decoder-memory-stats.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_PYTHON_CSRC_DECODER_MEMORY_STATS_H_
+#define KALDI_DECODER_PYTHON_CSRC_DECODER_MEMORY_STATS_H_
+
+#include "kaldi-decoder/python/csrc/kaldi-decoder.h"
+
+namespace kaldi_decoder {
+
+void PybindDecoderMemoryStats(py::module *m);
+
+}
+
+#endif  // KALDI_DECODER_PYTHON_CSRC_DECODER_MEMORY_STATS_H_
@@ -0,0 +1,47 @@
+// kaldi-decoder/python/csrc/endpoint.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/python/csrc/endpoint.h"
+
+#include <limits>
+
+#include "kaldi-decoder/csrc/endpoint.h"
+
+namespace kaldi_decoder {
+
+static void PybindEndpointRule(py::module *m) {
+  using PyClass = EndpointRule;
+  py::class_<PyClass>(*m, "EndpointRule")
+      .def(py::init<bool, float, float, float>(),
+           py::arg("must_contain_nonsilence") = true,
+           py::arg("min_trailing_silence") = 1.0,
+           py::arg("max_relative_cost") =
+               std::numeric_limits<float>::infinity(),
+           py::arg("min_utterance_length") = 0.0)
+      .def_readwrite("must_contain_nonsilence",
+                     &PyClass::must_contain_nonsilence)
+      .def_readwrite("min_trailing_silence", &PyClass::min_trailing_silence)
+      .def_readwrite("max_relative_cost", &PyClass::max_relative_cost)
+      .def_readwrite("min_utterance_length", &PyClass::min_utterance_length)
+      .def("__str__", &PyClass::ToString);
+}
+
+void PybindEndpoint(py::module *m) {
+  PybindEndpointRule(m);
+
+  using PyClass = EndpointConfig;
+  py::class_<PyClass>(*m, "EndpointConfig")
+      .def(py::init<>())
+      .def_readwrite("silence_labels", &PyClass::silence_labels)
+      .def_readwrite("frame_shift_in_seconds",
+                     &PyClass::frame_shift_in_seconds)
+      .def_readwrite("rule1", &PyClass::rule1)
+      .def_readwrite("rule2", &PyClass::rule2)
+      .def_readwrite("rule3", &PyClass::rule3)
+      .def_readwrite("rule4", &PyClass::rule4)
+      .def_readwrite("rule5", &PyClass::rule5)
+      .def("__str__", &PyClass::ToString);
+}
+
+}  // namespace kaldi_decoder
@@ -5,6 +5,8 @@
 #include "kaldi-decoder/python/csrc/faster-decoder.h"
 
 #include <limits>
+#include <sstream>
+#include <string>
 #include <utility>
 
 #include "kaldi-decoder/csrc/faster-decoder.h"
@@ -14,16 +16,20 @@ namespace kaldi_decoder {
 static void PybindFasterDecoderOptions(py::module *m) {
   using PyClass = FasterDecoderOptions;
   py::class_<PyClass>(*m, "FasterDecoderOptions")
-      .def(py::init<float, int32_t, int32_t, float, float>(),
+      .def(py::init<float, int32_t, int32_t, float, float, int64_t,
+                    int32_t>(),
            py::arg("beam") = 16.0,
            py::arg("max_active") = std::numeric_limits<int32_t>::max(),
            py::arg("min_active") = 20, py::arg("beam_delta") = 0.5,
-           py::arg("hash_ratio") = 2.0)
+           py::arg("hash_ratio") = 2.0, py::arg("max_mem_bytes") = 0,
+           py::arg("prefetch_distance") = 0)
       .def_readwrite("beam", &PyClass::beam)
       .def_readwrite("max_active", &PyClass::max_active)
       .def_readwrite("min_active", &PyClass::min_active)
       .def_readwrite("beam_delta", &PyClass::beam_delta)
       .def_readwrite("hash_ratio", &PyClass::hash_ratio)
+      .def_readwrite("max_mem_bytes", &PyClass::max_mem_bytes)
+      .def_readwrite("prefetch_distance", &PyClass::prefetch_distance)
       .def("__str__", &PyClass::ToString);
 }
 
@@ -41,8 +47,11 @@ void PybindFasterDecoder(py::module *m) {
                     const FasterDecoderOptions &>(),
            py::arg("fst"), py::arg("config"))
       .def("set_options", &PyClass::SetOptions, py::arg("config"))
+      .def("set_context_graph", &PyClass::SetContextGraph,
+           py::arg("context_graph"), py::keep_alive<1, 2>())
       .def("decode", &PyClass::Decode, py::arg("decodable"))
       .def("reached_final", &PyClass::ReachedFinal)
+      .def("final_relative_cost", &PyClass::FinalRelativeCost)
       .def(
           "get_best_path",
           [](PyClass &self, bool use_final_probs)
@@ -53,9 +62,28 @@ void PybindFasterDecoder(py::module *m) {
           },
           py::arg("use_final_probs") = true)
       .def("init_decoding", &PyClass::InitDecoding)
+      .def("reset", &PyClass::Reset)
       .def("advance_decoding", &PyClass::AdvanceDecoding, py::arg("decodable"),
            py::arg("max_num_frames") = -1)
-      .def("num_frames_decoded", &PyClass::NumFramesDecoded);
+      .def("set_endpoint_config", &PyClass::SetEndpointConfig,
+           py::arg("config"))
+      .def("endpoint_detected", &PyClass::EndpointDetected)
+      .def("num_frames_decoded", &PyClass::NumFramesDecoded)
+      .def("get_memory_stats", &PyClass::GetMemoryStats)
+      .def(
+          "snapshot",
+          [](const PyClass &self) -> py::bytes {
+            std::ostringstream os;
+            self.Snapshot(os);
+            return py::bytes(os.str());
+          })
+      .def(
+          "restore",
+          [](PyClass &self, const std::string &data) {
+            std::istringstream is(data);
+            self.Restore(is);
+          },
+          py::arg("data"));
 }
 
 }  // namespace kaldi_decoder
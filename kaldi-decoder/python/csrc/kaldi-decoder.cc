@@ -4,21 +4,53 @@
 
 #include "kaldi-decoder/python/csrc/kaldi-decoder.h"
 
+#include "kaldi-decoder/python/csrc/backoff-lm.h"
+#include "kaldi-decoder/python/csrc/confusion-network.h"
+#include "kaldi-decoder/python/csrc/context-graph.h"
+#include "kaldi-decoder/python/csrc/ctc-decoder.h"
+#include "kaldi-decoder/python/csrc/decodable-chunked.h"
 #include "kaldi-decoder/python/csrc/decodable-ctc.h"
 #include "kaldi-decoder/python/csrc/decodable-itf.h"
+#include "kaldi-decoder/python/csrc/decoder-memory-stats.h"
+#include "kaldi-decoder/python/csrc/endpoint.h"
 #include "kaldi-decoder/python/csrc/faster-decoder.h"
+#include "kaldi-decoder/python/csrc/keyword-spotter.h"
+#include "kaldi-decoder/python/csrc/lattice-determinize.h"
+#include "kaldi-decoder/python/csrc/lattice-incremental-decoder.h"
+#include "kaldi-decoder/python/csrc/lattice-rescore.h"
 #include "kaldi-decoder/python/csrc/lattice-simple-decoder.h"
+#include "kaldi-decoder/python/csrc/lazy-compose-fst.h"
+#include "kaldi-decoder/python/csrc/linear-aligner.h"
+#include "kaldi-decoder/python/csrc/shared-graph.h"
 #include "kaldi-decoder/python/csrc/simple-decoder.h"
+#include "kaldi-decoder/python/csrc/streaming-decoder-pool.h"
 
 namespace kaldi_decoder {
 
 PYBIND11_MODULE(_kaldi_decoder, m) {
   m.doc() = "pybind11 binding of kaldi-decoder";
+  PybindBackoffLm(&m);
+  PybindConfusionNetwork(&m);
+  PybindContextGraph(&m);
+  PybindCtcDecoder(&m);
   PybindDecodableItf(&m);
+  PybindDecoderMemoryStats(&m);
+  PybindEndpoint(&m);
   PybindFasterDecoder(&m);
+  PybindKeywordSpotter(&m);
+  PybindLatticeDeterminize(&m);
+  // Before the incremental decoder, whose config has a
+  // LatticeSimpleDecoderConfig as a default argument
   PybindLatticeSimpleDecoder(&m);
+  PybindLatticeIncrementalDecoder(&m);
+  PybindLatticeRescore(&m);
+  PybindLazyComposeFst(&m);
+  PybindLinearAligner(&m);
+  PybindSharedGraph(&m);
   PybindSimpleDecoder(&m);
+  PybindStreamingDecoderPool(&m);
   PybindDecodableCtc(&m);
+  PybindDecodableChunked(&m);
 }
 
 }  // namespace kaldi_decoder
@@ -0,0 +1,70 @@
+// kaldi-decoder/python/csrc/keyword-spotter.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/python/csrc/keyword-spotter.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "kaldi-decoder/csrc/keyword-spotter.h"
+
+namespace kaldi_decoder {
+
+static void PybindKeywordTrigger(py::module *m) {
+  using PyClass = KeywordTrigger;
+  py::class_<PyClass>(*m, "KeywordTrigger")
+      .def_readonly("keyword", &PyClass::keyword)
+      .def_readonly("start_frame", &PyClass::start_frame)
+      .def_readonly("end_frame", &PyClass::end_frame)
+      .def_readonly("score", &PyClass::score)
+      .def("__str__", [](const PyClass &self) {
+        std::ostringstream os;
+        os << "KeywordTrigger(keyword=" << self.keyword
+           << ", start_frame=" << self.start_frame
+           << ", end_frame=" << self.end_frame << ", score=" << self.score
+           << ")";
+        return os.str();
+      });
+}
+
+static void PybindKeywordSpotterOptions(py::module *m) {
+  using PyClass = KeywordSpotterOptions;
+  py::class_<PyClass>(*m, "KeywordSpotterOptions")
+      .def(py::init<float, int32_t, int32_t>(), py::arg("beam") = 20,
+           py::arg("max_keyword_frames") = 100,
+           py::arg("max_blank_frames") = 25)
+      .def_readwrite("beam", &PyClass::beam)
+      .def_readwrite("max_keyword_frames", &PyClass::max_keyword_frames)
+      .def_readwrite("max_blank_frames", &PyClass::max_blank_frames)
+      .def("__str__", &PyClass::ToString);
+}
+
+void PybindKeywordSpotter(py::module *m) {
+  PybindKeywordTrigger(m);
+  PybindKeywordSpotterOptions(m);
+
+  py::class_<KeywordGraph>(*m, "KeywordGraph")
+      .def(py::init<const std::vector<std::vector<int32_t>> &, float,
+                    const std::vector<float> &, int32_t>(),
+           py::arg("keywords"), py::arg("threshold") = 0.5,
+           py::arg("thresholds") = std::vector<float>{},
+           py::arg("blank_id") = 0)
+      .def("num_keywords", &KeywordGraph::NumKeywords)
+      .def("num_positions", &KeywordGraph::NumPositions);
+
+  using PyClass = KeywordSpotter;
+  py::class_<PyClass>(*m, "KeywordSpotter")
+      .def(py::init<const KeywordGraph &, const KeywordSpotterOptions &>(),
+           py::arg("graph"), py::arg("opts") = KeywordSpotterOptions(),
+           py::keep_alive<1, 2>())
+      .def("get_options", &PyClass::GetOptions)
+      .def("init_decoding", &PyClass::InitDecoding)
+      .def("advance_decoding", &PyClass::AdvanceDecoding, py::arg("decodable"),
+           py::arg("max_num_frames") = -1)
+      .def("pop_triggers", &PyClass::PopTriggers)
+      .def("num_frames_decoded", &PyClass::NumFramesDecoded);
+}
+
+}  // namespace kaldi_decoder
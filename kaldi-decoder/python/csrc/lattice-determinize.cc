@@ -0,0 +1,27 @@
+// kaldi-decoder/python/csrc/lattice-determinize.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/python/csrc/lattice-determinize.h"
+
+#include <limits>
+#include <utility>
+
+#include "kaldi-decoder/csrc/lattice-determinize.h"
+
+namespace kaldi_decoder {
+
+void PybindLatticeDeterminize(py::module *m) {
+  m->def(
+      "determinize_lattice",
+      [](const fst::VectorFst<fst::LatticeArc> &ifst, float beam)
+          -> std::pair<bool, fst::VectorFst<fst::LatticeArc>> {
+        fst::VectorFst<fst::LatticeArc> ofst;
+        bool ok = DeterminizeLattice(ifst, &ofst, beam);
+        return std::make_pair(ok, ofst);
+      },
+      py::arg("ifst"),
+      py::arg("beam") = std::numeric_limits<float>::infinity());
+}
+
+}  // namespace kaldi_decoder
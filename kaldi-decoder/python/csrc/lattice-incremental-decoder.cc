@@ -0,0 +1,108 @@
+// kaldi-decoder/python/csrc/lattice-incremental-decoder.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/python/csrc/lattice-incremental-decoder.h"
+
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "kaldi-decoder/csrc/lattice-incremental-decoder.h"
+
+namespace kaldi_decoder {
+
+static void PybindLatticeIncrementalDecoderConfig(py::module *m) {
+  using PyClass = LatticeIncrementalDecoderConfig;
+
+  py::class_<PyClass>(*m, "LatticeIncrementalDecoderConfig")
+      .def(py::init<const LatticeSimpleDecoderConfig &, int32_t, int32_t>(),
+           py::arg("decoder_config") = LatticeSimpleDecoderConfig(),
+           py::arg("determinize_max_delay") = 60,
+           py::arg("determinize_min_chunk_size") = 20)
+      .def_readwrite("decoder_config", &PyClass::decoder_config)
+      .def_readwrite("determinize_max_delay", &PyClass::determinize_max_delay)
+      .def_readwrite("determinize_min_chunk_size",
+                     &PyClass::determinize_min_chunk_size)
+      .def("__str__", &PyClass::ToString);
+}
+
+void PybindLatticeIncrementalDecoder(py::module *m) {
+  PybindLatticeIncrementalDecoderConfig(m);
+
+  using PyClass = LatticeIncrementalDecoder;
+  py::class_<PyClass>(*m, "LatticeIncrementalDecoder")
+      .def(py::init<const fst::Fst<fst::StdArc> &,
+                    const LatticeIncrementalDecoderConfig &>(),
+           py::arg("fst"), py::arg("config"))
+      .def(py::init<const fst::VectorFst<fst::StdArc> &,
+                    const LatticeIncrementalDecoderConfig &>(),
+           py::arg("fst"), py::arg("config"))
+      .def(py::init<const fst::ConstFst<fst::StdArc> &,
+                    const LatticeIncrementalDecoderConfig &>(),
+           py::arg("fst"), py::arg("config"))
+      .def("get_config", &PyClass::GetIncrementalOptions)
+      .def("set_context_graph", &PyClass::SetContextGraph,
+           py::arg("context_graph"), py::keep_alive<1, 2>())
+      .def("num_frames_decoded", &PyClass::NumFramesDecoded)
+      .def("num_frames_determinized", &PyClass::NumFramesDeterminized)
+      .def("get_memory_stats", &PyClass::GetMemoryStats)
+      .def("final_relative_cost", &PyClass::FinalRelativeCost)
+      .def("decode", &PyClass::Decode, py::arg("decodable"))
+      .def("init_decoding", &PyClass::InitDecoding)
+      .def("advance_decoding", &PyClass::AdvanceDecoding, py::arg("decodable"),
+           py::arg("max_num_frames") = -1)
+      .def("reset", &PyClass::Reset)
+      .def("finalize_decoding", &PyClass::FinalizeDecoding)
+      .def(
+          "get_best_path",
+          [](PyClass &self, bool use_final_probs)
+              -> std::pair<bool, fst::VectorFst<fst::LatticeArc>> {
+            fst::VectorFst<fst::LatticeArc> fst;
+            bool ok = self.GetBestPath(&fst, use_final_probs);
+            return std::make_pair(ok, fst);
+          },
+          py::arg("use_final_probs") = true)
+      .def(
+          "get_raw_lattice",
+          [](PyClass &self, bool use_final_probs)
+              -> std::pair<bool, fst::VectorFst<fst::LatticeArc>> {
+            fst::VectorFst<fst::LatticeArc> fst;
+            bool ok = self.GetRawLattice(&fst, use_final_probs);
+            return std::make_pair(ok, fst);
+          },
+          py::arg("use_final_probs") = true)
+      .def("get_nbest", &PyClass::GetNBest, py::arg("n"),
+           py::arg("use_final_probs") = true,
+           py::arg("unique_word_sequences") = true)
+      .def("get_word_posteriors", &PyClass::GetWordPosteriors,
+           py::arg("acoustic_scale") = 1.0, py::arg("use_final_probs") = true)
+      .def("get_confusion_network", &PyClass::GetConfusionNetwork,
+           py::arg("opts") = ConfusionNetworkOptions(),
+           py::arg("use_final_probs") = true)
+      .def(
+          "get_lattice",
+          [](PyClass &self, bool use_final_probs)
+              -> std::pair<bool, fst::VectorFst<fst::LatticeArc>> {
+            fst::VectorFst<fst::LatticeArc> fst;
+            bool ok = self.GetLattice(&fst, use_final_probs);
+            return std::make_pair(ok, fst);
+          },
+          py::arg("use_final_probs") = true)
+      .def(
+          "snapshot",
+          [](const PyClass &self) -> py::bytes {
+            std::ostringstream os;
+            self.Snapshot(os);
+            return py::bytes(os.str());
+          })
+      .def(
+          "restore",
+          [](PyClass &self, const std::string &data) {
+            std::istringstream is(data);
+            self.Restore(is);
+          },
+          py::arg("data"));
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,16 @@
+// kaldi-decoder/python/csrc/lattice-incremental-decoder.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_PYTHON_CSRC_LATTICE_INCREMENTAL_DECODER_H_
+#define KALDI_DECODER_PYTHON_CSRC_LATTICE_INCREMENTAL_DECODER_H_
+
+#include "kaldi-decoder/python/csrc/kaldi-decoder.h"
+
+namespace kaldi_decoder {
+
+void PybindLatticeIncrementalDecoder(py::module *m);
+
+}
+
+#endif  // KALDI_DECODER_PYTHON_CSRC_LATTICE_INCREMENTAL_DECODER_H_
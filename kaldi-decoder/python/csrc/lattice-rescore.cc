@@ -0,0 +1,85 @@
+// kaldi-decoder/python/csrc/lattice-rescore.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/python/csrc/lattice-rescore.h"
+
+#include <utility>
+#include <vector>
+
+#include "kaldi-decoder/csrc/lattice-rescore.h"
+
+namespace kaldi_decoder {
+
+static void PybindLatticeRescoreOptions(py::module *m) {
+  using PyClass = LatticeRescoreOptions;
+
+  py::class_<PyClass>(*m, "LatticeRescoreOptions")
+      .def(py::init<float, float, float, int32_t>(),
+           py::arg("old_lm_scale") = 1.0, py::arg("new_lm_scale") = 1.0,
+           py::arg("beam") = 8.0, py::arg("max_states") = -1)
+      .def_readwrite("old_lm_scale", &PyClass::old_lm_scale)
+      .def_readwrite("new_lm_scale", &PyClass::new_lm_scale)
+      .def_readwrite("beam", &PyClass::beam)
+      .def_readwrite("max_states", &PyClass::max_states)
+      .def("__str__", &PyClass::ToString);
+}
+
+void PybindLatticeRescore(py::module *m) {
+  PybindLatticeRescoreOptions(m);
+
+  m->def(
+      "rescore_lattice",
+      [](const fst::VectorFst<fst::LatticeArc> &ifst,
+         const DeterministicLm *old_lm, const DeterministicLm &new_lm,
+         const LatticeRescoreOptions &opts)
+          -> std::pair<bool, fst::VectorFst<fst::LatticeArc>> {
+        fst::VectorFst<fst::LatticeArc> ofst;
+        bool ok = RescoreLattice(ifst, old_lm, new_lm, opts, &ofst);
+        return std::make_pair(ok, ofst);
+      },
+      py::arg("ifst"), py::arg("old_lm"), py::arg("new_lm"),
+      py::arg("opts") = LatticeRescoreOptions());
+
+  using PyClass = LatticeRescorer;
+  py::class_<PyClass>(*m, "LatticeRescorer")
+      .def(py::init<const DeterministicLm *, const DeterministicLm &,
+                    const LatticeRescoreOptions &>(),
+           py::arg("old_lm"), py::arg("new_lm"),
+           py::arg("opts") = LatticeRescoreOptions(), py::keep_alive<1, 2>(),
+           py::keep_alive<1, 3>())
+      .def("get_options", &PyClass::GetOptions)
+      .def(
+          "rescore",
+          [](const PyClass &self, const fst::VectorFst<fst::LatticeArc> &ifst)
+              -> std::pair<bool, fst::VectorFst<fst::LatticeArc>> {
+            fst::VectorFst<fst::LatticeArc> ofst;
+            bool ok = self.Rescore(ifst, &ofst);
+            return std::make_pair(ok, ofst);
+          },
+          py::arg("ifst"))
+      .def(
+          "rescore_batch",
+          [](const PyClass &self,
+             const std::vector<fst::VectorFst<fst::LatticeArc>> &ifsts,
+             int32_t num_threads)
+              -> std::vector<std::pair<bool, fst::VectorFst<fst::LatticeArc>>> {
+            std::vector<fst::VectorFst<fst::LatticeArc>> ofsts;
+            std::vector<bool> ok;
+            {
+              // LMs implemented in Python acquire the GIL in their methods
+              py::gil_scoped_release release;
+              ok = self.RescoreBatch(ifsts, &ofsts, num_threads);
+            }
+
+            std::vector<std::pair<bool, fst::VectorFst<fst::LatticeArc>>> ans;
+            ans.reserve(ok.size());
+            for (size_t i = 0; i != ok.size(); ++i) {
+              ans.emplace_back(ok[i], std::move(ofsts[i]));
+            }
+            return ans;
+          },
+          py::arg("ifsts"), py::arg("num_threads") = 1);
+}
+
+}  // namespace kaldi_decoder
@@ -4,6 +4,10 @@
 
 #include "kaldi-decoder/python/csrc/lattice-simple-decoder.h"
 
+#include <sstream>
+#include <string>
+#include <utility>
+
 #include "kaldi-decoder/csrc/lattice-simple-decoder.h"
 
 namespace kaldi_decoder {
@@ -12,12 +16,13 @@ static void PybindLatticeSimpleDecoderConfig(py::module *m) {
   using PyClass = LatticeSimpleDecoderConfig;
 
   py::class_<PyClass>(*m, "LatticeSimpleDecoderConfig")
-      .def(py::init<float, float, int32_t, bool, bool, float, float>(),
+      .def(py::init<float, float, int32_t, bool, bool, float, float,
+                    int64_t>(),
            py::arg("beam") = 16.0, py::arg("lattice_beam") = 10.0,
            py::arg("prune_interval") = 25,
            py::arg("determinize_lattice") = true,
            py::arg("prune_lattice") = true, py::arg("beam_ratio") = 0.9,
-           py::arg("prune_scale") = 0.1)
+           py::arg("prune_scale") = 0.1, py::arg("max_mem_bytes") = 0)
       .def_readwrite("beam", &PyClass::beam)
       .def_readwrite("lattice_beam", &PyClass::lattice_beam)
       .def_readwrite("prune_interval", &PyClass::prune_interval)
@@ -25,11 +30,25 @@ static void PybindLatticeSimpleDecoderConfig(py::module *m) {
       .def_readwrite("prune_lattice", &PyClass::prune_lattice)
       .def_readwrite("beam_ratio", &PyClass::beam_ratio)
       .def_readwrite("prune_scale", &PyClass::prune_scale)
+      .def_readwrite("max_mem_bytes", &PyClass::max_mem_bytes)
       .def("__str__", &PyClass::ToString);
 }
 
+static void PybindNBestHypothesis(py::module *m) {
+  using PyClass = NBestHypothesis;
+
+  py::class_<PyClass>(*m, "NBestHypothesis")
+      .def_readonly("words", &PyClass::words)
+      .def_readonly("word_frames", &PyClass::word_frames)
+      .def_readonly("alignment", &PyClass::alignment)
+      .def_readonly("graph_cost", &PyClass::graph_cost)
+      .def_readonly("acoustic_cost", &PyClass::acoustic_cost)
+      .def_property_readonly("total_cost", &PyClass::TotalCost);
+}
+
 void PybindLatticeSimpleDecoder(py::module *m) {
   PybindLatticeSimpleDecoderConfig(m);
+  PybindNBestHypothesis(m);
 
   using PyClass = LatticeSimpleDecoder;
   py::class_<PyClass>(*m, "LatticeSimpleDecoder")
@@ -43,10 +62,16 @@ void PybindLatticeSimpleDecoder(py::module *m) {
                     const LatticeSimpleDecoderConfig &>(),
            py::arg("fst"), py::arg("config"))
       .def("get_config", &PyClass::GetOptions)
+      .def("set_context_graph", &PyClass::SetContextGraph,
+           py::arg("context_graph"), py::keep_alive<1, 2>())
       .def("num_frames_decoded", &PyClass::NumFramesDecoded)
+      .def("get_memory_stats", &PyClass::GetMemoryStats)
       .def("final_relative_cost", &PyClass::FinalRelativeCost)
       .def("decode", &PyClass::Decode, py::arg("decodable"))
       .def("init_decoding", &PyClass::InitDecoding)
+      .def("advance_decoding", &PyClass::AdvanceDecoding, py::arg("decodable"),
+           py::arg("max_num_frames") = -1)
+      .def("reset", &PyClass::Reset)
       .def("finalize_decoding", &PyClass::FinalizeDecoding)
       .def(
           "get_best_path",
@@ -65,7 +90,35 @@ void PybindLatticeSimpleDecoder(py::module *m) {
             bool ok = self.GetRawLattice(&fst, use_final_probs);
             return std::make_pair(ok, fst);
           },
-          py::arg("use_final_probs") = true);
+          py::arg("use_final_probs") = true)
+      .def("get_nbest", &PyClass::GetNBest, py::arg("n"),
+           py::arg("use_final_probs") = true,
+           py::arg("unique_word_sequences") = true)
+      .def("get_word_posteriors", &PyClass::GetWordPosteriors,
+           py::arg("acoustic_scale") = 1.0, py::arg("use_final_probs") = true)
+      .def("get_confusion_network", &PyClass::GetConfusionNetwork,
+           py::arg("opts") = ConfusionNetworkOptions(),
+           py::arg("use_final_probs") = true)
+      .def(
+          "extend_raw_lattice",
+          [](PyClass &self, fst::VectorFst<fst::LatticeArc> *lat) -> int32_t {
+            return self.ExtendRawLattice(lat);
+          },
+          py::arg("lat"))
+      .def(
+          "snapshot",
+          [](const PyClass &self) -> py::bytes {
+            std::ostringstream os;
+            self.Snapshot(os);
+            return py::bytes(os.str());
+          })
+      .def(
+          "restore",
+          [](PyClass &self, const std::string &data) {
+            std::istringstream is(data);
+            self.Restore(is);
+          },
+          py::arg("data"));
 }
 
 }  // namespace kaldi_decoder
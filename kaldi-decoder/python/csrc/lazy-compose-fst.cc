@@ -0,0 +1,43 @@
+// kaldi-decoder/python/csrc/lazy-compose-fst.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/python/csrc/lazy-compose-fst.h"
+
+#include "kaldi-decoder/csrc/lazy-compose-fst.h"
+
+namespace kaldi_decoder {
+
+static void PybindLazyComposeFstOptions(py::module *m) {
+  using PyClass = LazyComposeFstOptions;
+  py::class_<PyClass>(*m, "LazyComposeFstOptions")
+      .def(py::init<int64_t, bool>(), py::arg("cache_size") = (1 << 26),
+           py::arg("gc") = true)
+      .def_readwrite("cache_size", &PyClass::cache_size)
+      .def_readwrite("gc", &PyClass::gc)
+      .def("__str__", &PyClass::ToString);
+}
+
+void PybindLazyComposeFst(py::module *m) {
+  PybindLazyComposeFstOptions(m);
+
+  using PyClass = LazyComposeFst;
+  py::class_<PyClass>(*m, "LazyComposeFst")
+      .def(py::init<const fst::Fst<fst::StdArc> &,
+                    const fst::Fst<fst::StdArc> &,
+                    const LazyComposeFstOptions &>(),
+           py::arg("hcl"), py::arg("g"), py::arg("opts"))
+      .def(py::init<const fst::VectorFst<fst::StdArc> &,
+                    const fst::VectorFst<fst::StdArc> &,
+                    const LazyComposeFstOptions &>(),
+           py::arg("hcl"), py::arg("g"), py::arg("opts"))
+      .def(py::init<const fst::ConstFst<fst::StdArc> &,
+                    const fst::ConstFst<fst::StdArc> &,
+                    const LazyComposeFstOptions &>(),
+           py::arg("hcl"), py::arg("g"), py::arg("opts"))
+      .def_property_readonly("fst", &PyClass::GetFst,
+                             py::return_value_policy::reference_internal)
+      .def("get_options", &PyClass::GetOptions);
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,16 @@
+// kaldi-decoder/python/csrc/lazy-compose-fst.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_PYTHON_CSRC_LAZY_COMPOSE_FST_H_
+#define KALDI_DECODER_PYTHON_CSRC_LAZY_COMPOSE_FST_H_
+
+#include "kaldi-decoder/python/csrc/kaldi-decoder.h"
+
+namespace kaldi_decoder {
+
+void PybindLazyComposeFst(py::module *m);
+
+}
+
+#endif  // KALDI_DECODER_PYTHON_CSRC_LAZY_COMPOSE_FST_H_
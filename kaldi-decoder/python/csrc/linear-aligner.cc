@@ -0,0 +1,84 @@
+// kaldi-decoder/python/csrc/linear-aligner.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/python/csrc/linear-aligner.h"
+
+#include <tuple>
+#include <vector>
+
+#include "kaldi-decoder/csrc/linear-aligner.h"
+
+namespace kaldi_decoder {
+
+static void PybindLinearAlignmentGraph(py::module *m) {
+  using PyClass = LinearAlignmentGraph;
+
+  py::class_<PyClass> graph(*m, "LinearAlignmentGraph");
+
+  py::class_<PyClass::State>(graph, "State")
+      .def(py::init<>())
+      .def_readwrite("loop_label", &PyClass::State::loop_label)
+      .def_readwrite("loop_cost", &PyClass::State::loop_cost)
+      .def_readwrite("next_label", &PyClass::State::next_label)
+      .def_readwrite("next_cost", &PyClass::State::next_cost)
+      .def_readwrite("skip_label", &PyClass::State::skip_label)
+      .def_readwrite("skip_cost", &PyClass::State::skip_cost)
+      .def_readwrite("final_cost", &PyClass::State::final_cost);
+
+  graph.def(py::init<>()).def_readwrite("states", &PyClass::states);
+
+  m->def("build_ctc_alignment_graph", &BuildCtcAlignmentGraph,
+         py::arg("tokens"), py::arg("blank_id") = 0);
+
+  m->def("linear_alignment_graph_from_fst", &LinearAlignmentGraphFromFst,
+         py::arg("fst"));
+  m->def(
+      "linear_alignment_graph_from_fst",
+      [](const fst::VectorFst<fst::StdArc> &fst) {
+        return LinearAlignmentGraphFromFst(fst);
+      },
+      py::arg("fst"));
+  m->def(
+      "linear_alignment_graph_from_fst",
+      [](const fst::ConstFst<fst::StdArc> &fst) {
+        return LinearAlignmentGraphFromFst(fst);
+      },
+      py::arg("fst"));
+}
+
+static void PybindLinearAlignerOptions(py::module *m) {
+  using PyClass = LinearAlignerOptions;
+
+  py::class_<PyClass>(*m, "LinearAlignerOptions")
+      .def(py::init<int32_t, int32_t>(), py::arg("band_width") = 200,
+           py::arg("retry_band_width") = 0)
+      .def_readwrite("band_width", &PyClass::band_width)
+      .def_readwrite("retry_band_width", &PyClass::retry_band_width)
+      .def("__str__", &PyClass::ToString);
+}
+
+void PybindLinearAligner(py::module *m) {
+  PybindLinearAlignmentGraph(m);
+  PybindLinearAlignerOptions(m);
+
+  using PyClass = LinearAligner;
+  py::class_<PyClass>(*m, "LinearAligner")
+      .def(py::init<const LinearAlignmentGraph &,
+                    const LinearAlignerOptions &>(),
+           py::arg("graph"), py::arg("opts") = LinearAlignerOptions())
+      .def("get_options", &PyClass::GetOptions)
+      .def(
+          "align",
+          [](PyClass &self, DecodableInterface *decodable)
+              -> std::tuple<bool, std::vector<int32_t>, std::vector<int32_t>> {
+            std::vector<int32_t> alignment;
+            std::vector<int32_t> states;
+            bool ok = self.Align(decodable, &alignment, &states);
+            return std::make_tuple(ok, alignment, states);
+          },
+          py::arg("decodable"))
+      .def("total_cost", &PyClass::TotalCost);
+}
+
+}  // namespace kaldi_decoder
@@ -0,0 +1,16 @@
+// kaldi-decoder/python/csrc/linear-aligner.h
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#ifndef KALDI_DECODER_PYTHON_CSRC_LINEAR_ALIGNER_H_
+#define KALDI_DECODER_PYTHON_CSRC_LINEAR_ALIGNER_H_
+
+#include "kaldi-decoder/python/csrc/kaldi-decoder.h"
+
+namespace kaldi_decoder {
+
+void PybindLinearAligner(py::module *m);
+
+}
+
+#endif  // KALDI_DECODER_PYTHON_CSRC_LINEAR_ALIGNER_H_
@@ -0,0 +1,56 @@
+// kaldi-decoder/python/csrc/shared-graph.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/python/csrc/shared-graph.h"
+
+#include "kaldi-decoder/csrc/numa.h"
+#include "kaldi-decoder/csrc/shared-graph.h"
+
+namespace kaldi_decoder {
+
+static void PybindSharedGraphConfig(py::module *m) {
+  using PyClass = SharedGraphConfig;
+  py::class_<PyClass>(*m, "SharedGraphConfig")
+      .def(py::init<bool>(), py::arg("replicate_per_numa_node") = false)
+      .def_readwrite("replicate_per_numa_node",
+                     &PyClass::replicate_per_numa_node)
+      .def("__str__", &PyClass::ToString);
+}
+
+void PybindSharedGraph(py::module *m) {
+  PybindSharedGraphConfig(m);
+
+  using PyClass = SharedGraph;
+  py::class_<PyClass>(*m, "SharedGraph")
+      .def(py::init<const fst::Fst<fst::StdArc> &,
+                    const SharedGraphConfig &>(),
+           py::arg("fst"), py::arg("config") = SharedGraphConfig())
+      .def(py::init<const fst::VectorFst<fst::StdArc> &,
+                    const SharedGraphConfig &>(),
+           py::arg("fst"), py::arg("config") = SharedGraphConfig())
+      .def(py::init<const fst::ConstFst<fst::StdArc> &,
+                    const SharedGraphConfig &>(),
+           py::arg("fst"), py::arg("config") = SharedGraphConfig())
+      .def_property_readonly(
+          "fst", [](const PyClass &self) -> const fst::Fst<fst::StdArc> & {
+            return self.GetFst();
+          },
+          py::return_value_policy::reference_internal)
+      .def(
+          "get_fst",
+          [](const PyClass &self, int32_t numa_node)
+              -> const fst::Fst<fst::StdArc> & {
+            return self.GetFst(numa_node);
+          },
+          py::arg("numa_node"), py::return_value_policy::reference_internal)
+      .def_property_readonly("num_replicas", &PyClass::NumReplicas)
+      .def_property_readonly("num_states", &PyClass::NumStates)
+      .def_property_readonly("num_arcs", &PyClass::NumArcs)
+      .def_property_readonly("properties", &PyClass::Properties)
+      .def_property_readonly("config", &PyClass::GetConfig);
+
+  m->def("num_numa_nodes", &NumNumaNodes);
+}
+
+}  // namespace kaldi_decoder
@@ -34,7 +34,11 @@ void PybindSimpleDecoder(py::module *m) {
       .def("init_decoding", &PyClass::InitDecoding)
       .def("advance_decoding", &PyClass::AdvanceDecoding, py::arg("decodable"),
            py::arg("max_num_frames") = -1)
-      .def("num_frames_decoded", &PyClass::NumFramesDecoded);
+      .def("set_endpoint_config", &PyClass::SetEndpointConfig,
+           py::arg("config"))
+      .def("endpoint_detected", &PyClass::EndpointDetected)
+      .def("num_frames_decoded", &PyClass::NumFramesDecoded)
+      .def("get_memory_stats", &PyClass::GetMemoryStats);
 }
 
 }  // namespace kaldi_decoder
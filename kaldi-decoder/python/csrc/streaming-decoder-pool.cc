@@ -0,0 +1,140 @@
+// kaldi-decoder/python/csrc/streaming-decoder-pool.cc
+//
+// Copyright (c)  2023  Xiaomi Corporation
+
+#include "kaldi-decoder/python/csrc/streaming-decoder-pool.h"
+
+#include <chrono>  // NOLINT
+#include <future>  // NOLINT
+#include <memory>
+#include <string>
+
+#include "kaldi-decoder/csrc/ctc-decoder.h"
+#include "kaldi-decoder/csrc/faster-decoder.h"
+#include "kaldi-decoder/csrc/streaming-decoder-pool.h"
+
+namespace kaldi_decoder {
+
+namespace {
+
+// The workers may be running Python callbacks, which need the GIL, so it is
+// released while the pool is shut down.
+template <class T>
+struct ReleaseGilDeleter {
+  void operator()(T *p) const {
+    py::gil_scoped_release release;
+    delete p;
+  }
+};
+
+}  // namespace
+
+static void PybindStreamingDecoderPoolConfig(py::module *m) {
+  using PyClass = StreamingDecoderPoolConfig;
+  py::class_<PyClass>(*m, "StreamingDecoderPoolConfig")
+      .def(py::init([](int32_t num_threads, float max_latency_ms,
+                       int32_t max_idle_decoders) {
+             auto ans = std::make_unique<PyClass>();
+             ans->num_threads = num_threads;
+             ans->max_latency_ms = max_latency_ms;
+             ans->max_idle_decoders = max_idle_decoders;
+             return ans;
+           }),
+           py::arg("num_threads") = 1, py::arg("max_latency_ms") = 100,
+           py::arg("max_idle_decoders") = 64)
+      .def_readwrite("num_threads", &PyClass::num_threads)
+      .def_readwrite("max_latency_ms", &PyClass::max_latency_ms)
+      .def_readwrite("max_idle_decoders", &PyClass::max_idle_decoders)
+      .def("__str__", &PyClass::ToString);
+}
+
+static void PybindStreamingResult(py::module *m) {
+  using PyClass = StreamingResult;
+  py::class_<PyClass>(*m, "StreamingResult")
+      .def_readonly("words", &PyClass::words)
+      .def_readonly("num_frames_decoded", &PyClass::num_frames_decoded)
+      .def_readonly("endpoint_detected", &PyClass::endpoint_detected)
+      .def_readonly("is_final", &PyClass::is_final)
+      .def("__str__", &PyClass::ToString);
+
+  using Future = std::shared_future<StreamingResult>;
+  py::class_<Future>(*m, "StreamingResultFuture")
+      .def("get", &Future::get, py::call_guard<py::gil_scoped_release>())
+      .def("ready", [](const Future &self) {
+        return self.wait_for(std::chrono::seconds(0)) ==
+               std::future_status::ready;
+      });
+}
+
+// The decoders keep a reference to the graph, which is thus kept alive by
+// the pool
+template <class Decoder, class Fst, class PyPool>
+static void DefInit(PyPool *pool) {
+  using PyClass = StreamingDecoderPool<Decoder>;
+  pool->def(py::init([](const Fst &fst, const FasterDecoderOptions &options,
+                        const StreamingDecoderPoolConfig &config) {
+              auto factory = [&fst, options]() {
+                return std::make_unique<Decoder>(fst, options);
+              };
+              return new PyClass(factory, config);
+            }),
+            py::arg("fst"), py::arg("options"),
+            py::arg("config") = StreamingDecoderPoolConfig(),
+            py::keep_alive<1, 2>());
+}
+
+template <class Decoder>
+static void PybindStreamingDecoderPoolImpl(py::module *m,
+                                           const std::string &name) {
+  using PyClass = StreamingDecoderPool<Decoder>;
+  using Session = typename PyClass::Session;
+
+  py::class_<PyClass, std::unique_ptr<PyClass, ReleaseGilDeleter<PyClass>>>
+      pool(*m, name.c_str());
+
+  py::class_<Session, std::shared_ptr<Session>>(pool, "Session")
+      .def("accept_chunk", &Session::AcceptChunk, py::arg("log_probs"))
+      .def("input_finished", [](Session &self) {
+        return std::shared_future<StreamingResult>(self.InputFinished());
+      });
+
+  DefInit<Decoder, fst::Fst<fst::StdArc>>(&pool);
+  DefInit<Decoder, fst::VectorFst<fst::StdArc>>(&pool);
+  DefInit<Decoder, fst::ConstFst<fst::StdArc>>(&pool);
+
+  pool.def(
+      "create_session",
+      [](PyClass &self, py::object callback, float max_latency_ms) {
+        typename PyClass::Callback cb;
+        if (!callback.is_none()) {
+          // The function is called and destroyed by the workers, which
+          // do not hold the GIL
+          std::shared_ptr<py::function> f(
+              new py::function(callback.cast<py::function>()),
+              [](py::function *p) {
+                py::gil_scoped_acquire acquire;
+                delete p;
+              });
+          cb = [f](const StreamingResult &r) {
+            py::gil_scoped_acquire acquire;
+            (*f)(r);
+          };
+        }
+        return self.CreateSession(std::move(cb), max_latency_ms);
+      },
+      py::arg("callback") = py::none(), py::arg("max_latency_ms") = -1,
+      py::keep_alive<0, 1>())
+      .def("shutdown", &PyClass::Shutdown,
+           py::call_guard<py::gil_scoped_release>())
+      .def("num_queued", &PyClass::NumQueued);
+}
+
+void PybindStreamingDecoderPool(py::module *m) {
+  PybindStreamingDecoderPoolConfig(m);
+  PybindStreamingResult(m);
+  PybindStreamingDecoderPoolImpl<FasterDecoder>(m,
+                                                "StreamingFasterDecoderPool");
+  PybindStreamingDecoderPoolImpl<CtcDecoder>(m, "StreamingCtcDecoderPool");
+}
+
+}  // namespace kaldi_decoder
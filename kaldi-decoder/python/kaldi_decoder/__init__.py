@@ -1,9 +1,51 @@
 from kaldi_decoder.lib._kaldi_decoder import (
+    ArpaBackoffLm,
+    ConfusionBin,
+    ConfusionNetworkOptions,
+    ContextGraph,
+    CtcDecoder,
+    DecodableChunked,
     DecodableCtc,
     DecodableInterface,
+    DecoderMemoryStats,
+    DeterministicLm,
+    EndpointConfig,
+    EndpointRule,
     FasterDecoder,
     FasterDecoderOptions,
+    FstBackoffLm,
+    KeywordGraph,
+    KeywordSpotter,
+    KeywordSpotterOptions,
+    KeywordTrigger,
+    LatticeIncrementalDecoder,
+    LatticeIncrementalDecoderConfig,
+    LatticeRescoreOptions,
+    LatticeRescorer,
     LatticeSimpleDecoder,
     LatticeSimpleDecoderConfig,
+    LazyComposeFst,
+    LazyComposeFstOptions,
+    LinearAligner,
+    LinearAlignerOptions,
+    LinearAlignmentGraph,
+    NBestHypothesis,
+    SharedGraph,
+    SharedGraphConfig,
     SimpleDecoder,
+    StreamingCtcDecoderPool,
+    StreamingDecoderPoolConfig,
+    StreamingFasterDecoderPool,
+    StreamingResult,
+    StreamingResultFuture,
+    WordPosterior,
+    build_confusion_network,
+    build_ctc_alignment_graph,
+    determinize_lattice,
+    linear_alignment_graph_from_fst,
+    log_softmax_rows,
+    mbr_decode,
+    num_numa_nodes,
+    read_symbol_table,
+    rescore_lattice,
 )
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+#
+# Copyright (c)  2023  Xiaomi Corporation
+
+# A smoke test: importing the module runs all of its bindings, and the
+# default arguments of a binding must be registered before it.
+
+import unittest
+
+import numpy as np
+
+try:
+    import kaldi_decoder
+except ImportError:
+    # From the build tree; see tests/CMakeLists.txt
+    import _kaldi_decoder as kaldi_decoder
+
+try:
+    import kaldifst
+except ImportError:
+    kaldifst = None
+
+
+class TestLatticeIncrementalDecoder(unittest.TestCase):
+    def test_default_config(self):
+        config = kaldi_decoder.LatticeIncrementalDecoderConfig()
+        self.assertEqual(config.determinize_max_delay, 60)
+        self.assertEqual(config.determinize_min_chunk_size, 20)
+        self.assertIn("LatticeSimpleDecoderConfig", str(config))
+
+    @unittest.skipIf(kaldifst is None, "kaldifst is not installed")
+    def test_decode(self):
+        # One state with self-loops on the tokens 1 and 2
+        fst = kaldifst.StdVectorFst()
+        s = fst.add_state()
+        fst.start = s
+        fst.set_final(state=s, weight=0)
+        for i in (1, 2):
+            fst.add_arc(
+                state=s,
+                arc=kaldifst.StdArc(ilabel=i, olabel=i, weight=0, nextstate=s),
+            )
+
+        decoder = kaldi_decoder.LatticeIncrementalDecoder(
+            fst, kaldi_decoder.LatticeIncrementalDecoderConfig()
+        )
+        log_probs = np.log(
+            np.array([[0.9, 0.1], [0.2, 0.8], [0.7, 0.3]], dtype=np.float32)
+        )
+        decodable = kaldi_decoder.DecodableCtc(log_probs)
+        self.assertTrue(decoder.decode(decodable))
+        self.assertEqual(decoder.num_frames_decoded(), 3)
+
+        ok, lattice = decoder.get_lattice()
+        self.assertTrue(ok)
+
+
+if __name__ == "__main__":
+    unittest.main()